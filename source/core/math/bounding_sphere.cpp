@@ -0,0 +1,287 @@
+#include "bounding_sphere.h"
+#include "../parallel/parallel.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace fantasy
+{
+    // EPOS-26 使用的 13 个方向, 不需要归一化, 只用于比较投影大小.
+    static const float3 epos_directions[13] = {
+        float3(1.0f, 0.0f, 0.0f), float3(0.0f, 1.0f, 0.0f), float3(0.0f, 0.0f, 1.0f),
+        float3(1.0f, 1.0f, 1.0f), float3(1.0f, 1.0f, -1.0f), float3(1.0f, -1.0f, 1.0f), float3(1.0f, -1.0f, -1.0f),
+        float3(1.0f, 1.0f, 0.0f), float3(1.0f, -1.0f, 0.0f), float3(1.0f, 0.0f, 1.0f),
+        float3(1.0f, 0.0f, -1.0f), float3(0.0f, 1.0f, 1.0f), float3(0.0f, 1.0f, -1.0f)
+    };
+
+    static constexpr uint32_t EPOS_DIRECTION_COUNT = 13;
+    static constexpr uint32_t MIN_SPHERE_DIRECT_COUNT = 2 * EPOS_DIRECTION_COUNT;
+
+    // 点数较多时瓶颈在遍历上, 改用 EPOS-6 (只取三个坐标轴方向).
+    static constexpr uint64_t EPOS6_POINT_COUNT = 1ull << 16;
+
+    struct ExtremePoints
+    {
+        uint32_t direction_count = EPOS_DIRECTION_COUNT;
+        float min_projections[EPOS_DIRECTION_COUNT];
+        float max_projections[EPOS_DIRECTION_COUNT];
+        float3 min_points[EPOS_DIRECTION_COUNT];
+        float3 max_points[EPOS_DIRECTION_COUNT];
+
+        ExtremePoints()
+        {
+            std::fill_n(min_projections, EPOS_DIRECTION_COUNT, FLT_MAX);
+            std::fill_n(max_projections, EPOS_DIRECTION_COUNT, -FLT_MAX);
+        }
+
+        void merge(const ExtremePoints& other)
+        {
+            for (uint32_t ix = 0; ix < direction_count; ++ix)
+            {
+                if (other.min_projections[ix] < min_projections[ix])
+                {
+                    min_projections[ix] = other.min_projections[ix];
+                    min_points[ix] = other.min_points[ix];
+                }
+                if (other.max_projections[ix] > max_projections[ix])
+                {
+                    max_projections[ix] = other.max_projections[ix];
+                    max_points[ix] = other.max_points[ix];
+                }
+            }
+        }
+    };
+
+    template <uint32_t DirectionCount>
+    static ExtremePoints find_extreme_points(std::span<const float3> points)
+    {
+        // 只记录下标, 循环体内用条件选择代替分支, 方便编译器生成 cmov/blend.
+        float min_projections[DirectionCount];
+        float max_projections[DirectionCount];
+        uint64_t min_indices[DirectionCount] = {};
+        uint64_t max_indices[DirectionCount] = {};
+        std::fill_n(min_projections, DirectionCount, FLT_MAX);
+        std::fill_n(max_projections, DirectionCount, -FLT_MAX);
+
+        for (uint64_t point_index = 0; point_index < points.size(); ++point_index)
+        {
+            const float3& point = points[point_index];
+            for (uint32_t ix = 0; ix < DirectionCount; ++ix)
+            {
+                const float projection = dot(point, epos_directions[ix]);
+                const bool less = projection < min_projections[ix];
+                const bool greater = projection > max_projections[ix];
+                min_projections[ix] = less ? projection : min_projections[ix];
+                max_projections[ix] = greater ? projection : max_projections[ix];
+                min_indices[ix] = less ? point_index : min_indices[ix];
+                max_indices[ix] = greater ? point_index : max_indices[ix];
+            }
+        }
+
+        ExtremePoints extremes;
+        extremes.direction_count = DirectionCount;
+        for (uint32_t ix = 0; ix < DirectionCount; ++ix)
+        {
+            extremes.min_projections[ix] = min_projections[ix];
+            extremes.max_projections[ix] = max_projections[ix];
+            extremes.min_points[ix] = points[min_indices[ix]];
+            extremes.max_points[ix] = points[max_indices[ix]];
+        }
+        return extremes;
+    }
+
+    static bool sphere_contain(const Sphere& sphere, const float3& point)
+    {
+        const float radius = sphere.radius * (1.0f + 1e-5f) + 1e-7f;
+        return (point - sphere.center).length_squared() <= radius * radius;
+    }
+
+    static Sphere sphere_from_points(const float3& p0, const float3& p1)
+    {
+        return Sphere((p0 + p1) * 0.5f, (p1 - p0).length() * 0.5f);
+    }
+
+    static Sphere sphere_from_points(const float3& p0, const float3& p1, const float3& p2)
+    {
+        const float3 a = p1 - p0;
+        const float3 b = p2 - p0;
+        const float3 normal = cross(a, b);
+        const float denominator = 2.0f * normal.length_squared();
+
+        // 三点共线时退化为最远两点的包围球.
+        if (denominator < FLT_EPSILON * std::max(a.length_squared(), b.length_squared()))
+        {
+            Sphere sphere = sphere_from_points(p0, p1);
+            if (!sphere_contain(sphere, p2)) sphere = sphere_from_points(p0, p2);
+            if (!sphere_contain(sphere, p1)) sphere = sphere_from_points(p1, p2);
+            return sphere;
+        }
+
+        const float3 offset = (cross(normal, a) * b.length_squared() + cross(b, normal) * a.length_squared()) / denominator;
+        return Sphere(p0 + offset, offset.length());
+    }
+
+    static Sphere sphere_from_points(const float3& p0, const float3& p1, const float3& p2, const float3& p3)
+    {
+        const float3 a = p1 - p0;
+        const float3 b = p2 - p0;
+        const float3 c = p3 - p0;
+        const float denominator = 2.0f * dot(a, cross(b, c));
+
+        // 四点共面时取包含全部四点的最小三点包围球.
+        if (std::abs(denominator) < FLT_EPSILON * a.length() * b.length() * c.length())
+        {
+            const float3 points[4] = { p0, p1, p2, p3 };
+            Sphere best(float3(0.0f), FLT_MAX);
+            for (uint32_t skip = 0; skip < 4; ++skip)
+            {
+                const float3& q0 = points[skip == 0 ? 1 : 0];
+                const float3& q1 = points[skip <= 1 ? 2 : 1];
+                const float3& q2 = points[skip <= 2 ? 3 : 2];
+                const Sphere sphere = sphere_from_points(q0, q1, q2);
+                if (sphere.radius < best.radius && sphere_contain(sphere, points[skip])) best = sphere;
+            }
+            if (best.radius == FLT_MAX) best = merge(sphere_from_points(p0, p1, p2), Sphere(p3, 0.0f));
+            return best;
+        }
+
+        const float3 offset = (
+            cross(b, c) * a.length_squared() +
+            cross(c, a) * b.length_squared() +
+            cross(a, b) * c.length_squared()
+        ) / denominator;
+        return Sphere(p0 + offset, offset.length());
+    }
+
+    static Sphere sphere_from_support(const float3* support, uint32_t support_count)
+    {
+        switch (support_count)
+        {
+        case 0: return Sphere(float3(0.0f), -1.0f);
+        case 1: return Sphere(support[0], 0.0f);
+        case 2: return sphere_from_points(support[0], support[1]);
+        case 3: return sphere_from_points(support[0], support[1], support[2]);
+        default: return sphere_from_points(support[0], support[1], support[2], support[3]);
+        }
+    }
+
+    static Sphere welzl(float3* points, uint32_t count, float3* support, uint32_t support_count)
+    {
+        Sphere sphere = sphere_from_support(support, support_count);
+        if (support_count == 4) return sphere;
+
+        for (uint32_t ix = 0; ix < count; ++ix)
+        {
+            if (sphere.radius >= 0.0f && sphere_contain(sphere, points[ix])) continue;
+
+            support[support_count] = points[ix];
+            sphere = welzl(points, ix, support, support_count + 1);
+
+            // move-to-front, 让靠近边界的点优先被检查.
+            std::rotate(points, points + ix, points + ix + 1);
+        }
+        return sphere;
+    }
+
+    Sphere compute_min_sphere(std::span<const float3> points)
+    {
+        if (points.empty()) return Sphere(float3(0.0f), 0.0f);
+
+        std::vector<float3> copy(points.begin(), points.end());
+        float3 support[4];
+        return welzl(copy.data(), static_cast<uint32_t>(copy.size()), support, 0);
+    }
+
+    static Sphere compute_extreme_sphere(const ExtremePoints& extremes)
+    {
+        float3 points[MIN_SPHERE_DIRECT_COUNT];
+        for (uint32_t ix = 0; ix < extremes.direction_count; ++ix)
+        {
+            points[ix * 2 + 0] = extremes.min_points[ix];
+            points[ix * 2 + 1] = extremes.max_points[ix];
+        }
+        return compute_min_sphere(std::span<const float3>(points, extremes.direction_count * 2));
+    }
+
+    // Ritter 扩张. 按块先无分支地求块内最大距离, 只有块内存在球外的点时才逐点扩张.
+    static Sphere grow_sphere(Sphere sphere, std::span<const float3> points)
+    {
+        constexpr uint64_t block_size = 64;
+
+        float radius_squared = sphere.radius * sphere.radius;
+        for (uint64_t begin = 0; begin < points.size(); begin += block_size)
+        {
+            const uint64_t end = std::min<uint64_t>(begin + block_size, points.size());
+
+            float max_distance_squared = 0.0f;
+            for (uint64_t ix = begin; ix < end; ++ix)
+            {
+                max_distance_squared = std::max(max_distance_squared, (points[ix] - sphere.center).length_squared());
+            }
+            if (max_distance_squared <= radius_squared) continue;
+
+            for (uint64_t ix = begin; ix < end; ++ix)
+            {
+                const float distance_squared = (points[ix] - sphere.center).length_squared();
+                if (distance_squared > radius_squared)
+                {
+                    const float distance = std::sqrt(distance_squared);
+                    const float t = 0.5f - 0.5f * (sphere.radius / distance);
+                    sphere.center = sphere.center + (points[ix] - sphere.center) * t;
+                    sphere.radius = (sphere.radius + distance) * 0.5f;
+                    radius_squared = sphere.radius * sphere.radius;
+                }
+            }
+        }
+        return sphere;
+    }
+
+    Sphere compute_bounding_sphere(std::span<const float3> points)
+    {
+        if (points.size() <= MIN_SPHERE_DIRECT_COUNT) return compute_min_sphere(points);
+
+        const ExtremePoints extremes = points.size() > EPOS6_POINT_COUNT ?
+            find_extreme_points<3>(points) : find_extreme_points<EPOS_DIRECTION_COUNT>(points);
+        return grow_sphere(compute_extreme_sphere(extremes), points);
+    }
+
+    Sphere compute_bounding_sphere_parallel(std::span<const float3> points, uint32_t chunk_size)
+    {
+        const uint64_t chunk_count = (points.size() + chunk_size - 1) / chunk_size;
+        if (chunk_count <= 1) return compute_bounding_sphere(points);
+
+        auto get_chunk = [&](uint64_t chunk)
+        {
+            const uint64_t begin = chunk * chunk_size;
+            return points.subspan(begin, std::min<uint64_t>(chunk_size, points.size() - begin));
+        };
+
+        std::vector<ExtremePoints> chunk_extremes(chunk_count);
+        parallel::parallel_for(
+            [&](uint64_t chunk)
+            {
+                chunk_extremes[chunk] = find_extreme_points<3>(get_chunk(chunk));
+            },
+            chunk_count
+        );
+
+        ExtremePoints extremes = chunk_extremes[0];
+        for (const auto& chunk_extreme : chunk_extremes) extremes.merge(chunk_extreme);
+        const Sphere sphere = compute_extreme_sphere(extremes);
+
+        // 各 chunk 从同一个初始球独立扩张, 合并后的球必然包含所有点.
+        std::vector<Sphere> chunk_spheres(chunk_count);
+        parallel::parallel_for(
+            [&](uint64_t chunk)
+            {
+                chunk_spheres[chunk] = grow_sphere(sphere, get_chunk(chunk));
+            },
+            chunk_count
+        );
+
+        Sphere result = sphere;
+        for (const auto& chunk_sphere : chunk_spheres) result = merge(result, chunk_sphere);
+        return result;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef MATH_BOUNDING_SPHERE_H
+#define MATH_BOUNDING_SPHERE_H
+
+#include "bounds.h"
+#include <span>
+
+namespace fantasy
+{
+    // 精确最小包围球 (Welzl), 只适用于少量点.
+    Sphere compute_min_sphere(std::span<const float3> points);
+
+    // EPOS-26: 先在 13 个方向上取极值点, 对极值点求精确最小包围球, 再遍历一次所有点扩张.
+    // 点数很多时退化为 EPOS-6.
+    Sphere compute_bounding_sphere(std::span<const float3> points);
+
+    // 按 chunk 在线程池上并行求极值点和扩张, 最后合并各 chunk 的包围球. 需要先调用 parallel::initialize(),
+    // 且不能在线程池的任务中调用.
+    Sphere compute_bounding_sphere_parallel(std::span<const float3> points, uint32_t chunk_size = 1u << 18);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
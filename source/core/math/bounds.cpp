@@ -1,4 +1,5 @@
 #include "bounds.h"
+#include "bounding_sphere.h"
 #include "vector.h"
 #include <algorithm>
 #include <vector>
@@ -72,8 +73,15 @@ namespace fantasy
 		return Sphere(center, radius);
 	}
 
-	Sphere merge(const std::vector<Sphere>& spheres)
+	Sphere::Sphere(std::span<const float3> vertices)
+	{
+		*this = compute_bounding_sphere(vertices);
+	}
+
+	Sphere merge(std::span<const Sphere> spheres)
     {
+        if (spheres.empty()) return Sphere(float3(0.0f), 0.0f);
+
         uint32_t min_idx[3] = {};
         uint32_t max_idx[3] = {};
         for (uint32_t i = 0; i < spheres.size(); i++) 
@@ -81,7 +89,7 @@ namespace fantasy
             for (uint32_t k = 0; k < 3; k++) 
             {
                 if (spheres[i].center[k] - spheres[i].radius < spheres[min_idx[k]].center[k] - spheres[min_idx[k]].radius) min_idx[k] = i;
-                if (spheres[i].center[k] + spheres[i].radius < spheres[max_idx[k]].center[k] + spheres[max_idx[k]].radius) max_idx[k] = i;
+                if (spheres[i].center[k] + spheres[i].radius > spheres[max_idx[k]].center[k] + spheres[max_idx[k]].radius) max_idx[k] = i;
             }
         }
 
@@ -101,13 +109,6 @@ namespace fantasy
         {
             sphere = merge(sphere, spheres[i]);
         }
-        for (uint32_t i = 0; i < spheres.size(); i++) 
-        {
-            float radius_diff = sphere.radius - spheres[i].radius;
-            float t1 = radius_diff * radius_diff;
-            float t2 = float3(sphere.center - spheres[i].center).length_squared();
-            assert(t1 + 1e-6 >= t2);
-        }
         return sphere;
     }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "ray.h"
 #include <cassert>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 namespace fantasy 
@@ -441,55 +442,8 @@ namespace fantasy
 
 		Sphere(const float3& in_center, float in_radius) : center(in_center), radius(in_radius) {}
 
-		explicit Sphere(const std::vector<float3>& vertices)
-		{
-			uint32_t min_idx[3] = {};
-			uint32_t max_idx[3] = {};
-			for (uint32_t i = 0; i < vertices.size(); i++) 
-			{
-				for (int k = 0; k < 3; k++) 
-				{
-					if (vertices[i][k] < vertices[min_idx[k]][k]) min_idx[k] = i;
-					if (vertices[i][k] > vertices[max_idx[k]][k]) max_idx[k] = i;
-				}
-			}
-
-			float max_len = 0;
-			uint32_t max_axis = 0;
-			for (uint32_t k = 0; k < 3; k++) 
-			{
-				float3 pmin = vertices[min_idx[k]];
-				float3 pmax = vertices[max_idx[k]];
-				float tlen = float3(pmax - pmin).length_squared();
-				if (tlen > max_len) max_len = tlen, max_axis = k;
-			}
-
-			float3 pmin = vertices[min_idx[max_axis]];
-			float3 pmax = vertices[max_idx[max_axis]];
-
-			center = (pmin + pmax) * 0.5f;
-			radius = float(0.5 * sqrt(max_len));
-			max_len = radius * radius;
-
-			for (uint32_t i = 0; i < vertices.size(); i++) 
-			{
-				float len = float3(vertices[i] - center).length_squared();
-				if (len > max_len) 
-				{
-					len = sqrt(len);
-					float t = 0.5 - 0.5 * (radius / len);
-					center = center + (vertices[i] - center) * t;
-					radius = (radius + len) * 0.5;
-					max_len = radius * radius;
-				}
-			}
-
-			for (uint32_t i = 0; i < vertices.size(); i++) 
-			{
-				float len = float3(vertices[i] - center).length();
-				assert(len - 1e-6 <= radius);
-			}
-		}
+		// 见 compute_bounding_sphere().
+		explicit Sphere(std::span<const float3> vertices);
 
         float3 center;
         float radius;
@@ -526,7 +480,7 @@ namespace fantasy
 
 	Circle merge(const Circle& circle0, const Circle& circle1);
 	Sphere merge(const Sphere& sphere0, const Sphere& sphere1);
-	Sphere merge(const std::vector<Sphere>& spheres);
+	Sphere merge(std::span<const Sphere> spheres);
 
 	// 获取两个包围盒相交处的包围盒
 	template <typename T>
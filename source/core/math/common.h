@@ -39,6 +39,15 @@ namespace fantasy
 #define INVALID_SIZE_64 static_cast<uint64_t>(-1)
 #endif
 
+// x64 上 SSE2 总是可用, 批量数学函数据此选择 simd 实现.
+#ifndef MATH_SIMD_SSE
+#if defined(_M_X64) || defined(__SSE2__)
+#define MATH_SIMD_SSE 1
+#else
+#define MATH_SIMD_SSE 0
+#endif
+#endif
+
 #ifndef ENUM_CLASS_FLAG_OPERATORS
 #define ENUM_CLASS_FLAG_OPERATORS(T)                                    \
 inline T operator|(T a, T b) { return T(uint32_t(a) | uint32_t(b)); }   \
@@ -1,6 +1,10 @@
 #include "matrix.h"
 #include <cassert>
 
+#if MATH_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace fantasy 
 {    
     float4x4 translate(const float3& delta)
@@ -156,4 +160,36 @@ namespace fantasy
             crPos.x, crPos.y, crPos.z, 1.0f
         ));
     }
+
+    void mul(const float4x4& matrix1, const float4x4& matrix2, float4x4& out_matrix)
+    {
+#if MATH_SIMD_SSE
+        // 行向量约定, 结果的第 i 行为 matrix2 各行以 matrix1 第 i 行元素为权重的线性组合.
+        const __m128 row0 = _mm_loadu_ps(matrix2._data[0]);
+        const __m128 row1 = _mm_loadu_ps(matrix2._data[1]);
+        const __m128 row2 = _mm_loadu_ps(matrix2._data[2]);
+        const __m128 row3 = _mm_loadu_ps(matrix2._data[3]);
+
+        for (uint32_t ix = 0; ix < 4; ++ix)
+        {
+            const __m128 row = _mm_loadu_ps(matrix1._data[ix]);
+            __m128 result = _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), row0);
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), row2));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), row3));
+            _mm_storeu_ps(out_matrix._data[ix], result);
+        }
+#else
+        out_matrix = mul(matrix1, matrix2);
+#endif
+    }
+
+    void mul(std::span<const float4x4> matrices1, std::span<const float4x4> matrices2, std::span<float4x4> out_matrices)
+    {
+        assert(matrices1.size() == matrices2.size() && matrices1.size() == out_matrices.size());
+        for (uint64_t ix = 0; ix < out_matrices.size(); ++ix)
+        {
+            mul(matrices1[ix], matrices2[ix], out_matrices[ix]);
+        }
+    }
 }
@@ -4,6 +4,7 @@
 #include "vector.h"
 #include <cassert>
 #include <cstdint>
+#include <span>
 
 namespace fantasy 
 {
@@ -155,6 +156,12 @@ namespace fantasy
 	float3x3 create_orthogonal_basis_from_z(const float3& Z);
 	float4x4 look_at_left_hand(const float3& crPos, const float3& crLook, const float3& crUp);
 
+    // out_matrix = matrix1 * matrix2, 允许 out_matrix 与输入重叠.
+    void mul(const float4x4& matrix1, const float4x4& matrix2, float4x4& out_matrix);
+
+    // 批量矩阵乘法, out_matrices[i] = matrices1[i] * matrices2[i].
+    void mul(std::span<const float4x4> matrices1, std::span<const float4x4> matrices2, std::span<float4x4> out_matrices);
+
     template <typename T>
     requires std::is_same_v<T, float> || std::is_same_v<T, double>
     bool invertible(const Matrix4x4<T>& matrix, Matrix4x4<T>& out_inv_matrix)
@@ -1,4 +1,9 @@
 #include "quaternion.h"
+#include <cassert>
+
+#if MATH_SIMD_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace fantasy
 {
@@ -126,4 +131,154 @@ namespace fantasy
         const Quaternion quat = normalize(quat2 - quat1 * cos_theta);
         return quat1 * std::cos(theta) + quat * std::sin(theta);
     }
+
+    static_assert(sizeof(Quaternion) == sizeof(float) * 4, "Batch quaternion kernels assume a packed (w, x, y, z) layout.");
+
+    static void compose_transform(const float3& position, const Quaternion& rotation, const float3& scale, float4x4& out_matrix)
+    {
+        out_matrix = rotation.to_matrix();
+        for (uint32_t ix = 0; ix < 3; ++ix)
+        {
+            out_matrix._data[ix][0] *= scale[ix];
+            out_matrix._data[ix][1] *= scale[ix];
+            out_matrix._data[ix][2] *= scale[ix];
+            out_matrix._data[3][ix] = position[ix];
+        }
+    }
+
+#if MATH_SIMD_SSE
+    // 将 4 个四元数的旋转矩阵 (已乘缩放) 写入 out_matrices 的前三行, 输入为转置后的 w, x, y, z 分量.
+    static void store_rotation_4(
+        __m128 w, __m128 x, __m128 y, __m128 z,
+        __m128 scale_x, __m128 scale_y, __m128 scale_z,
+        float4x4* out_matrices
+    )
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 rows[3][4];
+        rows[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scale_x);
+        rows[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scale_x);
+        rows[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scale_x);
+        rows[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scale_y);
+        rows[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scale_y);
+        rows[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scale_y);
+        rows[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scale_z);
+        rows[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scale_z);
+        rows[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scale_z);
+
+        for (uint32_t row = 0; row < 3; ++row)
+        {
+            __m128 m0 = rows[row][0], m1 = rows[row][1], m2 = rows[row][2], m3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+            _mm_storeu_ps(out_matrices[0]._data[row], m0);
+            _mm_storeu_ps(out_matrices[1]._data[row], m1);
+            _mm_storeu_ps(out_matrices[2]._data[row], m2);
+            _mm_storeu_ps(out_matrices[3]._data[row], m3);
+        }
+    }
+
+    static void load_quaternion_4(const Quaternion* quats, __m128& w, __m128& x, __m128& y, __m128& z)
+    {
+        w = _mm_loadu_ps(&quats[0].m_w);
+        x = _mm_loadu_ps(&quats[1].m_w);
+        y = _mm_loadu_ps(&quats[2].m_w);
+        z = _mm_loadu_ps(&quats[3].m_w);
+        _MM_TRANSPOSE4_PS(w, x, y, z);
+    }
+#endif
+
+    void normalize(std::span<Quaternion> quats)
+    {
+        uint64_t ix = 0;
+#if MATH_SIMD_SSE
+        for (; ix + 4 <= quats.size(); ix += 4)
+        {
+            __m128 w, x, y, z;
+            load_quaternion_4(&quats[ix], w, x, y, z);
+
+            const __m128 length_squared = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(w, w), _mm_mul_ps(x, x)),
+                _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))
+            );
+            const __m128 inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+            w = _mm_mul_ps(w, inv_length);
+            x = _mm_mul_ps(x, inv_length);
+            y = _mm_mul_ps(y, inv_length);
+            z = _mm_mul_ps(z, inv_length);
+
+            _MM_TRANSPOSE4_PS(w, x, y, z);
+            _mm_storeu_ps(&quats[ix + 0].m_w, w);
+            _mm_storeu_ps(&quats[ix + 1].m_w, x);
+            _mm_storeu_ps(&quats[ix + 2].m_w, y);
+            _mm_storeu_ps(&quats[ix + 3].m_w, z);
+        }
+#endif
+        for (; ix < quats.size(); ++ix) quats[ix] = normalize(quats[ix]);
+    }
+
+    void quaternion_to_matrix(std::span<const Quaternion> quats, std::span<float4x4> out_matrices)
+    {
+        assert(quats.size() == out_matrices.size());
+
+        uint64_t ix = 0;
+#if MATH_SIMD_SSE
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; ix + 4 <= quats.size(); ix += 4)
+        {
+            __m128 w, x, y, z;
+            load_quaternion_4(&quats[ix], w, x, y, z);
+            store_rotation_4(w, x, y, z, one, one, one, &out_matrices[ix]);
+
+            for (uint32_t jx = 0; jx < 4; ++jx)
+            {
+                _mm_storeu_ps(out_matrices[ix + jx]._data[3], _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+            }
+        }
+#endif
+        for (; ix < quats.size(); ++ix) out_matrices[ix] = quats[ix].to_matrix();
+    }
+
+    void compose_transform(
+        std::span<const float3> positions,
+        std::span<const Quaternion> rotations,
+        std::span<const float3> scales,
+        std::span<float4x4> out_matrices
+    )
+    {
+        assert(positions.size() == rotations.size() && scales.size() == rotations.size() && out_matrices.size() == rotations.size());
+
+        uint64_t ix = 0;
+#if MATH_SIMD_SSE
+        for (; ix + 4 <= rotations.size(); ix += 4)
+        {
+            __m128 w, x, y, z;
+            load_quaternion_4(&rotations[ix], w, x, y, z);
+
+            const float3* scale = &scales[ix];
+            store_rotation_4(
+                w, x, y, z,
+                _mm_setr_ps(scale[0].x, scale[1].x, scale[2].x, scale[3].x),
+                _mm_setr_ps(scale[0].y, scale[1].y, scale[2].y, scale[3].y),
+                _mm_setr_ps(scale[0].z, scale[1].z, scale[2].z, scale[3].z),
+                &out_matrices[ix]
+            );
+
+            for (uint32_t jx = 0; jx < 4; ++jx)
+            {
+                const float3& position = positions[ix + jx];
+                _mm_storeu_ps(out_matrices[ix + jx]._data[3], _mm_setr_ps(position.x, position.y, position.z, 1.0f));
+            }
+        }
+#endif
+        for (; ix < rotations.size(); ++ix)
+        {
+            compose_transform(positions[ix], rotations[ix], scales[ix], out_matrices[ix]);
+        }
+    }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MATH_QUATERNION_H
 
 #include "matrix.h"
+#include <span>
 
 namespace fantasy 
 {
@@ -62,6 +63,21 @@ namespace fantasy
     Quaternion slerp(float ft, const Quaternion& quat1, const Quaternion& quat2);
 
 
+    // 以下为批量版本, MATH_SIMD_SSE 开启时每次处理 4 个四元数.
+
+    void normalize(std::span<Quaternion> quats);
+
+    void quaternion_to_matrix(std::span<const Quaternion> quats, std::span<float4x4> out_matrices);
+
+    // 按 scale * rotate * translate 的顺序 (行向量约定) 组合 TRS 矩阵.
+    void compose_transform(
+        std::span<const float3> positions,
+        std::span<const Quaternion> rotations,
+        std::span<const float3> scales,
+        std::span<float4x4> out_matrices
+    );
+
+
 
 }
 
@@ -24,7 +24,8 @@ namespace fantasy
 
 		Vector2(T _x, T _y) : x(_x), y(_y) {}
 
-		Vector2(const Vector2<T>& vec) : x(vec.x), y(vec.y) {}
+		// 保持可平凡拷贝, 数组可以整块拷贝和序列化.
+		Vector2(const Vector2<T>& vec) = default;
 
 		template <typename U>
 		requires std::is_arithmetic_v<U>
@@ -34,12 +35,7 @@ namespace fantasy
 		{
 		}
 
-		Vector2& operator=(const Vector2<T>& vec)
-		{
-			x = vec.x;
-			y = vec.y;
-			return *this;
-		}
+		Vector2& operator=(const Vector2<T>& vec) = default;
 
 		template <typename U>
 		requires std::is_arithmetic_v<U>
@@ -174,7 +170,7 @@ namespace fantasy
 
 		explicit Vector3(const Vector4<T>& vec) : x(vec.x), y(vec.y), z(vec.z) {}
 
-		Vector3(const Vector3<T>& vec) : x(vec.x), y(vec.y), z(vec.z) {}
+		Vector3(const Vector3<T>& vec) = default;
 
 		template <typename U>
 		requires std::is_arithmetic_v<U>
@@ -185,13 +181,7 @@ namespace fantasy
 		{
 		}
 
-		Vector3& operator=(const Vector3<T>& vec)
-		{
-			x = vec.x;
-			y = vec.y;
-			z = vec.z;
-			return *this;
-		}
+		Vector3& operator=(const Vector3<T>& vec) = default;
 
 		template <typename U>
 		requires std::is_arithmetic_v<U>
@@ -343,7 +333,7 @@ namespace fantasy
 		
 		Vector4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
 
-		Vector4(const Vector4<T>& vec) : x(vec.x), y(vec.y), z(vec.z), w(vec.w) {}
+		Vector4(const Vector4<T>& vec) = default;
 
 		explicit Vector4(const Vector3<T>& vec, T _w = 1) : x(vec.x), y(vec.y), z(vec.z), w(_w) {}
 
@@ -357,14 +347,7 @@ namespace fantasy
 		{
 		}
 
-		Vector4& operator=(const Vector4<T>& vec)
-		{
-			x = vec.x;
-			y = vec.y;
-			z = vec.z;
-			w = vec.w;
-			return *this;
-		}
+		Vector4& operator=(const Vector4<T>& vec) = default;
 
 		template <typename U>
 		requires std::is_arithmetic_v<U>
@@ -85,11 +85,26 @@ namespace fantasy
 			return thread_pool->thread_success(index);
         }
 
+        uint32_t thread_count()
+        {
+            return thread_pool->thread_count();
+        }
+
+        bool is_worker_thread()
+        {
+            return ThreadPool::is_worker_thread();
+        }
+
         uint64_t begin_thread(std::function<bool()>&& rrFunc)
         {
             return thread_pool->submit(std::move(rrFunc));
         }
 
+        void begin_task(std::function<void()>&& func)
+        {
+            thread_pool->execute(std::move(func));
+        }
+
         bool run(TaskFlow& flow)
         {
             ReturnIfFalse(!flow.empty());
@@ -131,10 +131,13 @@ namespace fantasy
         }
 
         uint64_t begin_thread(std::function<bool()>&& rrFunc);
-        void parallel_for(std::function<void(uint64_t)> func, uint64_t count, uint32_t chun_size = 1);
+        void begin_task(std::function<void()>&& func);      // 不占用 thread_finished()/thread_success() 的下标.
+        void parallel_for(std::function<void(uint64_t)> func, uint64_t count, uint32_t chun_size = 1);   // 可以多线程调用.
         void parallel_for(std::function<void(uint64_t, uint64_t)> func, uint64_t x, uint64_t y);
         bool thread_finished(uint64_t index);
         bool thread_success(uint64_t index);
+        uint32_t thread_count();
+        bool is_worker_thread();
     };
 }
 
@@ -5,9 +5,11 @@
 
 namespace fantasy 
 {
+    static thread_local bool worker_thread_flag = false;
+
     ThreadPool::ThreadPool(uint32_t thread_num)
     {
-        uint64_t max_thread_num = std::thread::hardware_concurrency() / 4;
+        uint64_t max_thread_num = std::max(std::thread::hardware_concurrency() / 4, 1u);
         if (thread_num > 0) max_thread_num = thread_num;
         
         for (uint64_t ix = 0; ix < max_thread_num; ++ix)
@@ -19,9 +21,10 @@ namespace fantasy
     ThreadPool::~ThreadPool()
     {
         {
+            std::lock_guard lock(_wait_mutex);
             _done = true;
-            _pool_task_queue.condition_variable.notify_all();
         }
+        _wait_condition.notify_all();
         
         for (auto& thread : _threads)
         {
@@ -36,11 +39,27 @@ namespace fantasy
     {
         auto task = std::make_shared<std::packaged_task<bool()>>(func);
         _futures.emplace_back(task->get_future());
-        _pool_task_queue.push([task]() { (*task)(); });
+        push_task([task]() { (*task)(); });
 
         return _futures.size() - 1;
     }
 
+    void ThreadPool::execute(std::function<void()> func)
+    {
+        push_task(std::move(func));
+    }
+
+    void ThreadPool::push_task(std::function<void()> task)
+    {
+        _pool_task_queue.push(std::move(task));
+
+        // worker 在持有锁时检查队列, 入队后获取一次锁再通知, 唤醒就不会落在检查与等待之间.
+        {
+            std::lock_guard lock(_wait_mutex);
+        }
+        _wait_condition.notify_one();
+    }
+
     void ThreadPool::wait_for_idle(uint32_t index)
     {
         while (index-- > 0)
@@ -70,12 +89,21 @@ namespace fantasy
 
     void ThreadPool::parallel_for(std::function<void(uint64_t)> func, uint64_t count, uint32_t chun_size)
     {
+        // worker 等待其它任务可能占住唯一的 worker, 直接在当前线程执行.
+        if (is_worker_thread())
+        {
+            for (uint64_t ix = 0; ix < count; ++ix) func(ix);
+            return;
+        }
+
+        // future 只保存在本次调用中, 不经过 _futures, 多个线程可以同时调用.
+        std::vector<std::future<bool>> futures;
         for (uint64_t ix = 0; ix < count; ix += chun_size)
         {
             auto task = std::make_shared<std::packaged_task<bool()>>(
                 [&func, ix, count, chun_size]() 
                 {
-                    uint32_t dwEndIndex = std::min(ix + chun_size, count);
+                    uint64_t dwEndIndex = std::min(ix + chun_size, count);
                     for (uint64_t ij = ix; ij < dwEndIndex; ++ij)
                     {
                         func(ij);
@@ -83,15 +111,24 @@ namespace fantasy
                     return true;
                 }
             );
-            _futures.emplace_back(task->get_future());
-            _pool_task_queue.push([task]() { (*task)(); });
+            futures.emplace_back(task->get_future());
+            push_task([task]() { (*task)(); });
         }
-
-        wait_for_idle(count);
+        for (auto& future : futures) future.get();
     }
     
     void ThreadPool::parallel_for(std::function<void(uint64_t, uint64_t)> func, uint64_t x, uint64_t y)
     {
+        if (is_worker_thread())
+        {
+            for (uint64_t iy = 0; iy < y; ++iy)
+            {
+                for (uint64_t ix = 0; ix < x; ++ix) func(ix, iy);
+            }
+            return;
+        }
+
+        std::vector<std::future<bool>> futures;
         for (uint64_t iy = 0; iy < y; ++iy)
         {
             auto task = std::make_shared<std::packaged_task<bool()>>(
@@ -104,27 +141,32 @@ namespace fantasy
                     return true;
                 }
             );
-            _futures.emplace_back(task->get_future());
-            _pool_task_queue.push([task]() { (*task)(); });
+            futures.emplace_back(task->get_future());
+            push_task([task]() { (*task)(); });
         }
-        wait_for_idle(y);
+        for (auto& future : futures) future.get();
+    }
+
+    bool ThreadPool::is_worker_thread()
+    {
+        return worker_thread_flag;
     }
 
     void ThreadPool::worker_thread(uint64_t index)
     {
-        std::mutex mutex;
-        std::unique_lock<std::mutex> Lock(mutex);
-        while (!_done)
+        worker_thread_flag = true;
+        while (true)
         {
             std::function<void()> Task;
             if (_pool_task_queue.try_pop(Task))
             {
                 Task();
+                continue;
             }
-            else
-            {
-                _pool_task_queue.condition_variable.wait(Lock);
-            }
+
+            std::unique_lock<std::mutex> Lock(_wait_mutex);
+            _wait_condition.wait(Lock, [this]() { return _done || !_pool_task_queue.empty(); });
+            if (_done) break;
         }
     }
 
@@ -1,6 +1,7 @@
 ﻿#ifndef TASK_FLOW_THREAD_POOL_H
 #define TASK_FLOW_THREAD_POOL_H
 
+#include <condition_variable>
 #include <functional>
 #include <future>
 #include <vector>
@@ -15,17 +16,27 @@ namespace fantasy
         ThreadPool(uint32_t thread_num = 0);
         ~ThreadPool();
 
+        // submit(), wait_for_idle(), thread_finished() 和 thread_success() 共用 _futures 和下标, 只能在同一个线程中调用.
         uint64_t submit(std::function<bool()> func);
+
+        // 不记录 future, 任务结果由调用方自己同步.
+        void execute(std::function<void()> func);
         void wait_for_idle(uint32_t index = 1);
 
         bool thread_finished(uint64_t index);
         bool thread_success(uint64_t index);
+        uint32_t thread_count() const { return static_cast<uint32_t>(_threads.size()); }
+
+        // 当前线程是否为某个线程池的 worker. worker 中等待其它任务可能占住唯一的 worker 而死锁.
+        static bool is_worker_thread();
 
+        // 可以在多个线程中同时调用. 在 worker 中调用时在当前线程依次执行.
         void parallel_for(std::function<void(uint64_t)> func, uint64_t count, uint32_t chun_size = 1);
         void parallel_for(std::function<void(uint64_t, uint64_t)> func, uint64_t x, uint64_t y);
 
     private:
         void worker_thread(uint64_t index);
+        void push_task(std::function<void()> task);
 
     private:
         std::atomic<bool> _done = false;
@@ -33,6 +44,10 @@ namespace fantasy
         std::vector<std::thread> _threads;
         std::vector<std::future<bool>> _futures;
         ConcurrentQueue<std::function<void()>> _pool_task_queue;
+
+        // 所有 worker 共用, 保证入队与等待之间不会丢失唤醒.
+        std::mutex _wait_mutex;
+        std::condition_variable _wait_condition;
     };
 
 
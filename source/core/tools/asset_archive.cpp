@@ -0,0 +1,337 @@
+#include "asset_archive.h"
+#include "hash_table.h"
+#include "log.h"
+#include "../math/common.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <zstd.h>
+
+namespace fantasy
+{
+    static constexpr int32_t ZSTD_LEVEL = 9;
+
+    // 压缩后至少小 1/8 才保存压缩数据, 否则解压的开销不划算.
+    static constexpr uint64_t MIN_COMPRESSION_GAIN = 8;
+
+    // zstd 的块最大 128KB, 最小的 RLE 块占 4 字节, 因此解压后的大小不会超过压缩大小的 32768 倍.
+    static constexpr uint64_t ZSTD_MAX_RATIO = (128 * 1024) / 4;
+
+    static uint64_t align_offset(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    // 偏移和大小都来自文件, 分开比较避免相加溢出.
+    static bool in_range(uint64_t offset, uint64_t size, uint64_t total_size)
+    {
+        return offset <= total_size && size <= total_size - offset;
+    }
+
+    // 只检查目录中的大小, 不读取条目数据, 打开时不会访问数据所在的页.
+    static bool check_entry_size(const AssetArchiveEntry& entry)
+    {
+        switch (entry.compression)
+        {
+        case AssetCompression::None:
+            return entry.size == entry.stored_size;
+        case AssetCompression::Zstd:
+            // 损坏的目录不会导致巨大的分配.
+            return entry.size <= entry.stored_size * ZSTD_MAX_RATIO;
+        default:
+            return false;
+        }
+    }
+
+    uint64_t hash_asset_name(std::string_view name)
+    {
+        return murmur_hash128(name.data(), name.size()).low;
+    }
+
+    bool AssetArchive::open(const std::string& path)
+    {
+        close();
+
+        if (!_mapping.open(path)) return false;
+
+        const uint8_t* data = _mapping.data();
+        const uint64_t file_size = _mapping.size();
+
+        AssetArchiveHeader header;
+        if (file_size < sizeof(header))
+        {
+            LOG_ERROR(path + " is not a valid asset archive.");
+            close();
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        const bool valid =
+            header.magic == ASSET_ARCHIVE_MAGIC &&
+            header.version == ASSET_ARCHIVE_VERSION &&
+            std::has_single_bit(header.slot_count) &&
+            header.slot_count > header.entry_count &&
+            header.entries_offset % alignof(AssetArchiveEntry) == 0 &&
+            header.slots_offset % alignof(uint32_t) == 0 &&
+            in_range(header.entries_offset, static_cast<uint64_t>(header.entry_count) * sizeof(AssetArchiveEntry), file_size) &&
+            in_range(header.slots_offset, static_cast<uint64_t>(header.slot_count) * sizeof(uint32_t), file_size) &&
+            in_range(header.names_offset, header.names_size, file_size);
+        if (!valid)
+        {
+            LOG_ERROR(path + " is not a valid asset archive.");
+            close();
+            return false;
+        }
+
+        _entries = std::span(reinterpret_cast<const AssetArchiveEntry*>(data + header.entries_offset), header.entry_count);
+        _slots = std::span(reinterpret_cast<const uint32_t*>(data + header.slots_offset), header.slot_count);
+        _names = std::string_view(reinterpret_cast<const char*>(data + header.names_offset), header.names_size);
+
+        for (const auto& entry : _entries)
+        {
+            if (
+                !in_range(entry.data_offset, entry.stored_size, file_size) ||
+                !in_range(entry.name_offset, entry.name_size, _names.size()) ||
+                !check_entry_size(entry)
+            )
+            {
+                LOG_ERROR(path + " is not a valid asset archive.");
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void AssetArchive::close()
+    {
+        _entries = {};
+        _slots = {};
+        _names = {};
+        _mapping.close();
+    }
+
+    uint32_t AssetArchive::find(std::string_view name) const
+    {
+        if (_slots.empty()) return INVALID_SIZE_32;
+
+        const uint64_t hash = hash_asset_name(name);
+        const uint32_t mask = static_cast<uint32_t>(_slots.size()) - 1;
+        uint32_t slot = static_cast<uint32_t>(hash) & mask;
+        for (uint32_t probe = 0; probe < _slots.size(); ++probe, slot = (slot + 1) & mask)
+        {
+            const uint32_t value = _slots[slot];
+            if (value == 0 || value > _entries.size()) break;
+
+            const uint32_t index = value - 1;
+            if (_entries[index].name_hash == hash && this->name(index) == name) return index;
+        }
+        return INVALID_SIZE_32;
+    }
+
+    std::span<const uint8_t> AssetArchive::view(uint32_t index) const
+    {
+        const AssetArchiveEntry& entry = _entries[index];
+        if (entry.compression != AssetCompression::None) return {};
+        return std::span(_mapping.data() + entry.data_offset, entry.stored_size);
+    }
+
+    bool AssetArchive::load(uint32_t index, std::vector<uint8_t>& out_data) const
+    {
+        const AssetArchiveEntry& entry = _entries[index];
+        const uint8_t* stored = _mapping.data() + entry.data_offset;
+
+        // 条目必须恰好是一个 zstd 帧, 帧头中记录的原始大小与目录一致. 读取时才检查, 打开时不需要访问所有数据.
+        if (
+            entry.compression == AssetCompression::Zstd && (
+                ZSTD_findFrameCompressedSize(stored, entry.stored_size) != entry.stored_size ||
+                ZSTD_getFrameContentSize(stored, entry.stored_size) != entry.size
+            )
+        )
+        {
+            LOG_ERROR("Asset " + std::string(name(index)) + " is corrupt.");
+            return false;
+        }
+
+        out_data.resize(entry.size);
+        switch (entry.compression)
+        {
+        case AssetCompression::None:
+            memcpy(out_data.data(), stored, entry.size);
+            return true;
+        case AssetCompression::Zstd:
+        {
+            const size_t size = ZSTD_decompress(out_data.data(), out_data.size(), stored, entry.stored_size);
+            if (ZSTD_isError(size) || size != entry.size)
+            {
+                LOG_ERROR("Decompress asset " + std::string(name(index)) + " failed.");
+                return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    std::string_view AssetArchive::name(uint32_t index) const
+    {
+        const AssetArchiveEntry& entry = _entries[index];
+        return _names.substr(entry.name_offset, entry.name_size);
+    }
+
+
+    void AssetArchiveBuilder::add(std::string name, std::vector<uint8_t> data, bool compress)
+    {
+        Asset asset{ .name = std::move(name), .data = std::move(data) };
+        asset.size = asset.data.size();
+
+        if (compress && !asset.data.empty())
+        {
+            std::vector<uint8_t> compressed(ZSTD_compressBound(asset.data.size()));
+            const size_t size = ZSTD_compress(compressed.data(), compressed.size(), asset.data.data(), asset.data.size(), ZSTD_LEVEL);
+            if (!ZSTD_isError(size) && size < asset.size - asset.size / MIN_COMPRESSION_GAIN)
+            {
+                compressed.resize(size);
+                asset.data = std::move(compressed);
+                asset.compression = AssetCompression::Zstd;
+            }
+        }
+        _assets.push_back(std::move(asset));
+    }
+
+    bool AssetArchiveBuilder::add_file(std::string name, const std::string& path, bool compress)
+    {
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input.is_open())
+        {
+            LOG_ERROR("Open " + path + " failed.");
+            return false;
+        }
+
+        std::vector<uint8_t> data(static_cast<uint64_t>(input.tellg()));
+        input.seekg(0);
+        if (!input.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())))
+        {
+            LOG_ERROR("Read " + path + " failed.");
+            return false;
+        }
+
+        add(std::move(name), std::move(data), compress);
+        return true;
+    }
+
+    bool AssetArchiveBuilder::add_directory(const std::string& directory, bool compress)
+    {
+        std::error_code error;
+        for (const auto& file : std::filesystem::recursive_directory_iterator(directory, error))
+        {
+            if (!file.is_regular_file()) continue;
+
+            const std::string name = std::filesystem::relative(file.path(), directory).generic_string();
+            if (!add_file(name, file.path().string(), compress)) return false;
+        }
+        if (error)
+        {
+            LOG_ERROR("Iterate " + directory + " failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool AssetArchiveBuilder::build(const std::string& path, uint32_t alignment)
+    {
+        if (!std::has_single_bit(alignment))
+        {
+            LOG_ERROR("Asset archive alignment must be a power of two.");
+            return false;
+        }
+
+        // 按名字 hash 排序, 同一组资源每次生成的文件相同.
+        std::vector<uint64_t> hashes(_assets.size());
+        std::vector<uint32_t> order(_assets.size());
+        for (uint32_t ix = 0; ix < _assets.size(); ++ix)
+        {
+            hashes[ix] = hash_asset_name(_assets[ix].name);
+            order[ix] = ix;
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : _assets[a].name < _assets[b].name; });
+
+        for (uint32_t ix = 1; ix < order.size(); ++ix)
+        {
+            if (_assets[order[ix]].name == _assets[order[ix - 1]].name)
+            {
+                LOG_ERROR("Duplicate asset " + _assets[order[ix]].name + ".");
+                return false;
+            }
+        }
+
+        AssetArchiveHeader header;
+        header.entry_count = static_cast<uint32_t>(_assets.size());
+        header.slot_count = std::bit_ceil(std::max(header.entry_count * 2, 2u));
+
+        std::vector<AssetArchiveEntry> entries(_assets.size());
+        std::vector<uint32_t> slots(header.slot_count, 0);
+        std::string names;
+
+        header.entries_offset = sizeof(AssetArchiveHeader);
+        header.slots_offset = header.entries_offset + entries.size() * sizeof(AssetArchiveEntry);
+        header.names_offset = header.slots_offset + slots.size() * sizeof(uint32_t);
+
+        for (const auto& asset : _assets) header.names_size += asset.name.size();
+        uint64_t data_offset = header.names_offset + header.names_size;
+
+        const uint32_t mask = header.slot_count - 1;
+        for (uint32_t ix = 0; ix < order.size(); ++ix)
+        {
+            const Asset& asset = _assets[order[ix]];
+
+            AssetArchiveEntry& entry = entries[ix];
+            entry.name_hash = hashes[order[ix]];
+            entry.name_offset = static_cast<uint32_t>(names.size());
+            entry.name_size = static_cast<uint32_t>(asset.name.size());
+            entry.data_offset = align_offset(data_offset, alignment);
+            entry.stored_size = asset.data.size();
+            entry.size = asset.size;
+            entry.compression = asset.compression;
+            data_offset = entry.data_offset + entry.stored_size;
+
+            names += asset.name;
+
+            uint32_t slot = static_cast<uint32_t>(entry.name_hash) & mask;
+            while (slots[slot] != 0) slot = (slot + 1) & mask;
+            slots[slot] = ix + 1;
+        }
+
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            LOG_ERROR("Create asset archive " + path + " failed.");
+            return false;
+        }
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(AssetArchiveEntry)));
+        output.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(uint32_t)));
+        output.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+        uint64_t offset = header.names_offset + header.names_size;
+        const std::vector<char> padding(alignment, 0);
+        for (uint32_t ix = 0; ix < order.size(); ++ix)
+        {
+            const Asset& asset = _assets[order[ix]];
+            output.write(padding.data(), static_cast<std::streamsize>(entries[ix].data_offset - offset));
+            output.write(reinterpret_cast<const char*>(asset.data.data()), static_cast<std::streamsize>(asset.data.size()));
+            offset = entries[ix].data_offset + asset.data.size();
+        }
+
+        if (!output.good())
+        {
+            LOG_ERROR("Write asset archive " + path + " failed.");
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef CORE_ASSET_ARCHIVE_H
+#define CORE_ASSET_ARCHIVE_H
+
+#include "file_mapping.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fantasy
+{
+    // .fpak 文件格式:
+    //   文件头.
+    //   目录: AssetArchiveEntry 数组, 按名字 hash 排序.
+    //   hash 槽位: 开放寻址表, 长度为 2 的幂, 每个槽位存目录下标 + 1, 0 表示空.
+    //   名字表: 所有名字连续存放, 用于确认 hash 命中.
+    //   数据: 每个条目按对齐要求存放, 压缩的条目保存 zstd 帧.
+    static constexpr uint32_t ASSET_ARCHIVE_MAGIC = 0x4b415046;      // "FPAK"
+    static constexpr uint32_t ASSET_ARCHIVE_VERSION = 1;
+    static constexpr uint32_t ASSET_ARCHIVE_DEFAULT_ALIGNMENT = 16;
+
+    enum class AssetCompression : uint32_t
+    {
+        None,
+        Zstd
+    };
+
+    struct AssetArchiveHeader
+    {
+        uint32_t magic = ASSET_ARCHIVE_MAGIC;
+        uint32_t version = ASSET_ARCHIVE_VERSION;
+        uint32_t entry_count = 0;
+        uint32_t slot_count = 0;
+        uint64_t entries_offset = 0;
+        uint64_t slots_offset = 0;
+        uint64_t names_offset = 0;
+        uint64_t names_size = 0;
+    };
+
+    struct AssetArchiveEntry
+    {
+        uint64_t name_hash = 0;
+        uint32_t name_offset = 0;
+        uint32_t name_size = 0;
+        uint64_t data_offset = 0;
+        uint64_t stored_size = 0;
+        uint64_t size = 0;
+        AssetCompression compression = AssetCompression::None;
+        uint32_t padding = 0;
+    };
+
+    // 名字统一使用 '/' 作为分隔符, 大小写敏感.
+    uint64_t hash_asset_name(std::string_view name);
+
+
+    // 映射整个文件, 打开后查找和读取都不再有系统调用. 打开时只检查目录, 不访问条目数据.
+    class AssetArchive
+    {
+    public:
+        bool open(const std::string& path);
+        void close();
+
+        // 找不到时返回 INVALID_SIZE_32.
+        uint32_t find(std::string_view name) const;
+
+        // 未压缩的条目直接返回映射中的数据, 压缩的条目返回空.
+        std::span<const uint8_t> view(uint32_t index) const;
+
+        // 压缩的条目先检查 zstd 帧再解压到 out_data, 未压缩的条目拷贝.
+        bool load(uint32_t index, std::vector<uint8_t>& out_data) const;
+
+        std::string_view name(uint32_t index) const;
+        const AssetArchiveEntry& entry(uint32_t index) const { return _entries[index]; }
+        uint32_t entry_count() const { return static_cast<uint32_t>(_entries.size()); }
+
+    private:
+        FileMapping _mapping;
+        std::span<const AssetArchiveEntry> _entries;
+        std::span<const uint32_t> _slots;
+        std::string_view _names;
+    };
+
+
+    class AssetArchiveBuilder
+    {
+    public:
+        // 压缩后没有明显变小的条目按不压缩保存.
+        void add(std::string name, std::vector<uint8_t> data, bool compress = false);
+        bool add_file(std::string name, const std::string& path, bool compress = false);
+
+        // 递归加入目录下的所有文件, 名字为相对 directory 的路径.
+        bool add_directory(const std::string& directory, bool compress = false);
+
+        bool build(const std::string& path, uint32_t alignment = ASSET_ARCHIVE_DEFAULT_ALIGNMENT);
+
+    private:
+        struct Asset
+        {
+            std::string name;
+            std::vector<uint8_t> data;
+            uint64_t size = 0;
+            AssetCompression compression = AssetCompression::None;
+        };
+
+        std::vector<Asset> _assets;
+    };
+}
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,455 @@
+#include "async_file_io.h"
+#include "log.h"
+#include "../parallel/parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fantasy
+{
+    static constexpr uint32_t MAX_FREE_BUFFER_COUNT = 64;
+    static constexpr uint32_t COMPLETION_BATCH_SIZE = 64;
+
+    // 单次读取的上限, 更大的请求分多次提交.
+    static constexpr uint64_t MAX_READ_SIZE = 1ull << 30;
+
+    static bool get_read_size(const AsyncReadRequest& desc, uint64_t file_size, uint64_t& out_size)
+    {
+        if (desc.offset > file_size) return false;
+
+        out_size = desc.size == 0 ? file_size - desc.offset : desc.size;
+        if (desc.offset + out_size > file_size) return false;
+
+        if (!desc.buffer.empty()) out_size = std::min<uint64_t>(out_size, desc.buffer.size());
+        return true;
+    }
+
+    AsyncFileIo::~AsyncFileIo()
+    {
+        destroy();
+    }
+
+    bool AsyncFileIo::initialize(uint32_t queue_depth)
+    {
+        destroy();
+
+#if defined(__linux__)
+        if (!initialize_ring(queue_depth)) LOG_INFO("io_uring is not available, fall back to blocking reads.");
+#endif
+
+        _stop = false;
+        _thread = std::thread(&AsyncFileIo::io_thread, this);
+        return true;
+    }
+
+    void AsyncFileIo::destroy()
+    {
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+        if (_thread.joinable()) _thread.join();
+
+        // I/O 线程退出前会完成所有请求, 这里只需等待线程池中的回调.
+        wait_idle();
+
+#if defined(__linux__)
+        destroy_ring();
+#endif
+
+        std::lock_guard lock(_buffer_mutex);
+        _free_buffers.clear();
+    }
+
+    void AsyncFileIo::read(std::span<const AsyncReadRequest> requests, ReadFunc func)
+    {
+        if (requests.empty()) return;
+
+        auto shared_func = std::make_shared<ReadFunc>(std::move(func));
+        {
+            std::lock_guard lock(_mutex);
+            for (uint32_t ix = 0; ix < requests.size(); ++ix)
+            {
+                _requests.push_back(Request{ .desc = requests[ix], .index = ix, .func = shared_func });
+            }
+            _pending_count += requests.size();
+        }
+        _condition.notify_one();
+    }
+
+    void AsyncFileIo::wait_idle()
+    {
+        std::unique_lock lock(_idle_mutex);
+        _idle_condition.wait(lock, [this]() { return _pending_count == 0; });
+    }
+
+    void AsyncFileIo::recycle(std::vector<uint8_t>&& buffer)
+    {
+        if (buffer.capacity() == 0) return;
+
+        std::lock_guard lock(_buffer_mutex);
+        if (_free_buffers.size() < MAX_FREE_BUFFER_COUNT) _free_buffers.push_back(std::move(buffer));
+    }
+
+    std::vector<uint8_t> AsyncFileIo::acquire_buffer(uint64_t size)
+    {
+        {
+            std::lock_guard lock(_buffer_mutex);
+
+            // 选择能容纳 size 的最小缓存.
+            auto best = _free_buffers.end();
+            for (auto iter = _free_buffers.begin(); iter != _free_buffers.end(); ++iter)
+            {
+                if (iter->capacity() >= size && (best == _free_buffers.end() || iter->capacity() < best->capacity())) best = iter;
+            }
+            if (best != _free_buffers.end())
+            {
+                std::vector<uint8_t> buffer = std::move(*best);
+                *best = std::move(_free_buffers.back());
+                _free_buffers.pop_back();
+
+                buffer.resize(size);
+                return buffer;
+            }
+        }
+        return std::vector<uint8_t>(size);
+    }
+
+    void AsyncFileIo::complete(Request& request, AsyncReadResult& result)
+    {
+        result.index = request.index;
+        _completions.push_back(Completion{ .func = std::move(request.func), .result = std::move(result) });
+    }
+
+    void AsyncFileIo::flush_completions()
+    {
+        for (uint64_t begin = 0; begin < _completions.size(); begin += COMPLETION_BATCH_SIZE)
+        {
+            const uint64_t end = std::min<uint64_t>(begin + COMPLETION_BATCH_SIZE, _completions.size());
+            auto completions = std::make_shared<std::vector<Completion>>(
+                std::make_move_iterator(_completions.begin() + begin),
+                std::make_move_iterator(_completions.begin() + end)
+            );
+
+            parallel::begin_task(
+                [this, completions]()
+                {
+                    for (auto& completion : *completions)
+                    {
+                        (*completion.func)(completion.result);
+                        recycle(std::move(completion.result.buffer));
+                    }
+
+                    if ((_pending_count -= completions->size()) == 0)
+                    {
+                        std::lock_guard lock(_idle_mutex);
+                        _idle_condition.notify_all();
+                    }
+                }
+            );
+        }
+        _completions.clear();
+    }
+
+    void AsyncFileIo::io_thread()
+    {
+#if defined(__linux__)
+        if (_ring_fd >= 0)
+        {
+            uring_loop();
+            return;
+        }
+#endif
+
+        while (true)
+        {
+            Request request;
+            {
+                std::unique_lock lock(_mutex);
+                if (_requests.empty() && !_completions.empty())
+                {
+                    // 队列空了再交出回调, 凑成批次.
+                    lock.unlock();
+                    flush_completions();
+                    lock.lock();
+                }
+
+                _condition.wait(lock, [this]() { return _stop || !_requests.empty(); });
+                if (_requests.empty()) return;
+
+                request = std::move(_requests.front());
+                _requests.pop_front();
+            }
+            blocking_read(request);
+            if (_completions.size() >= COMPLETION_BATCH_SIZE) flush_completions();
+        }
+    }
+
+    void AsyncFileIo::blocking_read(Request& request)
+    {
+        AsyncReadResult result;
+
+        std::ifstream input(request.desc.path, std::ios::binary | std::ios::ate);
+        uint64_t size = 0;
+        if (!input.is_open() || !get_read_size(request.desc, static_cast<uint64_t>(input.tellg()), size))
+        {
+            LOG_ERROR("Read " + request.desc.path + " failed.");
+            complete(request, result);
+            return;
+        }
+
+        if (request.desc.buffer.empty())
+        {
+            result.buffer = acquire_buffer(size);
+            result.data = std::span<uint8_t>(result.buffer.data(), size);
+        }
+        else
+        {
+            result.data = request.desc.buffer.first(size);
+        }
+
+        input.seekg(static_cast<std::streamoff>(request.desc.offset));
+        result.success = static_cast<bool>(input.read(reinterpret_cast<char*>(result.data.data()), static_cast<std::streamsize>(size)));
+        if (!result.success) LOG_ERROR("Read " + request.desc.path + " failed.");
+
+        complete(request, result);
+    }
+
+#if defined(__linux__)
+    bool AsyncFileIo::initialize_ring(uint32_t queue_depth)
+    {
+        io_uring_params params{};
+        const int32_t fd = static_cast<int32_t>(syscall(__NR_io_uring_setup, queue_depth, &params));
+        if (fd < 0) return false;
+
+        // IORING_OP_READ 需要 5.6 以上的内核, 同一版本加入了 IORING_FEAT_RW_CUR_POS.
+        if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        _ring_fd = fd;
+        _ring.entries = params.sq_entries;
+        _ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        _ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        _ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) _ring.sq_ring_size = _ring.cq_ring_size = std::max(_ring.sq_ring_size, _ring.cq_ring_size);
+
+        _ring.sq_ring = mmap(nullptr, _ring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (_ring.sq_ring == MAP_FAILED) _ring.sq_ring = nullptr;
+
+        _ring.cq_ring = single_mmap ? _ring.sq_ring : mmap(nullptr, _ring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (_ring.cq_ring == MAP_FAILED) _ring.cq_ring = nullptr;
+
+        _ring.sqes = mmap(nullptr, _ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (_ring.sqes == MAP_FAILED) _ring.sqes = nullptr;
+
+        if (_ring.sq_ring == nullptr || _ring.cq_ring == nullptr || _ring.sqes == nullptr)
+        {
+            destroy_ring();
+            return false;
+        }
+
+        uint8_t* sq_ring = static_cast<uint8_t*>(_ring.sq_ring);
+        uint8_t* cq_ring = static_cast<uint8_t*>(_ring.cq_ring);
+        _ring.sq_head = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.head);
+        _ring.sq_tail = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+        _ring.sq_mask = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.ring_mask);
+        _ring.sq_array = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+        _ring.cq_head = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+        _ring.cq_tail = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+        _ring.cq_mask = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.ring_mask);
+        _ring.cqes = cq_ring + params.cq_off.cqes;
+
+        // 每个槽位同时最多只有一个 sqe, 因此提交队列不会溢出.
+        _slots.resize(_ring.entries);
+        _free_slots.resize(_ring.entries);
+        for (uint32_t ix = 0; ix < _ring.entries; ++ix) _free_slots[ix] = _ring.entries - 1 - ix;
+        return true;
+    }
+
+    void AsyncFileIo::destroy_ring()
+    {
+        if (_ring.sqes) munmap(_ring.sqes, _ring.sqes_size);
+        if (_ring.cq_ring && _ring.cq_ring != _ring.sq_ring) munmap(_ring.cq_ring, _ring.cq_ring_size);
+        if (_ring.sq_ring) munmap(_ring.sq_ring, _ring.sq_ring_size);
+        if (_ring_fd >= 0) ::close(_ring_fd);
+
+        _ring = Ring{};
+        _ring_fd = -1;
+        _slots.clear();
+        _free_slots.clear();
+    }
+
+    bool AsyncFileIo::prepare(InFlight& in_flight)
+    {
+        const AsyncReadRequest& desc = in_flight.request.desc;
+
+        in_flight.fd = ::open(desc.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        struct stat file_stat{};
+        uint64_t size = 0;
+        if (in_flight.fd < 0 || fstat(in_flight.fd, &file_stat) != 0 || !get_read_size(desc, static_cast<uint64_t>(file_stat.st_size), size))
+        {
+            LOG_ERROR("Read " + desc.path + " failed.");
+            if (in_flight.fd >= 0) ::close(in_flight.fd);
+            in_flight.fd = -1;
+            complete(in_flight.request, in_flight.result);
+            return false;
+        }
+
+        if (desc.buffer.empty())
+        {
+            in_flight.result.buffer = acquire_buffer(size);
+            in_flight.result.data = std::span<uint8_t>(in_flight.result.buffer.data(), size);
+        }
+        else
+        {
+            in_flight.result.data = desc.buffer.first(size);
+        }
+        in_flight.read_size = size;
+        in_flight.finished_size = 0;
+        return true;
+    }
+
+    void AsyncFileIo::submit_read(uint32_t slot)
+    {
+        const InFlight& in_flight = _slots[slot];
+
+        const uint32_t tail = *_ring.sq_tail;
+        const uint32_t index = tail & *_ring.sq_mask;
+
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(_ring.sqes)[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = in_flight.fd;
+        sqe.off = in_flight.request.desc.offset + in_flight.finished_size;
+        sqe.addr = reinterpret_cast<uint64_t>(in_flight.result.data.data() + in_flight.finished_size);
+        sqe.len = static_cast<uint32_t>(std::min(in_flight.read_size - in_flight.finished_size, MAX_READ_SIZE));
+        sqe.user_data = slot;
+
+        _ring.sq_array[index] = index;
+        __atomic_store_n(_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    void AsyncFileIo::uring_loop()
+    {
+        uint32_t in_flight_count = 0;
+        uint32_t unsubmitted_count = 0;
+        std::vector<Request> batch;
+        while (true)
+        {
+            batch.clear();
+            {
+                std::unique_lock lock(_mutex);
+                if (in_flight_count == 0)
+                {
+                    _condition.wait(lock, [this]() { return _stop || !_requests.empty(); });
+                    if (_requests.empty()) return;
+                }
+
+                const uint64_t count = std::min<uint64_t>(_requests.size(), _free_slots.size());
+                for (uint64_t ix = 0; ix < count; ++ix)
+                {
+                    batch.push_back(std::move(_requests.front()));
+                    _requests.pop_front();
+                }
+            }
+
+            for (auto& request : batch)
+            {
+                const uint32_t slot = _free_slots.back();
+                InFlight& in_flight = _slots[slot];
+                in_flight = InFlight{};
+                in_flight.request = std::move(request);
+                if (!prepare(in_flight)) continue;
+
+                if (in_flight.read_size == 0)
+                {
+                    ::close(in_flight.fd);
+                    in_flight.result.success = true;
+                    complete(in_flight.request, in_flight.result);
+                    continue;
+                }
+
+                _free_slots.pop_back();
+                submit_read(slot);
+                unsubmitted_count++;
+                in_flight_count++;
+            }
+            if (in_flight_count == 0)
+            {
+                flush_completions();
+                continue;
+            }
+
+            // 一次系统调用提交整批请求, 并等待至少一个完成.
+            const int32_t ret = static_cast<int32_t>(syscall(__NR_io_uring_enter, _ring_fd, unsubmitted_count, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                LOG_ERROR("io_uring_enter failed: " + std::string(strerror(errno)));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            unsubmitted_count -= static_cast<uint32_t>(ret);
+
+            uint32_t head = *_ring.cq_head;
+            const uint32_t tail = __atomic_load_n(_ring.cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(_ring.cqes)[head & *_ring.cq_mask];
+                const uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+                InFlight& in_flight = _slots[slot];
+
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    submit_read(slot);
+                    unsubmitted_count++;
+                    continue;
+                }
+
+                if (cqe.res > 0)
+                {
+                    in_flight.finished_size += static_cast<uint64_t>(cqe.res);
+                    if (in_flight.finished_size < in_flight.read_size)
+                    {
+                        // 读取不完整时继续读剩余部分.
+                        submit_read(slot);
+                        unsubmitted_count++;
+                        continue;
+                    }
+                    in_flight.result.success = true;
+                }
+                else
+                {
+                    LOG_ERROR("Read " + in_flight.request.desc.path + " failed.");
+                }
+
+                ::close(in_flight.fd);
+                complete(in_flight.request, in_flight.result);
+                in_flight = InFlight{};
+                _free_slots.push_back(slot);
+                in_flight_count--;
+            }
+            __atomic_store_n(_ring.cq_head, head, __ATOMIC_RELEASE);
+
+            flush_completions();
+        }
+    }
+#endif
+}
@@ -0,0 +1,162 @@
+#ifndef CORE_ASYNC_FILE_IO_H
+#define CORE_ASYNC_FILE_IO_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fantasy
+{
+    struct AsyncReadRequest
+    {
+        std::string path;
+        uint64_t offset = 0;
+        uint64_t size = 0;              // 0 表示读到文件末尾.
+
+        // 为空时从缓存池中分配, 否则最多读取 buffer.size() 字节.
+        std::span<uint8_t> buffer;
+    };
+
+    struct AsyncReadResult
+    {
+        uint32_t index = 0;             // 请求在本次 read() 中的下标.
+        bool success = false;
+        std::span<uint8_t> data;
+
+        // 使用缓存池时 data 指向这里, 回调结束后会被回收, 需要保留的话在回调中 move 走.
+        std::vector<uint8_t> buffer;
+    };
+
+    // 异步读文件. 一个专用的 I/O 线程负责提交请求, Linux 上使用 io_uring, 一次提交一批读请求,
+    // 其他平台或 io_uring 不可用时在该线程中阻塞读取. 完成回调在线程池中执行, 需要先调用 parallel::initialize().
+    class AsyncFileIo
+    {
+    public:
+        using ReadFunc = std::function<void(AsyncReadResult&)>;
+
+        ~AsyncFileIo();
+
+        bool initialize(uint32_t queue_depth = 256);
+        void destroy();
+
+        // 每个请求完成后调用一次 func, 不保证顺序.
+        void read(std::span<const AsyncReadRequest> requests, ReadFunc func);
+
+        // 等待所有请求的回调执行完毕.
+        void wait_idle();
+
+        // 归还不再使用的缓存, 之后的请求可以复用.
+        void recycle(std::vector<uint8_t>&& buffer);
+
+        bool using_io_uring() const { return _ring_fd >= 0; }
+
+    private:
+        struct Request
+        {
+            AsyncReadRequest desc;
+            uint32_t index = 0;
+            std::shared_ptr<ReadFunc> func;
+        };
+
+        struct InFlight
+        {
+            Request request;
+            AsyncReadResult result;
+            int32_t fd = -1;
+            uint64_t read_size = 0;
+            uint64_t finished_size = 0;
+        };
+
+        struct Completion
+        {
+            std::shared_ptr<ReadFunc> func;
+            AsyncReadResult result;
+        };
+
+        void io_thread();
+        void blocking_read(Request& request);
+        void complete(Request& request, AsyncReadResult& result);
+        void flush_completions();
+
+        std::vector<uint8_t> acquire_buffer(uint64_t size);
+
+#if defined(__linux__)
+        // 打开文件并确定读取大小, 失败时直接完成请求.
+        bool prepare(InFlight& in_flight);
+
+        bool initialize_ring(uint32_t queue_depth);
+        void destroy_ring();
+        void submit_read(uint32_t slot);
+        void uring_loop();
+#endif
+
+    private:
+        std::thread _thread;
+        bool _stop = false;
+
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<Request> _requests;
+
+        // 只在 I/O 线程中访问, 每轮收割后按批交给线程池.
+        std::vector<Completion> _completions;
+
+        std::mutex _idle_mutex;
+        std::condition_variable _idle_condition;
+        std::atomic<uint64_t> _pending_count = 0;
+
+        std::mutex _buffer_mutex;
+        std::vector<std::vector<uint8_t>> _free_buffers;
+
+        int32_t _ring_fd = -1;
+
+#if defined(__linux__)
+        struct Ring
+        {
+            void* sq_ring = nullptr;
+            void* cq_ring = nullptr;
+            uint64_t sq_ring_size = 0;
+            uint64_t cq_ring_size = 0;
+            void* sqes = nullptr;
+            uint64_t sqes_size = 0;
+
+            uint32_t* sq_head = nullptr;
+            uint32_t* sq_tail = nullptr;
+            uint32_t* sq_mask = nullptr;
+            uint32_t* sq_array = nullptr;
+            uint32_t* cq_head = nullptr;
+            uint32_t* cq_tail = nullptr;
+            uint32_t* cq_mask = nullptr;
+            void* cqes = nullptr;
+
+            uint32_t entries = 0;
+        } _ring;
+
+        std::vector<InFlight> _slots;
+        std::vector<uint32_t> _free_slots;
+#endif
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef CORE_FILE_H
 #define CORE_FILE_H
+#include <cstdint>
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <vector>
 
 namespace fantasy
 {
@@ -23,6 +25,16 @@ namespace fantasy
 		return get_file_last_write_time(file0) > get_file_last_write_time(file1);
 	}
 
+	inline bool read_binary_file(const char* path, std::vector<uint8_t>& out_data)
+	{
+		std::ifstream input(path, std::ios::binary | std::ios::ate);
+		if (!input.is_open()) return false;
+
+		out_data.resize(static_cast<uint64_t>(input.tellg()));
+		input.seekg(0);
+		return static_cast<bool>(input.read(reinterpret_cast<char*>(out_data.data()), static_cast<std::streamsize>(out_data.size())));
+	}
+
 	inline std::string remove_file_extension(const char* path)
 	{
 		const std::filesystem::path file_path(path);
@@ -39,123 +51,18 @@ namespace fantasy
 		}
 	}
 
-
-	namespace serialization
+	// 转为绝对路径并统一使用 '/', 用于比较来自不同来源的同一文件.
+	inline std::string normalize_path(const std::string& path)
 	{
-		class BinaryOutput
-		{
-		public:
-			BinaryOutput(const std::string& file_name) : _output(file_name, std::ios::binary) {}
-			~BinaryOutput() { _output.close(); }
-
-			template <typename... Args>
-			void operator()(Args&&... arguments)
-			{
-				(process(arguments), ...);
-			}
-
-		public:
-			void save_binary_data(const void* data, int64_t size)
-			{
-				if (_output.is_open())
-				{
-					_output.write(static_cast<const char*>(data), size);
-					_output.write("\n", 1);
-				}
-			}
-
-		private:
-			template <typename T>
-			void process(T&& value)
-			{
-				process_impl(value);
-			}
-
-			template <typename T>
-			void process_impl(const std::vector<T>& value)
-			{
-				uint64_t size = value.size();
-				save_binary_data(&size, sizeof(uint64_t));
-				for (const T& element : value)
-				{
-					process_impl(element);
-				}
-			}
-
-			void process_impl(const std::string& value)
-			{
-				uint64_t size = value.size();
-				save_binary_data(&size, sizeof(uint64_t));
-				save_binary_data(value.data(), static_cast<int64_t>(size));
-			}
-
-			void process_impl(uint64_t value) { save_binary_data(&value, sizeof(uint64_t)); }
-			void process_impl(uint32_t value) { save_binary_data(&value, sizeof(uint32_t)); }
-			void process_impl(float value) { save_binary_data(&value, sizeof(float)); }
-
-		private:
-			std::ofstream _output;
-		};
-
-		class BinaryInput
+		std::error_code error;
+		const std::filesystem::path file_path = std::filesystem::weakly_canonical(path, error);
+		if (error)
 		{
-		public:
-			BinaryInput(const std::string& file_name) : _input(file_name, std::ios::binary) {}
-			~BinaryInput() noexcept { _input.close(); }
-
-			template <typename... Args>
-			void operator()(Args&&... arguments)
-			{
-				(process(arguments), ...);
-			}
-
-		public:
-			void load_binary_data(void* out_data, int64_t size)
-			{
-				if (_input.is_open())
-				{
-					_input.read(static_cast<char*>(out_data), size);
-					char new_line;
-					_input.read(&new_line, 1);
-				}
-			}
-
-		private:
-			template <typename T>
-			void process(T&& value)
-			{
-				process_impl(value);
-			}
-
-			template <typename T>
-			void process_impl(std::vector<T>& out)
-			{
-				uint64_t size = 0;
-				load_binary_data(&size, sizeof(uint64_t));
-
-				out.resize(size);
-				for (T& element : out)
-				{
-					process_impl(element);
-				}
-			}
-
-			void process_impl(std::string& out)
-			{
-				uint64_t size = 0;
-				load_binary_data(&size, sizeof(uint64_t));
-
-				out.resize(size);
-				load_binary_data(out.data(), static_cast<int64_t>(size));
-			}
-
-			void process_impl(uint64_t& OutValue) { load_binary_data(&OutValue, sizeof(uint64_t)); }
-			void process_impl(uint32_t& OutValue) { load_binary_data(&OutValue, sizeof(uint32_t)); }
-			void process_impl(float& OutValue) { load_binary_data(&OutValue, sizeof(float)); }
-
-		private:
-			std::ifstream _input;
-		};
+			std::string ret = path;
+			replace_back_slashes(ret);
+			return ret;
+		}
+		return file_path.generic_string();
 	}
 }
 
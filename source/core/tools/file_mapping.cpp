@@ -0,0 +1,117 @@
+#include "file_mapping.h"
+#include "log.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fantasy
+{
+    FileMapping::~FileMapping()
+    {
+        close();
+    }
+
+#if defined(_WIN32)
+    bool FileMapping::open(const std::string& path)
+    {
+        close();
+
+        // 允许其他句柄继续追加写入, 映射只覆盖打开时的文件大小.
+        HANDLE file = CreateFileA(
+            path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL,
+            nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            LOG_ERROR("Open file " + path + " failed.");
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr)
+        {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            LOG_ERROR("Map file " + path + " failed.");
+            return false;
+        }
+
+        _file = file;
+        _mapping = mapping;
+        _data = static_cast<const uint8_t*>(data);
+        _size = static_cast<uint64_t>(size.QuadPart);
+        return true;
+    }
+
+    void FileMapping::close()
+    {
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file) CloseHandle(_file);
+
+        _data = nullptr;
+        _size = 0;
+        _file = nullptr;
+        _mapping = nullptr;
+    }
+#else
+    bool FileMapping::open(const std::string& path)
+    {
+        close();
+
+        const int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            LOG_ERROR("Open file " + path + " failed.");
+            return false;
+        }
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size == 0)
+        {
+            ::close(file);
+            return false;
+        }
+
+        // 映射建立后即可关闭文件描述符.
+        void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+        ::close(file);
+        if (data == MAP_FAILED)
+        {
+            LOG_ERROR("Map file " + path + " failed.");
+            return false;
+        }
+
+        _data = static_cast<const uint8_t*>(data);
+        _size = static_cast<uint64_t>(status.st_size);
+        return true;
+    }
+
+    void FileMapping::close()
+    {
+        if (_data) munmap(const_cast<uint8_t*>(_data), static_cast<size_t>(_size));
+
+        _data = nullptr;
+        _size = 0;
+    }
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef CORE_FILE_MAPPING_H
+#define CORE_FILE_MAPPING_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace fantasy
+{
+    // 只读映射整个文件, 析构时解除映射.
+    class FileMapping
+    {
+    public:
+        FileMapping() = default;
+        ~FileMapping();
+
+        FileMapping(const FileMapping&) = delete;
+        FileMapping& operator=(const FileMapping&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        const uint8_t* data() const { return _data; }
+        uint64_t size() const { return _size; }
+        std::span<const uint8_t> view() const { return std::span<const uint8_t>(_data, _size); }
+
+        bool is_open() const { return _data != nullptr; }
+
+    private:
+        const uint8_t* _data = nullptr;
+        uint64_t _size = 0;
+
+#if defined(_WIN32)
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+#endif
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,188 @@
+#include "file_watcher.h"
+#include "file.h"
+#include "log.h"
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fantasy
+{
+    FileWatcher::~FileWatcher()
+    {
+        destroy();
+    }
+
+#if defined(_WIN32)
+    static_assert(sizeof(OVERLAPPED) <= 32);
+
+    bool FileWatcher::initialize(const std::string& directory)
+    {
+        destroy();
+        _directory = normalize_path(directory);
+
+        HANDLE handle = CreateFileA(
+            _directory.c_str(),
+            FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+            nullptr
+        );
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            LOG_ERROR("Watch directory " + directory + " failed.");
+            return false;
+        }
+
+        _directory_handle = handle;
+        _event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        return begin_read();
+    }
+
+    void FileWatcher::destroy()
+    {
+        if (_directory_handle)
+        {
+            CancelIo(_directory_handle);
+            CloseHandle(_directory_handle);
+        }
+        if (_event) CloseHandle(_event);
+
+        _directory_handle = nullptr;
+        _event = nullptr;
+    }
+
+    bool FileWatcher::begin_read()
+    {
+        OVERLAPPED* overlapped = reinterpret_cast<OVERLAPPED*>(_overlapped);
+        *overlapped = OVERLAPPED{};
+        overlapped->hEvent = _event;
+        ResetEvent(_event);
+
+        if (!ReadDirectoryChangesW(
+            _directory_handle,
+            _buffer,
+            sizeof(_buffer),
+            TRUE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+            nullptr,
+            overlapped,
+            nullptr
+        ))
+        {
+            LOG_ERROR("ReadDirectoryChangesW() called failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool FileWatcher::wait_changes(std::vector<std::string>& out_paths, uint32_t timeout_ms)
+    {
+        if (_directory_handle == nullptr) return false;
+        if (WaitForSingleObject(_event, timeout_ms) != WAIT_OBJECT_0) return true;
+
+        DWORD size = 0;
+        if (!GetOverlappedResult(_directory_handle, reinterpret_cast<OVERLAPPED*>(_overlapped), &size, FALSE)) return false;
+
+        // size 为 0 说明缓冲区溢出, 变化的文件已经丢失, 只能等待下一次修改.
+        uint64_t offset = 0;
+        while (size > 0)
+        {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(_buffer + offset);
+            if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+            {
+                const std::wstring name(info->FileName, info->FileNameLength / sizeof(WCHAR));
+                out_paths.push_back(normalize_path((std::filesystem::path(_directory) / name).string()));
+            }
+
+            if (info->NextEntryOffset == 0) break;
+            offset += info->NextEntryOffset;
+        }
+        return begin_read();
+    }
+#else
+    bool FileWatcher::initialize(const std::string& directory)
+    {
+        destroy();
+        _directory = normalize_path(directory);
+
+        _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify < 0)
+        {
+            LOG_ERROR("inotify_init1() called failed.");
+            return false;
+        }
+
+        // inotify 不支持递归监听, 每个子目录单独添加.
+        if (!add_watch(_directory)) return false;
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(_directory, error))
+        {
+            if (entry.is_directory() && !add_watch(entry.path().generic_string())) return false;
+        }
+        return true;
+    }
+
+    void FileWatcher::destroy()
+    {
+        if (_inotify >= 0) close(_inotify);
+        _inotify = -1;
+        _watch_directories.clear();
+    }
+
+    bool FileWatcher::add_watch(const std::string& directory)
+    {
+        const int watch = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch < 0)
+        {
+            LOG_ERROR("Watch directory " + directory + " failed.");
+            return false;
+        }
+        _watch_directories[watch] = directory;
+        return true;
+    }
+
+    bool FileWatcher::wait_changes(std::vector<std::string>& out_paths, uint32_t timeout_ms)
+    {
+        if (_inotify < 0) return false;
+
+        pollfd poll_fd{ .fd = _inotify, .events = POLLIN, .revents = 0 };
+        if (poll(&poll_fd, 1, static_cast<int>(timeout_ms)) <= 0) return true;
+
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (true)
+        {
+            const ssize_t size = read(_inotify, buffer, sizeof(buffer));
+            if (size <= 0) break;
+
+            for (ssize_t offset = 0; offset < size;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                auto iter = _watch_directories.find(event->wd);
+                if (iter == _watch_directories.end() || event->len == 0) continue;
+
+                const std::string path = iter->second + "/" + event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    if (event->mask & IN_CREATE) add_watch(path);
+                    continue;
+                }
+
+                // 只有 IN_CREATE 的新文件此时可能还未写完, 等待随后的 IN_CLOSE_WRITE.
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) out_paths.push_back(normalize_path(path));
+            }
+        }
+        return true;
+    }
+#endif
+}
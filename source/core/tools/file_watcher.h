@@ -0,0 +1,56 @@
+#ifndef CORE_FILE_WATCHER_H
+#define CORE_FILE_WATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy
+{
+    // 监听目录及其子目录下文件的写入, 创建和重命名. Windows 上使用 ReadDirectoryChangesW, 其他平台使用 inotify.
+    class FileWatcher
+    {
+    public:
+        FileWatcher() = default;
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        bool initialize(const std::string& directory);
+        void destroy();
+
+        // 最多阻塞 timeout_ms 毫秒, 将发生变化的文件路径 (normalize_path() 后) 追加到 out_paths, 可能重复.
+        bool wait_changes(std::vector<std::string>& out_paths, uint32_t timeout_ms);
+
+    private:
+        std::string _directory;
+
+#if defined(_WIN32)
+        bool begin_read();
+
+        void* _directory_handle = nullptr;
+        void* _event = nullptr;
+        alignas(8) uint8_t _overlapped[32] = {};
+        alignas(8) uint8_t _buffer[64 * 1024] = {};
+#else
+        bool add_watch(const std::string& directory);
+
+        int _inotify = -1;
+        std::unordered_map<int, std::string> _watch_directories;
+#endif
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,190 @@
+#include "frame_benchmark.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fantasy
+{
+    static std::string to_json_string(const std::string& str)
+    {
+        std::string ret = "\"";
+        for (const char c : str)
+        {
+            switch (c)
+            {
+            case '"': ret += "\\\""; break;
+            case '\\': ret += "\\\\"; break;
+            case '\n': ret += "\\n"; break;
+            case '\t': ret += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    ret += buffer;
+                }
+                else
+                {
+                    ret += c;
+                }
+            }
+        }
+        return ret + "\"";
+    }
+
+    static std::string to_json_number(double value)
+    {
+        std::ostringstream stream;
+        if (value == std::floor(value) && std::abs(value) < 1e15)
+        {
+            stream << static_cast<int64_t>(value);
+        }
+        else
+        {
+            stream.precision(6);
+            stream << std::fixed << value;
+        }
+        return stream.str();
+    }
+
+    // 最近秩法, 结果总是某个实际的样本.
+    static double get_percentile(const std::vector<double>& sorted_samples, double percentile)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted_samples.size()));
+        return sorted_samples[std::clamp(rank, size_t(1), sorted_samples.size()) - 1];
+    }
+
+    void FrameBenchmark::initialize(uint64_t warmup_frame_count, uint64_t frame_count)
+    {
+        _warmup_frame_count = warmup_frame_count;
+        _frame_count = frame_count;
+        _cpu_times.assign(frame_count, -1.0);
+        _gpu_times.assign(frame_count, -1.0);
+        _infos.clear();
+    }
+
+    void FrameBenchmark::record_cpu_time(uint64_t frame_index, double milliseconds)
+    {
+        uint64_t index = 0;
+        if (get_sample_index(frame_index, index)) _cpu_times[index] = milliseconds;
+    }
+
+    void FrameBenchmark::record_gpu_time(uint64_t frame_index, double milliseconds)
+    {
+        uint64_t index = 0;
+        if (get_sample_index(frame_index, index)) _gpu_times[index] = milliseconds;
+    }
+
+    void FrameBenchmark::add_info(const std::string& key, const std::string& value)
+    {
+        _infos.emplace_back(key, to_json_string(value));
+    }
+
+    void FrameBenchmark::add_info(const std::string& key, double value)
+    {
+        _infos.emplace_back(key, to_json_number(value));
+    }
+
+    FrameTimeStatistics FrameBenchmark::get_statistics(const std::vector<double>& samples)
+    {
+        std::vector<double> sorted_samples;
+        sorted_samples.reserve(samples.size());
+        for (const double sample : samples)
+        {
+            if (sample >= 0.0) sorted_samples.push_back(sample);
+        }
+
+        FrameTimeStatistics ret;
+        if (sorted_samples.empty()) return ret;
+
+        std::sort(sorted_samples.begin(), sorted_samples.end());
+
+        double sum = 0.0;
+        for (const double sample : sorted_samples) sum += sample;
+
+        ret.sample_count = sorted_samples.size();
+        ret.min = sorted_samples.front();
+        ret.max = sorted_samples.back();
+        ret.mean = sum / sorted_samples.size();
+        ret.p50 = get_percentile(sorted_samples, 50.0);
+        ret.p95 = get_percentile(sorted_samples, 95.0);
+        ret.p99 = get_percentile(sorted_samples, 99.0);
+        return ret;
+    }
+
+    bool FrameBenchmark::write_json(const std::string& path) const
+    {
+        const auto write_statistics = [](std::ostream& stream, const FrameTimeStatistics& statistics)
+        {
+            stream << "{ \"sample_count\": " << statistics.sample_count
+                   << ", \"min\": " << to_json_number(statistics.min)
+                   << ", \"mean\": " << to_json_number(statistics.mean)
+                   << ", \"p50\": " << to_json_number(statistics.p50)
+                   << ", \"p95\": " << to_json_number(statistics.p95)
+                   << ", \"p99\": " << to_json_number(statistics.p99)
+                   << ", \"max\": " << to_json_number(statistics.max) << " }";
+        };
+
+        // 未记录的帧写为 null, 保持数组下标与帧序号对应.
+        const auto write_samples = [](std::ostream& stream, const std::vector<double>& samples)
+        {
+            stream << "[";
+            for (size_t ix = 0; ix < samples.size(); ++ix)
+            {
+                if (ix != 0) stream << ", ";
+                if (samples[ix] >= 0.0) stream << to_json_number(samples[ix]);
+                else stream << "null";
+            }
+            stream << "]";
+        };
+
+        const std::filesystem::path file_path(path);
+        if (file_path.has_parent_path())
+        {
+            std::error_code error;
+            std::filesystem::create_directories(file_path.parent_path(), error);
+        }
+
+        std::ofstream file(file_path, std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOG_ERROR("Open benchmark output " + path + " failed.");
+            return false;
+        }
+
+        file << "{\n";
+        for (const auto& [key, value] : _infos)
+        {
+            file << "    " << to_json_string(key) << ": " << value << ",\n";
+        }
+        file << "    \"warmup_frame_count\": " << _warmup_frame_count << ",\n";
+        file << "    \"frame_count\": " << _frame_count << ",\n";
+        file << "    \"cpu_frame_ms\": ";
+        write_statistics(file, get_statistics(_cpu_times));
+        file << ",\n    \"gpu_frame_ms\": ";
+        write_statistics(file, get_statistics(_gpu_times));
+        file << ",\n    \"frames\": {\n        \"cpu_ms\": ";
+        write_samples(file, _cpu_times);
+        file << ",\n        \"gpu_ms\": ";
+        write_samples(file, _gpu_times);
+        file << "\n    }\n}\n";
+
+        if (!file.good())
+        {
+            LOG_ERROR("Write benchmark output " + path + " failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool FrameBenchmark::get_sample_index(uint64_t frame_index, uint64_t& out_index) const
+    {
+        if (frame_index < _warmup_frame_count || frame_index >= _warmup_frame_count + _frame_count) return false;
+        out_index = frame_index - _warmup_frame_count;
+        return true;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef CORE_FRAME_BENCHMARK_H
+#define CORE_FRAME_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fantasy
+{
+    struct FrameTimeStatistics
+    {
+        uint64_t sample_count = 0;
+        double min = 0.0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    // 记录一段连续帧的 CPU 帧时间和 GPU 时间 (毫秒), 结束后统计百分位并写入 JSON.
+    // 前 warmup_frame_count 帧 (管线创建, 首次上传等) 不计入统计.
+    // GPU 时间要等帧的 fence 之后才能读取, 所以两种时间都按帧序号记录, 可以乱序写入.
+    class FrameBenchmark
+    {
+    public:
+        void initialize(uint64_t warmup_frame_count, uint64_t frame_count);
+
+        bool is_enabled() const { return _frame_count > 0; }
+
+        // 包括预热帧在内的全部帧都已经渲染.
+        bool is_finished(uint64_t frame_index) const { return is_enabled() && frame_index >= _warmup_frame_count + _frame_count; }
+
+        void record_cpu_time(uint64_t frame_index, double milliseconds);
+        void record_gpu_time(uint64_t frame_index, double milliseconds);
+
+        // 附加到 JSON 中的环境信息, 如设备名和分辨率.
+        void add_info(const std::string& key, const std::string& value);
+        void add_info(const std::string& key, double value);
+
+        bool write_json(const std::string& path) const;
+
+        // 负数表示这一帧没有记录 (如设备不支持时间戳), 不计入统计.
+        static FrameTimeStatistics get_statistics(const std::vector<double>& samples);
+
+    private:
+        bool get_sample_index(uint64_t frame_index, uint64_t& out_index) const;
+
+    private:
+        uint64_t _warmup_frame_count = 0;
+        uint64_t _frame_count = 0;
+
+        // 未记录的帧为负数.
+        std::vector<double> _cpu_times;
+        std::vector<double> _gpu_times;
+
+        std::vector<std::pair<std::string, std::string>> _infos;    // 值已经是 JSON 文本.
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -82,6 +82,30 @@ namespace fantasy
         uint32_t b = murmur_add(a, z.u);
 		return murmur_mix(b);
 	}
+
+
+    struct Hash128
+    {
+        uint64_t low = 0;
+        uint64_t high = 0;
+
+        bool operator==(const Hash128& other) const { return low == other.low && high == other.high; }
+        bool operator!=(const Hash128& other) const { return !(*this == other); }
+    };
+
+    struct Hash128Hasher
+    {
+        uint64_t operator()(const Hash128& hash) const { return hash.low ^ (hash.high * 0x9e3779b97f4a7c15ull); }
+    };
+
+    // MurmurHash3 x64 128 位版本, 用于缓存键等需要低冲突率的场合.
+    Hash128 murmur_hash128(const void* data, uint64_t size, uint64_t seed = 0);
+
+    // 以 hash 为种子继续哈希 data, 用于将多段数据按顺序组合成一个 hash.
+    inline Hash128 murmur_hash128(const Hash128& hash, const void* data, uint64_t size)
+    {
+        return murmur_hash128(data, size, hash.low ^ hash.high);
+    }
 }
 
 
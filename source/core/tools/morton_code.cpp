@@ -0,0 +1,199 @@
+#include "morton_code.h"
+#include <algorithm>
+#include <cassert>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MORTON_CODE_BMI2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define BMI2_TARGET
+#else
+#define BMI2_TARGET __attribute__((target("bmi2")))
+#endif
+#else
+#define MORTON_CODE_BMI2 0
+#endif
+
+namespace fantasy
+{
+    static constexpr uint64_t MORTON3_MASK_X = 0x1249249249249249ull;
+    static constexpr uint64_t MORTON3_MASK_Y = MORTON3_MASK_X << 1;
+    static constexpr uint64_t MORTON3_MASK_Z = MORTON3_MASK_X << 2;
+
+    bool cpu_support_bmi2()
+    {
+#if MORTON_CODE_BMI2
+        static const bool supported = []()
+        {
+#if defined(_MSC_VER)
+            int info[4] = {};
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 8)) != 0;
+#else
+            return __builtin_cpu_supports("bmi2") != 0;
+#endif
+        }();
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    // 将点量化到 [0, 2^bit_count - 1] 的整数网格.
+    struct Quantizer
+    {
+        float3 lower;
+        float3 scale;
+        float max_value;
+
+        Quantizer(const Bounds3F& bounds, uint32_t bit_count)
+        {
+            max_value = static_cast<float>((1u << bit_count) - 1);
+            const float3 extent = bounds._upper - bounds._lower;
+
+            lower = bounds._lower;
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                scale[ix] = extent[ix] > 0.0f ? max_value / extent[ix] : 0.0f;
+            }
+        }
+
+        void quantize(const float3& point, uint32_t (&out_axes)[3]) const
+        {
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                const float value = std::clamp((point[ix] - lower[ix]) * scale[ix], 0.0f, max_value);
+                out_axes[ix] = static_cast<uint32_t>(value);
+            }
+        }
+    };
+
+#if MORTON_CODE_BMI2
+    BMI2_TARGET static void morton_encode_bmi2(std::span<const float3> points, const Quantizer& quantizer, std::span<uint32_t> out_codes)
+    {
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = static_cast<uint32_t>(
+                _pdep_u64(axes[0], MORTON3_MASK_X) | _pdep_u64(axes[1], MORTON3_MASK_Y) | _pdep_u64(axes[2], MORTON3_MASK_Z)
+            );
+        }
+    }
+
+    BMI2_TARGET static void morton_encode64_bmi2(std::span<const float3> points, const Quantizer& quantizer, std::span<uint64_t> out_codes)
+    {
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = _pdep_u64(axes[0], MORTON3_MASK_X) | _pdep_u64(axes[1], MORTON3_MASK_Y) | _pdep_u64(axes[2], MORTON3_MASK_Z);
+        }
+    }
+
+    // 位数作为模板参数, 让转置的循环可以完全展开.
+    template <uint32_t BitCount, typename Code>
+    BMI2_TARGET static void hilbert_encode_bmi2(std::span<const float3> points, const Quantizer& quantizer, std::span<Code> out_codes)
+    {
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            hilbert_transpose(axes, BitCount);
+            out_codes[ix] = static_cast<Code>(
+                _pdep_u64(axes[2], MORTON3_MASK_X) | _pdep_u64(axes[1], MORTON3_MASK_Y) | _pdep_u64(axes[0], MORTON3_MASK_Z)
+            );
+        }
+    }
+
+    BMI2_TARGET static void morton_decode64_bmi2(std::span<const uint64_t> codes, std::span<uint3> out_coords)
+    {
+        for (uint64_t ix = 0; ix < codes.size(); ++ix)
+        {
+            out_coords[ix] = uint3(
+                static_cast<uint32_t>(_pext_u64(codes[ix], MORTON3_MASK_X)),
+                static_cast<uint32_t>(_pext_u64(codes[ix], MORTON3_MASK_Y)),
+                static_cast<uint32_t>(_pext_u64(codes[ix], MORTON3_MASK_Z))
+            );
+        }
+    }
+#endif
+
+    void morton_encode(std::span<const float3> points, const Bounds3F& bounds, std::span<uint32_t> out_codes)
+    {
+        assert(points.size() == out_codes.size());
+
+        const Quantizer quantizer(bounds, 10);
+#if MORTON_CODE_BMI2
+        if (cpu_support_bmi2()) return morton_encode_bmi2(points, quantizer, out_codes);
+#endif
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = morton_encode(axes[0], axes[1], axes[2]);
+        }
+    }
+
+    void morton_encode64(std::span<const float3> points, const Bounds3F& bounds, std::span<uint64_t> out_codes)
+    {
+        assert(points.size() == out_codes.size());
+
+        const Quantizer quantizer(bounds, 21);
+#if MORTON_CODE_BMI2
+        if (cpu_support_bmi2()) return morton_encode64_bmi2(points, quantizer, out_codes);
+#endif
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = morton_encode64(axes[0], axes[1], axes[2]);
+        }
+    }
+
+    void hilbert_encode(std::span<const float3> points, const Bounds3F& bounds, std::span<uint32_t> out_codes)
+    {
+        assert(points.size() == out_codes.size());
+
+        const Quantizer quantizer(bounds, 10);
+#if MORTON_CODE_BMI2
+        if (cpu_support_bmi2()) return hilbert_encode_bmi2<10>(points, quantizer, out_codes);
+#endif
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = hilbert_encode(axes[0], axes[1], axes[2]);
+        }
+    }
+
+    void hilbert_encode64(std::span<const float3> points, const Bounds3F& bounds, std::span<uint64_t> out_codes)
+    {
+        assert(points.size() == out_codes.size());
+
+        const Quantizer quantizer(bounds, 21);
+#if MORTON_CODE_BMI2
+        if (cpu_support_bmi2()) return hilbert_encode_bmi2<21>(points, quantizer, out_codes);
+#endif
+        for (uint64_t ix = 0; ix < points.size(); ++ix)
+        {
+            uint32_t axes[3];
+            quantizer.quantize(points[ix], axes);
+            out_codes[ix] = hilbert_encode64(axes[0], axes[1], axes[2]);
+        }
+    }
+
+    void morton_decode64(std::span<const uint64_t> codes, std::span<uint3> out_coords)
+    {
+        assert(codes.size() == out_coords.size());
+
+#if MORTON_CODE_BMI2
+        if (cpu_support_bmi2()) return morton_decode64_bmi2(codes, out_coords);
+#endif
+        for (uint64_t ix = 0; ix < codes.size(); ++ix)
+        {
+            morton_decode(codes[ix], out_coords[ix].x, out_coords[ix].y, out_coords[ix].z);
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #ifndef CORE_TOOLS_MORTON_CODE_H
 #define CORE_TOOLS_MORTON_CODE_H
+#include "../math/bounds.h"
 #include <cstdint>
+#include <span>
 
 namespace fantasy 
 {
@@ -35,6 +37,165 @@ namespace fantasy
         y = ReverseMortonCode2(Morton >> 1);
     }
 
+
+    // 将低位的比特按 2 或 3 的间隔展开, 用于按轴交错编码.
+    inline uint64_t morton_expand2(uint64_t x)
+    {
+        x &= 0x00000000ffffffffull;
+        x = (x ^ (x << 16)) & 0x0000ffff0000ffffull;
+        x = (x ^ (x << 8))  & 0x00ff00ff00ff00ffull;
+        x = (x ^ (x << 4))  & 0x0f0f0f0f0f0f0f0full;
+        x = (x ^ (x << 2))  & 0x3333333333333333ull;
+        x = (x ^ (x << 1))  & 0x5555555555555555ull;
+        return x;
+    }
+
+    inline uint64_t morton_compact2(uint64_t x)
+    {
+        x &= 0x5555555555555555ull;
+        x = (x ^ (x >> 1))  & 0x3333333333333333ull;
+        x = (x ^ (x >> 2))  & 0x0f0f0f0f0f0f0f0full;
+        x = (x ^ (x >> 4))  & 0x00ff00ff00ff00ffull;
+        x = (x ^ (x >> 8))  & 0x0000ffff0000ffffull;
+        x = (x ^ (x >> 16)) & 0x00000000ffffffffull;
+        return x;
+    }
+
+    inline uint64_t morton_expand3(uint64_t x)
+    {
+        x &= 0x00000000001fffffull;
+        x = (x ^ (x << 32)) & 0x001f00000000ffffull;
+        x = (x ^ (x << 16)) & 0x001f0000ff0000ffull;
+        x = (x ^ (x << 8))  & 0x100f00f00f00f00full;
+        x = (x ^ (x << 4))  & 0x10c30c30c30c30c3ull;
+        x = (x ^ (x << 2))  & 0x1249249249249249ull;
+        return x;
+    }
+
+    inline uint64_t morton_compact3(uint64_t x)
+    {
+        x &= 0x1249249249249249ull;
+        x = (x ^ (x >> 2))  & 0x10c30c30c30c30c3ull;
+        x = (x ^ (x >> 4))  & 0x100f00f00f00f00full;
+        x = (x ^ (x >> 8))  & 0x001f0000ff0000ffull;
+        x = (x ^ (x >> 16)) & 0x001f00000000ffffull;
+        x = (x ^ (x >> 32)) & 0x00000000001fffffull;
+        return x;
+    }
+
+    // 2D: 32 位编码每轴 16 位, 64 位编码每轴 32 位. x 位于最低位.
+    inline uint32_t morton_encode(uint32_t x, uint32_t y)
+    {
+        return static_cast<uint32_t>(morton_expand2(x & 0xffff) | (morton_expand2(y & 0xffff) << 1));
+    }
+
+    inline uint64_t morton_encode64(uint32_t x, uint32_t y)
+    {
+        return morton_expand2(x) | (morton_expand2(y) << 1);
+    }
+
+    // 3D: 32 位编码每轴 10 位, 64 位编码每轴 21 位.
+    inline uint32_t morton_encode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return static_cast<uint32_t>(
+            morton_expand3(x & 0x3ff) | (morton_expand3(y & 0x3ff) << 1) | (morton_expand3(z & 0x3ff) << 2)
+        );
+    }
+
+    inline uint64_t morton_encode64(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return morton_expand3(x) | (morton_expand3(y) << 1) | (morton_expand3(z) << 2);
+    }
+
+    inline void morton_decode(uint64_t code, uint32_t& x, uint32_t& y)
+    {
+        x = static_cast<uint32_t>(morton_compact2(code));
+        y = static_cast<uint32_t>(morton_compact2(code >> 1));
+    }
+
+    inline void morton_decode(uint64_t code, uint32_t& x, uint32_t& y, uint32_t& z)
+    {
+        x = static_cast<uint32_t>(morton_compact3(code));
+        y = static_cast<uint32_t>(morton_compact3(code >> 1));
+        z = static_cast<uint32_t>(morton_compact3(code >> 2));
+    }
+
+    // Skilling 的转置算法, 将坐标原地变换为 hilbert 转置形式, bit_count 为每轴的位数.
+    template <uint32_t Dimension>
+    inline void hilbert_transpose(uint32_t (&axes)[Dimension], uint32_t bit_count)
+    {
+        // 拷贝到局部变量, 避免编译器因别名把每一步都写回内存.
+        uint32_t x[Dimension];
+        for (uint32_t ix = 0; ix < Dimension; ++ix) x[ix] = axes[ix];
+
+        const uint32_t top_bit = 1u << (bit_count - 1);
+        for (uint32_t q = top_bit; q > 1; q >>= 1)
+        {
+            const uint32_t p = q - 1;
+
+            // axes[0] 位为 1 时只翻转自身低位, 单独处理.
+            x[0] ^= p & (0u - ((x[0] & q) != 0));
+            for (uint32_t ix = 1; ix < Dimension; ++ix)
+            {
+                // 该位为 1 时翻转 x[0] 的低位, 否则交换 x[0] 与 x[ix] 的低位. 用掩码代替分支.
+                const uint32_t set_mask = 0u - ((x[ix] & q) != 0);
+                const uint32_t t = (x[0] ^ x[ix]) & p & ~set_mask;
+                x[0] ^= (p & set_mask) | t;
+                x[ix] ^= t;
+            }
+        }
+
+        for (uint32_t ix = 1; ix < Dimension; ++ix) x[ix] ^= x[ix - 1];
+
+        uint32_t t = 0;
+        for (uint32_t q = top_bit; q > 1; q >>= 1)
+        {
+            t ^= (q - 1) & (0u - ((x[Dimension - 1] & q) != 0));
+        }
+        for (uint32_t ix = 0; ix < Dimension; ++ix) axes[ix] = x[ix] ^ t;
+    }
+
+    // hilbert 编码与同维度的 morton 编码位数相同, 转置后第 0 轴位于每组的最高位.
+    inline uint32_t hilbert_encode(uint32_t x, uint32_t y)
+    {
+        uint32_t axes[2] = { x & 0xffff, y & 0xffff };
+        hilbert_transpose(axes, 16);
+        return morton_encode(axes[1], axes[0]);
+    }
+
+    inline uint64_t hilbert_encode64(uint32_t x, uint32_t y)
+    {
+        uint32_t axes[2] = { x, y };
+        hilbert_transpose(axes, 32);
+        return morton_encode64(axes[1], axes[0]);
+    }
+
+    inline uint32_t hilbert_encode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        uint32_t axes[3] = { x & 0x3ff, y & 0x3ff, z & 0x3ff };
+        hilbert_transpose(axes, 10);
+        return morton_encode(axes[2], axes[1], axes[0]);
+    }
+
+    inline uint64_t hilbert_encode64(uint32_t x, uint32_t y, uint32_t z)
+    {
+        uint32_t axes[3] = { x & 0x1fffff, y & 0x1fffff, z & 0x1fffff };
+        hilbert_transpose(axes, 21);
+        return morton_encode64(axes[2], axes[1], axes[0]);
+    }
+
+
+    // 批量版本. 点先被量化到 bounds 内的整数网格 (32 位编码每轴 10 位, 64 位编码每轴 21 位),
+    // cpu 支持 BMI2 时使用 pdep/pext, 否则回退到移位实现, 运行时检测一次.
+    bool cpu_support_bmi2();
+
+    void morton_encode(std::span<const float3> points, const Bounds3F& bounds, std::span<uint32_t> out_codes);
+    void morton_encode64(std::span<const float3> points, const Bounds3F& bounds, std::span<uint64_t> out_codes);
+    void hilbert_encode(std::span<const float3> points, const Bounds3F& bounds, std::span<uint32_t> out_codes);
+    void hilbert_encode64(std::span<const float3> points, const Bounds3F& bounds, std::span<uint64_t> out_codes);
+
+    void morton_decode64(std::span<const uint64_t> codes, std::span<uint3> out_coords);
+
 }
 
 
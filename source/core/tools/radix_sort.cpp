@@ -0,0 +1,116 @@
+#include "radix_sort.h"
+#include "../parallel/parallel.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace fantasy
+{
+    static constexpr uint32_t RADIX_BIT_COUNT = 8;
+    static constexpr uint32_t RADIX_BUCKET_COUNT = 1u << RADIX_BIT_COUNT;
+    static constexpr uint64_t RADIX_MIN_CHUNK_SIZE = 1u << 16;
+
+    template <typename Key>
+    static void radix_sort_impl(std::span<Key> keys, std::span<uint32_t> values, bool parallel)
+    {
+        assert(values.empty() || values.size() == keys.size());
+
+        const uint64_t count = keys.size();
+        if (count <= 1) return;
+
+        const bool has_value = !values.empty();
+
+        uint64_t chunk_count = 1;
+        if (parallel)
+        {
+            const uint64_t thread_count = std::max(parallel::thread_count(), 1u);
+            chunk_count = std::clamp<uint64_t>(count / RADIX_MIN_CHUNK_SIZE, 1, thread_count * 4);
+        }
+        const uint64_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+        auto run_chunks = [chunk_count](const std::function<void(uint64_t)>& func)
+        {
+            if (chunk_count == 1) func(0);
+            else parallel::parallel_for(func, chunk_count);
+        };
+
+        std::vector<Key> key_buffer(count);
+        std::vector<uint32_t> value_buffer(has_value ? count : 0);
+
+        Key* src_keys = keys.data();
+        Key* dst_keys = key_buffer.data();
+        uint32_t* src_values = values.data();
+        uint32_t* dst_values = value_buffer.data();
+
+        // 每块一份直方图, 分散时转为该块在每个桶内的写入位置, 保证排序稳定.
+        std::vector<uint64_t> histograms(chunk_count * RADIX_BUCKET_COUNT);
+
+        for (uint32_t shift = 0; shift < sizeof(Key) * 8; shift += RADIX_BIT_COUNT)
+        {
+            std::fill(histograms.begin(), histograms.end(), 0);
+            run_chunks(
+                [&](uint64_t chunk)
+                {
+                    uint64_t* histogram = histograms.data() + chunk * RADIX_BUCKET_COUNT;
+                    const uint64_t end = std::min(count, (chunk + 1) * chunk_size);
+                    for (uint64_t ix = chunk * chunk_size; ix < end; ++ix)
+                    {
+                        histogram[(src_keys[ix] >> shift) & (RADIX_BUCKET_COUNT - 1)]++;
+                    }
+                }
+            );
+
+            bool skip = false;
+            uint64_t offset = 0;
+            for (uint32_t bucket = 0; bucket < RADIX_BUCKET_COUNT; ++bucket)
+            {
+                uint64_t bucket_count = 0;
+                for (uint64_t chunk = 0; chunk < chunk_count; ++chunk)
+                {
+                    uint64_t& histogram = histograms[chunk * RADIX_BUCKET_COUNT + bucket];
+                    const uint64_t chunk_bucket_count = histogram;
+                    histogram = offset;
+                    offset += chunk_bucket_count;
+                    bucket_count += chunk_bucket_count;
+                }
+                if (bucket_count == count) skip = true;
+            }
+            if (skip) continue;
+
+            run_chunks(
+                [&](uint64_t chunk)
+                {
+                    uint64_t* cursors = histograms.data() + chunk * RADIX_BUCKET_COUNT;
+                    const uint64_t end = std::min(count, (chunk + 1) * chunk_size);
+                    for (uint64_t ix = chunk * chunk_size; ix < end; ++ix)
+                    {
+                        const uint64_t dst = cursors[(src_keys[ix] >> shift) & (RADIX_BUCKET_COUNT - 1)]++;
+                        dst_keys[dst] = src_keys[ix];
+                        if (has_value) dst_values[dst] = src_values[ix];
+                    }
+                }
+            );
+
+            std::swap(src_keys, dst_keys);
+            std::swap(src_values, dst_values);
+        }
+
+        if (src_keys != keys.data())
+        {
+            memcpy(keys.data(), src_keys, count * sizeof(Key));
+            if (has_value) memcpy(values.data(), src_values, count * sizeof(uint32_t));
+        }
+    }
+
+    void radix_sort(std::span<uint32_t> keys, std::span<uint32_t> values, bool parallel)
+    {
+        radix_sort_impl(keys, values, parallel);
+    }
+
+    void radix_sort(std::span<uint64_t> keys, std::span<uint32_t> values, bool parallel)
+    {
+        radix_sort_impl(keys, values, parallel);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef CORE_TOOLS_RADIX_SORT_H
+#define CORE_TOOLS_RADIX_SORT_H
+
+#include <cstdint>
+#include <span>
+
+namespace fantasy
+{
+    // 按 key 做稳定的 LSD 基数排序 (每趟 8 位), values 为空或与 keys 等长, 随 key 一起重排.
+    // 所有 key 在某一字节上都相同时跳过该趟, 因此 30 位的 morton 编码只需要 4 趟.
+    // parallel 为 true 时按块在线程池上统计直方图和分散, 需要先调用 parallel::initialize(),
+    // 且不能在线程池的任务中调用.
+    void radix_sort(std::span<uint32_t> keys, std::span<uint32_t> values, bool parallel = false);
+    void radix_sort(std::span<uint64_t> keys, std::span<uint32_t> values, bool parallel = false);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,193 @@
+#include "serialization.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace fantasy
+{
+    namespace serialization
+    {
+        static constexpr uint64_t BUFFER_SIZE = 64 * 1024;
+
+        BinaryOutput::BinaryOutput(const std::string& file_name) : _output(file_name, std::ios::binary | std::ios::trunc)
+        {
+            if (!_output.is_open())
+            {
+                LOG_ERROR("Open " + file_name + " failed.");
+                _failed = true;
+                return;
+            }
+
+            _buffer.reserve(BUFFER_SIZE);
+
+            const uint32_t header[2] = { SERIALIZATION_MAGIC, SERIALIZATION_FORMAT_VERSION };
+            save_binary_data(header, sizeof(header));
+        }
+
+        BinaryOutput::~BinaryOutput()
+        {
+            close();
+        }
+
+        bool BinaryOutput::close()
+        {
+            if (_output.is_open())
+            {
+                flush();
+                _output.close();
+            }
+            return !_failed;
+        }
+
+        void BinaryOutput::save_binary_data(const void* data, uint64_t size)
+        {
+            if (_failed || size == 0) return;
+
+            _offset += size;
+
+            // 大块数据不经过缓存直接写入.
+            if (_buffer.size() + size > BUFFER_SIZE)
+            {
+                flush();
+                if (size >= BUFFER_SIZE)
+                {
+                    if (!_output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size))) _failed = true;
+                    return;
+                }
+            }
+
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            _buffer.insert(_buffer.end(), bytes, bytes + size);
+        }
+
+        void BinaryOutput::save_varint(uint64_t value)
+        {
+            uint8_t bytes[10];
+            uint32_t count = 0;
+            while (value >= 0x80)
+            {
+                bytes[count++] = static_cast<uint8_t>(value | 0x80);
+                value >>= 7;
+            }
+            bytes[count++] = static_cast<uint8_t>(value);
+            save_binary_data(bytes, count);
+        }
+
+        void BinaryOutput::align(uint64_t alignment)
+        {
+            static const uint8_t padding[64] = {};
+            uint64_t size = ((_offset + alignment - 1) & ~(alignment - 1)) - _offset;
+            while (size > 0)
+            {
+                const uint64_t count = std::min(size, static_cast<uint64_t>(sizeof(padding)));
+                save_binary_data(padding, count);
+                size -= count;
+            }
+        }
+
+        void BinaryOutput::flush()
+        {
+            if (_buffer.empty()) return;
+            if (!_output.write(reinterpret_cast<const char*>(_buffer.data()), static_cast<std::streamsize>(_buffer.size()))) _failed = true;
+            _buffer.clear();
+        }
+
+
+        BinaryInput::BinaryInput(const std::string& file_name) : _input(file_name, std::ios::binary | std::ios::ate)
+        {
+            if (!_input.is_open())
+            {
+                LOG_ERROR("Open " + file_name + " failed.");
+                _failed = true;
+                return;
+            }
+
+            _file_size = static_cast<uint64_t>(_input.tellg());
+            _input.seekg(0);
+            _buffer.resize(BUFFER_SIZE);
+
+            if (!load_header()) LOG_ERROR(file_name + " is not a valid serialization file.");
+        }
+
+        bool BinaryInput::load_binary_data(void* out_data, uint64_t size)
+        {
+            if (_failed) return false;
+            if (size > remaining()) return fail();
+
+            _offset += size;
+
+            uint8_t* dst = static_cast<uint8_t*>(out_data);
+            const uint64_t buffered = std::min(size, _buffer_size - _buffer_offset);
+            memcpy(dst, _buffer.data() + _buffer_offset, buffered);
+            _buffer_offset += buffered;
+            dst += buffered;
+            size -= buffered;
+            if (size == 0) return true;
+
+            // 缓存已读完, 大块数据直接读入目标.
+            if (size >= BUFFER_SIZE)
+            {
+                if (!_input.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(size))) return fail();
+                return true;
+            }
+
+            const uint64_t file_left = remaining() + size;
+            _buffer_size = std::min(BUFFER_SIZE, file_left);
+            _buffer_offset = 0;
+            if (!_input.read(reinterpret_cast<char*>(_buffer.data()), static_cast<std::streamsize>(_buffer_size))) return fail();
+
+            memcpy(dst, _buffer.data(), size);
+            _buffer_offset = size;
+            return true;
+        }
+
+        bool BinaryInput::skip(uint64_t size)
+        {
+            if (_failed) return false;
+            if (size > remaining()) return fail();
+
+            if (size <= _buffer_size - _buffer_offset)
+            {
+                _buffer_offset += size;
+                _offset += size;
+                return true;
+            }
+
+            _offset += size;
+            _buffer_offset = _buffer_size = 0;
+            if (!_input.seekg(static_cast<std::streamoff>(_offset))) return fail();
+            return true;
+        }
+
+
+        MappedBinaryInput::MappedBinaryInput(const std::string& file_name)
+        {
+            if (!_mapping.open(file_name))
+            {
+                _failed = true;
+                return;
+            }
+
+            if (!load_header()) LOG_ERROR(file_name + " is not a valid serialization file.");
+        }
+
+        bool MappedBinaryInput::load_binary_data(void* out_data, uint64_t size)
+        {
+            if (_failed) return false;
+            if (size > remaining()) return fail();
+
+            memcpy(out_data, _mapping.data() + _offset, size);
+            _offset += size;
+            return true;
+        }
+
+        bool MappedBinaryInput::skip(uint64_t size)
+        {
+            if (_failed) return false;
+            if (size > remaining()) return fail();
+
+            _offset += size;
+            return true;
+        }
+    }
+}
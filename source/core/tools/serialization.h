@@ -0,0 +1,332 @@
+#ifndef CORE_SERIALIZATION_H
+#define CORE_SERIALIZATION_H
+
+#include "file_mapping.h"
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// 声明需要序列化的成员, 版本号随对象写入, 读取时传给 serialize(), 新增成员时递增版本并按版本判断是否读取:
+//     template <typename Archive>
+//     void serialize(Archive& archive, uint32_t version) { archive(a, b); if (version >= 2) archive(c); }
+#define SERIALIZATION_VERSION(VERSION) static constexpr uint32_t serialization_version = VERSION
+
+#define SERIALIZATION_FIELDS(VERSION, ...)                                          \
+    SERIALIZATION_VERSION(VERSION);                                                 \
+    template <typename Archive>                                                     \
+    void serialize(Archive& archive, uint32_t) { archive(__VA_ARGS__); }
+
+
+namespace fantasy
+{
+    namespace serialization
+    {
+        // 声明了 serialization_version 的类型通过 serialize() 逐成员处理.
+        template <typename T>
+        concept Serializable = requires { { T::serialization_version } -> std::convertible_to<uint32_t>; };
+
+        template <typename T>
+        struct is_span : std::false_type {};
+
+        template <typename T, size_t N>
+        struct is_span<std::span<T, N>> : std::true_type {};
+
+        // 其余可平凡拷贝的类型直接按字节拷贝, 数组整体拷贝. 指针和 span 本身不能按字节写入.
+        template <typename T>
+        concept Bulk = std::is_trivially_copyable_v<T> && !Serializable<T> && !std::is_pointer_v<T> && !is_span<T>::value;
+
+        // 文件格式:
+        //   文件头: magic + 格式版本.
+        //   Bulk 类型: 原始字节, 不对齐.
+        //   Serializable 类型: varint 版本号, 之后依次是各成员.
+        //   std::string: varint 长度 + 字符.
+        //   Bulk 数组: varint 元素个数, 填充到 alignof(T), 连续的元素字节, 映射读取时可直接返回 span.
+        //   其他数组: varint 元素个数 + 逐个元素.
+        static constexpr uint32_t SERIALIZATION_MAGIC = 0x52455346;    // "FSER"
+        static constexpr uint32_t SERIALIZATION_FORMAT_VERSION = 1;
+
+        class BinaryOutput
+        {
+        public:
+            explicit BinaryOutput(const std::string& file_name);
+            ~BinaryOutput();
+
+            BinaryOutput(const BinaryOutput&) = delete;
+            BinaryOutput& operator=(const BinaryOutput&) = delete;
+
+            template <typename... Args>
+            void operator()(Args&&... arguments)
+            {
+                (process(arguments), ...);
+            }
+
+            // 写入缓存中的数据并关闭文件, 返回是否全部写入成功.
+            bool close();
+            bool good() const { return !_failed; }
+
+            void save_binary_data(const void* data, uint64_t size);
+            void save_varint(uint64_t value);
+            void align(uint64_t alignment);
+
+        private:
+            template <typename T>
+            void process(const T& value)
+            {
+                process_impl(value);
+            }
+
+            template <Bulk T>
+            void process_impl(const T& value) { save_binary_data(&value, sizeof(T)); }
+
+            template <Serializable T>
+            void process_impl(const T& value)
+            {
+                save_varint(T::serialization_version);
+
+                // serialize() 同时用于读写, 因此不是 const 成员函数.
+                const_cast<T&>(value).serialize(*this, T::serialization_version);
+            }
+
+            void process_impl(const std::string& value)
+            {
+                save_varint(value.size());
+                save_binary_data(value.data(), value.size());
+            }
+
+            template <typename T>
+            void process_impl(std::span<const T> value)
+            {
+                save_varint(value.size());
+                if constexpr (Bulk<T>)
+                {
+                    align(alignof(T));
+                    save_binary_data(value.data(), value.size_bytes());
+                }
+                else
+                {
+                    for (const T& element : value) process_impl(element);
+                }
+            }
+
+            template <typename T>
+            void process_impl(std::span<T> value) { process_impl(std::span<const T>(value)); }
+
+            template <typename T>
+            void process_impl(const std::vector<T>& value) { process_impl(std::span<const T>(value)); }
+
+            void flush();
+
+        private:
+            std::ofstream _output;
+            std::vector<uint8_t> _buffer;
+            uint64_t _offset = 0;
+            bool _failed = false;
+        };
+
+
+        // 两种读取方式共用的解析逻辑, Derived 提供 load_binary_data(), skip(), offset() 和 remaining().
+        // 数据不完整或格式不符时 good() 返回 false, 之后的读取全部忽略.
+        template <typename Derived>
+        class InputArchive
+        {
+        public:
+            template <typename... Args>
+            void operator()(Args&&... arguments)
+            {
+                (process(arguments), ...);
+            }
+
+            bool good() const { return !_failed; }
+
+            bool load_varint(uint64_t& out_value)
+            {
+                out_value = 0;
+                for (uint32_t shift = 0; shift < 64; shift += 7)
+                {
+                    uint8_t byte = 0;
+                    if (!derived().load_binary_data(&byte, 1)) return false;
+
+                    out_value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                    if ((byte & 0x80) == 0) return true;
+                }
+                return fail();
+            }
+
+            bool align(uint64_t alignment)
+            {
+                const uint64_t offset = derived().offset();
+                return derived().skip(((offset + alignment - 1) & ~(alignment - 1)) - offset);
+            }
+
+        protected:
+            bool fail()
+            {
+                _failed = true;
+                return false;
+            }
+
+            // 元素个数来自文件, 先和剩余大小比较, 避免损坏的文件导致巨大的分配.
+            // Bulk 数组在个数之后有对齐填充, 需要先跳过填充再比较.
+            bool load_count(uint64_t& out_count, uint64_t element_size, uint64_t alignment = 1)
+            {
+                if (!load_varint(out_count)) return false;
+                if (alignment > 1 && !align(alignment)) return false;
+                if (out_count > derived().remaining() / element_size) return fail();
+                return true;
+            }
+
+            template <typename T>
+            void process(T& value)
+            {
+                static_cast<Derived*>(this)->process_impl(value);
+            }
+
+            template <Bulk T>
+            void process_impl(T& out) { derived().load_binary_data(&out, sizeof(T)); }
+
+            template <Serializable T>
+            void process_impl(T& out)
+            {
+                uint64_t version = 0;
+                if (!load_varint(version)) return;
+                if (version > T::serialization_version)
+                {
+                    fail();
+                    return;
+                }
+                out.serialize(derived(), static_cast<uint32_t>(version));
+            }
+
+            void process_impl(std::string& out)
+            {
+                uint64_t size = 0;
+                if (!load_count(size, 1)) return;
+
+                out.resize(size);
+                derived().load_binary_data(out.data(), size);
+            }
+
+            template <typename T>
+            void process_impl(std::vector<T>& out)
+            {
+                uint64_t size = 0;
+                if constexpr (Bulk<T>)
+                {
+                    if (!load_count(size, sizeof(T), alignof(T))) return;
+
+                    out.resize(size);
+                    derived().load_binary_data(out.data(), size * sizeof(T));
+                }
+                else
+                {
+                    // 非 Bulk 元素至少占一个字节.
+                    if (!load_count(size, 1)) return;
+
+                    out.resize(size);
+                    for (T& element : out)
+                    {
+                        process(element);
+                        if (_failed) return;
+                    }
+                }
+            }
+
+            // 检查文件头, 由 Derived 打开文件后调用.
+            bool load_header()
+            {
+                uint32_t header[2] = {};
+                if (!derived().load_binary_data(header, sizeof(header))) return false;
+                if (header[0] != SERIALIZATION_MAGIC || header[1] != SERIALIZATION_FORMAT_VERSION) return fail();
+                return true;
+            }
+
+            Derived& derived() { return *static_cast<Derived*>(this); }
+
+        protected:
+            bool _failed = false;
+        };
+
+
+        // 通过带缓存的文件流读取.
+        class BinaryInput : public InputArchive<BinaryInput>
+        {
+        public:
+            explicit BinaryInput(const std::string& file_name);
+
+            BinaryInput(const BinaryInput&) = delete;
+            BinaryInput& operator=(const BinaryInput&) = delete;
+
+            bool load_binary_data(void* out_data, uint64_t size);
+            bool skip(uint64_t size);
+
+            uint64_t offset() const { return _offset; }
+            uint64_t remaining() const { return _file_size - _offset; }
+
+        private:
+            friend class InputArchive<BinaryInput>;
+            using InputArchive<BinaryInput>::process_impl;
+
+        private:
+            std::ifstream _input;
+            std::vector<uint8_t> _buffer;
+            uint64_t _buffer_offset = 0;
+            uint64_t _buffer_size = 0;
+            uint64_t _offset = 0;
+            uint64_t _file_size = 0;
+        };
+
+
+        // 映射整个文件读取, Bulk 数组可以用 std::span<const T> 接收, 直接指向映射而不做拷贝,
+        // span 只在 MappedBinaryInput 存活期间有效.
+        class MappedBinaryInput : public InputArchive<MappedBinaryInput>
+        {
+        public:
+            explicit MappedBinaryInput(const std::string& file_name);
+
+            MappedBinaryInput(const MappedBinaryInput&) = delete;
+            MappedBinaryInput& operator=(const MappedBinaryInput&) = delete;
+
+            bool load_binary_data(void* out_data, uint64_t size);
+            bool skip(uint64_t size);
+
+            uint64_t offset() const { return _offset; }
+            uint64_t remaining() const { return _mapping.size() - _offset; }
+
+        private:
+            friend class InputArchive<MappedBinaryInput>;
+            using InputArchive<MappedBinaryInput>::process_impl;
+
+            template <Bulk T>
+            void process_impl(std::span<const T>& out)
+            {
+                uint64_t size = 0;
+                if (!load_count(size, sizeof(T), alignof(T))) return;
+
+                out = std::span<const T>(reinterpret_cast<const T*>(_mapping.data() + _offset), size);
+                _offset += size * sizeof(T);
+            }
+
+        private:
+            FileMapping _mapping;
+            uint64_t _offset = 0;
+        };
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
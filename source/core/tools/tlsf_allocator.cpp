@@ -0,0 +1,252 @@
+#include "tlsf_allocator.h"
+#include <algorithm>
+#include <bit>
+
+namespace fantasy
+{
+    void TlsfAllocator::initialize(uint64_t capacity)
+    {
+        _capacity = capacity;
+        _used_size = 0;
+        _allocation_count = 0;
+        _first_node = TlsfAllocation::INVALID_NODE;
+        _fl_bitmap = 0;
+        std::fill(std::begin(_sl_bitmaps), std::end(_sl_bitmaps), 0u);
+        for (auto& heads : _free_heads) std::fill(std::begin(heads), std::end(heads), TlsfAllocation::INVALID_NODE);
+        _nodes.clear();
+        _unused_nodes.clear();
+
+        if (capacity == 0) return;
+
+        _first_node = create_node(0, capacity);
+        insert_free_node(_first_node);
+    }
+
+    TlsfAllocation TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+    {
+        size = std::max<uint64_t>(size, 1);
+        alignment = std::max<uint64_t>(alignment, 1);
+        if (size > _capacity || alignment > _capacity || size > _capacity - _used_size) return TlsfAllocation{};
+
+        // 多搜索 alignment - 1 字节, 保证找到的块对齐后仍然放得下.
+        const uint32_t node = find_free_node(size + alignment - 1);
+        if (node == TlsfAllocation::INVALID_NODE) return TlsfAllocation{};
+        remove_free_node(node);
+
+        const uint64_t aligned_offset = (_nodes[node].offset + alignment - 1) & ~(alignment - 1);
+        const uint64_t padding = aligned_offset - _nodes[node].offset;
+        if (padding > 0)
+        {
+            // 对齐留下的前半部分作为新的空闲块. 空闲块的物理相邻块一定已分配, 无需合并.
+            const uint32_t front = create_node(_nodes[node].offset, padding);
+            Node& front_node = _nodes[front];
+            Node& current = _nodes[node];
+
+            front_node.prev_physical = current.prev_physical;
+            front_node.next_physical = node;
+            if (current.prev_physical != TlsfAllocation::INVALID_NODE) _nodes[current.prev_physical].next_physical = front;
+            else _first_node = front;
+            current.prev_physical = front;
+            current.offset = aligned_offset;
+            current.size -= padding;
+
+            insert_free_node(front);
+        }
+
+        if (_nodes[node].size > size) split_free_tail(node, size);
+
+        Node& current = _nodes[node];
+        current.free = false;
+        _used_size += current.size;
+        _allocation_count++;
+
+        return TlsfAllocation{ .offset = current.offset, .size = current.size, .node = node };
+    }
+
+    void TlsfAllocator::release(const TlsfAllocation& allocation)
+    {
+        uint32_t node = allocation.node;
+        if (node >= _nodes.size() || _nodes[node].free) return;
+
+        _used_size -= _nodes[node].size;
+        _allocation_count--;
+
+        const uint32_t next = _nodes[node].next_physical;
+        if (next != TlsfAllocation::INVALID_NODE && _nodes[next].free)
+        {
+            remove_free_node(next);
+            merge_next(node, next);
+        }
+
+        const uint32_t prev = _nodes[node].prev_physical;
+        if (prev != TlsfAllocation::INVALID_NODE && _nodes[prev].free)
+        {
+            remove_free_node(prev);
+            merge_next(prev, node);
+            node = prev;
+        }
+
+        insert_free_node(node);
+    }
+
+    TlsfStats TlsfAllocator::get_stats() const
+    {
+        TlsfStats stats;
+        stats.capacity = _capacity;
+        stats.used_size = _used_size;
+        stats.allocation_count = _allocation_count;
+
+        for (uint32_t node = _first_node; node != TlsfAllocation::INVALID_NODE; node = _nodes[node].next_physical)
+        {
+            if (!_nodes[node].free) continue;
+            stats.free_block_count++;
+            stats.largest_free_size = std::max(stats.largest_free_size, _nodes[node].size);
+        }
+        return stats;
+    }
+
+    void TlsfAllocator::for_each_allocation(const std::function<void(const TlsfAllocation&)>& func) const
+    {
+        for (uint32_t node = _first_node; node != TlsfAllocation::INVALID_NODE; node = _nodes[node].next_physical)
+        {
+            if (_nodes[node].free) continue;
+            func(TlsfAllocation{ .offset = _nodes[node].offset, .size = _nodes[node].size, .node = node });
+        }
+    }
+
+    void TlsfAllocator::mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl)
+    {
+        // 小于 SL_INDEX_COUNT 的尺寸全部放在第 0 级, 二级索引即尺寸本身.
+        if (size < SL_INDEX_COUNT)
+        {
+            fl = 0;
+            sl = static_cast<uint32_t>(size);
+            return;
+        }
+
+        const uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+        fl = msb - SL_INDEX_COUNT_LOG2 + 1;
+        sl = static_cast<uint32_t>(size >> (msb - SL_INDEX_COUNT_LOG2)) - SL_INDEX_COUNT;
+    }
+
+    void TlsfAllocator::mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl)
+    {
+        // 向上取整到下一个二级区间, 这样区间内的任意空闲块都足够大.
+        if (size >= SL_INDEX_COUNT)
+        {
+            const uint32_t msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+            size += (1ull << (msb - SL_INDEX_COUNT_LOG2)) - 1;
+        }
+        mapping_insert(size, fl, sl);
+    }
+
+    uint32_t TlsfAllocator::create_node(uint64_t offset, uint64_t size)
+    {
+        uint32_t node;
+        if (!_unused_nodes.empty())
+        {
+            node = _unused_nodes.back();
+            _unused_nodes.pop_back();
+            _nodes[node] = Node{};
+        }
+        else
+        {
+            node = static_cast<uint32_t>(_nodes.size());
+            _nodes.emplace_back();
+        }
+
+        _nodes[node].offset = offset;
+        _nodes[node].size = size;
+        return node;
+    }
+
+    void TlsfAllocator::destroy_node(uint32_t node)
+    {
+        _nodes[node].free = false;
+        _unused_nodes.push_back(node);
+    }
+
+    void TlsfAllocator::insert_free_node(uint32_t node)
+    {
+        uint32_t fl, sl;
+        mapping_insert(_nodes[node].size, fl, sl);
+
+        const uint32_t head = _free_heads[fl][sl];
+        _nodes[node].free = true;
+        _nodes[node].prev_free = TlsfAllocation::INVALID_NODE;
+        _nodes[node].next_free = head;
+        if (head != TlsfAllocation::INVALID_NODE) _nodes[head].prev_free = node;
+
+        _free_heads[fl][sl] = node;
+        _fl_bitmap |= 1ull << fl;
+        _sl_bitmaps[fl] |= 1u << sl;
+    }
+
+    void TlsfAllocator::remove_free_node(uint32_t node)
+    {
+        uint32_t fl, sl;
+        mapping_insert(_nodes[node].size, fl, sl);
+
+        Node& current = _nodes[node];
+        if (current.prev_free != TlsfAllocation::INVALID_NODE) _nodes[current.prev_free].next_free = current.next_free;
+        if (current.next_free != TlsfAllocation::INVALID_NODE) _nodes[current.next_free].prev_free = current.prev_free;
+
+        if (_free_heads[fl][sl] == node)
+        {
+            _free_heads[fl][sl] = current.next_free;
+            if (current.next_free == TlsfAllocation::INVALID_NODE)
+            {
+                _sl_bitmaps[fl] &= ~(1u << sl);
+                if (_sl_bitmaps[fl] == 0) _fl_bitmap &= ~(1ull << fl);
+            }
+        }
+
+        current.free = false;
+        current.prev_free = TlsfAllocation::INVALID_NODE;
+        current.next_free = TlsfAllocation::INVALID_NODE;
+    }
+
+    uint32_t TlsfAllocator::find_free_node(uint64_t size)
+    {
+        uint32_t fl, sl;
+        mapping_search(size, fl, sl);
+        if (fl >= FL_INDEX_COUNT) return TlsfAllocation::INVALID_NODE;
+
+        uint32_t sl_bitmap = _sl_bitmaps[fl] & (~0u << sl);
+        if (sl_bitmap == 0)
+        {
+            const uint64_t fl_bitmap = fl + 1 < 64 ? _fl_bitmap & (~0ull << (fl + 1)) : 0;
+            if (fl_bitmap == 0) return TlsfAllocation::INVALID_NODE;
+
+            fl = static_cast<uint32_t>(std::countr_zero(fl_bitmap));
+            sl_bitmap = _sl_bitmaps[fl];
+        }
+        sl = static_cast<uint32_t>(std::countr_zero(sl_bitmap));
+        return _free_heads[fl][sl];
+    }
+
+    void TlsfAllocator::split_free_tail(uint32_t node, uint64_t size)
+    {
+        const uint32_t tail = create_node(_nodes[node].offset + size, _nodes[node].size - size);
+        Node& tail_node = _nodes[tail];
+        Node& current = _nodes[node];
+
+        tail_node.prev_physical = node;
+        tail_node.next_physical = current.next_physical;
+        if (current.next_physical != TlsfAllocation::INVALID_NODE) _nodes[current.next_physical].prev_physical = tail;
+        current.next_physical = tail;
+        current.size = size;
+
+        insert_free_node(tail);
+    }
+
+    void TlsfAllocator::merge_next(uint32_t node, uint32_t next)
+    {
+        Node& current = _nodes[node];
+        current.size += _nodes[next].size;
+        current.next_physical = _nodes[next].next_physical;
+        if (current.next_physical != TlsfAllocation::INVALID_NODE) _nodes[current.next_physical].prev_physical = node;
+
+        destroy_node(next);
+    }
+}
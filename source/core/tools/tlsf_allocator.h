@@ -0,0 +1,107 @@
+#ifndef CORE_TLSF_ALLOCATOR_H
+#define CORE_TLSF_ALLOCATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace fantasy
+{
+    struct TlsfAllocation
+    {
+        static constexpr uint32_t INVALID_NODE = ~0u;
+
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint32_t node = INVALID_NODE;
+
+        bool valid() const { return node != INVALID_NODE; }
+    };
+
+    struct TlsfStats
+    {
+        uint64_t capacity = 0;
+        uint64_t used_size = 0;
+        uint64_t largest_free_size = 0;
+        uint32_t allocation_count = 0;
+        uint32_t free_block_count = 0;
+    };
+
+    // 只管理 [0, capacity) 的偏移, 不持有内存, 用于 GPU 内存块等的子分配.
+    // 两级分段空闲链表 (Two-Level Segregated Fit), 分配和释放都是 O(1), 释放时立即与相邻空闲块合并.
+    class TlsfAllocator
+    {
+    public:
+        TlsfAllocator() = default;
+        explicit TlsfAllocator(uint64_t capacity) { initialize(capacity); }
+
+        void initialize(uint64_t capacity);
+
+        // alignment 必须是 2 的幂. 失败时返回的 TlsfAllocation 无效.
+        TlsfAllocation allocate(uint64_t size, uint64_t alignment = 1);
+        void release(const TlsfAllocation& allocation);
+
+        bool empty() const { return _allocation_count == 0; }
+        uint64_t capacity() const { return _capacity; }
+        uint64_t used_size() const { return _used_size; }
+        TlsfStats get_stats() const;
+
+        // 按偏移顺序遍历已分配的块.
+        void for_each_allocation(const std::function<void(const TlsfAllocation&)>& func) const;
+
+    private:
+        static constexpr uint32_t SL_INDEX_COUNT_LOG2 = 5;
+        static constexpr uint32_t SL_INDEX_COUNT = 1u << SL_INDEX_COUNT_LOG2;
+        static constexpr uint32_t FL_INDEX_COUNT = 64 - SL_INDEX_COUNT_LOG2 + 1;
+
+        struct Node
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t prev_physical = TlsfAllocation::INVALID_NODE;
+            uint32_t next_physical = TlsfAllocation::INVALID_NODE;
+            uint32_t prev_free = TlsfAllocation::INVALID_NODE;
+            uint32_t next_free = TlsfAllocation::INVALID_NODE;
+            bool free = false;
+        };
+
+        static void mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl);
+        static void mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl);
+
+        uint32_t create_node(uint64_t offset, uint64_t size);
+        void destroy_node(uint32_t node);
+
+        void insert_free_node(uint32_t node);
+        void remove_free_node(uint32_t node);
+        uint32_t find_free_node(uint64_t size);
+
+        // 从 node 的 offset + size 处切出后半部分作为新的空闲块.
+        void split_free_tail(uint32_t node, uint64_t size);
+
+        // 把 node 与其后相邻的 next 合并, next 被回收.
+        void merge_next(uint32_t node, uint32_t next);
+
+    private:
+        uint64_t _capacity = 0;
+        uint64_t _used_size = 0;
+        uint32_t _allocation_count = 0;
+        uint32_t _first_node = TlsfAllocation::INVALID_NODE;
+
+        uint64_t _fl_bitmap = 0;
+        uint32_t _sl_bitmaps[FL_INDEX_COUNT] = {};
+        uint32_t _free_heads[FL_INDEX_COUNT][SL_INDEX_COUNT];
+
+        std::vector<Node> _nodes;
+        std::vector<uint32_t> _unused_nodes;
+    };
+}
+
+
+
+
+
+
+
+
+
+#endif
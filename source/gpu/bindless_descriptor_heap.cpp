@@ -0,0 +1,243 @@
+#include "bindless_descriptor_heap.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+
+namespace fantasy
+{
+    void BindlessSlotAllocator::initialize(uint32_t capacity)
+    {
+        _capacity = capacity;
+        _next_unused.store(0, std::memory_order_relaxed);
+        _free_head.store(pack(0, INVALID_INDEX), std::memory_order_relaxed);
+        _free_next = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+    }
+
+    uint32_t BindlessSlotAllocator::allocate()
+    {
+        uint64_t head = _free_head.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != INVALID_INDEX)
+        {
+            const uint32_t index = static_cast<uint32_t>(head);
+            const uint32_t next = _free_next[index].load(std::memory_order_relaxed);
+            const uint32_t tag = static_cast<uint32_t>(head >> 32) + 1;
+            if (_free_head.compare_exchange_weak(head, pack(tag, next), std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+
+        // 不用 fetch_add, 容量耗尽后计数不会继续增长.
+        uint32_t index = _next_unused.load(std::memory_order_relaxed);
+        while (index < _capacity)
+        {
+            if (_next_unused.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) return index;
+        }
+        return INVALID_INDEX;
+    }
+
+    void BindlessSlotAllocator::free(uint32_t index)
+    {
+        uint64_t head = _free_head.load(std::memory_order_relaxed);
+        do
+        {
+            _free_next[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        }
+        while (!_free_head.compare_exchange_weak(
+            head,
+            pack(static_cast<uint32_t>(head >> 32) + 1, index),
+            std::memory_order_release,
+            std::memory_order_relaxed
+        ));
+    }
+
+    bool BindlessDescriptorHeap::initialize(VkPhysicalDevice physical_device, VkDevice device)
+    {
+        _device = device;
+
+        VkPhysicalDeviceVulkan12Properties properties12{};
+        properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties.pNext = &properties12;
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+
+        // 整个描述符集和单个着色器阶段的限制都要满足.
+        const std::array<uint32_t, TYPE_COUNT> limits = {
+            std::min(properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages),
+            std::min(properties12.maxDescriptorSetUpdateAfterBindStorageBuffers, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers),
+            std::min(properties12.maxDescriptorSetUpdateAfterBindSamplers, properties12.maxPerStageDescriptorUpdateAfterBindSamplers)
+        };
+
+        std::array<VkDescriptorSetLayoutBinding, TYPE_COUNT> bindings{};
+        std::array<VkDescriptorBindingFlags, TYPE_COUNT> binding_flags{};
+        std::array<VkDescriptorPoolSize, TYPE_COUNT> pool_sizes{};
+        for (uint32_t ix = 0; ix < TYPE_COUNT; ++ix)
+        {
+            const auto type = static_cast<BindlessResourceType>(ix);
+            const uint32_t capacity = std::min(DEFAULT_CAPACITIES[ix], limits[ix]);
+            _allocators[ix].initialize(capacity);
+
+            bindings[ix].binding = ix;
+            bindings[ix].descriptorType = get_descriptor_type(type);
+            bindings[ix].descriptorCount = capacity;
+            bindings[ix].stageFlags = VK_SHADER_STAGE_ALL;
+
+            // PARTIALLY_BOUND: 未写入的槽位只要不被访问就是合法的.
+            // UPDATE_AFTER_BIND, UPDATE_UNUSED_WHILE_PENDING: 描述符集已经绑定或正在被执行时, 仍可写入其它槽位.
+            binding_flags[ix] =
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+            pool_sizes[ix].type = bindings[ix].descriptorType;
+            pool_sizes[ix].descriptorCount = capacity;
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info{};
+        binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        binding_flags_create_info.bindingCount = TYPE_COUNT;
+        binding_flags_create_info.pBindingFlags = binding_flags.data();
+
+        VkDescriptorSetLayoutCreateInfo layout_create_info{};
+        layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_create_info.pNext = &binding_flags_create_info;
+        layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layout_create_info.bindingCount = TYPE_COUNT;
+        layout_create_info.pBindings = bindings.data();
+        ReturnIfFalse(vkCreateDescriptorSetLayout(_device, &layout_create_info, nullptr, &_layout) == VK_SUCCESS);
+
+        VkDescriptorPoolCreateInfo pool_create_info{};
+        pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        pool_create_info.maxSets = 1;
+        pool_create_info.poolSizeCount = TYPE_COUNT;
+        pool_create_info.pPoolSizes = pool_sizes.data();
+        ReturnIfFalse(vkCreateDescriptorPool(_device, &pool_create_info, nullptr, &_pool) == VK_SUCCESS);
+
+        VkDescriptorSetAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocate_info.descriptorPool = _pool;
+        allocate_info.descriptorSetCount = 1;
+        allocate_info.pSetLayouts = &_layout;
+        ReturnIfFalse(vkAllocateDescriptorSets(_device, &allocate_info, &_descriptor_set) == VK_SUCCESS);
+        return true;
+    }
+
+    void BindlessDescriptorHeap::destroy()
+    {
+        if (_device == VK_NULL_HANDLE) return;
+
+        // 描述符集随 pool 一起释放.
+        vkDestroyDescriptorPool(_device, _pool, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+        for (auto& slots : _retired_slots) slots.clear();
+        _device = VK_NULL_HANDLE;
+    }
+
+    void BindlessDescriptorHeap::begin_frame(uint64_t frame_index)
+    {
+        std::lock_guard lock(_retire_mutex);
+        _frame_index = frame_index;
+
+        // 这个桶中的槽位在 NUM_FRAMES_IN_FLIGHT 帧之前释放, 那一帧的 fence 已经等待过.
+        auto& slots = _retired_slots[_frame_index % NUM_FRAMES_IN_FLIGHT];
+        for (const auto& [type, index] : slots) _allocators[static_cast<uint32_t>(type)].free(index);
+        slots.clear();
+    }
+
+    uint32_t BindlessDescriptorHeap::allocate_sampled_image(VkImageView image_view, VkImageLayout layout)
+    {
+        const uint32_t index = allocate_slot(BindlessResourceType::SampledImage);
+        if (index == INVALID_INDEX) return INVALID_INDEX;
+
+        VkDescriptorImageInfo image_info{};
+        image_info.imageView = image_view;
+        image_info.imageLayout = layout;
+
+        VkWriteDescriptorSet write{};
+        write.dstBinding = static_cast<uint32_t>(BindlessResourceType::SampledImage);
+        write.dstArrayElement = index;
+        write.pImageInfo = &image_info;
+        write_descriptor(write);
+        return index;
+    }
+
+    uint32_t BindlessDescriptorHeap::allocate_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        const uint32_t index = allocate_slot(BindlessResourceType::StorageBuffer);
+        if (index == INVALID_INDEX) return INVALID_INDEX;
+
+        VkDescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = buffer;
+        buffer_info.offset = offset;
+        buffer_info.range = range;
+
+        VkWriteDescriptorSet write{};
+        write.dstBinding = static_cast<uint32_t>(BindlessResourceType::StorageBuffer);
+        write.dstArrayElement = index;
+        write.pBufferInfo = &buffer_info;
+        write_descriptor(write);
+        return index;
+    }
+
+    uint32_t BindlessDescriptorHeap::allocate_sampler(VkSampler sampler)
+    {
+        const uint32_t index = allocate_slot(BindlessResourceType::Sampler);
+        if (index == INVALID_INDEX) return INVALID_INDEX;
+
+        VkDescriptorImageInfo sampler_info{};
+        sampler_info.sampler = sampler;
+
+        VkWriteDescriptorSet write{};
+        write.dstBinding = static_cast<uint32_t>(BindlessResourceType::Sampler);
+        write.dstArrayElement = index;
+        write.pImageInfo = &sampler_info;
+        write_descriptor(write);
+        return index;
+    }
+
+    void BindlessDescriptorHeap::release(BindlessResourceType type, uint32_t index)
+    {
+        if (index == INVALID_INDEX) return;
+
+        std::lock_guard lock(_retire_mutex);
+        _retired_slots[_frame_index % NUM_FRAMES_IN_FLIGHT].emplace_back(type, index);
+    }
+
+    void BindlessDescriptorHeap::bind(VkCommandBuffer cmd_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const
+    {
+        vkCmdBindDescriptorSets(cmd_buffer, bind_point, layout, 0, 1, &_descriptor_set, 0, nullptr);
+    }
+
+    VkDescriptorType BindlessDescriptorHeap::get_descriptor_type(BindlessResourceType type)
+    {
+        switch (type)
+        {
+        case BindlessResourceType::SampledImage: return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        case BindlessResourceType::StorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case BindlessResourceType::Sampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        default: return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        }
+    }
+
+    uint32_t BindlessDescriptorHeap::allocate_slot(BindlessResourceType type)
+    {
+        const uint32_t index = _allocators[static_cast<uint32_t>(type)].allocate();
+        if (index == INVALID_INDEX)
+        {
+            LOG_ERROR("Bindless descriptor heap is full, capacity " + std::to_string(get_capacity(type)) + ".");
+        }
+        return index;
+    }
+
+    void BindlessDescriptorHeap::write_descriptor(VkWriteDescriptorSet& write)
+    {
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = _descriptor_set;
+        write.descriptorCount = 1;
+        write.descriptorType = get_descriptor_type(static_cast<BindlessResourceType>(write.dstBinding));
+
+        std::lock_guard lock(_write_mutex);
+        vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef GPU_BINDLESS_DESCRIPTOR_HEAP_H
+#define GPU_BINDLESS_DESCRIPTOR_HEAP_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fantasy
+{
+    // 全局描述符集中的绑定, 枚举值即 binding 编号, 着色器中以同样的编号声明无大小数组.
+    enum class BindlessResourceType : uint8_t
+    {
+        SampledImage,
+        StorageBuffer,
+        Sampler,
+
+        Count
+    };
+
+    // 无锁的下标分配. 释放的下标进入带版本号的空闲栈 (避免 ABA), 空闲栈为空时从未使用过的下标中分配.
+    class BindlessSlotAllocator
+    {
+    public:
+        static constexpr uint32_t INVALID_INDEX = ~0u;
+
+        void initialize(uint32_t capacity);
+
+        // 容量耗尽时返回 INVALID_INDEX.
+        uint32_t allocate();
+        void free(uint32_t index);
+
+        uint32_t get_capacity() const { return _capacity; }
+
+    private:
+        static uint64_t pack(uint32_t tag, uint32_t index) { return (static_cast<uint64_t>(tag) << 32) | index; }
+
+    private:
+        uint32_t _capacity = 0;
+        std::atomic<uint32_t> _next_unused = 0;
+        std::atomic<uint64_t> _free_head = pack(0, INVALID_INDEX);     // 高 32 位为版本号, 低 32 位为栈顶下标.
+        std::unique_ptr<std::atomic<uint32_t>[]> _free_next;            // 空闲栈中每个下标的下一个.
+    };
+
+    // Bindless 资源模型. 整个程序只有一个 update-after-bind 的描述符集, 每种资源类型一个大数组,
+    // 资源创建时写入一个槽位, 着色器通过 push constant 传入的下标访问, 绘制时不再逐个绑定描述符集.
+    // 槽位的分配无锁, 写入描述符时加锁, vkUpdateDescriptorSets 要求对同一个描述符集的写入外部同步.
+    class BindlessDescriptorHeap
+    {
+    public:
+        static constexpr uint32_t INVALID_INDEX = BindlessSlotAllocator::INVALID_INDEX;
+
+        // 期望的数组大小, 超过设备限制时取设备限制.
+        static constexpr std::array<uint32_t, static_cast<size_t>(BindlessResourceType::Count)> DEFAULT_CAPACITIES = {
+            16384,  // SampledImage
+            16384,  // StorageBuffer
+            256     // Sampler
+        };
+
+        bool initialize(VkPhysicalDevice physical_device, VkDevice device);
+        void destroy();
+
+        // 等待该帧的 fence 之后调用, 回收 NUM_FRAMES_IN_FLIGHT 帧之前释放的槽位.
+        void begin_frame(uint64_t frame_index);
+
+        // 分配槽位并写入描述符, 失败时返回 INVALID_INDEX.
+        uint32_t allocate_sampled_image(VkImageView image_view, VkImageLayout layout);
+        uint32_t allocate_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+        uint32_t allocate_sampler(VkSampler sampler);
+
+        // 之前的帧可能仍在访问该槽位, NUM_FRAMES_IN_FLIGHT 帧之后才会重新分配.
+        void release(BindlessResourceType type, uint32_t index);
+
+        // 每个指令缓冲 (包括 secondary) 开头绑定一次.
+        void bind(VkCommandBuffer cmd_buffer, VkPipelineBindPoint bind_point, VkPipelineLayout layout) const;
+
+        VkDescriptorSetLayout get_layout() const { return _layout; }
+        uint32_t get_capacity(BindlessResourceType type) const { return _allocators[static_cast<uint32_t>(type)].get_capacity(); }
+
+        static VkDescriptorType get_descriptor_type(BindlessResourceType type);
+
+    private:
+        uint32_t allocate_slot(BindlessResourceType type);
+        void write_descriptor(VkWriteDescriptorSet& write);
+
+    private:
+        static constexpr uint32_t TYPE_COUNT = static_cast<uint32_t>(BindlessResourceType::Count);
+
+        VkDevice _device = VK_NULL_HANDLE;
+        VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+        VkDescriptorPool _pool = VK_NULL_HANDLE;
+        VkDescriptorSet _descriptor_set = VK_NULL_HANDLE;
+
+        std::array<BindlessSlotAllocator, TYPE_COUNT> _allocators;
+        std::mutex _write_mutex;
+
+        uint64_t _frame_index = 0;
+        std::mutex _retire_mutex;
+        std::array<std::vector<std::pair<BindlessResourceType, uint32_t>>, NUM_FRAMES_IN_FLIGHT> _retired_slots;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,148 @@
+#include "command_recorder.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+#include <atomic>
+#include <latch>
+
+namespace fantasy
+{
+    bool ParallelCommandRecorder::initialize(VkDevice device, uint32_t queue_family_index, uint32_t thread_count)
+    {
+        _device = device;
+        _slot_count = std::max(thread_count, 1u);
+        if (_slot_count > 1) _pool = std::make_unique<ThreadPool>(_slot_count - 1);
+
+        VkCommandPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        create_info.queueFamilyIndex = queue_family_index;
+        create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (auto& slots : _frames)
+        {
+            slots.resize(_slot_count);
+            for (auto& slot : slots)
+            {
+                ReturnIfFalse(vkCreateCommandPool(_device, &create_info, nullptr, &slot.cmd_pool) == VK_SUCCESS);
+            }
+        }
+        return true;
+    }
+
+    void ParallelCommandRecorder::destroy()
+    {
+        _pool.reset();
+        for (auto& slots : _frames)
+        {
+            for (auto& slot : slots)
+            {
+                // 销毁 pool 时其中的指令缓冲一并释放.
+                vkDestroyCommandPool(_device, slot.cmd_pool, nullptr);
+            }
+            slots.clear();
+        }
+    }
+
+    bool ParallelCommandRecorder::begin_frame(uint64_t frame_index)
+    {
+        _current_frame = static_cast<uint32_t>(frame_index % NUM_FRAMES_IN_FLIGHT);
+        for (auto& slot : _frames[_current_frame])
+        {
+            ReturnIfFalse(vkResetCommandPool(_device, slot.cmd_pool, 0) == VK_SUCCESS);
+            slot.used_count = 0;
+        }
+        return true;
+    }
+
+    bool ParallelCommandRecorder::record_render_pass(
+        VkCommandBuffer primary_cmd_buffer,
+        const VkRenderPassBeginInfo& begin_info,
+        uint64_t draw_count,
+        const RecordFunc& func
+    )
+    {
+        const uint64_t segment_count = std::min<uint64_t>(
+            _slot_count,
+            (draw_count + MIN_DRAWS_PER_SEGMENT - 1) / MIN_DRAWS_PER_SEGMENT
+        );
+
+        if (segment_count <= 1)
+        {
+            vkCmdBeginRenderPass(primary_cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+            const bool result = func(primary_cmd_buffer, 0, draw_count);
+            vkCmdEndRenderPass(primary_cmd_buffer);
+            return result;
+        }
+
+        auto& slots = _frames[_current_frame];
+        std::vector<VkCommandBuffer> cmd_buffers(segment_count);
+        for (uint64_t ix = 0; ix < segment_count; ++ix)
+        {
+            ReturnIfFalse(get_secondary_cmd_buffer(slots[ix], cmd_buffers[ix]));
+        }
+
+        VkCommandBufferInheritanceInfo inheritance_info{};
+        inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass = begin_info.renderPass;
+        inheritance_info.subpass = 0;
+        inheritance_info.framebuffer = begin_info.framebuffer;
+
+        // VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: 整个 secondary 都在 inheritance_info 指定的 render pass 内执行.
+        VkCommandBufferBeginInfo cmd_buffer_begin{};
+        cmd_buffer_begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmd_buffer_begin.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        cmd_buffer_begin.pInheritanceInfo = &inheritance_info;
+
+        std::atomic<bool> success = true;
+        auto record = [&](uint64_t segment)
+        {
+            VkCommandBuffer cmd_buffer = cmd_buffers[segment];
+            const uint64_t begin = segment * draw_count / segment_count;
+            const uint64_t end = (segment + 1) * draw_count / segment_count;
+
+            if (vkBeginCommandBuffer(cmd_buffer, &cmd_buffer_begin) != VK_SUCCESS)
+            {
+                success = false;
+                return;
+            }
+            const bool result = func(cmd_buffer, begin, end);
+            if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS || !result) success = false;
+        };
+
+        // 调用线程不空等, 自己录制第 0 段.
+        std::latch finished(static_cast<std::ptrdiff_t>(segment_count - 1));
+        for (uint64_t segment = 1; segment < segment_count; ++segment)
+        {
+            _pool->execute(
+                [&, segment]()
+                {
+                    record(segment);
+                    finished.count_down();
+                }
+            );
+        }
+        record(0);
+        finished.wait();
+        ReturnIfFalse(success);
+
+        // 分段按 draw 的顺序执行, 结果与单线程录制一致.
+        vkCmdBeginRenderPass(primary_cmd_buffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        vkCmdExecuteCommands(primary_cmd_buffer, static_cast<uint32_t>(segment_count), cmd_buffers.data());
+        vkCmdEndRenderPass(primary_cmd_buffer);
+        return true;
+    }
+
+    bool ParallelCommandRecorder::get_secondary_cmd_buffer(RecordSlot& slot, VkCommandBuffer& out_cmd_buffer)
+    {
+        if (slot.used_count == slot.cmd_buffers.size())
+        {
+            VkCommandBufferAllocateInfo alloc_info{};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = slot.cmd_pool;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            alloc_info.commandBufferCount = 1;
+            ReturnIfFalse(vkAllocateCommandBuffers(_device, &alloc_info, &slot.cmd_buffers.emplace_back()) == VK_SUCCESS);
+        }
+        out_cmd_buffer = slot.cmd_buffers[slot.used_count++];
+        return true;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef GPU_COMMAND_RECORDER_H
+#define GPU_COMMAND_RECORDER_H
+
+#include <vulkan/vulkan.h>
+#include "../core/parallel/thread_pool.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace fantasy
+{
+    // 把一个 render pass 内的 draw 分段并行录制进 secondary command buffer, 再按分段顺序在 primary 中执行.
+    // 录制线程数与全局线程池无关, 调用线程录制第 0 段, 其余分段交给自己的 thread_count - 1 个 worker.
+    // 每帧每个录制槽一个 command pool, 第 i 段只使用第 i 个槽, 同一个 pool 不会被两个线程同时使用, 无需加锁.
+    class ParallelCommandRecorder
+    {
+    public:
+        // 录制 [begin, end) 范围内的 draw. secondary 不继承 primary 的状态, 每段需要自己绑定管线, 视口和描述符.
+        using RecordFunc = std::function<bool(VkCommandBuffer cmd_buffer, uint64_t begin, uint64_t end)>;
+
+        // 每段至少这么多 draw, 更少时分到多个线程的开销大于收益.
+        static constexpr uint64_t MIN_DRAWS_PER_SEGMENT = 256;
+
+        // thread_count 为 1 时总是直接录制进 primary.
+        bool initialize(VkDevice device, uint32_t queue_family_index, uint32_t thread_count);
+        void destroy();
+
+        // 等待该帧的 fence 之后调用, 整体重置该帧所有槽的 pool.
+        bool begin_frame(uint64_t frame_index);
+
+        // 开始 render pass, 录制 draw_count 个 draw 后结束. 只有一段时直接录制进 primary.
+        bool record_render_pass(
+            VkCommandBuffer primary_cmd_buffer,
+            const VkRenderPassBeginInfo& begin_info,
+            uint64_t draw_count,
+            const RecordFunc& func
+        );
+
+        uint32_t get_thread_count() const { return _slot_count; }
+
+    private:
+        struct RecordSlot
+        {
+            VkCommandPool cmd_pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> cmd_buffers;   // pool 重置后复用, 不再释放.
+            uint32_t used_count = 0;
+        };
+
+        bool get_secondary_cmd_buffer(RecordSlot& slot, VkCommandBuffer& out_cmd_buffer);
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        uint32_t _slot_count = 0;
+        uint32_t _current_frame = 0;
+        std::array<std::vector<RecordSlot>, NUM_FRAMES_IN_FLIGHT> _frames;
+        std::unique_ptr<ThreadPool> _pool;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,82 @@
+#include "frame_constant_allocator.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+
+namespace fantasy
+{
+    static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool FrameConstantAllocator::initialize(
+        VkPhysicalDevice physical_device,
+        GpuMemoryAllocator* allocator,
+        BindlessDescriptorHeap* bindless_heap,
+        VkDeviceSize frame_size
+    )
+    {
+        _allocator = allocator;
+        _bindless_heap = bindless_heap;
+
+        // 着色器中最大的标量对齐是 float4, 至少 16 字节.
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        _alignment = std::max({
+            VkDeviceSize(16),
+            properties.limits.minUniformBufferOffsetAlignment,
+            properties.limits.minStorageBufferOffsetAlignment
+        });
+        _frame_size = align_up(frame_size, _alignment);
+
+        // 着色器中的偏移是 32 位的.
+        const VkDeviceSize buffer_size = _frame_size * NUM_FRAMES_IN_FLIGHT;
+        ReturnIfFalse(buffer_size <= UINT32_MAX);
+
+        VkBufferCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        create_info.size = buffer_size;
+        create_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ReturnIfFalse(_allocator->create_buffer(
+            create_info,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _buffer,
+            _allocation
+        ));
+
+        _buffer_index = _bindless_heap->allocate_storage_buffer(_buffer, 0, buffer_size);
+        return _buffer_index != BindlessDescriptorHeap::INVALID_INDEX;
+    }
+
+    void FrameConstantAllocator::destroy()
+    {
+        if (_buffer == VK_NULL_HANDLE) return;
+
+        _bindless_heap->release(BindlessResourceType::StorageBuffer, _buffer_index);
+        _allocator->destroy_buffer(_buffer, _allocation);
+        _buffer = VK_NULL_HANDLE;
+        _buffer_index = BindlessDescriptorHeap::INVALID_INDEX;
+    }
+
+    void FrameConstantAllocator::begin_frame(uint64_t frame_index)
+    {
+        _frame_offset = (frame_index % NUM_FRAMES_IN_FLIGHT) * _frame_size;
+        _head.store(0, std::memory_order_relaxed);
+    }
+
+    void* FrameConstantAllocator::allocate(VkDeviceSize size, uint32_t& out_offset)
+    {
+        // 每次分配的大小都向上对齐, 起点自然也是对齐的.
+        const VkDeviceSize aligned_size = align_up(std::max(size, VkDeviceSize(1)), _alignment);
+        const VkDeviceSize offset = _head.fetch_add(aligned_size, std::memory_order_relaxed);
+        if (offset + aligned_size > _frame_size)
+        {
+            LOG_ERROR("Frame constant allocator is full, frame size " + std::to_string(_frame_size) + ".");
+            return nullptr;
+        }
+
+        out_offset = static_cast<uint32_t>(_frame_offset + offset);
+        return static_cast<uint8_t*>(_allocation.mapped_data) + out_offset;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef GPU_FRAME_CONSTANT_ALLOCATOR_H
+#define GPU_FRAME_CONSTANT_ALLOCATOR_H
+
+#include "gpu_memory_allocator.h"
+#include "bindless_descriptor_heap.h"
+#include <atomic>
+#include <cstring>
+
+namespace fantasy
+{
+    // 每帧常量的线性分配器. 一个常驻映射的大 buffer 按 NUM_FRAMES_IN_FLIGHT 分成等大的区域,
+    // 每帧只在自己的区域内移动指针分配, 帧开始时整体重置, 不需要逐个释放.
+    // 整个 buffer 在 bindless 描述符集中只占一个槽位, 着色器用槽位下标和分配得到的字节偏移读取常量,
+    // 分配不会创建新的描述符, 也不会分配新的内存.
+    // 偏移按设备的 uniform/storage buffer 偏移对齐, 也可以直接用作动态描述符的 dynamic offset.
+    // allocate() 可以多线程调用, begin_frame() 不能与 allocate() 同时调用.
+    class FrameConstantAllocator
+    {
+    public:
+        static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 4ull << 20;
+
+        bool initialize(
+            VkPhysicalDevice physical_device,
+            GpuMemoryAllocator* allocator,
+            BindlessDescriptorHeap* bindless_heap,
+            VkDeviceSize frame_size = DEFAULT_FRAME_SIZE
+        );
+        void destroy();
+
+        // 等待该帧的 fence 之后调用, 之后的分配都在该帧的区域内.
+        void begin_frame(uint64_t frame_index);
+
+        // 返回常驻映射的地址, out_offset 是相对整个 buffer 的偏移. 当前帧的区域用完时返回 nullptr.
+        void* allocate(VkDeviceSize size, uint32_t& out_offset);
+
+        template <typename T>
+        bool write(const T& value, uint32_t& out_offset)
+        {
+            void* data = allocate(sizeof(T), out_offset);
+            if (data == nullptr) return false;
+            memcpy(data, &value, sizeof(T));
+            return true;
+        }
+
+        VkBuffer get_buffer() const { return _buffer; }
+        uint32_t get_buffer_index() const { return _buffer_index; }
+        VkDeviceSize get_frame_size() const { return _frame_size; }
+        VkDeviceSize get_alignment() const { return _alignment; }
+
+    private:
+        GpuMemoryAllocator* _allocator = nullptr;
+        BindlessDescriptorHeap* _bindless_heap = nullptr;
+
+        VkBuffer _buffer = VK_NULL_HANDLE;
+        GpuAllocation _allocation;
+        uint32_t _buffer_index = BindlessDescriptorHeap::INVALID_INDEX;
+
+        VkDeviceSize _frame_size = 0;
+        VkDeviceSize _alignment = 16;
+        VkDeviceSize _frame_offset = 0;             // 当前帧区域在 buffer 中的起点.
+        std::atomic<VkDeviceSize> _head = 0;        // 相对当前帧区域的起点.
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,506 @@
+#include "gpu_memory_allocator.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+#include <bit>
+#include <map>
+
+namespace fantasy
+{
+    static constexpr uint32_t INVALID_MEMORY_TYPE = ~0u;
+    static constexpr uint32_t INVALID_BLOCK = ~0u;
+
+    // 小于这个大小的堆 (如部分独显上 256MB 的 BAR) 每块只占堆的 1/8, 避免一个块占满整个堆.
+    static constexpr VkDeviceSize SMALL_HEAP_SIZE = 1ull << 30;
+
+    bool GpuMemoryAllocator::initialize(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size)
+    {
+        _device = device;
+        _block_size = block_size;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &_memory_properties);
+
+        _buffer_image_granularity = properties.limits.bufferImageGranularity;
+        _max_allocation_count = properties.limits.maxMemoryAllocationCount;
+        return true;
+    }
+
+    void GpuMemoryAllocator::destroy()
+    {
+        std::lock_guard lock(_mutex);
+
+        for (uint32_t ix = 0; ix < _blocks.size(); ++ix)
+        {
+            if (_blocks[ix] == nullptr) continue;
+            if (!_blocks[ix]->allocator.empty()) LOG_ERROR("GPU memory block destroyed with live allocations.");
+            destroy_block(ix);
+        }
+        _blocks.clear();
+
+        if (_dedicated_count > 0) LOG_ERROR("Dedicated GPU memory allocations leaked.");
+    }
+
+    uint32_t GpuMemoryAllocator::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const
+    {
+        uint32_t best_type = INVALID_MEMORY_TYPE;
+        uint32_t best_cost = ~0u;
+        for (uint32_t ix = 0; ix < _memory_properties.memoryTypeCount; ++ix)
+        {
+            const VkMemoryPropertyFlags flags = _memory_properties.memoryTypes[ix].propertyFlags;
+            if (!(type_bits & (1u << ix)) || (flags & required) != required) continue;
+
+            // 缺少 preferred 的属性代价更高, 多余的属性 (如 DEVICE_LOCAL 内存上的 HOST_VISIBLE) 其次.
+            const uint32_t cost =
+                static_cast<uint32_t>(std::popcount(preferred & ~flags)) * 32 +
+                static_cast<uint32_t>(std::popcount(flags & ~(required | preferred)));
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_type = ix;
+            }
+        }
+        return best_type;
+    }
+
+    bool GpuMemoryAllocator::allocate(
+        const VkMemoryRequirements& requirements,
+        VkMemoryPropertyFlags properties,
+        GpuResourceKind kind,
+        GpuAllocation& out_allocation
+    )
+    {
+        std::lock_guard lock(_mutex);
+        return allocate_memory(requirements, properties, kind, false, VK_NULL_HANDLE, VK_NULL_HANDLE, out_allocation);
+    }
+
+    void GpuMemoryAllocator::release(GpuAllocation& allocation)
+    {
+        std::lock_guard lock(_mutex);
+        release_locked(allocation);
+    }
+
+    bool GpuMemoryAllocator::create_buffer(
+        const VkBufferCreateInfo& create_info,
+        VkMemoryPropertyFlags properties,
+        VkBuffer& out_buffer,
+        GpuAllocation& out_allocation
+    )
+    {
+        ReturnIfFalse(vkCreateBuffer(_device, &create_info, nullptr, &out_buffer) == VK_SUCCESS);
+
+        VkBufferMemoryRequirementsInfo2 requirements_info{};
+        requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+        requirements_info.buffer = out_buffer;
+
+        VkMemoryDedicatedRequirements dedicated_requirements{};
+        dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicated_requirements;
+        vkGetBufferMemoryRequirements2(_device, &requirements_info, &requirements);
+
+        bool success;
+        {
+            std::lock_guard lock(_mutex);
+            success = allocate_memory(
+                requirements.memoryRequirements,
+                properties,
+                GpuResourceKind::Linear,
+                dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation,
+                out_buffer,
+                VK_NULL_HANDLE,
+                out_allocation
+            );
+        }
+
+        if (!success || vkBindBufferMemory(_device, out_buffer, out_allocation.memory, out_allocation.offset) != VK_SUCCESS)
+        {
+            destroy_buffer(out_buffer, out_allocation);
+            out_buffer = VK_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
+
+    bool GpuMemoryAllocator::create_image(
+        const VkImageCreateInfo& create_info,
+        VkMemoryPropertyFlags properties,
+        VkImage& out_image,
+        GpuAllocation& out_allocation
+    )
+    {
+        ReturnIfFalse(vkCreateImage(_device, &create_info, nullptr, &out_image) == VK_SUCCESS);
+
+        VkImageMemoryRequirementsInfo2 requirements_info{};
+        requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+        requirements_info.image = out_image;
+
+        VkMemoryDedicatedRequirements dedicated_requirements{};
+        dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+        VkMemoryRequirements2 requirements{};
+        requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        requirements.pNext = &dedicated_requirements;
+        vkGetImageMemoryRequirements2(_device, &requirements_info, &requirements);
+
+        bool success;
+        {
+            std::lock_guard lock(_mutex);
+            success = allocate_memory(
+                requirements.memoryRequirements,
+                properties,
+                create_info.tiling == VK_IMAGE_TILING_LINEAR ? GpuResourceKind::Linear : GpuResourceKind::Optimal,
+                dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation,
+                VK_NULL_HANDLE,
+                out_image,
+                out_allocation
+            );
+        }
+
+        if (!success || vkBindImageMemory(_device, out_image, out_allocation.memory, out_allocation.offset) != VK_SUCCESS)
+        {
+            destroy_image(out_image, out_allocation);
+            out_image = VK_NULL_HANDLE;
+            return false;
+        }
+        return true;
+    }
+
+    void GpuMemoryAllocator::destroy_buffer(VkBuffer buffer, GpuAllocation& allocation)
+    {
+        vkDestroyBuffer(_device, buffer, nullptr);
+        release(allocation);
+    }
+
+    void GpuMemoryAllocator::destroy_image(VkImage image, GpuAllocation& allocation)
+    {
+        vkDestroyImage(_device, image, nullptr);
+        release(allocation);
+    }
+
+    GpuMemoryStats GpuMemoryAllocator::get_stats() const
+    {
+        std::lock_guard lock(_mutex);
+
+        GpuMemoryStats stats;
+        stats.dedicated_count = _dedicated_count;
+        stats.dedicated_bytes = _dedicated_bytes;
+        stats.device_allocation_count = _device_allocation_count;
+        stats.allocation_count = _dedicated_count;
+
+        uint64_t free_bytes = 0;
+        uint64_t largest_free_bytes = 0;
+        for (const auto& block : _blocks)
+        {
+            if (block == nullptr) continue;
+
+            const TlsfStats block_stats = block->allocator.get_stats();
+            stats.block_count++;
+            stats.allocation_count += block_stats.allocation_count;
+            stats.block_bytes += block_stats.capacity;
+            stats.block_used_bytes += block_stats.used_size;
+
+            free_bytes += block_stats.capacity - block_stats.used_size;
+            largest_free_bytes += block_stats.largest_free_size;
+        }
+        if (free_bytes > 0) stats.fragmentation = 1.0f - static_cast<float>(largest_free_bytes) / static_cast<float>(free_bytes);
+
+        return stats;
+    }
+
+    uint32_t GpuMemoryAllocator::defragment(const MoveFunc& move_func, uint32_t max_moves)
+    {
+        std::lock_guard lock(_mutex);
+
+        std::map<std::pair<uint32_t, GpuResourceKind>, std::vector<uint32_t>> groups;
+        for (uint32_t ix = 0; ix < _blocks.size(); ++ix)
+        {
+            if (_blocks[ix] != nullptr) groups[{ _blocks[ix]->memory_type, _blocks[ix]->kind }].push_back(ix);
+        }
+
+        uint32_t move_count = 0;
+        for (const auto& [key, block_indices] : groups)
+        {
+            if (block_indices.size() < 2) continue;
+
+            const uint32_t src_block = *std::min_element(
+                block_indices.begin(),
+                block_indices.end(),
+                [this](uint32_t a, uint32_t b) { return _blocks[a]->allocator.used_size() < _blocks[b]->allocator.used_size(); }
+            );
+            MemoryBlock& src = *_blocks[src_block];
+
+            std::vector<TlsfAllocation> sub_allocations;
+            src.allocator.for_each_allocation([&](const TlsfAllocation& allocation) { sub_allocations.push_back(allocation); });
+
+            for (const auto& sub_allocation : sub_allocations)
+            {
+                if (move_count >= max_moves) break;
+
+                GpuAllocation src_allocation;
+                src_allocation.memory = src.memory;
+                src_allocation.offset = sub_allocation.offset;
+                src_allocation.size = sub_allocation.size;
+                src_allocation.mapped_data = src.mapped_data ? static_cast<uint8_t*>(src.mapped_data) + sub_allocation.offset : nullptr;
+                src_allocation.memory_type = src.memory_type;
+                src_allocation.block = src_block;
+                src_allocation.sub_allocation = sub_allocation;
+
+                VkMemoryRequirements requirements{};
+                requirements.size = sub_allocation.size;
+                requirements.alignment = src.alignments[sub_allocation.node];
+
+                GpuAllocation dst_allocation;
+                bool allocated = false;
+                for (uint32_t dst_block : block_indices)
+                {
+                    if (dst_block != src_block && sub_allocate(dst_block, requirements, dst_allocation))
+                    {
+                        allocated = true;
+                        break;
+                    }
+                }
+                if (!allocated) break;
+
+                if (!move_func(src_allocation, dst_allocation))
+                {
+                    release_locked(dst_allocation);
+                    break;
+                }
+
+                src.allocator.release(sub_allocation);
+                move_count++;
+            }
+
+            if (src.allocator.empty()) destroy_block(src_block);
+        }
+        return move_count;
+    }
+
+    bool GpuMemoryAllocator::allocate_memory(
+        const VkMemoryRequirements& requirements,
+        VkMemoryPropertyFlags properties,
+        GpuResourceKind kind,
+        bool prefer_dedicated,
+        VkBuffer dedicated_buffer,
+        VkImage dedicated_image,
+        GpuAllocation& out_allocation
+    )
+    {
+        // bufferImageGranularity 为 1 时两类资源可以放在同一个块中.
+        if (_buffer_image_granularity <= 1) kind = GpuResourceKind::Linear;
+
+        const bool dedicated = prefer_dedicated || requirements.size > _block_size / 2;
+
+        uint32_t type_bits = requirements.memoryTypeBits;
+        while (true)
+        {
+            const uint32_t memory_type = find_memory_type(type_bits, properties);
+            if (memory_type == INVALID_MEMORY_TYPE)
+            {
+                LOG_ERROR("Allocate GPU memory failed, no suitable memory type left.");
+                return false;
+            }
+
+            if (dedicated)
+            {
+                if (allocate_dedicated(requirements, memory_type, dedicated_buffer, dedicated_image, out_allocation)) return true;
+            }
+            else
+            {
+                if (allocate_from_blocks(requirements, memory_type, kind, out_allocation)) return true;
+            }
+
+            // 这一类型所在的堆已满, 换下一个满足要求的类型.
+            type_bits &= ~(1u << memory_type);
+        }
+    }
+
+    bool GpuMemoryAllocator::allocate_dedicated(
+        const VkMemoryRequirements& requirements,
+        uint32_t memory_type,
+        VkBuffer dedicated_buffer,
+        VkImage dedicated_image,
+        GpuAllocation& out_allocation
+    )
+    {
+        VkMemoryDedicatedAllocateInfo dedicated_info{};
+        dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicated_info.buffer = dedicated_buffer;
+        dedicated_info.image = dedicated_image;
+        const bool has_resource = dedicated_buffer != VK_NULL_HANDLE || dedicated_image != VK_NULL_HANDLE;
+
+        VkDeviceMemory memory;
+        void* mapped_data;
+        if (!allocate_device_memory(requirements.size, memory_type, has_resource ? &dedicated_info : nullptr, memory, mapped_data)) return false;
+
+        out_allocation = GpuAllocation{};
+        out_allocation.memory = memory;
+        out_allocation.offset = 0;
+        out_allocation.size = requirements.size;
+        out_allocation.mapped_data = mapped_data;
+        out_allocation.memory_type = memory_type;
+        out_allocation.block = GpuAllocation::DEDICATED_BLOCK;
+
+        _dedicated_count++;
+        _dedicated_bytes += requirements.size;
+        return true;
+    }
+
+    bool GpuMemoryAllocator::allocate_from_blocks(
+        const VkMemoryRequirements& requirements,
+        uint32_t memory_type,
+        GpuResourceKind kind,
+        GpuAllocation& out_allocation
+    )
+    {
+        for (uint32_t ix = 0; ix < _blocks.size(); ++ix)
+        {
+            const auto& block = _blocks[ix];
+            if (block == nullptr || block->memory_type != memory_type || block->kind != kind) continue;
+            if (sub_allocate(ix, requirements, out_allocation)) return true;
+        }
+
+        const uint32_t block_index = create_block(memory_type, kind, requirements.size);
+        if (block_index != INVALID_BLOCK) return sub_allocate(block_index, requirements, out_allocation);
+
+        // 整块分配不出来时退回到刚好够用的独立分配.
+        return allocate_dedicated(requirements, memory_type, VK_NULL_HANDLE, VK_NULL_HANDLE, out_allocation);
+    }
+
+    bool GpuMemoryAllocator::sub_allocate(uint32_t block_index, const VkMemoryRequirements& requirements, GpuAllocation& out_allocation)
+    {
+        MemoryBlock& block = *_blocks[block_index];
+
+        const TlsfAllocation sub_allocation = block.allocator.allocate(requirements.size, requirements.alignment);
+        if (!sub_allocation.valid()) return false;
+
+        if (block.alignments.size() <= sub_allocation.node) block.alignments.resize(sub_allocation.node + 1);
+        block.alignments[sub_allocation.node] = requirements.alignment;
+
+        out_allocation = GpuAllocation{};
+        out_allocation.memory = block.memory;
+        out_allocation.offset = sub_allocation.offset;
+        out_allocation.size = sub_allocation.size;
+        out_allocation.mapped_data = block.mapped_data ? static_cast<uint8_t*>(block.mapped_data) + sub_allocation.offset : nullptr;
+        out_allocation.memory_type = block.memory_type;
+        out_allocation.block = block_index;
+        out_allocation.sub_allocation = sub_allocation;
+        return true;
+    }
+
+    uint32_t GpuMemoryAllocator::create_block(uint32_t memory_type, GpuResourceKind kind, VkDeviceSize min_size)
+    {
+        const VkDeviceSize heap_size = _memory_properties.memoryHeaps[_memory_properties.memoryTypes[memory_type].heapIndex].size;
+
+        VkDeviceSize size = _block_size;
+        if (heap_size < SMALL_HEAP_SIZE) size = std::min(size, heap_size / 8);
+        size = std::max(size, min_size);
+
+        // 分配失败时减半重试, 直到不足以容纳当前请求.
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped_data = nullptr;
+        while (!allocate_device_memory(size, memory_type, nullptr, memory, mapped_data))
+        {
+            if (size / 2 < min_size) return INVALID_BLOCK;
+            size /= 2;
+        }
+
+        auto block = std::make_unique<MemoryBlock>();
+        block->memory = memory;
+        block->mapped_data = mapped_data;
+        block->memory_type = memory_type;
+        block->kind = kind;
+        block->allocator.initialize(size);
+
+        auto iter = std::find(_blocks.begin(), _blocks.end(), nullptr);
+        if (iter == _blocks.end()) iter = _blocks.insert(iter, nullptr);
+        *iter = std::move(block);
+        return static_cast<uint32_t>(iter - _blocks.begin());
+    }
+
+    void GpuMemoryAllocator::destroy_block(uint32_t block_index)
+    {
+        free_device_memory(_blocks[block_index]->memory);
+        _blocks[block_index].reset();
+    }
+
+    bool GpuMemoryAllocator::allocate_device_memory(
+        VkDeviceSize size,
+        uint32_t memory_type,
+        const void* next,
+        VkDeviceMemory& out_memory,
+        void*& out_mapped_data
+    )
+    {
+        out_mapped_data = nullptr;
+        if (_device_allocation_count >= _max_allocation_count)
+        {
+            LOG_ERROR("Reached maxMemoryAllocationCount.");
+            return false;
+        }
+
+        VkMemoryAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.pNext = next;
+        allocate_info.allocationSize = size;
+        allocate_info.memoryTypeIndex = memory_type;
+        if (vkAllocateMemory(_device, &allocate_info, nullptr, &out_memory) != VK_SUCCESS) return false;
+
+        // 主机可见的内存整块常驻映射, 子分配直接使用偏移后的指针.
+        if (is_host_visible(memory_type) && vkMapMemory(_device, out_memory, 0, VK_WHOLE_SIZE, 0, &out_mapped_data) != VK_SUCCESS)
+        {
+            vkFreeMemory(_device, out_memory, nullptr);
+            return false;
+        }
+
+        _device_allocation_count++;
+        return true;
+    }
+
+    void GpuMemoryAllocator::free_device_memory(VkDeviceMemory memory)
+    {
+        // vkFreeMemory 会隐式解除映射.
+        vkFreeMemory(_device, memory, nullptr);
+        _device_allocation_count--;
+    }
+
+    void GpuMemoryAllocator::release_locked(GpuAllocation& allocation)
+    {
+        if (!allocation.valid()) return;
+
+        if (allocation.dedicated())
+        {
+            free_device_memory(allocation.memory);
+            _dedicated_count--;
+            _dedicated_bytes -= allocation.size;
+        }
+        else
+        {
+            MemoryBlock& block = *_blocks[allocation.block];
+            block.allocator.release(allocation.sub_allocation);
+
+            // 同组还有其它块时释放空块, 保留最后一个避免反复分配.
+            if (block.allocator.empty())
+            {
+                const bool has_other_block = std::any_of(
+                    _blocks.begin(),
+                    _blocks.end(),
+                    [&](const auto& other)
+                    {
+                        return other != nullptr && other.get() != &block && other->memory_type == block.memory_type && other->kind == block.kind;
+                    }
+                );
+                if (has_other_block) destroy_block(allocation.block);
+            }
+        }
+        allocation = GpuAllocation{};
+    }
+
+    bool GpuMemoryAllocator::is_host_visible(uint32_t memory_type) const
+    {
+        return (_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+}
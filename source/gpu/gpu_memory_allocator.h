@@ -0,0 +1,145 @@
+#ifndef GPU_MEMORY_ALLOCATOR_H
+#define GPU_MEMORY_ALLOCATOR_H
+
+#include "../core/tools/tlsf_allocator.h"
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace fantasy
+{
+    // 线性资源 (buffer, linear image) 与 optimal image 放在不同的内存块中,
+    // 这样同一个块内不会出现两者相邻, 无需处理 bufferImageGranularity.
+    enum class GpuResourceKind : uint8_t
+    {
+        Linear,
+        Optimal
+    };
+
+    struct GpuAllocation
+    {
+        static constexpr uint32_t DEDICATED_BLOCK = ~0u;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped_data = nullptr;        // 主机可见的内存常驻映射, 已经加上 offset.
+        uint32_t memory_type = ~0u;
+        uint32_t block = DEDICATED_BLOCK;
+        TlsfAllocation sub_allocation;
+
+        bool valid() const { return memory != VK_NULL_HANDLE; }
+        bool dedicated() const { return block == DEDICATED_BLOCK; }
+    };
+
+    struct GpuMemoryStats
+    {
+        uint32_t block_count = 0;
+        uint32_t dedicated_count = 0;
+        uint32_t allocation_count = 0;      // 子分配与独立分配的总数.
+        uint32_t device_allocation_count = 0;   // vkAllocateMemory 的次数, 受 maxMemoryAllocationCount 限制.
+        uint64_t block_bytes = 0;
+        uint64_t block_used_bytes = 0;
+        uint64_t dedicated_bytes = 0;
+
+        // 1 - 各块最大空闲区间之和 / 空闲总量, 0 表示每个块的空闲空间都是连续的.
+        float fragmentation = 0.0f;
+    };
+
+    // 按内存类型分配大块 VkDeviceMemory, 块内用 TLSF 子分配. 超过半个块大小或驱动倾向独立分配的资源单独分配.
+    class GpuMemoryAllocator
+    {
+    public:
+        static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+
+        // move_func(src, dst): 把 src 的数据拷贝到 dst 并让资源改用 dst, 返回前拷贝必须已经完成.
+        // 返回 true 后 src 由分配器释放. 回调中不能再调用分配器.
+        using MoveFunc = std::function<bool(const GpuAllocation& src, const GpuAllocation& dst)>;
+
+        bool initialize(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize block_size = DEFAULT_BLOCK_SIZE);
+        void destroy();
+
+        // 满足 required 的类型中优先选择包含 preferred 的, 其次选择多余属性最少的.
+        uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) const;
+
+        bool allocate(
+            const VkMemoryRequirements& requirements,
+            VkMemoryPropertyFlags properties,
+            GpuResourceKind kind,
+            GpuAllocation& out_allocation
+        );
+        void release(GpuAllocation& allocation);
+
+        // 创建资源, 分配内存并绑定.
+        bool create_buffer(const VkBufferCreateInfo& create_info, VkMemoryPropertyFlags properties, VkBuffer& out_buffer, GpuAllocation& out_allocation);
+        bool create_image(const VkImageCreateInfo& create_info, VkMemoryPropertyFlags properties, VkImage& out_image, GpuAllocation& out_allocation);
+        void destroy_buffer(VkBuffer buffer, GpuAllocation& allocation);
+        void destroy_image(VkImage image, GpuAllocation& allocation);
+
+        GpuMemoryStats get_stats() const;
+
+        // 对每组 (内存类型, 资源类型) 中使用量最少的块, 尝试把其中的分配搬到同组的其它块, 搬空后释放该块.
+        // 返回成功移动的分配数.
+        uint32_t defragment(const MoveFunc& move_func, uint32_t max_moves = ~0u);
+
+    private:
+        struct MemoryBlock
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mapped_data = nullptr;
+            uint32_t memory_type = 0;
+            GpuResourceKind kind = GpuResourceKind::Linear;
+            TlsfAllocator allocator;
+            std::vector<VkDeviceSize> alignments;   // 按 TLSF 节点下标记录对齐, 碎片整理时重新分配使用.
+        };
+
+        bool allocate_memory(
+            const VkMemoryRequirements& requirements,
+            VkMemoryPropertyFlags properties,
+            GpuResourceKind kind,
+            bool prefer_dedicated,
+            VkBuffer dedicated_buffer,
+            VkImage dedicated_image,
+            GpuAllocation& out_allocation
+        );
+        bool allocate_dedicated(
+            const VkMemoryRequirements& requirements,
+            uint32_t memory_type,
+            VkBuffer dedicated_buffer,
+            VkImage dedicated_image,
+            GpuAllocation& out_allocation
+        );
+        bool allocate_from_blocks(const VkMemoryRequirements& requirements, uint32_t memory_type, GpuResourceKind kind, GpuAllocation& out_allocation);
+        bool sub_allocate(uint32_t block_index, const VkMemoryRequirements& requirements, GpuAllocation& out_allocation);
+        uint32_t create_block(uint32_t memory_type, GpuResourceKind kind, VkDeviceSize min_size);
+        void destroy_block(uint32_t block_index);
+        bool allocate_device_memory(VkDeviceSize size, uint32_t memory_type, const void* next, VkDeviceMemory& out_memory, void*& out_mapped_data);
+        void free_device_memory(VkDeviceMemory memory);
+        void release_locked(GpuAllocation& allocation);
+        bool is_host_visible(uint32_t memory_type) const;
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties _memory_properties{};
+        VkDeviceSize _block_size = DEFAULT_BLOCK_SIZE;
+        VkDeviceSize _buffer_image_granularity = 1;
+        uint32_t _max_allocation_count = 0;
+
+        mutable std::mutex _mutex;
+        std::vector<std::unique_ptr<MemoryBlock>> _blocks;     // 释放的块置空, 下标可复用.
+        uint32_t _device_allocation_count = 0;
+        uint32_t _dedicated_count = 0;
+        uint64_t _dedicated_bytes = 0;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
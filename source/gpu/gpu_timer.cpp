@@ -0,0 +1,91 @@
+#include "gpu_timer.h"
+#include "../core/math/common.h"
+#include "../core/tools/log.h"
+#include <vector>
+
+namespace fantasy
+{
+    bool GpuTimer::initialize(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family_index)
+    {
+        _device = device;
+        _frame_indices.fill(INVALID_SIZE_64);
+
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+        ReturnIfFalse(queue_family_index < queue_family_count);
+
+        const uint32_t valid_bits = queue_families[queue_family_index].timestampValidBits;
+        if (valid_bits == 0)
+        {
+            LOG_WARN("Queue family " + std::to_string(queue_family_index) + " does not support timestamp queries.");
+            return true;
+        }
+        _timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        _timestamp_period = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = 2 * NUM_FRAMES_IN_FLIGHT;
+        return vkCreateQueryPool(_device, &create_info, nullptr, &_query_pool) == VK_SUCCESS;
+    }
+
+    void GpuTimer::destroy()
+    {
+        if (_query_pool == VK_NULL_HANDLE) return;
+
+        vkDestroyQueryPool(_device, _query_pool, nullptr);
+        _query_pool = VK_NULL_HANDLE;
+    }
+
+    void GpuTimer::begin_frame(VkCommandBuffer cmd_buffer, uint64_t frame_index)
+    {
+        if (_query_pool == VK_NULL_HANDLE) return;
+
+        // 查询在写入之前必须重置, 这对查询上次的结果已经读取或者不再需要.
+        const uint32_t slot = static_cast<uint32_t>(frame_index % NUM_FRAMES_IN_FLIGHT);
+        vkCmdResetQueryPool(cmd_buffer, _query_pool, slot * 2, 2);
+        vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, _query_pool, slot * 2);
+        _frame_indices[slot] = frame_index;
+    }
+
+    void GpuTimer::end_frame(VkCommandBuffer cmd_buffer, uint64_t frame_index)
+    {
+        if (_query_pool == VK_NULL_HANDLE) return;
+
+        // 在之前的所有指令执行完后写入.
+        const uint32_t slot = static_cast<uint32_t>(frame_index % NUM_FRAMES_IN_FLIGHT);
+        vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, _query_pool, slot * 2 + 1);
+    }
+
+    bool GpuTimer::get_frame_time(uint64_t frame_index, double& out_milliseconds)
+    {
+        if (_query_pool == VK_NULL_HANDLE) return false;
+
+        const uint32_t slot = static_cast<uint32_t>(frame_index % NUM_FRAMES_IN_FLIGHT);
+        if (_frame_indices[slot] != frame_index) return false;
+        _frame_indices[slot] = INVALID_SIZE_64;
+
+        // fence 已经等待过, 结果一定可用, 不需要 VK_QUERY_RESULT_WAIT_BIT.
+        uint64_t timestamps[2] = {};
+        ReturnIfFalse(vkGetQueryPoolResults(
+            _device,
+            _query_pool,
+            slot * 2,
+            2,
+            sizeof(timestamps),
+            timestamps,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT
+        ) == VK_SUCCESS);
+
+        const uint64_t ticks = (timestamps[1] - timestamps[0]) & _timestamp_mask;
+        out_milliseconds = static_cast<double>(ticks) * _timestamp_period / 1000000.0;
+        return true;
+    }
+}
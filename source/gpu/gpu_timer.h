@@ -0,0 +1,49 @@
+#ifndef GPU_GPU_TIMER_H
+#define GPU_GPU_TIMER_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+
+namespace fantasy
+{
+    // 用时间戳查询测量每帧指令缓冲在 GPU 上的执行时间.
+    // 每帧占用一对查询, 按帧序号轮流使用 NUM_FRAMES_IN_FLIGHT 对,
+    // 结果在等待该帧的 fence 之后读取, 不会让 CPU 等待 GPU.
+    // 队列族不支持时间戳时 initialize() 仍然成功, 之后的调用都不做任何事.
+    class GpuTimer
+    {
+    public:
+        bool initialize(VkPhysicalDevice physical_device, VkDevice device, uint32_t queue_family_index);
+        void destroy();
+
+        bool is_supported() const { return _query_pool != VK_NULL_HANDLE; }
+
+        // 分别在指令缓冲的开头和结尾录制, 不能在渲染流程内.
+        void begin_frame(VkCommandBuffer cmd_buffer, uint64_t frame_index);
+        void end_frame(VkCommandBuffer cmd_buffer, uint64_t frame_index);
+
+        // 该帧的 fence 等待之后调用, 每帧的结果只能取得一次.
+        // 查询已被之后的帧覆盖或者该帧没有录制时返回 false.
+        bool get_frame_time(uint64_t frame_index, double& out_milliseconds);
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        VkQueryPool _query_pool = VK_NULL_HANDLE;
+
+        double _timestamp_period = 1.0;         // 每个时间戳单位的纳秒数.
+        uint64_t _timestamp_mask = ~0ull;       // 时间戳只有 timestampValidBits 位有效.
+
+        // 每对查询最近一次录制的帧序号, 结果被读取后置为 INVALID_SIZE_64.
+        std::array<uint64_t, NUM_FRAMES_IN_FLIGHT> _frame_indices;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
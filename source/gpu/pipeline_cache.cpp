@@ -0,0 +1,468 @@
+#include "pipeline_cache.h"
+#include "../core/parallel/parallel.h"
+#include "../core/tools/log.h"
+#include "../core/tools/timer.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+
+namespace fantasy
+{
+    static constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x434c5046;  // "FPLC"
+    static constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+    // 文件头之后紧跟驱动的缓存数据. 驱动升级后 pipelineCacheUUID 不一定改变, 所以额外记录驱动版本.
+    struct PipelineCacheFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+        Hash128 data_hash;
+    };
+
+    bool PipelineCache::initialize(VkPhysicalDevice physical_device, VkDevice device, const std::string& cache_path)
+    {
+        _device = device;
+        _cache_path = cache_path;
+        vkGetPhysicalDeviceProperties(physical_device, &_device_properties);
+
+        std::vector<uint8_t> cache_data;
+        if (!load_cache_data(cache_data)) cache_data.clear();
+
+        VkPipelineCacheCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        create_info.initialDataSize = cache_data.size();
+        create_info.pInitialData = cache_data.empty() ? nullptr : cache_data.data();
+        if (vkCreatePipelineCache(_device, &create_info, nullptr, &_pipeline_cache) != VK_SUCCESS)
+        {
+            // 驱动仍然拒绝数据时从空缓存开始.
+            create_info.initialDataSize = 0;
+            create_info.pInitialData = nullptr;
+            ReturnIfFalse(vkCreatePipelineCache(_device, &create_info, nullptr, &_pipeline_cache) == VK_SUCCESS);
+        }
+        return true;
+    }
+
+    void PipelineCache::destroy()
+    {
+        if (_device == VK_NULL_HANDLE) return;
+
+        save();
+
+        std::lock_guard lock(_mutex);
+        for (auto& [key, pipeline] : _pipelines) vkDestroyPipeline(_device, pipeline, nullptr);
+        _pipelines.clear();
+        vkDestroyPipelineCache(_device, _pipeline_cache, nullptr);
+        _pipeline_cache = VK_NULL_HANDLE;
+        _device = VK_NULL_HANDLE;
+    }
+
+    bool PipelineCache::save() const
+    {
+        size_t data_size = 0;
+        ReturnIfFalse(vkGetPipelineCacheData(_device, _pipeline_cache, &data_size, nullptr) == VK_SUCCESS);
+        std::vector<uint8_t> data(data_size);
+        ReturnIfFalse(vkGetPipelineCacheData(_device, _pipeline_cache, &data_size, data.data()) == VK_SUCCESS);
+        data.resize(data_size);
+
+        PipelineCacheFileHeader header{};
+        header.magic = PIPELINE_CACHE_MAGIC;
+        header.version = PIPELINE_CACHE_VERSION;
+        header.vendor_id = _device_properties.vendorID;
+        header.device_id = _device_properties.deviceID;
+        header.driver_version = _device_properties.driverVersion;
+        memcpy(header.pipeline_cache_uuid, _device_properties.pipelineCacheUUID, VK_UUID_SIZE);
+        header.data_size = data.size();
+        header.data_hash = murmur_hash128(data.data(), data.size());
+
+        const std::filesystem::path path(_cache_path);
+        std::filesystem::path temp_path = path;
+        temp_path += ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+        {
+            std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+            if (
+                !output.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+                !output.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))
+            )
+            {
+                LOG_ERROR("Write pipeline cache " + temp_path.string() + " failed.");
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temp_path, path, error);
+        if (error)
+        {
+            LOG_ERROR("Replace pipeline cache " + _cache_path + " failed: " + error.message());
+            return false;
+        }
+        return true;
+    }
+
+    bool PipelineCache::load_cache_data(std::vector<uint8_t>& out_data) const
+    {
+        std::ifstream input(_cache_path, std::ios::binary | std::ios::ate);
+        if (!input.is_open()) return false;
+
+        const uint64_t file_size = static_cast<uint64_t>(input.tellg());
+        input.seekg(0);
+
+        PipelineCacheFileHeader header{};
+        if (file_size < sizeof(header) || !input.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+
+        // 设备或驱动变化后缓存数据无效, 文件截断或损坏时也丢弃, 不把它交给驱动.
+        if (
+            header.magic != PIPELINE_CACHE_MAGIC ||
+            header.version != PIPELINE_CACHE_VERSION ||
+            header.vendor_id != _device_properties.vendorID ||
+            header.device_id != _device_properties.deviceID ||
+            header.driver_version != _device_properties.driverVersion ||
+            memcmp(header.pipeline_cache_uuid, _device_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+            header.data_size != file_size - sizeof(header)
+        )
+        {
+            LOG_WARN("Pipeline cache " + _cache_path + " is stale, rebuild it.");
+            return false;
+        }
+
+        out_data.resize(header.data_size);
+        if (!input.read(reinterpret_cast<char*>(out_data.data()), static_cast<std::streamsize>(out_data.size()))) return false;
+
+        if (murmur_hash128(out_data.data(), out_data.size()) != header.data_hash)
+        {
+            LOG_WARN("Pipeline cache " + _cache_path + " is corrupted, rebuild it.");
+            return false;
+        }
+
+        // 驱动数据自带的头也要与当前设备一致.
+        VkPipelineCacheHeaderVersionOne driver_header{};
+        if (out_data.size() < sizeof(driver_header)) return false;
+        memcpy(&driver_header, out_data.data(), sizeof(driver_header));
+        return driver_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            driver_header.vendorID == _device_properties.vendorID &&
+            driver_header.deviceID == _device_properties.deviceID &&
+            memcmp(driver_header.pipelineCacheUUID, _device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    Hash128 PipelineCache::get_key(const GraphicsPipelineDesc& desc)
+    {
+        Hash128 key = murmur_hash128(desc.vs_code.data(), desc.vs_code.size());
+        auto add = [&key](const void* data, uint64_t size) { key = murmur_hash128(key, data, size); };
+        auto add_value = [&add](const auto& value) { add(&value, sizeof(value)); };
+
+        add(desc.vs_entry_point.data(), desc.vs_entry_point.size());
+        add_value(desc.ps_code.size());
+        add(desc.ps_code.data(), desc.ps_code.size());
+        add(desc.ps_entry_point.data(), desc.ps_entry_point.size());
+
+        // 这些 Vulkan 结构体只包含 32 位成员, 没有填充字节, 可以直接哈希.
+        add_value(desc.vertex_bindings.size());
+        add(desc.vertex_bindings.data(), desc.vertex_bindings.size() * sizeof(VkVertexInputBindingDescription));
+        add_value(desc.vertex_attributes.size());
+        add(desc.vertex_attributes.data(), desc.vertex_attributes.size() * sizeof(VkVertexInputAttributeDescription));
+        add_value(desc.blend_attachments.size());
+        add(desc.blend_attachments.data(), desc.blend_attachments.size() * sizeof(VkPipelineColorBlendAttachmentState));
+
+        add_value(desc.topology);
+        add_value(desc.polygon_mode);
+        add_value(desc.cull_mode);
+        add_value(desc.front_face);
+        add_value(desc.sample_count);
+        add_value(desc.depth_test);
+        add_value(desc.depth_write);
+        add_value(desc.depth_compare_op);
+        add_value(desc.layout);
+        add_value(desc.render_pass);
+        add_value(desc.subpass);
+        return key;
+    }
+
+    Hash128 PipelineCache::get_key(const ComputePipelineDesc& desc)
+    {
+        Hash128 key = murmur_hash128(desc.cs_code.data(), desc.cs_code.size());
+        key = murmur_hash128(key, desc.cs_entry_point.data(), desc.cs_entry_point.size());
+
+        // 与图形管线的键区分开.
+        const VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+        key = murmur_hash128(key, &bind_point, sizeof(bind_point));
+        return murmur_hash128(key, &desc.layout, sizeof(desc.layout));
+    }
+
+    bool PipelineCache::get_graphics_pipeline(const GraphicsPipelineDesc& desc, VkPipeline& out_pipeline)
+    {
+        return get_pipeline(
+            get_key(desc),
+            [this, &desc](VkPipeline& out_pipeline) { return create_graphics_pipeline(desc, out_pipeline); },
+            out_pipeline
+        );
+    }
+
+    bool PipelineCache::get_compute_pipeline(const ComputePipelineDesc& desc, VkPipeline& out_pipeline)
+    {
+        return get_pipeline(
+            get_key(desc),
+            [this, &desc](VkPipeline& out_pipeline) { return create_compute_pipeline(desc, out_pipeline); },
+            out_pipeline
+        );
+    }
+
+    bool PipelineCache::get_pipeline(const Hash128& key, const std::function<bool(VkPipeline&)>& create_func, VkPipeline& out_pipeline)
+    {
+        {
+            std::lock_guard lock(_mutex);
+            auto iter = _pipelines.find(key);
+            if (iter != _pipelines.end())
+            {
+                out_pipeline = iter->second;
+                return true;
+            }
+        }
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        ReturnIfFalse(create_func(pipeline));
+
+        // 其它线程可能同时创建了同样的管线, 只保留先插入的.
+        std::lock_guard lock(_mutex);
+        auto [iter, inserted] = _pipelines.emplace(key, pipeline);
+        if (!inserted) vkDestroyPipeline(_device, pipeline, nullptr);
+        out_pipeline = iter->second;
+        return true;
+    }
+
+    bool PipelineCache::create_pipelines(
+        std::span<const GraphicsPipelineDesc> graphics_descs,
+        std::span<VkPipeline> out_graphics_pipelines,
+        std::span<const ComputePipelineDesc> compute_descs,
+        std::span<VkPipeline> out_compute_pipelines
+    )
+    {
+        ReturnIfFalse(out_graphics_pipelines.size() == graphics_descs.size());
+        ReturnIfFalse(out_compute_pipelines.size() == compute_descs.size());
+
+        Timer timer;
+
+        // 图形管线在前, 计算管线在后, 统一编号.
+        const uint64_t graphics_count = graphics_descs.size();
+        const uint64_t count = graphics_count + compute_descs.size();
+        auto create = [&](uint64_t ix, VkPipeline& out_pipeline)
+        {
+            return ix < graphics_count ?
+                create_graphics_pipeline(graphics_descs[ix], out_pipeline) :
+                create_compute_pipeline(compute_descs[ix - graphics_count], out_pipeline);
+        };
+        auto output = [&](uint64_t ix) -> VkPipeline&
+        {
+            return ix < graphics_count ? out_graphics_pipelines[ix] : out_compute_pipelines[ix - graphics_count];
+        };
+
+        std::vector<Hash128> keys(count);
+        std::vector<uint64_t> missing;      // 同样的状态只创建一次.
+        {
+            std::unordered_set<Hash128, Hash128Hasher> missing_keys;
+
+            std::lock_guard lock(_mutex);
+            for (uint64_t ix = 0; ix < count; ++ix)
+            {
+                keys[ix] = ix < graphics_count ? get_key(graphics_descs[ix]) : get_key(compute_descs[ix - graphics_count]);
+                if (!_pipelines.contains(keys[ix]) && missing_keys.insert(keys[ix]).second) missing.push_back(ix);
+            }
+        }
+
+        std::vector<VkPipeline> created(missing.size(), VK_NULL_HANDLE);
+        std::atomic<bool> success = true;
+        parallel::parallel_for(
+            [&](uint64_t ix)
+            {
+                if (!create(missing[ix], created[ix])) success = false;
+            },
+            missing.size()
+        );
+
+        // 查找之后其它线程可能移除了已有的管线, 找不到的当作未命中, 之后单独创建.
+        std::vector<uint64_t> evicted;
+        std::unordered_set<Hash128, Hash128Hasher> evicted_keys;
+        {
+            std::lock_guard lock(_mutex);
+            for (uint64_t ix = 0; ix < missing.size(); ++ix)
+            {
+                if (created[ix] == VK_NULL_HANDLE) continue;
+                if (!_pipelines.emplace(keys[missing[ix]], created[ix]).second) vkDestroyPipeline(_device, created[ix], nullptr);
+            }
+            if (!success)
+            {
+                LOG_ERROR("Create pipelines failed.");
+                return false;
+            }
+
+            for (uint64_t ix = 0; ix < count; ++ix)
+            {
+                auto iter = _pipelines.find(keys[ix]);
+                if (iter != _pipelines.end()) output(ix) = iter->second;
+                else
+                {
+                    evicted.push_back(ix);
+                    evicted_keys.insert(keys[ix]);
+                }
+            }
+        }
+        for (uint64_t ix : evicted)
+        {
+            ReturnIfFalse(get_pipeline(keys[ix], [&](VkPipeline& out_pipeline) { return create(ix, out_pipeline); }, output(ix)));
+        }
+
+        LOG_INFO(
+            "Created " + std::to_string(missing.size() + evicted_keys.size()) + " of " + std::to_string(count) +
+            " pipelines in " + std::to_string(timer.elapsed() * 1000.0f) + " ms."
+        );
+        return true;
+    }
+
+    void PipelineCache::evict(VkPipeline pipeline)
+    {
+        std::lock_guard lock(_mutex);
+        std::erase_if(_pipelines, [pipeline](const auto& pair) { return pair.second == pipeline; });
+    }
+
+    uint64_t PipelineCache::get_pipeline_count() const
+    {
+        std::lock_guard lock(_mutex);
+        return _pipelines.size();
+    }
+
+    bool PipelineCache::create_graphics_pipeline(const GraphicsPipelineDesc& desc, VkPipeline& out_pipeline) const
+    {
+        VkShaderModuleCreateInfo module_create_info{};
+        module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+
+        VkShaderModule vs = VK_NULL_HANDLE;
+        VkShaderModule ps = VK_NULL_HANDLE;
+        module_create_info.codeSize = desc.vs_code.size();
+        module_create_info.pCode = reinterpret_cast<const uint32_t*>(desc.vs_code.data());
+        ReturnIfFalse(vkCreateShaderModule(_device, &module_create_info, nullptr, &vs) == VK_SUCCESS);
+        module_create_info.codeSize = desc.ps_code.size();
+        module_create_info.pCode = reinterpret_cast<const uint32_t*>(desc.ps_code.data());
+        if (vkCreateShaderModule(_device, &module_create_info, nullptr, &ps) != VK_SUCCESS)
+        {
+            vkDestroyShaderModule(_device, vs, nullptr);
+            return false;
+        }
+
+        VkPipelineShaderStageCreateInfo stage_create_infos[2]{};
+        stage_create_infos[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_create_infos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stage_create_infos[0].module = vs;
+        stage_create_infos[0].pName = desc.vs_entry_point.c_str();
+        stage_create_infos[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_create_infos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stage_create_infos[1].module = ps;
+        stage_create_infos[1].pName = desc.ps_entry_point.c_str();
+
+        VkPipelineVertexInputStateCreateInfo vertex_input_create_info{};
+        vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input_create_info.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertex_bindings.size());
+        vertex_input_create_info.pVertexBindingDescriptions = desc.vertex_bindings.data();
+        vertex_input_create_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertex_attributes.size());
+        vertex_input_create_info.pVertexAttributeDescriptions = desc.vertex_attributes.data();
+
+        VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info{};
+        input_assembly_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly_create_info.topology = desc.topology;
+        input_assembly_create_info.primitiveRestartEnable = VK_FALSE;
+
+        // 视口和裁剪矩形是动态状态, 这里只需要数量.
+        VkPipelineViewportStateCreateInfo viewport_create_info{};
+        viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport_create_info.viewportCount = 1;
+        viewport_create_info.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo raster_create_info{};
+        raster_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        raster_create_info.depthClampEnable = VK_FALSE;
+        raster_create_info.rasterizerDiscardEnable = VK_FALSE;
+        raster_create_info.polygonMode = desc.polygon_mode;
+        raster_create_info.lineWidth = 1.0f;
+        raster_create_info.cullMode = desc.cull_mode;
+        raster_create_info.frontFace = desc.front_face;
+        raster_create_info.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisample_create_info{};
+        multisample_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample_create_info.rasterizationSamples = desc.sample_count;
+        multisample_create_info.minSampleShading = 1.0f;
+
+        VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info{};
+        depth_stencil_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth_stencil_create_info.depthTestEnable = desc.depth_test ? VK_TRUE : VK_FALSE;
+        depth_stencil_create_info.depthWriteEnable = desc.depth_write ? VK_TRUE : VK_FALSE;
+        depth_stencil_create_info.depthCompareOp = desc.depth_compare_op;
+
+        VkPipelineColorBlendStateCreateInfo color_blend_create_info{};
+        color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        color_blend_create_info.logicOpEnable = VK_FALSE;
+        color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
+        color_blend_create_info.attachmentCount = static_cast<uint32_t>(desc.blend_attachments.size());
+        color_blend_create_info.pAttachments = desc.blend_attachments.data();
+
+        const VkDynamicState dynamic_states[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamic_state_create_info{};
+        dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state_create_info.dynamicStateCount = 2;
+        dynamic_state_create_info.pDynamicStates = dynamic_states;
+
+        VkGraphicsPipelineCreateInfo pipeline_create_info{};
+        pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipeline_create_info.stageCount = 2;
+        pipeline_create_info.pStages = stage_create_infos;
+        pipeline_create_info.pVertexInputState = &vertex_input_create_info;
+        pipeline_create_info.pInputAssemblyState = &input_assembly_create_info;
+        pipeline_create_info.pViewportState = &viewport_create_info;
+        pipeline_create_info.pRasterizationState = &raster_create_info;
+        pipeline_create_info.pMultisampleState = &multisample_create_info;
+        pipeline_create_info.pDepthStencilState = &depth_stencil_create_info;
+        pipeline_create_info.pColorBlendState = &color_blend_create_info;
+        pipeline_create_info.pDynamicState = &dynamic_state_create_info;
+        pipeline_create_info.layout = desc.layout;
+        pipeline_create_info.renderPass = desc.render_pass;
+        pipeline_create_info.subpass = desc.subpass;
+
+        const VkResult result = vkCreateGraphicsPipelines(_device, _pipeline_cache, 1, &pipeline_create_info, nullptr, &out_pipeline);
+
+        // 管线创建完成后不再需要着色器模块.
+        vkDestroyShaderModule(_device, vs, nullptr);
+        vkDestroyShaderModule(_device, ps, nullptr);
+        return result == VK_SUCCESS;
+    }
+
+    bool PipelineCache::create_compute_pipeline(const ComputePipelineDesc& desc, VkPipeline& out_pipeline) const
+    {
+        VkShaderModuleCreateInfo module_create_info{};
+        module_create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_create_info.codeSize = desc.cs_code.size();
+        module_create_info.pCode = reinterpret_cast<const uint32_t*>(desc.cs_code.data());
+
+        VkShaderModule cs = VK_NULL_HANDLE;
+        ReturnIfFalse(vkCreateShaderModule(_device, &module_create_info, nullptr, &cs) == VK_SUCCESS);
+
+        VkComputePipelineCreateInfo pipeline_create_info{};
+        pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeline_create_info.stage.module = cs;
+        pipeline_create_info.stage.pName = desc.cs_entry_point.c_str();
+        pipeline_create_info.layout = desc.layout;
+
+        const VkResult result = vkCreateComputePipelines(_device, _pipeline_cache, 1, &pipeline_create_info, nullptr, &out_pipeline);
+
+        vkDestroyShaderModule(_device, cs, nullptr);
+        return result == VK_SUCCESS;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef GPU_PIPELINE_CACHE_H
+#define GPU_PIPELINE_CACHE_H
+
+#include "../core/tools/hash_table.h"
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy
+{
+    // 图形管线的完整状态. 着色器按字节码内容参与哈希, 字节码在创建期间必须有效.
+    // 管线布局和渲染流程按句柄参与哈希, 只在本次运行内有效, 跨运行的复用由 VkPipelineCache 完成.
+    struct GraphicsPipelineDesc
+    {
+        std::span<const uint8_t> vs_code;
+        std::string vs_entry_point = "main";
+        std::span<const uint8_t> ps_code;
+        std::string ps_entry_point = "main";
+
+        std::vector<VkVertexInputBindingDescription> vertex_bindings;
+        std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+        VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+        VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        VkSampleCountFlagBits sample_count = VK_SAMPLE_COUNT_1_BIT;
+
+        bool depth_test = false;
+        bool depth_write = false;
+        VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+        // 每个颜色附着一个.
+        std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+    };
+
+    struct ComputePipelineDesc
+    {
+        std::span<const uint8_t> cs_code;
+        std::string cs_entry_point = "main";
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+    };
+
+    // 管线子系统. 完整管线状态的 hash 作为键, 内存中缓存键到 VkPipeline 的映射, 同样的状态只创建一次.
+    // 驱动的 VkPipelineCache 数据在退出时写入磁盘, 启动时校验文件头 (设备, 驱动版本, 数据 hash) 后恢复,
+    // 使下次启动时创建管线不再需要重新编译着色器.
+    // 所有接口都可以多线程调用. create_pipelines() 的 parallel_for 不经过线程池共享的 future 列表,
+    // 在线程池的任务中调用时在当前线程依次创建.
+    class PipelineCache
+    {
+    public:
+        bool initialize(VkPhysicalDevice physical_device, VkDevice device, const std::string& cache_path);
+
+        // 保存缓存数据并销毁所有管线.
+        void destroy();
+
+        // 把当前的缓存数据写入磁盘, 先写临时文件再替换, 中途退出不会损坏旧文件.
+        bool save() const;
+
+        static Hash128 get_key(const GraphicsPipelineDesc& desc);
+        static Hash128 get_key(const ComputePipelineDesc& desc);
+
+        // 已经存在时直接返回. 返回的管线归 PipelineCache 所有.
+        bool get_graphics_pipeline(const GraphicsPipelineDesc& desc, VkPipeline& out_pipeline);
+        bool get_compute_pipeline(const ComputePipelineDesc& desc, VkPipeline& out_pipeline);
+
+        // 在线程池上并行创建还不存在的图形和计算管线, 输出与 desc 一一对应.
+        bool create_pipelines(
+            std::span<const GraphicsPipelineDesc> graphics_descs,
+            std::span<VkPipeline> out_graphics_pipelines,
+            std::span<const ComputePipelineDesc> compute_descs,
+            std::span<VkPipeline> out_compute_pipelines
+        );
+
+        // 从缓存中移除但不销毁, 由调用者在 GPU 不再使用后销毁, 用于热重载替换管线.
+        void evict(VkPipeline pipeline);
+
+        uint64_t get_pipeline_count() const;
+
+    private:
+        bool load_cache_data(std::vector<uint8_t>& out_data) const;
+        bool get_pipeline(const Hash128& key, const std::function<bool(VkPipeline&)>& create_func, VkPipeline& out_pipeline);
+        bool create_graphics_pipeline(const GraphicsPipelineDesc& desc, VkPipeline& out_pipeline) const;
+        bool create_compute_pipeline(const ComputePipelineDesc& desc, VkPipeline& out_pipeline) const;
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties _device_properties{};
+        std::string _cache_path;
+
+        VkPipelineCache _pipeline_cache = VK_NULL_HANDLE;   // 驱动保证内部同步, 可以多线程同时使用.
+
+        mutable std::mutex _mutex;
+        std::unordered_map<Hash128, VkPipeline, Hash128Hasher> _pipelines;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,515 @@
+#include "render_graph.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+
+namespace fantasy
+{
+    struct UsageInfo
+    {
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        VkImageLayout layout;       // 只对图像有效.
+        bool write;
+    };
+
+    static constexpr VkPipelineStageFlags2 FRAGMENT_TESTS_STAGES =
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    static constexpr VkPipelineStageFlags2 GRAPHICS_SHADER_STAGES =
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+
+    // 屏障的源访问类型只需要写入, 读取不需要使其可用.
+    static constexpr VkAccessFlags2 WRITE_ACCESS =
+        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+        VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+    // 按 RenderGraphUsage 的顺序排列.
+    static constexpr UsageInfo usage_infos[] = {
+        { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true },
+        { FRAGMENT_TESTS_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true },
+        { FRAGMENT_TESTS_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false },
+        { GRAPHICS_SHADER_STAGES, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false },
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false },
+        { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true },
+        { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false },
+        { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true },
+        { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+        { GRAPHICS_SHADER_STAGES | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false },
+    };
+    static_assert(std::size(usage_infos) == static_cast<size_t>(RenderGraphUsage::Count));
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // FNV-1a, 只用于判断声明是否改变.
+    class DeclarationHasher
+    {
+    public:
+        template <typename T>
+        void add(const T& value)
+        {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+            for (size_t ix = 0; ix < sizeof(T); ++ix)
+            {
+                _hash = (_hash ^ bytes[ix]) * 1099511628211ull;
+            }
+        }
+
+        uint64_t get() const { return _hash; }
+
+    private:
+        uint64_t _hash = 14695981039346656037ull;
+    };
+
+    void RenderGraph::reset()
+    {
+        _resources.clear();
+        _passes.clear();
+    }
+
+    RenderGraphHandle RenderGraph::create_texture(std::string name, const RenderGraphTextureDesc& desc)
+    {
+        Resource& resource = _resources.emplace_back();
+        resource.name = std::move(name);
+        resource.image = true;
+        resource.texture_desc = desc;
+        return RenderGraphHandle{ static_cast<uint32_t>(_resources.size() - 1) };
+    }
+
+    RenderGraphHandle RenderGraph::create_buffer(std::string name, const RenderGraphBufferDesc& desc)
+    {
+        Resource& resource = _resources.emplace_back();
+        resource.name = std::move(name);
+        resource.buffer_desc = desc;
+        return RenderGraphHandle{ static_cast<uint32_t>(_resources.size() - 1) };
+    }
+
+    RenderGraphHandle RenderGraph::import_texture(
+        std::string name,
+        const RenderGraphTextureDesc& desc,
+        const RenderGraphResourceState& initial_state,
+        const RenderGraphResourceState& final_state
+    )
+    {
+        RenderGraphHandle handle = create_texture(std::move(name), desc);
+        Resource& resource = _resources[handle.index];
+        resource.imported = true;
+        resource.initial_state = initial_state;
+        resource.final_state = final_state;
+        return handle;
+    }
+
+    RenderGraphHandle RenderGraph::import_buffer(
+        std::string name,
+        const RenderGraphBufferDesc& desc,
+        const RenderGraphResourceState& initial_state,
+        const RenderGraphResourceState& final_state
+    )
+    {
+        RenderGraphHandle handle = create_buffer(std::move(name), desc);
+        Resource& resource = _resources[handle.index];
+        resource.imported = true;
+        resource.initial_state = initial_state;
+        resource.final_state = final_state;
+        return handle;
+    }
+
+    uint32_t RenderGraph::add_pass(std::string name, ExecuteFunc func, bool side_effect)
+    {
+        Pass& pass = _passes.emplace_back();
+        pass.name = std::move(name);
+        pass.func = std::move(func);
+        pass.side_effect = side_effect;
+        return static_cast<uint32_t>(_passes.size() - 1);
+    }
+
+    bool RenderGraph::read(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        return add_access(pass, resource, usage, false);
+    }
+
+    bool RenderGraph::write(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage)
+    {
+        return add_access(pass, resource, usage, true);
+    }
+
+    bool RenderGraph::add_access(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage, bool write)
+    {
+        if (pass >= _passes.size() || resource.index >= _resources.size() || usage >= RenderGraphUsage::Count)
+        {
+            LOG_ERROR("Invalid render graph access.");
+            return false;
+        }
+        if (usage_infos[static_cast<uint32_t>(usage)].write != write)
+        {
+            LOG_ERROR("Render graph pass " + _passes[pass].name + " uses " + _resources[resource.index].name + " with mismatched read/write usage.");
+            return false;
+        }
+
+        _passes[pass].accesses.push_back(Access{ .resource = resource.index, .usage = usage, .write = write });
+        return true;
+    }
+
+    bool RenderGraph::compile(const MemoryQuery& memory_query, bool& out_rebuilt)
+    {
+        out_rebuilt = false;
+
+        const uint64_t hash = hash_declaration();
+        if (_plan_valid && hash == _plan_hash) return true;
+
+        _plan = RenderGraphPlan{};
+        _plan_valid = false;
+
+        std::vector<uint32_t> alive_passes;
+        cull_passes(alive_passes);
+
+        _plan.placements.resize(_resources.size());
+        for (uint32_t step = 0; step < alive_passes.size(); ++step)
+        {
+            _plan.steps.push_back(RenderGraphPlan::Step{ .pass = alive_passes[step] });
+            for (const auto& access : _passes[alive_passes[step]].accesses)
+            {
+                auto& placement = _plan.placements[access.resource];
+                placement.first_step = std::min(placement.first_step, step);
+                placement.last_step = std::max(placement.last_step, step);
+            }
+        }
+
+        ReturnIfFalse(place_transient_resources(memory_query));
+        ReturnIfFalse(build_barriers());
+
+        _plan_hash = hash;
+        _plan_valid = true;
+        out_rebuilt = true;
+        return true;
+    }
+
+    uint64_t RenderGraph::hash_declaration() const
+    {
+        // 名字和执行函数不影响执行计划, 不参与哈希.
+        DeclarationHasher hasher;
+        hasher.add(_resources.size());
+        for (const auto& resource : _resources)
+        {
+            hasher.add(resource.image);
+            hasher.add(resource.imported);
+            if (resource.image)
+            {
+                const auto& desc = resource.texture_desc;
+                hasher.add(desc.width);
+                hasher.add(desc.height);
+                hasher.add(desc.mip_count);
+                hasher.add(desc.array_size);
+                hasher.add(desc.format);
+                hasher.add(desc.usage);
+                hasher.add(desc.aspect);
+            }
+            else
+            {
+                hasher.add(resource.buffer_desc.size);
+                hasher.add(resource.buffer_desc.usage);
+            }
+            for (const auto* state : { &resource.initial_state, &resource.final_state })
+            {
+                hasher.add(state->stages);
+                hasher.add(state->access);
+                hasher.add(state->layout);
+            }
+        }
+
+        hasher.add(_passes.size());
+        for (const auto& pass : _passes)
+        {
+            hasher.add(pass.side_effect);
+            hasher.add(pass.accesses.size());
+            for (const auto& access : pass.accesses)
+            {
+                hasher.add(access.resource);
+                hasher.add(access.usage);
+                hasher.add(access.write);
+            }
+        }
+        return hasher.get();
+    }
+
+    void RenderGraph::cull_passes(std::vector<uint32_t>& out_alive_passes) const
+    {
+        // 从后往前, 外部资源和被存活 pass 读取的资源是需要的, 写入需要的资源或有副作用的 pass 存活.
+        // 写入不会让资源变为不需要, 后面的 pass 可能只写入部分内容 (如 LOAD_OP_LOAD), 保守地保留之前的写入者.
+        std::vector<bool> needed(_resources.size(), false);
+        for (uint32_t ix = 0; ix < _resources.size(); ++ix)
+        {
+            needed[ix] = _resources[ix].imported;
+        }
+
+        std::vector<bool> alive(_passes.size(), false);
+        for (uint32_t ix = static_cast<uint32_t>(_passes.size()); ix-- > 0;)
+        {
+            const Pass& pass = _passes[ix];
+
+            alive[ix] = pass.side_effect;
+            for (const auto& access : pass.accesses)
+            {
+                if (access.write && needed[access.resource]) alive[ix] = true;
+            }
+            if (!alive[ix]) continue;
+
+            for (const auto& access : pass.accesses)
+            {
+                if (!access.write) needed[access.resource] = true;
+            }
+        }
+
+        for (uint32_t ix = 0; ix < _passes.size(); ++ix)
+        {
+            if (alive[ix]) out_alive_passes.push_back(ix);
+        }
+    }
+
+    bool RenderGraph::place_transient_resources(const MemoryQuery& memory_query)
+    {
+        std::vector<VkMemoryRequirements> requirements(_resources.size());
+        std::vector<uint32_t> transients;
+        for (uint32_t ix = 0; ix < _resources.size(); ++ix)
+        {
+            if (_resources[ix].imported || _plan.placements[ix].first_step == ~0u) continue;
+
+            ReturnIfFalse(memory_query(ix, requirements[ix]));
+            transients.push_back(ix);
+        }
+
+        // 先放大的资源, 小资源更容易填进大资源之间的空隙.
+        std::stable_sort(
+            transients.begin(),
+            transients.end(),
+            [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; }
+        );
+
+        auto lifetime_overlap = [this](uint32_t a, uint32_t b)
+        {
+            const auto& pa = _plan.placements[a];
+            const auto& pb = _plan.placements[b];
+            return pa.first_step <= pb.last_step && pb.first_step <= pa.last_step;
+        };
+
+        std::vector<std::vector<uint32_t>> heap_members;
+        for (uint32_t resource : transients)
+        {
+            const VkMemoryRequirements& requirement = requirements[resource];
+            const bool image = _resources[resource].image;
+
+            uint32_t heap_index = 0;
+            for (; heap_index < _plan.heaps.size(); ++heap_index)
+            {
+                const auto& heap = _plan.heaps[heap_index];
+                if (heap.image == image && (heap.memory_type_bits & requirement.memoryTypeBits) != 0) break;
+            }
+            if (heap_index == _plan.heaps.size())
+            {
+                _plan.heaps.push_back(RenderGraphHeap{ .image = image });
+                heap_members.emplace_back();
+            }
+
+            // 与生命周期重叠的资源按偏移排序, 找第一个放得下的空隙, heap 可以增长所以一定能放下.
+            std::vector<std::pair<VkDeviceSize, VkDeviceSize>> ranges;
+            for (uint32_t member : heap_members[heap_index])
+            {
+                if (!lifetime_overlap(resource, member)) continue;
+                const VkDeviceSize offset = _plan.placements[member].offset;
+                ranges.emplace_back(offset, offset + requirements[member].size);
+            }
+            std::sort(ranges.begin(), ranges.end());
+
+            VkDeviceSize offset = 0;
+            for (const auto& [begin, end] : ranges)
+            {
+                if (align_up(offset, requirement.alignment) + requirement.size <= begin) break;
+                offset = std::max(offset, end);
+            }
+            offset = align_up(offset, requirement.alignment);
+
+            auto& heap = _plan.heaps[heap_index];
+            heap.size = std::max(heap.size, offset + requirement.size);
+            heap.alignment = std::max(heap.alignment, requirement.alignment);
+            heap.memory_type_bits &= requirement.memoryTypeBits;
+
+            _plan.placements[resource].heap = heap_index;
+            _plan.placements[resource].offset = offset;
+            _plan.placements[resource].size = requirement.size;
+            heap_members[heap_index].push_back(resource);
+        }
+        return true;
+    }
+
+    bool RenderGraph::build_barriers()
+    {
+        struct TrackedState
+        {
+            VkPipelineStageFlags2 write_stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+
+            // 上次写入之后已经通过屏障可见的阶段和访问类型, 其它读取者还需要屏障.
+            VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 visible_access = VK_ACCESS_2_NONE;
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        };
+
+        // 每个资源在一帧内所有用途的并集, 作为下一帧 (或共用内存的下一个资源) 首次使用时要等待的操作.
+        std::vector<VkPipelineStageFlags2> used_stages(_resources.size(), VK_PIPELINE_STAGE_2_NONE);
+        std::vector<VkAccessFlags2> written_access(_resources.size(), VK_ACCESS_2_NONE);
+        for (const auto& step : _plan.steps)
+        {
+            for (const auto& access : _passes[step.pass].accesses)
+            {
+                const UsageInfo& info = usage_infos[static_cast<uint32_t>(access.usage)];
+                used_stages[access.resource] |= info.stages;
+                written_access[access.resource] |= info.access & WRITE_ACCESS;
+            }
+        }
+
+        std::vector<TrackedState> states(_resources.size());
+        for (uint32_t ix = 0; ix < _resources.size(); ++ix)
+        {
+            const Resource& resource = _resources[ix];
+            TrackedState& state = states[ix];
+            if (resource.imported)
+            {
+                state.write_stages = resource.initial_state.stages;
+                state.write_access = resource.initial_state.access;
+                state.layout = resource.initial_state.layout;
+                continue;
+            }
+
+            // 临时资源的内容从不保留, 但之前帧和共用内存的资源对这块内存的访问必须先完成.
+            const auto& placement = _plan.placements[ix];
+            if (placement.heap == ~0u) continue;
+            for (uint32_t other = 0; other < _resources.size(); ++other)
+            {
+                const auto& other_placement = _plan.placements[other];
+                if (other_placement.heap != placement.heap ||
+                    other_placement.offset >= placement.offset + placement.size ||
+                    placement.offset >= other_placement.offset + other_placement.size)
+                {
+                    continue;
+                }
+                state.write_stages |= used_stages[other];
+                state.write_access |= written_access[other];
+            }
+        }
+
+        auto add_barrier = [this](uint32_t resource, const TrackedState& state, VkPipelineStageFlags2 src_stages, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access, VkImageLayout new_layout)
+        {
+            _plan.barriers.push_back(RenderGraphBarrier{
+                .resource = resource,
+                .src_stages = src_stages,
+                .src_access = state.write_access,
+                .dst_stages = dst_stages,
+                .dst_access = dst_access,
+                .old_layout = state.layout,
+                .new_layout = new_layout
+            });
+        };
+
+        for (auto& step : _plan.steps)
+        {
+            step.barrier_offset = static_cast<uint32_t>(_plan.barriers.size());
+
+            // 同一个 pass 对同一个资源的多次访问合并, 图像的布局必须一致.
+            std::vector<Access> accesses;
+            std::vector<UsageInfo> merged_infos;
+            for (const auto& access : _passes[step.pass].accesses)
+            {
+                const UsageInfo& info = usage_infos[static_cast<uint32_t>(access.usage)];
+                auto iter = std::find_if(accesses.begin(), accesses.end(), [&](const Access& a) { return a.resource == access.resource; });
+                if (iter == accesses.end())
+                {
+                    accesses.push_back(access);
+                    merged_infos.push_back(info);
+                    continue;
+                }
+
+                UsageInfo& merged = merged_infos[iter - accesses.begin()];
+                if (_resources[access.resource].image && merged.layout != info.layout)
+                {
+                    LOG_ERROR("Render graph pass " + _passes[step.pass].name + " uses " + _resources[access.resource].name + " in two image layouts.");
+                    return false;
+                }
+                merged.stages |= info.stages;
+                merged.access |= info.access;
+                merged.write = merged.write || info.write;
+                iter->write = iter->write || access.write;
+            }
+
+            for (uint32_t ix = 0; ix < accesses.size(); ++ix)
+            {
+                const uint32_t resource = accesses[ix].resource;
+                const UsageInfo& info = merged_infos[ix];
+                TrackedState& state = states[resource];
+
+                const bool image = _resources[resource].image;
+                const VkImageLayout layout = image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                const bool transition = image && layout != state.layout;
+
+                if (info.write)
+                {
+                    // 写后写, 读后写都需要等待, 读后写只需要执行依赖.
+                    const VkPipelineStageFlags2 src_stages = state.write_stages | state.read_stages;
+                    if (transition || src_stages != VK_PIPELINE_STAGE_2_NONE)
+                    {
+                        add_barrier(resource, state, src_stages, info.stages, info.access, layout);
+                    }
+                    state = TrackedState{ .write_stages = info.stages, .write_access = info.access & WRITE_ACCESS, .layout = layout };
+                }
+                else if (transition)
+                {
+                    // 布局转换本身是一次写入, 之前的读取也要等待. 之后的读取者经由这次的目标阶段链式依赖转换.
+                    add_barrier(resource, state, state.write_stages | state.read_stages, info.stages, info.access, layout);
+                    state.write_stages |= info.stages;
+                    state.read_stages |= info.stages;
+                    state.visible_stages = info.stages;
+                    state.visible_access = info.access;
+                    state.layout = layout;
+                }
+                else
+                {
+                    // 读后读不需要屏障, 除非上次写入对这次的阶段或访问类型还不可见.
+                    const bool invisible = (info.stages & ~state.visible_stages) || (info.access & ~state.visible_access);
+                    if (state.write_access != VK_ACCESS_2_NONE && invisible)
+                    {
+                        add_barrier(resource, state, state.write_stages, info.stages, info.access, layout);
+                        state.visible_stages |= info.stages;
+                        state.visible_access |= info.access;
+                    }
+                    state.read_stages |= info.stages;
+                }
+            }
+
+            step.barrier_count = static_cast<uint32_t>(_plan.barriers.size()) - step.barrier_offset;
+        }
+
+        _plan.final_barrier_offset = static_cast<uint32_t>(_plan.barriers.size());
+        for (uint32_t ix = 0; ix < _resources.size(); ++ix)
+        {
+            const Resource& resource = _resources[ix];
+            if (!resource.imported) continue;
+
+            const RenderGraphResourceState& final_state = resource.final_state;
+            const TrackedState& state = states[ix];
+
+            // 最终布局为 UNDEFINED 表示保持图执行后的布局.
+            const VkImageLayout layout = resource.image && final_state.layout != VK_IMAGE_LAYOUT_UNDEFINED ? final_state.layout : state.layout;
+            if (layout == state.layout && final_state.stages == VK_PIPELINE_STAGE_2_NONE) continue;
+
+            add_barrier(ix, state, state.write_stages | state.read_stages, final_state.stages, final_state.access, layout);
+        }
+        _plan.final_barrier_count = static_cast<uint32_t>(_plan.barriers.size()) - _plan.final_barrier_offset;
+        return true;
+    }
+}
@@ -0,0 +1,215 @@
+#ifndef GPU_RENDER_GRAPH_H
+#define GPU_RENDER_GRAPH_H
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace fantasy
+{
+    // 资源在 pass 中的用途, 决定管线阶段, 访问类型和图像布局.
+    enum class RenderGraphUsage : uint8_t
+    {
+        ColorAttachment,
+        DepthAttachment,
+        DepthRead,
+        GraphicsShaderRead,
+        ComputeShaderRead,
+        ComputeStorageRead,
+        ComputeStorageWrite,
+        TransferSrc,
+        TransferDst,
+        VertexBuffer,
+        IndexBuffer,
+        IndirectBuffer,
+        UniformBuffer,
+
+        Count
+    };
+
+    struct RenderGraphTextureDesc
+    {
+        uint32_t width = 1;
+        uint32_t height = 1;
+        uint32_t mip_count = 1;
+        uint32_t array_size = 1;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    struct RenderGraphBufferDesc
+    {
+        VkDeviceSize size = 0;
+        VkBufferUsageFlags usage = 0;
+    };
+
+    // 外部资源在图执行之前和之后的状态.
+    struct RenderGraphResourceState
+    {
+        VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct RenderGraphHandle
+    {
+        static constexpr uint32_t INVALID_INDEX = ~0u;
+
+        uint32_t index = INVALID_INDEX;
+
+        bool valid() const { return index != INVALID_INDEX; }
+    };
+
+    struct RenderGraphBarrier
+    {
+        uint32_t resource = 0;
+        VkPipelineStageFlags2 src_stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+        VkPipelineStageFlags2 dst_stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 dst_access = VK_ACCESS_2_NONE;
+        VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout new_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    // 生命周期不重叠的临时资源共用一块内存, 同一个 heap 内的资源类型 (buffer 或 image) 相同.
+    struct RenderGraphHeap
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memory_type_bits = ~0u;
+        bool image = false;
+    };
+
+    // 编译结果, 只有图的声明改变时才重新生成.
+    struct RenderGraphPlan
+    {
+        struct Step
+        {
+            uint32_t pass = 0;
+            uint32_t barrier_offset = 0;    // 该 pass 之前要执行的屏障, 合并为一次 vkCmdPipelineBarrier2.
+            uint32_t barrier_count = 0;
+        };
+
+        struct Placement
+        {
+            uint32_t heap = ~0u;            // 外部资源和被剔除的资源没有 heap.
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = 0;
+            uint32_t first_step = ~0u;
+            uint32_t last_step = 0;
+        };
+
+        std::vector<Step> steps;
+        std::vector<RenderGraphBarrier> barriers;
+        uint32_t final_barrier_offset = 0;  // 所有 pass 之后把外部资源转换到最终状态.
+        uint32_t final_barrier_count = 0;
+
+        std::vector<RenderGraphHeap> heaps;
+        std::vector<Placement> placements;  // 按资源下标.
+    };
+
+    // 执行时资源下标到实际对象的映射.
+    struct RenderGraphRegistry
+    {
+        std::vector<VkImage> images;
+        std::vector<VkImageView> image_views;
+        std::vector<VkBuffer> buffers;
+    };
+
+    // 帧渲染图. 每帧重新声明资源和 pass, pass 声明对资源的读写, 编译时剔除结果无人使用的 pass,
+    // 计算 pass 之间最少的屏障, 并让生命周期不重叠的临时资源共用内存.
+    // 声明与上次编译时相同时直接复用执行计划. 编译本身不调用 Vulkan, 可以脱离 GPU 测试.
+    class RenderGraph
+    {
+    public:
+        using ExecuteFunc = std::function<bool(VkCommandBuffer cmd_buffer, const RenderGraphRegistry& registry)>;
+
+        // 查询临时资源的内存需求, 只对未被剔除的临时资源调用.
+        using MemoryQuery = std::function<bool(uint32_t resource, VkMemoryRequirements& out_requirements)>;
+
+        struct Resource
+        {
+            std::string name;
+            bool image = false;
+            bool imported = false;
+            RenderGraphTextureDesc texture_desc;
+            RenderGraphBufferDesc buffer_desc;
+            RenderGraphResourceState initial_state;
+            RenderGraphResourceState final_state;
+        };
+
+        struct Access
+        {
+            uint32_t resource = 0;
+            RenderGraphUsage usage = RenderGraphUsage::Count;
+            bool write = false;
+        };
+
+        struct Pass
+        {
+            std::string name;
+            ExecuteFunc func;
+            bool side_effect = false;       // 即使输出没有被使用也不剔除, 如回读数据到 CPU.
+            std::vector<Access> accesses;
+        };
+
+        // 清空声明, 保留上次的执行计划.
+        void reset();
+
+        RenderGraphHandle create_texture(std::string name, const RenderGraphTextureDesc& desc);
+        RenderGraphHandle create_buffer(std::string name, const RenderGraphBufferDesc& desc);
+        RenderGraphHandle import_texture(
+            std::string name,
+            const RenderGraphTextureDesc& desc,
+            const RenderGraphResourceState& initial_state,
+            const RenderGraphResourceState& final_state
+        );
+        RenderGraphHandle import_buffer(
+            std::string name,
+            const RenderGraphBufferDesc& desc,
+            const RenderGraphResourceState& initial_state,
+            const RenderGraphResourceState& final_state
+        );
+
+        uint32_t add_pass(std::string name, ExecuteFunc func, bool side_effect = false);
+        bool read(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage);
+        bool write(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage);
+
+        // out_rebuilt 为 true 时执行计划已经重新生成, 临时资源需要重新创建.
+        bool compile(const MemoryQuery& memory_query, bool& out_rebuilt);
+
+        // 执行计划对应的资源创建失败时调用, 下次 compile 会重新生成.
+        void invalidate() { _plan_valid = false; }
+
+        const RenderGraphPlan& get_plan() const { return _plan; }
+        const std::vector<Resource>& get_resources() const { return _resources; }
+        const std::vector<Pass>& get_passes() const { return _passes; }
+
+    private:
+        bool add_access(uint32_t pass, RenderGraphHandle resource, RenderGraphUsage usage, bool write);
+        uint64_t hash_declaration() const;
+
+        void cull_passes(std::vector<uint32_t>& out_alive_passes) const;
+        bool place_transient_resources(const MemoryQuery& memory_query);
+        bool build_barriers();
+
+    private:
+        std::vector<Resource> _resources;
+        std::vector<Pass> _passes;
+
+        RenderGraphPlan _plan;
+        uint64_t _plan_hash = 0;
+        bool _plan_valid = false;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
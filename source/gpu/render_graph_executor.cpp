@@ -0,0 +1,292 @@
+#include "render_graph_executor.h"
+#include "../core/tools/log.h"
+
+namespace fantasy
+{
+    bool RenderGraphExecutor::initialize(VkDevice device, GpuMemoryAllocator* allocator)
+    {
+        _device = device;
+        _allocator = allocator;
+        return true;
+    }
+
+    void RenderGraphExecutor::destroy()
+    {
+        if (_device == VK_NULL_HANDLE) return;
+
+        destroy_transient_resources(_transients);
+        for (auto& transients : _retired_transients) destroy_transient_resources(transients);
+        _retired_transients.clear();
+        _device = VK_NULL_HANDLE;
+    }
+
+    void RenderGraphExecutor::begin_frame(uint64_t frame_index)
+    {
+        _frame_index = frame_index;
+
+        // 退役之后又过了 NUM_FRAMES_IN_FLIGHT 帧, 使用过它们的指令一定已经执行完.
+        std::erase_if(
+            _retired_transients,
+            [this](TransientResources& transients)
+            {
+                if (_frame_index < transients.retire_frame + NUM_FRAMES_IN_FLIGHT) return false;
+                destroy_transient_resources(transients);
+                return true;
+            }
+        );
+    }
+
+    void RenderGraphExecutor::bind_image(RenderGraphHandle handle, VkImage image, VkImageView image_view)
+    {
+        if (handle.index >= _imported.images.size())
+        {
+            _imported.images.resize(handle.index + 1, VK_NULL_HANDLE);
+            _imported.image_views.resize(handle.index + 1, VK_NULL_HANDLE);
+        }
+        _imported.images[handle.index] = image;
+        _imported.image_views[handle.index] = image_view;
+    }
+
+    void RenderGraphExecutor::bind_buffer(RenderGraphHandle handle, VkBuffer buffer)
+    {
+        if (handle.index >= _imported.buffers.size()) _imported.buffers.resize(handle.index + 1, VK_NULL_HANDLE);
+        _imported.buffers[handle.index] = buffer;
+    }
+
+    bool RenderGraphExecutor::execute(RenderGraph& graph, VkCommandBuffer cmd_buffer)
+    {
+        const auto& resources = graph.get_resources();
+
+        // 只有重新编译时才会查询内存需求, 新的临时资源先创建在 pending 中.
+        // 复用执行计划的帧不分配 pending, 重新编译时才按资源数量分配.
+        TransientResources pending;
+        auto allocate_pending = [&]()
+        {
+            if (pending.images.size() == resources.size()) return;
+            pending.images.resize(resources.size(), VK_NULL_HANDLE);
+            pending.image_views.resize(resources.size(), VK_NULL_HANDLE);
+            pending.buffers.resize(resources.size(), VK_NULL_HANDLE);
+        };
+
+        bool rebuilt = false;
+        const bool compiled = graph.compile(
+            [&](uint32_t resource, VkMemoryRequirements& out_requirements)
+            {
+                allocate_pending();
+                return create_transient_resource(resources[resource], resource, pending, out_requirements);
+            },
+            rebuilt
+        );
+        // 没有临时资源时不会查询内存需求, 但注册表仍然需要按资源数量分配.
+        if (rebuilt) allocate_pending();
+        if (!compiled || (rebuilt && !bind_transient_memory(graph, pending)))
+        {
+            destroy_transient_resources(pending);
+            graph.invalidate();
+            return false;
+        }
+
+        if (rebuilt)
+        {
+            _transients.retire_frame = _frame_index;
+            _retired_transients.push_back(std::move(_transients));
+            _transients = std::move(pending);
+        }
+
+        _registry.images = _transients.images;
+        _registry.image_views = _transients.image_views;
+        _registry.buffers = _transients.buffers;
+        for (uint32_t ix = 0; ix < resources.size(); ++ix)
+        {
+            if (!resources[ix].imported) continue;
+
+            const bool bound = resources[ix].image ?
+                ix < _imported.images.size() && _imported.images[ix] != VK_NULL_HANDLE :
+                ix < _imported.buffers.size() && _imported.buffers[ix] != VK_NULL_HANDLE;
+            if (!bound)
+            {
+                LOG_ERROR("Render graph resource " + resources[ix].name + " is imported but not bound.");
+                return false;
+            }
+            if (resources[ix].image)
+            {
+                _registry.images[ix] = _imported.images[ix];
+                _registry.image_views[ix] = _imported.image_views[ix];
+            }
+            else
+            {
+                _registry.buffers[ix] = _imported.buffers[ix];
+            }
+        }
+
+        const RenderGraphPlan& plan = graph.get_plan();
+        const auto& passes = graph.get_passes();
+        for (const auto& step : plan.steps)
+        {
+            record_barriers(cmd_buffer, graph, step.barrier_offset, step.barrier_count);
+
+            const auto& pass = passes[step.pass];
+            if (pass.func && !pass.func(cmd_buffer, _registry))
+            {
+                LOG_ERROR("Render graph pass " + pass.name + " failed.");
+                return false;
+            }
+        }
+        record_barriers(cmd_buffer, graph, plan.final_barrier_offset, plan.final_barrier_count);
+        return true;
+    }
+
+    bool RenderGraphExecutor::create_transient_resource(
+        const RenderGraph::Resource& resource,
+        uint32_t index,
+        TransientResources& transients,
+        VkMemoryRequirements& out_requirements
+    )
+    {
+        if (resource.image)
+        {
+            const RenderGraphTextureDesc& desc = resource.texture_desc;
+
+            VkImageCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            create_info.imageType = VK_IMAGE_TYPE_2D;
+            create_info.format = desc.format;
+            create_info.extent = { desc.width, desc.height, 1 };
+            create_info.mipLevels = desc.mip_count;
+            create_info.arrayLayers = desc.array_size;
+            create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            create_info.usage = desc.usage;
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            ReturnIfFalse(vkCreateImage(_device, &create_info, nullptr, &transients.images[index]) == VK_SUCCESS);
+            vkGetImageMemoryRequirements(_device, transients.images[index], &out_requirements);
+        }
+        else
+        {
+            VkBufferCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            create_info.size = resource.buffer_desc.size;
+            create_info.usage = resource.buffer_desc.usage;
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ReturnIfFalse(vkCreateBuffer(_device, &create_info, nullptr, &transients.buffers[index]) == VK_SUCCESS);
+            vkGetBufferMemoryRequirements(_device, transients.buffers[index], &out_requirements);
+        }
+        return true;
+    }
+
+    bool RenderGraphExecutor::bind_transient_memory(const RenderGraph& graph, TransientResources& transients)
+    {
+        const RenderGraphPlan& plan = graph.get_plan();
+        const auto& resources = graph.get_resources();
+
+        for (const auto& heap : plan.heaps)
+        {
+            VkMemoryRequirements requirements{};
+            requirements.size = heap.size;
+            requirements.alignment = heap.alignment;
+            requirements.memoryTypeBits = heap.memory_type_bits;
+            ReturnIfFalse(_allocator->allocate(
+                requirements,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                heap.image ? GpuResourceKind::Optimal : GpuResourceKind::Linear,
+                transients.heaps.emplace_back()
+            ));
+        }
+
+        for (uint32_t ix = 0; ix < resources.size(); ++ix)
+        {
+            const auto& placement = plan.placements[ix];
+            if (resources[ix].imported || placement.heap == ~0u) continue;
+
+            const GpuAllocation& heap = transients.heaps[placement.heap];
+            const VkDeviceSize offset = heap.offset + placement.offset;
+            if (!resources[ix].image)
+            {
+                ReturnIfFalse(vkBindBufferMemory(_device, transients.buffers[ix], heap.memory, offset) == VK_SUCCESS);
+                continue;
+            }
+
+            ReturnIfFalse(vkBindImageMemory(_device, transients.images[ix], heap.memory, offset) == VK_SUCCESS);
+
+            const RenderGraphTextureDesc& desc = resources[ix].texture_desc;
+
+            VkImageViewCreateInfo view_create_info{};
+            view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_create_info.image = transients.images[ix];
+            view_create_info.viewType = desc.array_size > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+            view_create_info.format = desc.format;
+            view_create_info.subresourceRange.aspectMask = desc.aspect;
+            view_create_info.subresourceRange.baseMipLevel = 0;
+            view_create_info.subresourceRange.levelCount = desc.mip_count;
+            view_create_info.subresourceRange.baseArrayLayer = 0;
+            view_create_info.subresourceRange.layerCount = desc.array_size;
+            ReturnIfFalse(vkCreateImageView(_device, &view_create_info, nullptr, &transients.image_views[ix]) == VK_SUCCESS);
+        }
+        return true;
+    }
+
+    void RenderGraphExecutor::destroy_transient_resources(TransientResources& transients)
+    {
+        for (auto image_view : transients.image_views) vkDestroyImageView(_device, image_view, nullptr);
+        for (auto image : transients.images) vkDestroyImage(_device, image, nullptr);
+        for (auto buffer : transients.buffers) vkDestroyBuffer(_device, buffer, nullptr);
+        for (auto& heap : transients.heaps) _allocator->release(heap);
+        transients = TransientResources{};
+    }
+
+    void RenderGraphExecutor::record_barriers(VkCommandBuffer cmd_buffer, const RenderGraph& graph, uint32_t offset, uint32_t count)
+    {
+        if (count == 0) return;
+
+        const auto& resources = graph.get_resources();
+        const RenderGraphPlan& plan = graph.get_plan();
+
+        // buffer 没有布局, 全部合并为一个全局内存屏障; 图像各自一个屏障. 整个 step 一次提交.
+        VkMemoryBarrier2 memory_barrier{};
+        memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        bool has_memory_barrier = false;
+
+        _image_barriers.clear();
+        for (uint32_t ix = offset; ix < offset + count; ++ix)
+        {
+            const RenderGraphBarrier& barrier = plan.barriers[ix];
+            const RenderGraph::Resource& resource = resources[barrier.resource];
+            if (!resource.image)
+            {
+                memory_barrier.srcStageMask |= barrier.src_stages;
+                memory_barrier.srcAccessMask |= barrier.src_access;
+                memory_barrier.dstStageMask |= barrier.dst_stages;
+                memory_barrier.dstAccessMask |= barrier.dst_access;
+                has_memory_barrier = true;
+                continue;
+            }
+
+            VkImageMemoryBarrier2& image_barrier = _image_barriers.emplace_back();
+            image_barrier = VkImageMemoryBarrier2{};
+            image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            image_barrier.srcStageMask = barrier.src_stages;
+            image_barrier.srcAccessMask = barrier.src_access;
+            image_barrier.dstStageMask = barrier.dst_stages;
+            image_barrier.dstAccessMask = barrier.dst_access;
+            image_barrier.oldLayout = barrier.old_layout;
+            image_barrier.newLayout = barrier.new_layout;
+            image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.image = _registry.images[barrier.resource];
+            image_barrier.subresourceRange.aspectMask = resource.texture_desc.aspect;
+            image_barrier.subresourceRange.baseMipLevel = 0;
+            image_barrier.subresourceRange.levelCount = resource.texture_desc.mip_count;
+            image_barrier.subresourceRange.baseArrayLayer = 0;
+            image_barrier.subresourceRange.layerCount = resource.texture_desc.array_size;
+        }
+
+        VkDependencyInfo dependency_info{};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.memoryBarrierCount = has_memory_barrier ? 1 : 0;
+        dependency_info.pMemoryBarriers = &memory_barrier;
+        dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(_image_barriers.size());
+        dependency_info.pImageMemoryBarriers = _image_barriers.data();
+        vkCmdPipelineBarrier2(cmd_buffer, &dependency_info);
+    }
+}
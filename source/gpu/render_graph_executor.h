@@ -0,0 +1,65 @@
+#ifndef GPU_RENDER_GRAPH_EXECUTOR_H
+#define GPU_RENDER_GRAPH_EXECUTOR_H
+
+#include "render_graph.h"
+#include "gpu_memory_allocator.h"
+
+namespace fantasy
+{
+    // 按 RenderGraph 的执行计划创建临时资源, 录制屏障并依次执行 pass.
+    // 执行计划重新生成时旧的临时资源在 NUM_FRAMES_IN_FLIGHT 帧之后才销毁, 期间仍可能被 GPU 使用.
+    class RenderGraphExecutor
+    {
+    public:
+        bool initialize(VkDevice device, GpuMemoryAllocator* allocator);
+        void destroy();
+
+        // 等待该帧的 fence 之后调用.
+        void begin_frame(uint64_t frame_index);
+
+        // 外部资源每帧都要绑定实际对象, 如当前的 back buffer.
+        void bind_image(RenderGraphHandle handle, VkImage image, VkImageView image_view);
+        void bind_buffer(RenderGraphHandle handle, VkBuffer buffer);
+
+        // 编译 graph (声明未变时复用执行计划和临时资源), 然后录制进 cmd_buffer.
+        bool execute(RenderGraph& graph, VkCommandBuffer cmd_buffer);
+
+    private:
+        struct TransientResources
+        {
+            std::vector<VkImage> images;            // 按资源下标.
+            std::vector<VkImageView> image_views;
+            std::vector<VkBuffer> buffers;
+            std::vector<GpuAllocation> heaps;
+            uint64_t retire_frame = 0;
+        };
+
+        bool create_transient_resource(const RenderGraph::Resource& resource, uint32_t index, TransientResources& transients, VkMemoryRequirements& out_requirements);
+        bool bind_transient_memory(const RenderGraph& graph, TransientResources& transients);
+        void destroy_transient_resources(TransientResources& transients);
+
+        void record_barriers(VkCommandBuffer cmd_buffer, const RenderGraph& graph, uint32_t offset, uint32_t count);
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        GpuMemoryAllocator* _allocator = nullptr;
+        uint64_t _frame_index = 0;
+
+        TransientResources _transients;
+        std::vector<TransientResources> _retired_transients;
+
+        RenderGraphRegistry _imported;      // bind_image, bind_buffer 绑定的外部资源.
+        RenderGraphRegistry _registry;
+
+        std::vector<VkImageMemoryBarrier2> _image_barriers;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,484 @@
+#include "upload_manager.h"
+#include "../core/tools/log.h"
+#include "../core/math/common.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace fantasy
+{
+    // 覆盖 4, 8, 16 字节的纹素块, 同时满足 vkCmdCopyBufferToImage 对 bufferOffset 的要求.
+    static constexpr VkDeviceSize IMAGE_STAGING_ALIGNMENT = 16;
+    static constexpr VkDeviceSize BUFFER_STAGING_ALIGNMENT = 4;
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool UploadManager::initialize(
+        VkDevice device,
+        GpuMemoryAllocator* allocator,
+        uint32_t queue_family_index,
+        VkQueue queue,
+        uint32_t graphics_queue_family_index,
+        VkDeviceSize ring_size
+    )
+    {
+        _device = device;
+        _allocator = allocator;
+        _queue_family_index = queue_family_index;
+        _queue = queue;
+        _graphics_queue_family_index = graphics_queue_family_index;
+        _ring_size = ring_size;
+
+        VkSemaphoreTypeCreateInfo type_create_info{};
+        type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_create_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_create_info{};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_create_info.pNext = &type_create_info;
+        ReturnIfFalse(vkCreateSemaphore(_device, &semaphore_create_info, nullptr, &_timeline_semaphore) == VK_SUCCESS);
+
+        VkBufferCreateInfo buffer_create_info{};
+        buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_create_info.size = _ring_size;
+        buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ReturnIfFalse(_allocator->create_buffer(
+            buffer_create_info,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            _ring_buffer,
+            _ring_memory
+        ));
+        return true;
+    }
+
+    void UploadManager::destroy()
+    {
+        if (_device == VK_NULL_HANDLE) return;
+
+        wait_idle();
+
+        std::lock_guard lock(_mutex);
+        retire_batches();
+        if (!_submitted_batches.empty()) LOG_ERROR("Upload batches destroyed before completion.");
+
+        auto destroy_batch = [this](UploadBatch& batch)
+        {
+            for (auto& [buffer, memory] : batch.temporary_buffers) _allocator->destroy_buffer(buffer, memory);
+            vkDestroyCommandPool(_device, batch.cmd_pool, nullptr);
+        };
+        for (auto& batch : _submitted_batches) destroy_batch(batch);
+        for (auto& batch : _free_batches) destroy_batch(batch);
+        if (_current_batch.cmd_pool != VK_NULL_HANDLE) destroy_batch(_current_batch);
+        _submitted_batches.clear();
+        _free_batches.clear();
+        _current_batch = UploadBatch{};
+
+        _allocator->destroy_buffer(_ring_buffer, _ring_memory);
+        vkDestroySemaphore(_device, _timeline_semaphore, nullptr);
+        _device = VK_NULL_HANDLE;
+    }
+
+    bool UploadManager::upload_buffer(
+        VkBuffer dst_buffer,
+        VkDeviceSize dst_offset,
+        const void* data,
+        VkDeviceSize size,
+        VkPipelineStageFlags dst_stages,
+        VkAccessFlags dst_access
+    )
+    {
+        if (size == 0) return true;
+
+        StagingRange staging;
+        ReturnIfFalse(reserve_staging(size, BUFFER_STAGING_ALIGNMENT, staging));
+        memcpy(staging.data, data, size);
+
+        std::lock_guard lock(_mutex);
+        const bool recording = begin_batch();
+        commit_staging(staging);
+        ReturnIfFalse(recording);
+
+        VkCommandBuffer cmd_buffer = _current_batch.cmd_buffer;
+
+        VkBufferCopy copy_region{};
+        copy_region.srcOffset = staging.offset;
+        copy_region.dstOffset = dst_offset;
+        copy_region.size = size;
+        vkCmdCopyBuffer(cmd_buffer, staging.buffer, dst_buffer, 1, &copy_region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.buffer = dst_buffer;
+        barrier.offset = dst_offset;
+        barrier.size = size;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        if (ownership_transfer())
+        {
+            // release 屏障的目标阶段在上传队列上无意义, acquire 屏障负责可见性.
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = _queue_family_index;
+            barrier.dstQueueFamilyIndex = _graphics_queue_family_index;
+            vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dst_access;
+            _batch_buffer_barriers.push_back(barrier);
+            _batch_stages |= dst_stages;
+        }
+        else
+        {
+            barrier.dstAccessMask = dst_access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+
+        return true;
+    }
+
+    bool UploadManager::upload_image(
+        VkImage dst_image,
+        VkImageAspectFlags aspect,
+        uint32_t mip_count,
+        std::span<const VkBufferImageCopy> regions,
+        std::span<const uint8_t> data,
+        VkImageLayout final_layout,
+        VkPipelineStageFlags dst_stages,
+        VkAccessFlags dst_access
+    )
+    {
+        if (regions.empty() || data.empty()) return false;
+
+        StagingRange staging;
+        ReturnIfFalse(reserve_staging(data.size(), IMAGE_STAGING_ALIGNMENT, staging));
+        memcpy(staging.data, data.data(), data.size());
+
+        std::lock_guard lock(_mutex);
+        const bool recording = begin_batch();
+        commit_staging(staging);
+        ReturnIfFalse(recording);
+
+        VkCommandBuffer cmd_buffer = _current_batch.cmd_buffer;
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.image = dst_image;
+        barrier.subresourceRange.aspectMask = aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mip_count;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        // 之前的内容直接丢弃, 不需要等待任何操作.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkBufferImageCopy> copies(regions.begin(), regions.end());
+        for (auto& copy : copies) copy.bufferOffset += staging.offset;
+        vkCmdCopyBufferToImage(
+            cmd_buffer,
+            staging.buffer,
+            dst_image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(copies.size()),
+            copies.data()
+        );
+
+        // 布局转换只执行一次, release 和 acquire 屏障的 oldLayout, newLayout 必须一致.
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = final_layout;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        if (ownership_transfer())
+        {
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = _queue_family_index;
+            barrier.dstQueueFamilyIndex = _graphics_queue_family_index;
+            vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = dst_access;
+            _batch_image_barriers.push_back(barrier);
+            _batch_stages |= dst_stages;
+        }
+        else
+        {
+            barrier.dstAccessMask = dst_access;
+            vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        return true;
+    }
+
+    bool UploadManager::flush(VkCommandBuffer graphics_cmd_buffer, uint64_t& out_wait_value)
+    {
+        std::lock_guard lock(_mutex);
+
+        ReturnIfFalse(submit_batch());
+        retire_batches();
+
+        out_wait_value = 0;
+        if (_submitted_value == _acquired_value) return true;
+
+        out_wait_value = _submitted_value;
+        _acquired_value = _submitted_value;
+
+        if (!_acquire_buffer_barriers.empty() || !_acquire_image_barriers.empty())
+        {
+            // 提交时在 ALL_COMMANDS 阶段等待时间线信号量, acquire 屏障接在这次等待之后.
+            vkCmdPipelineBarrier(
+                graphics_cmd_buffer,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                _acquire_stages,
+                0,
+                0,
+                nullptr,
+                static_cast<uint32_t>(_acquire_buffer_barriers.size()),
+                _acquire_buffer_barriers.data(),
+                static_cast<uint32_t>(_acquire_image_barriers.size()),
+                _acquire_image_barriers.data()
+            );
+            _acquire_buffer_barriers.clear();
+            _acquire_image_barriers.clear();
+            _acquire_stages = 0;
+        }
+        return true;
+    }
+
+    uint64_t UploadManager::get_completed_value() const
+    {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(_device, _timeline_semaphore, &value);
+        return value;
+    }
+
+    bool UploadManager::wait_idle()
+    {
+        uint64_t value;
+        {
+            std::lock_guard lock(_mutex);
+            ReturnIfFalse(submit_batch());
+            value = _submitted_value;
+        }
+
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &_timeline_semaphore;
+        wait_info.pValues = &value;
+        ReturnIfFalse(vkWaitSemaphores(_device, &wait_info, INVALID_SIZE_64) == VK_SUCCESS);
+
+        std::lock_guard lock(_mutex);
+        retire_batches();
+        return true;
+    }
+
+    bool UploadManager::begin_batch()
+    {
+        if (_current_batch.cmd_buffer != VK_NULL_HANDLE) return true;
+
+        if (!_free_batches.empty())
+        {
+            _current_batch = std::move(_free_batches.back());
+            _free_batches.pop_back();
+        }
+        else
+        {
+            VkCommandPoolCreateInfo pool_create_info{};
+            pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_create_info.queueFamilyIndex = _queue_family_index;
+            pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            ReturnIfFalse(vkCreateCommandPool(_device, &pool_create_info, nullptr, &_current_batch.cmd_pool) == VK_SUCCESS);
+        }
+
+        // 批次回收时整体重置 pool, 这里重新分配指令缓冲.
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = _current_batch.cmd_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        ReturnIfFalse(vkAllocateCommandBuffers(_device, &alloc_info, &_current_batch.cmd_buffer) == VK_SUCCESS);
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        return vkBeginCommandBuffer(_current_batch.cmd_buffer, &begin_info) == VK_SUCCESS;
+    }
+
+    bool UploadManager::submit_batch()
+    {
+        if (_current_batch.cmd_buffer == VK_NULL_HANDLE) return true;
+
+        UploadBatch batch = std::move(_current_batch);
+        _current_batch = UploadBatch{};
+
+        ReturnIfFalse(vkEndCommandBuffer(batch.cmd_buffer) == VK_SUCCESS);
+        batch.timeline_value = _submitted_value + 1;
+
+        // 其它线程预留的暂存区可能录制在之后的批次中, 这一批完成时不能回收它们.
+        batch.ring_end = _reserved_positions.empty() ? _ring_head : std::min(_ring_head, *_reserved_positions.begin());
+
+        VkTimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &batch.timeline_value;
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.cmd_buffer;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &_timeline_semaphore;
+        ReturnIfFalse(vkQueueSubmit(_queue, 1, &submit_info, VK_NULL_HANDLE) == VK_SUCCESS);
+
+        _submitted_value = batch.timeline_value;
+        _submitted_batches.push_back(std::move(batch));
+
+        _acquire_buffer_barriers.insert(_acquire_buffer_barriers.end(), _batch_buffer_barriers.begin(), _batch_buffer_barriers.end());
+        _acquire_image_barriers.insert(_acquire_image_barriers.end(), _batch_image_barriers.begin(), _batch_image_barriers.end());
+        _acquire_stages |= _batch_stages;
+        _batch_buffer_barriers.clear();
+        _batch_image_barriers.clear();
+        _batch_stages = 0;
+        return true;
+    }
+
+    bool UploadManager::retire_batches()
+    {
+        if (_submitted_batches.empty()) return false;
+
+        const uint64_t completed_value = get_completed_value();
+        bool retired = false;
+        while (!_submitted_batches.empty() && _submitted_batches.front().timeline_value <= completed_value)
+        {
+            UploadBatch& batch = _submitted_batches.front();
+            _ring_tail = batch.ring_end;
+
+            for (auto& [buffer, memory] : batch.temporary_buffers) _allocator->destroy_buffer(buffer, memory);
+            batch.temporary_buffers.clear();
+
+            vkResetCommandPool(_device, batch.cmd_pool, 0);
+            batch.cmd_buffer = VK_NULL_HANDLE;
+
+            _free_batches.push_back(std::move(batch));
+            _submitted_batches.pop_front();
+            retired = true;
+        }
+        return retired;
+    }
+
+    bool UploadManager::wait_oldest_batch(std::unique_lock<std::mutex>& lock)
+    {
+        if (_submitted_batches.empty()) return false;
+
+        // 等待期间释放锁, 渲染线程的 flush() 不会被阻塞.
+        const uint64_t value = _submitted_batches.front().timeline_value;
+        lock.unlock();
+
+        VkSemaphoreWaitInfo wait_info{};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &_timeline_semaphore;
+        wait_info.pValues = &value;
+        const bool success = vkWaitSemaphores(_device, &wait_info, INVALID_SIZE_64) == VK_SUCCESS;
+
+        lock.lock();
+        return success;
+    }
+
+    bool UploadManager::reserve_staging(VkDeviceSize size, VkDeviceSize alignment, StagingRange& out_range)
+    {
+        if (size > _ring_size / 2)
+        {
+            // 大块上传若放进环形缓冲区, 需要等前面所有批次完成才能腾出连续空间.
+            VkBufferCreateInfo create_info{};
+            create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            create_info.size = size;
+            create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ReturnIfFalse(_allocator->create_buffer(
+                create_info,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                out_range.buffer,
+                out_range.temporary_memory
+            ));
+
+            out_range.offset = 0;
+            out_range.data = static_cast<uint8_t*>(out_range.temporary_memory.mapped_data);
+            return true;
+        }
+
+        std::unique_lock lock(_mutex);
+        while (true)
+        {
+            // 不跨越缓冲区末尾, 放不下时跳过末尾剩余的部分.
+            uint64_t head = align_up(_ring_head, alignment);
+            if (head % _ring_size + size > _ring_size) head = (head / _ring_size + 1) * _ring_size;
+
+            if (head + size - _ring_tail <= _ring_size)
+            {
+                _ring_head = head + size;
+                _reserved_positions.insert(head);
+
+                out_range.buffer = _ring_buffer;
+                out_range.offset = head % _ring_size;
+                out_range.data = static_cast<uint8_t*>(_ring_memory.mapped_data) + out_range.offset;
+                out_range.ring_position = head;
+                return true;
+            }
+
+            // 空间不足时先回收已完成的批次, 再提交当前批次并等待最早的批次.
+            if (retire_batches()) continue;
+            if (_current_batch.cmd_buffer != VK_NULL_HANDLE)
+            {
+                ReturnIfFalse(submit_batch());
+            }
+            else if (!_submitted_batches.empty())
+            {
+                ReturnIfFalse(wait_oldest_batch(lock));
+            }
+            else if (!_reserved_positions.empty())
+            {
+                // 剩余空间都被其它线程预留, 等它们录制完成.
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            else
+            {
+                LOG_ERROR("Upload staging ring is corrupted.");
+                return false;
+            }
+        }
+    }
+
+    void UploadManager::commit_staging(StagingRange& range)
+    {
+        if (!range.temporary_memory.valid())
+        {
+            _reserved_positions.erase(range.ring_position);
+            return;
+        }
+
+        if (_current_batch.cmd_buffer != VK_NULL_HANDLE)
+        {
+            _current_batch.temporary_buffers.emplace_back(range.buffer, range.temporary_memory);
+        }
+        else
+        {
+            _allocator->destroy_buffer(range.buffer, range.temporary_memory);
+        }
+    }
+}
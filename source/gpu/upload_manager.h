@@ -0,0 +1,139 @@
+#ifndef GPU_UPLOAD_MANAGER_H
+#define GPU_UPLOAD_MANAGER_H
+
+#include "gpu_memory_allocator.h"
+#include <deque>
+#include <set>
+#include <span>
+
+namespace fantasy
+{
+    // 资源上传队列. 数据先写入常驻映射的环形暂存缓冲区, 拷贝指令与屏障攒成一批, 在 flush() 时一起提交,
+    // 用时间线信号量跟踪每一批的完成, 完成后回收暂存空间. CPU 只在暂存空间耗尽时等待 GPU.
+    //
+    // 上传队列与图形队列属于不同队列族时, 上传后的资源所有权需要转移: 上传批次中录制 release 屏障,
+    // flush() 在图形指令缓冲开头录制对应的 acquire 屏障.
+    // 与图形队列共用同一个 VkQueue 时, 所有调用都必须在提交图形指令的线程进行.
+    class UploadManager
+    {
+    public:
+        static constexpr VkDeviceSize DEFAULT_RING_SIZE = 64ull << 20;
+
+        bool initialize(
+            VkDevice device,
+            GpuMemoryAllocator* allocator,
+            uint32_t queue_family_index,
+            VkQueue queue,
+            uint32_t graphics_queue_family_index,
+            VkDeviceSize ring_size = DEFAULT_RING_SIZE
+        );
+        void destroy();
+
+        // 用于首次填充资源, 资源之前的内容不保留. 数据在调用中拷贝进暂存区, 返回后即可释放.
+        // dst_stages, dst_access 为上传后资源在图形队列上的使用方式.
+        bool upload_buffer(
+            VkBuffer dst_buffer,
+            VkDeviceSize dst_offset,
+            const void* data,
+            VkDeviceSize size,
+            VkPipelineStageFlags dst_stages,
+            VkAccessFlags dst_access
+        );
+
+        // regions 的 bufferOffset 相对于 data, 上传 image 的前 mip_count 个 mip, 完成后转换为 final_layout.
+        bool upload_image(
+            VkImage dst_image,
+            VkImageAspectFlags aspect,
+            uint32_t mip_count,
+            std::span<const VkBufferImageCopy> regions,
+            std::span<const uint8_t> data,
+            VkImageLayout final_layout,
+            VkPipelineStageFlags dst_stages,
+            VkAccessFlags dst_access
+        );
+
+        // 提交当前批次, 并在 graphics_cmd_buffer 中录制尚未录制的 acquire 屏障.
+        // 返回图形队列提交时需要等待的时间线值, 0 表示没有新的上传需要等待.
+        bool flush(VkCommandBuffer graphics_cmd_buffer, uint64_t& out_wait_value);
+
+        VkSemaphore get_timeline_semaphore() const { return _timeline_semaphore; }
+        uint64_t get_completed_value() const;
+
+        // 提交当前批次并在 CPU 上等待所有上传完成.
+        bool wait_idle();
+
+    private:
+        struct UploadBatch
+        {
+            VkCommandPool cmd_pool = VK_NULL_HANDLE;
+            VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+            uint64_t timeline_value = 0;
+            uint64_t ring_end = 0;          // 该批次用到的环形缓冲区末尾, 完成后 tail 移动到这里.
+
+            // 超过环形缓冲区一半的上传使用独立的暂存 buffer, 批次完成后释放.
+            std::vector<std::pair<VkBuffer, GpuAllocation>> temporary_buffers;
+        };
+
+        struct StagingRange
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            uint8_t* data = nullptr;
+            uint64_t ring_position = 0;         // 在环形缓冲区中的绝对位置.
+            GpuAllocation temporary_memory;     // 有效时 buffer 为独立的暂存 buffer.
+        };
+
+        bool begin_batch();
+        bool submit_batch();
+        bool retire_batches();
+        bool wait_oldest_batch(std::unique_lock<std::mutex>& lock);
+
+        // 预留暂存区后在锁外写入数据, 录制拷贝指令时再 commit, 写入期间不阻塞其它线程.
+        bool reserve_staging(VkDeviceSize size, VkDeviceSize alignment, StagingRange& out_range);
+        void commit_staging(StagingRange& range);
+        bool ownership_transfer() const { return _queue_family_index != _graphics_queue_family_index; }
+
+    private:
+        VkDevice _device = VK_NULL_HANDLE;
+        GpuMemoryAllocator* _allocator = nullptr;
+        uint32_t _queue_family_index = 0;
+        uint32_t _graphics_queue_family_index = 0;
+        VkQueue _queue = VK_NULL_HANDLE;
+
+        VkSemaphore _timeline_semaphore = VK_NULL_HANDLE;
+        uint64_t _submitted_value = 0;
+        uint64_t _acquired_value = 0;       // flush() 已经让图形队列等待过的值.
+
+        VkBuffer _ring_buffer = VK_NULL_HANDLE;
+        GpuAllocation _ring_memory;
+        VkDeviceSize _ring_size = 0;
+        uint64_t _ring_head = 0;            // head 与 tail 单调递增, 对 _ring_size 取模得到偏移.
+        uint64_t _ring_tail = 0;
+        std::set<uint64_t> _reserved_positions;    // 已预留但还未录制拷贝的位置, 批次的 ring_end 不能越过它们.
+
+        UploadBatch _current_batch;
+        std::deque<UploadBatch> _submitted_batches;
+        std::vector<UploadBatch> _free_batches;
+
+        // 已提交但还未在图形队列上录制的 acquire 屏障.
+        std::vector<VkBufferMemoryBarrier> _acquire_buffer_barriers;
+        std::vector<VkImageMemoryBarrier> _acquire_image_barriers;
+        VkPipelineStageFlags _acquire_stages = 0;
+
+        // 当前批次的 acquire 屏障, 批次提交后移入上面的列表.
+        std::vector<VkBufferMemoryBarrier> _batch_buffer_barriers;
+        std::vector<VkImageMemoryBarrier> _batch_image_barriers;
+        VkPipelineStageFlags _batch_stages = 0;
+
+        std::mutex _mutex;
+    };
+}
+
+
+
+
+
+
+
+
+#endif
@@ -1,7 +1,51 @@
 #include "vulkan_base.h"
+#include <charconv>
+#include <cstring>
+#include <string>
 
-int main()
+// 只接受十进制数字, 不接受符号和空白, 超出类型范围或小于 min_value 时返回 false.
+template <typename T>
+static bool parse_number(const char* text, T min_value, T& out_value)
 {
-	fantasy::VulkanBase().run();
-	return 0;
-}
\ No newline at end of file
+	const char* end = text + strlen(text);
+	T value = 0;
+	const auto [ptr, error] = std::from_chars(text, end, value);
+	if (ptr != end || error != std::errc() || value < min_value) return false;
+	out_value = value;
+	return true;
+}
+
+// 用法: learn-vulkan [--headless] [--direct-draws] [--record-threads N] [--width N] [--height N] [--instances N] [--frames N] [--warmup N] [--benchmark <输出 .json>] [--dump <输出 .ppm>]
+// --headless 必须和 --frames 一起使用, --benchmark 统计 --warmup 之后的 --frames 帧, --dump 只在 --headless 时可用.
+int main(int argc, char** argv)
+{
+	fantasy::RunOptions options;
+
+	// 未知参数和缺少值的参数都不合法.
+	bool valid = true;
+	for (int ix = 1; ix < argc && valid; ++ix)
+	{
+		const bool has_value = ix + 1 < argc;
+		if (strcmp(argv[ix], "--headless") == 0) options.headless = true;
+		else if (strcmp(argv[ix], "--direct-draws") == 0) options.direct_draws = true;
+		else if (strcmp(argv[ix], "--record-threads") == 0 && has_value) valid = parse_number(argv[++ix], 0u, options.record_thread_count);
+		else if (strcmp(argv[ix], "--width") == 0 && has_value) valid = parse_number(argv[++ix], 1u, options.resolution.width);
+		else if (strcmp(argv[ix], "--height") == 0 && has_value) valid = parse_number(argv[++ix], 1u, options.resolution.height);
+		else if (strcmp(argv[ix], "--instances") == 0 && has_value) valid = parse_number(argv[++ix], 1u, options.instance_count);
+		else if (strcmp(argv[ix], "--frames") == 0 && has_value) valid = parse_number<uint64_t>(argv[++ix], 0, options.frame_count);
+		else if (strcmp(argv[ix], "--warmup") == 0 && has_value) valid = parse_number<uint64_t>(argv[++ix], 0, options.warmup_frame_count);
+		else if (strcmp(argv[ix], "--benchmark") == 0 && has_value) options.benchmark_path = argv[++ix];
+		else if (strcmp(argv[ix], "--dump") == 0 && has_value) options.dump_path = argv[++ix];
+		else valid = false;
+	}
+	if (!valid)
+	{
+		LOG_ERROR(
+			"Usage: learn-vulkan [--headless] [--direct-draws] [--record-threads N] [--width N] [--height N] [--instances N] "
+			"[--frames N] [--warmup N] [--benchmark <output .json>] [--dump <output .ppm>]"
+		);
+		return 1;
+	}
+
+	return fantasy::VulkanBase().run(options) ? 0 : 1;
+}
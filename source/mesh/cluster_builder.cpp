@@ -0,0 +1,362 @@
+#include "cluster_builder.h"
+#include "mesh_simplifier.h"
+#include "../core/parallel/parallel.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace fantasy
+{
+    static constexpr uint32_t CLUSTER_MAX_VERTEX_COUNT = 256;
+    static constexpr uint32_t CLUSTER_DAG_MAGIC = 0x534c4346;   // "FCLS"
+
+    struct ClusterData
+    {
+        Cluster cluster;
+        std::vector<float3> vertices;
+        std::vector<uint8_t> indices;
+    };
+
+    static ClusterData create_cluster(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        std::span<const uint32_t> triangles,
+        std::span<const uint32_t> global_vertices
+    )
+    {
+        ClusterData data;
+        data.vertices.resize(global_vertices.size());
+        for (uint32_t ix = 0; ix < global_vertices.size(); ++ix) data.vertices[ix] = vertices[global_vertices[ix]];
+
+        float3 normal_sum;
+        std::vector<float3> normals;
+        normals.reserve(triangles.size());
+
+        data.indices.reserve(triangles.size() * 3);
+        for (uint32_t triangle : triangles)
+        {
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                const uint32_t index = indices[triangle * 3 + ix];
+                data.indices.push_back(static_cast<uint8_t>(
+                    std::lower_bound(global_vertices.begin(), global_vertices.end(), index) - global_vertices.begin()
+                ));
+            }
+
+            const float3& p0 = vertices[indices[triangle * 3 + 0]];
+            const float3& p1 = vertices[indices[triangle * 3 + 1]];
+            const float3& p2 = vertices[indices[triangle * 3 + 2]];
+            const float3 normal = cross(p1 - p0, p2 - p0);
+            if (normal.length_squared() > 0.0f)
+            {
+                normals.push_back(normalize(normal));
+                normal_sum += normals.back();
+            }
+        }
+
+        Cluster& cluster = data.cluster;
+        cluster.bounds = Sphere(data.vertices);
+        cluster.lod_bounds = cluster.bounds;
+        cluster.vertex_count = static_cast<uint32_t>(data.vertices.size());
+        cluster.triangle_count = static_cast<uint32_t>(triangles.size());
+
+        if (normal_sum.length_squared() > 0.0f)
+        {
+            cluster.cone_axis = normalize(normal_sum);
+            cluster.cone_cutoff = 1.0f;
+            for (const auto& normal : normals) cluster.cone_cutoff = std::min(cluster.cone_cutoff, dot(cluster.cone_axis, normal));
+            if (cluster.cone_cutoff <= 0.0f) cluster.cone_cutoff = -1.0f;
+        }
+        return data;
+    }
+
+    // 按空间划分网格, 顶点数超过 256 的 cluster 会被继续对半划分.
+    static void clusterize(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        uint32_t cluster_triangle_count,
+        std::vector<ClusterData>& out_clusters
+    )
+    {
+        const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+
+        std::vector<float3> centroids(triangle_count);
+        std::vector<uint32_t> order(triangle_count);
+        for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            centroids[triangle] = (
+                vertices[indices[triangle * 3 + 0]] +
+                vertices[indices[triangle * 3 + 1]] +
+                vertices[indices[triangle * 3 + 2]]
+            ) * (1.0f / 3.0f);
+            order[triangle] = triangle;
+        }
+
+        std::vector<uint32_t> global_vertices;
+
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        for (auto range : partition_triangles(centroids, order, cluster_triangle_count)) stack.push_back(range);
+        std::reverse(stack.begin(), stack.end());
+
+        while (!stack.empty())
+        {
+            const auto [begin, end] = stack.back();
+            stack.pop_back();
+
+            std::span<uint32_t> triangles(order.data() + begin, end - begin);
+
+            global_vertices.clear();
+            for (uint32_t triangle : triangles)
+            {
+                for (uint32_t ix = 0; ix < 3; ++ix) global_vertices.push_back(indices[triangle * 3 + ix]);
+            }
+            std::sort(global_vertices.begin(), global_vertices.end());
+            global_vertices.erase(std::unique(global_vertices.begin(), global_vertices.end()), global_vertices.end());
+
+            if (global_vertices.size() > CLUSTER_MAX_VERTEX_COUNT && triangles.size() > 1)
+            {
+                auto sub_ranges = partition_triangles(centroids, triangles, static_cast<uint32_t>(triangles.size() + 1) / 2);
+                for (auto iter = sub_ranges.rbegin(); iter != sub_ranges.rend(); ++iter)
+                {
+                    stack.emplace_back(begin + iter->first, begin + iter->second);
+                }
+                continue;
+            }
+
+            out_clusters.push_back(create_cluster(vertices, indices, triangles, global_vertices));
+        }
+    }
+
+    struct GroupResult
+    {
+        std::vector<ClusterData> parents;
+        float lod_error = 0.0f;
+        Sphere lod_bounds;
+    };
+
+    static GroupResult simplify_group(
+        const std::vector<ClusterData>& clusters,
+        std::span<const uint32_t> children,
+        uint32_t cluster_triangle_count
+    )
+    {
+        GroupResult result;
+
+        std::vector<float3> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Sphere> child_bounds;
+        for (uint32_t child : children)
+        {
+            const ClusterData& data = clusters[child];
+
+            const uint32_t vertex_offset = static_cast<uint32_t>(vertices.size());
+            vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+            for (uint8_t index : data.indices) indices.push_back(vertex_offset + index);
+
+            child_bounds.push_back(data.cluster.lod_bounds);
+            result.lod_error = std::max(result.lod_error, data.cluster.lod_error);
+        }
+        result.lod_bounds = merge(child_bounds);
+
+        weld_vertices(vertices, indices);
+
+        // group 外的接缝表现为开放边, 锁定后相邻 group 之间不会产生裂缝.
+        MeshSimplifier simplifier(vertices, indices);
+        simplifier.lock_boundary();
+        const float error = simplifier.simplify(static_cast<uint32_t>(indices.size() / 6));
+        simplifier.compact();
+
+        vertices.resize(simplifier.remaining_vertex_count());
+        indices.resize(simplifier.remaining_triangle_count() * 3);
+
+        result.lod_error = std::max(result.lod_error, error);
+        if (!indices.empty()) clusterize(vertices, indices, cluster_triangle_count, result.parents);
+        return result;
+    }
+
+    bool build_cluster_dag(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        const ClusterBuildDesc& desc,
+        ClusterDag& out_dag
+    )
+    {
+        ReturnIfFalse(!indices.empty() && indices.size() % 3 == 0);
+        ReturnIfFalse(desc.cluster_triangle_count > 0 && desc.cluster_triangle_count <= CLUSTER_MAX_VERTEX_COUNT);
+        ReturnIfFalse(desc.group_cluster_count > 1);
+
+        std::vector<float3> welded_vertices(vertices.begin(), vertices.end());
+        std::vector<uint32_t> welded_indices(indices.begin(), indices.end());
+        weld_vertices(welded_vertices, welded_indices);
+
+        std::vector<ClusterData> clusters;
+        clusterize(welded_vertices, welded_indices, desc.cluster_triangle_count, clusters);
+
+        out_dag = ClusterDag{};
+
+        uint32_t level_begin = 0;
+        uint32_t level_end = static_cast<uint32_t>(clusters.size());
+        for (uint32_t mip_level = 0; mip_level < desc.max_mip_level && level_end - level_begin > 1; ++mip_level)
+        {
+            const uint32_t level_count = level_end - level_begin;
+
+            std::vector<float3> centers(level_count);
+            std::vector<uint32_t> order(level_count);
+            for (uint32_t ix = 0; ix < level_count; ++ix)
+            {
+                centers[ix] = clusters[level_begin + ix].cluster.bounds.center;
+                order[ix] = ix;
+            }
+            const auto group_ranges = partition_triangles(centers, order, desc.group_cluster_count);
+            for (uint32_t& index : order) index += level_begin;
+
+            std::vector<GroupResult> results(group_ranges.size());
+            parallel::parallel_for(
+                [&](uint64_t group_index)
+                {
+                    const auto [begin, end] = group_ranges[group_index];
+                    results[group_index] = simplify_group(
+                        clusters,
+                        std::span<const uint32_t>(order.data() + begin, end - begin),
+                        desc.cluster_triangle_count
+                    );
+                },
+                results.size()
+            );
+
+            uint32_t parent_count = 0;
+            for (const auto& result : results) parent_count += static_cast<uint32_t>(result.parents.size());
+
+            // 锁定边界过多导致无法继续简化时停止, 当前层即为根.
+            if (parent_count == 0 || parent_count >= level_count) break;
+
+            for (uint32_t group_index = 0; group_index < group_ranges.size(); ++group_index)
+            {
+                const auto [begin, end] = group_ranges[group_index];
+                GroupResult& result = results[group_index];
+
+                ClusterGroup& group = out_dag.groups.emplace_back();
+                group.lod_bounds = result.lod_bounds;
+                group.max_parent_lod_error = result.lod_error;
+                group.mip_level = mip_level;
+                group.cluster_offset = static_cast<uint32_t>(out_dag.group_clusters.size());
+                group.cluster_count = end - begin;
+
+                for (uint32_t ix = begin; ix < end; ++ix)
+                {
+                    Cluster& child = clusters[order[ix]].cluster;
+                    child.group_index = static_cast<uint32_t>(out_dag.groups.size() - 1);
+                    child.parent_lod_error = result.lod_error;
+                    out_dag.group_clusters.push_back(order[ix]);
+                }
+
+                for (auto& parent : result.parents)
+                {
+                    parent.cluster.lod_bounds = result.lod_bounds;
+                    parent.cluster.lod_error = result.lod_error;
+                    parent.cluster.mip_level = mip_level + 1;
+                    clusters.push_back(std::move(parent));
+                }
+            }
+
+            level_begin = level_end;
+            level_end = static_cast<uint32_t>(clusters.size());
+        }
+
+        out_dag.clusters.reserve(clusters.size());
+        for (auto& data : clusters)
+        {
+            Cluster& cluster = out_dag.clusters.emplace_back(data.cluster);
+            if (cluster.group_index == INVALID_SIZE_32) cluster.parent_lod_error = FLT_MAX;
+
+            cluster.vertex_offset = static_cast<uint32_t>(out_dag.vertices.size());
+            cluster.triangle_offset = static_cast<uint32_t>(out_dag.indices.size() / 3);
+            out_dag.vertices.insert(out_dag.vertices.end(), data.vertices.begin(), data.vertices.end());
+            out_dag.indices.insert(out_dag.indices.end(), data.indices.begin(), data.indices.end());
+        }
+        return true;
+    }
+
+    uint64_t ClusterDag::memory_size() const
+    {
+        return  clusters.size() * sizeof(Cluster) +
+                groups.size() * sizeof(ClusterGroup) +
+                group_clusters.size() * sizeof(uint32_t) +
+                vertices.size() * sizeof(float3) +
+                indices.size() * sizeof(uint8_t);
+    }
+
+
+    bool save_cluster_dag(const std::string& path, const ClusterDag& dag)
+    {
+        // 各数组按对齐整块写入, 读取时同样整块拷贝.
+        serialization::BinaryOutput output(path);
+        output(CLUSTER_DAG_MAGIC, dag);
+        if (!output.close())
+        {
+            LOG_ERROR("Write cluster dag file " + path + " failed.");
+            return false;
+        }
+        return true;
+    }
+
+    // 检查所有下标和范围都在数组内, 之后使用 dag 时不需要再做边界检查.
+    static bool validate_cluster_dag(const ClusterDag& dag)
+    {
+        const uint64_t triangle_count = dag.indices.size() / 3;
+        for (const auto& cluster : dag.clusters)
+        {
+            if (
+                cluster.vertex_count > CLUSTER_MAX_VERTEX_COUNT ||
+                uint64_t(cluster.vertex_offset) + cluster.vertex_count > dag.vertices.size() ||
+                uint64_t(cluster.triangle_offset) + cluster.triangle_count > triangle_count ||
+                (cluster.group_index != INVALID_SIZE_32 && cluster.group_index >= dag.groups.size())
+            )
+            {
+                return false;
+            }
+
+            const uint64_t index_end = (uint64_t(cluster.triangle_offset) + cluster.triangle_count) * 3;
+            for (uint64_t ix = uint64_t(cluster.triangle_offset) * 3; ix < index_end; ++ix)
+            {
+                if (dag.indices[ix] >= cluster.vertex_count) return false;
+            }
+        }
+        for (const auto& group : dag.groups)
+        {
+            if (uint64_t(group.cluster_offset) + group.cluster_count > dag.group_clusters.size()) return false;
+        }
+        for (uint32_t cluster_index : dag.group_clusters)
+        {
+            if (cluster_index >= dag.clusters.size()) return false;
+        }
+        return true;
+    }
+
+    bool load_cluster_dag(const std::string& path, ClusterDag& out_dag)
+    {
+        // 数组长度在分配前与剩余的文件大小核对, 损坏或截断的文件不会触发巨大的分配.
+        serialization::MappedBinaryInput input(path);
+        uint32_t magic = 0;
+        input(magic);
+        if (!input.good() || magic != CLUSTER_DAG_MAGIC)
+        {
+            LOG_ERROR("Cluster dag file " + path + " is invalid or out of date.");
+            return false;
+        }
+
+        input(out_dag);
+        if (!input.good() || input.remaining() != 0)
+        {
+            LOG_ERROR("Cluster dag file " + path + " is truncated or corrupt.");
+            return false;
+        }
+
+        if (!validate_cluster_dag(out_dag))
+        {
+            LOG_ERROR("Cluster dag file " + path + " is corrupt.");
+            return false;
+        }
+        return true;
+    }
+}
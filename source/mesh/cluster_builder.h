@@ -0,0 +1,92 @@
+#ifndef MESH_CLUSTER_BUILDER_H
+#define MESH_CLUSTER_BUILDER_H
+
+#include "../core/math/bounds.h"
+#include "../core/tools/serialization.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace fantasy
+{
+    struct Cluster
+    {
+        Sphere bounds;
+        Sphere lod_bounds;
+
+        // 法线锥, cone_cutoff 为所有三角形法线与 cone_axis 夹角余弦的最小值, 为 -1 时不可用于剔除.
+        float3 cone_axis;
+        float cone_cutoff = -1.0f;
+
+        // 当 lod_error <= 阈值 < parent_lod_error 时选用该 cluster.
+        float lod_error = 0.0f;
+        float parent_lod_error = 0.0f;
+
+        uint32_t group_index = INVALID_SIZE_32;     // 作为子节点所属的 group, 根节点为 INVALID_SIZE_32.
+        uint32_t mip_level = 0;
+
+        uint32_t vertex_offset = 0;
+        uint32_t vertex_count = 0;
+        uint32_t triangle_offset = 0;
+        uint32_t triangle_count = 0;
+    };
+
+    struct ClusterGroup
+    {
+        Sphere lod_bounds;
+        float max_parent_lod_error = 0.0f;
+        uint32_t mip_level = 0;
+
+        uint32_t cluster_offset = 0;    // 子 cluster 在 ClusterDag::group_clusters 中的范围.
+        uint32_t cluster_count = 0;
+    };
+
+    struct ClusterDag
+    {
+        std::vector<Cluster> clusters;
+        std::vector<ClusterGroup> groups;
+        std::vector<uint32_t> group_clusters;
+
+        std::vector<float3> vertices;
+        std::vector<uint8_t> indices;   // cluster 内的局部索引, 每个 cluster 最多 256 个顶点.
+
+        uint64_t memory_size() const;
+
+        SERIALIZATION_FIELDS(1, clusters, groups, group_clusters, vertices, indices);
+    };
+
+    struct ClusterBuildDesc
+    {
+        uint32_t cluster_triangle_count = 128;  // 64 或 128.
+        uint32_t group_cluster_count = 8;
+        uint32_t max_mip_level = 32;
+    };
+
+    // 将网格划分为 cluster, 再逐级分组简化生成 lod dag. 需要先调用 parallel::initialize().
+    bool build_cluster_dag(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        const ClusterBuildDesc& desc,
+        ClusterDag& out_dag
+    );
+
+    bool save_cluster_dag(const std::string& path, const ClusterDag& dag);
+    bool load_cluster_dag(const std::string& path, ClusterDag& out_dag);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
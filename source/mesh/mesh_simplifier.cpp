@@ -0,0 +1,535 @@
+#include "mesh_simplifier.h"
+#include "../core/math/bounds.h"
+#include "../core/parallel/parallel.h"
+#include "../core/tools/hash_table.h"
+#include <algorithm>
+#include <cmath>
+
+namespace fantasy
+{
+    static uint32_t edge_hash(uint32_t vertex0, uint32_t vertex1)
+    {
+        return murmur_mix(murmur_add(vertex0, vertex1));
+    }
+
+    // 为每个顶点找到第一个与其位置相同的顶点.
+    static std::vector<uint32_t> create_weld_remap(std::span<const float3> vertices)
+    {
+        const uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
+
+        std::vector<uint32_t> remap(vertex_count);
+        HashTable hash_table(vertex_count);
+        for (uint32_t ix = 0; ix < vertex_count; ++ix)
+        {
+            const uint32_t key = hash(vertices[ix]);
+
+            remap[ix] = ix;
+            for (uint32_t jx : hash_table[key])
+            {
+                if (vertices[jx] == vertices[ix])
+                {
+                    remap[ix] = jx;
+                    break;
+                }
+            }
+            if (remap[ix] == ix) hash_table.insert(key, ix);
+        }
+        return remap;
+    }
+
+
+    MeshSimplifier::MeshSimplifier(std::span<float3> vertices, std::span<uint32_t> indices) :
+        _vertices(vertices), _indices(indices)
+    {
+        const uint32_t vertex_count = static_cast<uint32_t>(_vertices.size());
+        const uint32_t triangle_count = static_cast<uint32_t>(_indices.size() / 3);
+
+        _vertex_quadrics.resize(vertex_count);
+        _vertex_triangles.resize(vertex_count);
+        _vertex_versions.resize(vertex_count, 0);
+        _vertex_flags.resize(vertex_count, VertexFlag::Removed);
+        _triangle_removed.resize(triangle_count, 0);
+
+        std::vector<uint32_t> remap = create_weld_remap(_vertices);
+        for (uint32_t& index : _indices) index = remap[index];
+
+        _remaining_triangle_count = triangle_count;
+        for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            const uint32_t* tri = &_indices[triangle * 3];
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0])
+            {
+                _triangle_removed[triangle] = 1;
+                _remaining_triangle_count--;
+                continue;
+            }
+
+            const double3 p0(_vertices[tri[0]]);
+            const double3 p1(_vertices[tri[1]]);
+            const double3 p2(_vertices[tri[2]]);
+
+            // 面积为 0 的三角形无法确定平面, 不贡献误差.
+            QuadricSurface quadric;
+            if (cross(p1 - p0, p2 - p0).length_squared() > 0.0)
+            {
+                quadric = QuadricSurface(p0, p1, p2);
+            }
+
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                _vertex_quadrics[tri[ix]] = merge(_vertex_quadrics[tri[ix]], quadric);
+                _vertex_triangles[tri[ix]].push_back(triangle);
+                _vertex_flags[tri[ix]] = 0;
+            }
+        }
+
+        for (uint8_t flag : _vertex_flags)
+        {
+            if (!(flag & VertexFlag::Removed)) _remaining_vertex_count++;
+        }
+
+        build_edges();
+    }
+
+    void MeshSimplifier::build_edges()
+    {
+        HashTable edge_table(static_cast<uint32_t>(_indices.size()));
+        for (uint32_t triangle = 0; triangle < _triangle_removed.size(); ++triangle)
+        {
+            if (_triangle_removed[triangle]) continue;
+
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                uint32_t vertex0 = _indices[triangle * 3 + ix];
+                uint32_t vertex1 = _indices[triangle * 3 + triangle_index_cycle3(ix)];
+                if (vertex0 > vertex1) std::swap(vertex0, vertex1);
+
+                const uint32_t key = edge_hash(vertex0, vertex1);
+
+                uint32_t edge_index = INVALID_SIZE_32;
+                for (uint32_t jx : edge_table[key])
+                {
+                    if (_edges[jx].first == vertex0 && _edges[jx].second == vertex1)
+                    {
+                        edge_index = jx;
+                        break;
+                    }
+                }
+
+                if (edge_index == INVALID_SIZE_32)
+                {
+                    edge_index = static_cast<uint32_t>(_edges.size());
+                    _edges.emplace_back(vertex0, vertex1);
+                    _edge_use_counts.push_back(0);
+                    edge_table.insert(key, edge_index);
+                }
+                _edge_use_counts[edge_index]++;
+            }
+        }
+    }
+
+    void MeshSimplifier::lock_boundary()
+    {
+        for (uint32_t ix = 0; ix < _edges.size(); ++ix)
+        {
+            if (_edge_use_counts[ix] == 1)
+            {
+                _vertex_flags[_edges[ix].first] |= VertexFlag::Locked;
+                _vertex_flags[_edges[ix].second] |= VertexFlag::Locked;
+            }
+        }
+    }
+
+    float MeshSimplifier::evaluate(uint32_t vertex0, uint32_t vertex1, float3& out_position)
+    {
+        const bool locked0 = _vertex_flags[vertex0] & VertexFlag::Locked;
+        const bool locked1 = _vertex_flags[vertex1] & VertexFlag::Locked;
+        if (locked0 && locked1) return INFINITY;
+
+        QuadricSurface quadric = merge(_vertex_quadrics[vertex0], _vertex_quadrics[vertex1]);
+
+        const float3& p0 = _vertices[vertex0];
+        const float3& p1 = _vertices[vertex1];
+
+        if (locked0 || locked1)
+        {
+            out_position = locked0 ? p0 : p1;
+            return quadric.distance_to_surface(out_position);
+        }
+
+        // 候选点为二次误差的极小值点, 两个端点和中点, 取误差最小者.
+        float3 candidates[4] = { p0, p1, (p0 + p1) * 0.5f, float3() };
+        uint32_t candidate_count = 3;
+
+        float3 optimal, normal, tangent;
+        if (quadric.get_vertex(optimal, normal, tangent))
+        {
+            // 矩阵接近奇异时解会跑得很远, 限制在边附近.
+            const float limit = float3(p1 - p0).length_squared() * 4.0f;
+            if (std::isfinite(optimal.x) && float3(optimal - candidates[2]).length_squared() <= limit)
+            {
+                candidates[candidate_count++] = optimal;
+            }
+        }
+
+        float min_cost = INFINITY;
+        for (uint32_t ix = 0; ix < candidate_count; ++ix)
+        {
+            const float cost = quadric.distance_to_surface(candidates[ix]);
+            if (cost < min_cost)
+            {
+                min_cost = cost;
+                out_position = candidates[ix];
+            }
+        }
+        return min_cost;
+    }
+
+    void MeshSimplifier::push_edge(uint32_t vertex0, uint32_t vertex1)
+    {
+        float3 position;
+        const float cost = evaluate(vertex0, vertex1, position);
+        if (std::isinf(cost)) return;
+
+        _heap.push(Collapse{
+            .cost = cost,
+            .position = position,
+            .vertex0 = vertex0,
+            .vertex1 = vertex1,
+            .version0 = _vertex_versions[vertex0],
+            .version1 = _vertex_versions[vertex1]
+        });
+    }
+
+    bool MeshSimplifier::triangle_contain(uint32_t triangle, uint32_t vertex) const
+    {
+        const uint32_t* tri = &_indices[triangle * 3];
+        return tri[0] == vertex || tri[1] == vertex || tri[2] == vertex;
+    }
+
+    bool MeshSimplifier::flipped(uint32_t vertex, uint32_t other, const float3& position)
+    {
+        for (uint32_t triangle : _vertex_triangles[vertex])
+        {
+            if (_triangle_removed[triangle] || triangle_contain(triangle, other)) continue;
+
+            float3 p[3];
+            float3 q[3];
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                const uint32_t index = _indices[triangle * 3 + ix];
+                p[ix] = _vertices[index];
+                q[ix] = index == vertex ? position : p[ix];
+            }
+
+            const float3 old_normal = cross(p[1] - p[0], p[2] - p[0]);
+            const float3 new_normal = cross(q[1] - q[0], q[2] - q[0]);
+            if (dot(old_normal, new_normal) <= 0.0f) return true;
+        }
+        return false;
+    }
+
+    bool MeshSimplifier::collapse(uint32_t vertex0, uint32_t vertex1, const float3& position)
+    {
+        if (flipped(vertex0, vertex1, position) || flipped(vertex1, vertex0, position)) return false;
+
+        _vertices[vertex0] = position;
+        _vertex_quadrics[vertex0] = merge(_vertex_quadrics[vertex0], _vertex_quadrics[vertex1]);
+        if (_vertex_flags[vertex1] & VertexFlag::Locked) _vertex_flags[vertex0] |= VertexFlag::Locked;
+
+        // vertex1 坍缩到 vertex0, 同时引用两者的三角形退化并被移除.
+        for (uint32_t triangle : _vertex_triangles[vertex1])
+        {
+            if (_triangle_removed[triangle]) continue;
+
+            if (triangle_contain(triangle, vertex0))
+            {
+                _triangle_removed[triangle] = 1;
+                _remaining_triangle_count--;
+                continue;
+            }
+
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                uint32_t& index = _indices[triangle * 3 + ix];
+                if (index == vertex1) index = vertex0;
+            }
+            _vertex_triangles[vertex0].push_back(triangle);
+        }
+
+        auto& triangles = _vertex_triangles[vertex0];
+        triangles.erase(
+            std::remove_if(triangles.begin(), triangles.end(), [this](uint32_t triangle) { return _triangle_removed[triangle] != 0; }),
+            triangles.end()
+        );
+
+        _vertex_triangles[vertex1].clear();
+        _vertex_triangles[vertex1].shrink_to_fit();
+        _vertex_flags[vertex1] |= VertexFlag::Removed;
+        _vertex_versions[vertex0]++;
+        _vertex_versions[vertex1]++;
+        _remaining_vertex_count--;
+
+        std::vector<uint32_t> neighbors;
+        neighbors.reserve(triangles.size() * 2);
+        for (uint32_t triangle : triangles)
+        {
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                const uint32_t index = _indices[triangle * 3 + ix];
+                if (index != vertex0) neighbors.push_back(index);
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+        for (uint32_t neighbor : neighbors) push_edge(vertex0, neighbor);
+
+        return true;
+    }
+
+    float MeshSimplifier::simplify(uint32_t target_triangle_count)
+    {
+        for (const auto& [vertex0, vertex1] : _edges) push_edge(vertex0, vertex1);
+
+        float max_error = 0.0f;
+        while (!_heap.empty() && _remaining_triangle_count > target_triangle_count)
+        {
+            const Collapse top = _heap.top();
+            _heap.pop();
+
+            // 惰性删除: 顶点已被移除或在入堆之后发生过变化的条目直接丢弃.
+            if (
+                (_vertex_flags[top.vertex0] & VertexFlag::Removed) ||
+                (_vertex_flags[top.vertex1] & VertexFlag::Removed) ||
+                _vertex_versions[top.vertex0] != top.version0 ||
+                _vertex_versions[top.vertex1] != top.version1
+            )
+            {
+                continue;
+            }
+
+            // 版本未变, 入堆时算出的坍缩位置和误差依然有效.
+            if (collapse(top.vertex0, top.vertex1, top.position))
+            {
+                max_error = std::max(max_error, top.cost);
+            }
+        }
+
+        _heap = {};
+        return std::sqrt(max_error);
+    }
+
+    void MeshSimplifier::compact()
+    {
+        std::vector<uint32_t> remap(_vertices.size(), INVALID_SIZE_32);
+
+        uint32_t vertex_count = 0;
+        for (uint32_t ix = 0; ix < _vertices.size(); ++ix)
+        {
+            if (_vertex_flags[ix] & VertexFlag::Removed) continue;
+
+            remap[ix] = vertex_count;
+            _vertices[vertex_count] = _vertices[ix];
+            _vertex_quadrics[vertex_count] = _vertex_quadrics[ix];
+            _vertex_flags[vertex_count] = _vertex_flags[ix];
+            vertex_count++;
+        }
+
+        uint32_t triangle_count = 0;
+        for (uint32_t triangle = 0; triangle < _triangle_removed.size(); ++triangle)
+        {
+            if (_triangle_removed[triangle]) continue;
+
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                _indices[triangle_count * 3 + ix] = remap[_indices[triangle * 3 + ix]];
+            }
+            triangle_count++;
+        }
+
+        _remaining_vertex_count = vertex_count;
+        _remaining_triangle_count = triangle_count;
+
+        std::fill(_vertex_flags.begin() + vertex_count, _vertex_flags.end(), VertexFlag::Removed);
+        std::fill(_triangle_removed.begin(), _triangle_removed.end(), 1);
+        std::fill(_triangle_removed.begin(), _triangle_removed.begin() + triangle_count, 0);
+
+        for (auto& triangles : _vertex_triangles) triangles.clear();
+        for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            for (uint32_t ix = 0; ix < 3; ++ix)
+            {
+                _vertex_triangles[_indices[triangle * 3 + ix]].push_back(triangle);
+            }
+        }
+        std::fill(_vertex_versions.begin(), _vertex_versions.end(), 0);
+
+        _edges.clear();
+        _edge_use_counts.clear();
+        build_edges();
+    }
+
+
+    uint32_t weld_vertices(std::vector<float3>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> remap = create_weld_remap(vertices);
+
+        uint32_t vertex_count = 0;
+        for (uint32_t ix = 0; ix < vertices.size(); ++ix)
+        {
+            if (remap[ix] == ix)
+            {
+                vertices[vertex_count] = vertices[ix];
+                remap[ix] = vertex_count++;
+            }
+            else
+            {
+                // 被合并的顶点总是指向更小的索引, 该索引已经完成重映射.
+                remap[ix] = remap[remap[ix]];
+            }
+        }
+        vertices.resize(vertex_count);
+
+        for (uint32_t& index : indices) index = remap[index];
+        return vertex_count;
+    }
+
+
+    std::vector<std::pair<uint32_t, uint32_t>> partition_triangles(
+        std::span<const float3> centroids,
+        std::span<uint32_t> order,
+        uint32_t leaf_size
+    )
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, static_cast<uint32_t>(order.size()) } };
+        while (!stack.empty())
+        {
+            const auto [begin, end] = stack.back();
+            stack.pop_back();
+
+            if (end - begin <= leaf_size)
+            {
+                ranges.emplace_back(begin, end);
+                continue;
+            }
+
+            Bounds3F bounds;
+            for (uint32_t ix = begin; ix < end; ++ix) bounds = merge(bounds, centroids[order[ix]]);
+            const uint32_t axis = bounds.max_axis();
+
+            const uint32_t mid = begin + (end - begin) / 2;
+            std::nth_element(
+                order.begin() + begin,
+                order.begin() + mid,
+                order.begin() + end,
+                [&](uint32_t lhs, uint32_t rhs) { return centroids[lhs][axis] < centroids[rhs][axis]; }
+            );
+
+            stack.emplace_back(mid, end);
+            stack.emplace_back(begin, mid);
+        }
+        return ranges;
+    }
+
+    static MeshLod simplify_lod(const MeshLod& src, uint32_t cluster_triangle_count)
+    {
+        const uint32_t triangle_count = static_cast<uint32_t>(src.indices.size() / 3);
+
+        std::vector<float3> centroids(triangle_count);
+        std::vector<uint32_t> order(triangle_count);
+        for (uint32_t triangle = 0; triangle < triangle_count; ++triangle)
+        {
+            centroids[triangle] = (
+                src.vertices[src.indices[triangle * 3 + 0]] +
+                src.vertices[src.indices[triangle * 3 + 1]] +
+                src.vertices[src.indices[triangle * 3 + 2]]
+            ) * (1.0f / 3.0f);
+            order[triangle] = triangle;
+        }
+
+        const auto ranges = partition_triangles(centroids, order, cluster_triangle_count);
+
+        std::vector<MeshLod> clusters(ranges.size());
+        parallel::parallel_for(
+            [&](uint64_t cluster_index)
+            {
+                const auto [begin, end] = ranges[cluster_index];
+                MeshLod& cluster = clusters[cluster_index];
+
+                std::vector<uint32_t> global_vertices;
+                global_vertices.reserve((end - begin) * 3);
+                for (uint32_t ix = begin; ix < end; ++ix)
+                {
+                    for (uint32_t jx = 0; jx < 3; ++jx) global_vertices.push_back(src.indices[order[ix] * 3 + jx]);
+                }
+                std::sort(global_vertices.begin(), global_vertices.end());
+                global_vertices.erase(std::unique(global_vertices.begin(), global_vertices.end()), global_vertices.end());
+
+                cluster.vertices.resize(global_vertices.size());
+                for (uint32_t ix = 0; ix < global_vertices.size(); ++ix) cluster.vertices[ix] = src.vertices[global_vertices[ix]];
+
+                cluster.indices.reserve((end - begin) * 3);
+                for (uint32_t ix = begin; ix < end; ++ix)
+                {
+                    for (uint32_t jx = 0; jx < 3; ++jx)
+                    {
+                        const uint32_t index = src.indices[order[ix] * 3 + jx];
+                        cluster.indices.push_back(static_cast<uint32_t>(
+                            std::lower_bound(global_vertices.begin(), global_vertices.end(), index) - global_vertices.begin()
+                        ));
+                    }
+                }
+
+                MeshSimplifier simplifier(cluster.vertices, cluster.indices);
+                simplifier.lock_boundary();
+                cluster.error = simplifier.simplify(std::max((end - begin) / 2, 1u));
+                simplifier.compact();
+
+                cluster.vertices.resize(simplifier.remaining_vertex_count());
+                cluster.indices.resize(simplifier.remaining_triangle_count() * 3);
+            },
+            clusters.size()
+        );
+
+        // 边界顶点被锁定, 位置不变, 合并后重新焊接即可缝合各 cluster.
+        MeshLod dst;
+        dst.error = src.error;
+        for (const auto& cluster : clusters)
+        {
+            const uint32_t vertex_offset = static_cast<uint32_t>(dst.vertices.size());
+            dst.vertices.insert(dst.vertices.end(), cluster.vertices.begin(), cluster.vertices.end());
+            for (uint32_t index : cluster.indices) dst.indices.push_back(index + vertex_offset);
+            dst.error = std::max(dst.error, cluster.error);
+        }
+        weld_vertices(dst.vertices, dst.indices);
+        return dst;
+    }
+
+    std::vector<MeshLod> build_lod_chain(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        uint32_t max_lod_count,
+        uint32_t cluster_triangle_count
+    )
+    {
+        std::vector<MeshLod> lods;
+        if (max_lod_count == 0 || indices.empty()) return lods;
+
+        MeshLod& lod0 = lods.emplace_back();
+        lod0.vertices.assign(vertices.begin(), vertices.end());
+        lod0.indices.assign(indices.begin(), indices.end());
+        weld_vertices(lod0.vertices, lod0.indices);
+
+        while (lods.size() < max_lod_count)
+        {
+            MeshLod lod = simplify_lod(lods.back(), cluster_triangle_count);
+
+            // 锁定的边界使得简化无法继续推进时停止.
+            if (lod.indices.empty() || lod.indices.size() > lods.back().indices.size() * 9 / 10) break;
+            lods.push_back(std::move(lod));
+        }
+        return lods;
+    }
+}
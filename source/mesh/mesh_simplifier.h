@@ -0,0 +1,119 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "../core/math/surface.h"
+#include <cstdint>
+#include <queue>
+#include <span>
+#include <vector>
+
+namespace fantasy
+{
+    // 基于二次误差度量 (QEM) 的边坍缩简化, 直接在传入的顶点和索引上原地修改.
+    class MeshSimplifier
+    {
+    public:
+        MeshSimplifier(std::span<float3> vertices, std::span<uint32_t> indices);
+
+        // 锁定开放边上的顶点, cluster 局部简化时用来保持与相邻 cluster 的接缝不变.
+        void lock_boundary();
+
+        // 返回简化过程中的最大误差, 为二次误差的平方根, 与顶点坐标同单位.
+        float simplify(uint32_t target_triangle_count);
+
+        // 将剩余的顶点和三角形紧凑排列到 span 的前部, 调用者再按 remaining_*_count() 截断.
+        void compact();
+
+        uint32_t remaining_vertex_count() const { return _remaining_vertex_count; }
+        uint32_t remaining_triangle_count() const { return _remaining_triangle_count; }
+
+    private:
+        struct Collapse
+        {
+            float cost;
+            float3 position;
+            uint32_t vertex0;
+            uint32_t vertex1;
+            uint32_t version0;
+            uint32_t version1;
+
+            bool operator>(const Collapse& other) const { return cost > other.cost; }
+        };
+
+        void build_edges();
+        void push_edge(uint32_t vertex0, uint32_t vertex1);
+        float evaluate(uint32_t vertex0, uint32_t vertex1, float3& out_position);
+        bool collapse(uint32_t vertex0, uint32_t vertex1, const float3& position);
+        bool flipped(uint32_t vertex, uint32_t other, const float3& position);
+        bool triangle_contain(uint32_t triangle, uint32_t vertex) const;
+
+    private:
+        enum VertexFlag : uint8_t
+        {
+            Removed = 0x01,
+            Locked  = 0x02,
+        };
+
+        std::span<float3> _vertices;
+        std::span<uint32_t> _indices;
+
+        uint32_t _remaining_vertex_count = 0;
+        uint32_t _remaining_triangle_count = 0;
+
+        std::vector<QuadricSurface> _vertex_quadrics;
+        std::vector<std::vector<uint32_t>> _vertex_triangles;
+        std::vector<uint32_t> _vertex_versions;
+        std::vector<uint8_t> _vertex_flags;
+        std::vector<uint8_t> _triangle_removed;
+
+        // 每条无向边 (min, max) 及其被引用的三角形数, 只被一个三角形引用的即为开放边.
+        std::vector<std::pair<uint32_t, uint32_t>> _edges;
+        std::vector<uint32_t> _edge_use_counts;
+
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> _heap;
+    };
+
+
+    struct MeshLod
+    {
+        std::vector<float3> vertices;
+        std::vector<uint32_t> indices;
+        float error = 0.0f;     // 与 MeshSimplifier::simplify() 的返回值同单位.
+    };
+
+    // 合并位置完全相同的顶点, 返回焊接后的顶点数.
+    uint32_t weld_vertices(std::vector<float3>& vertices, std::vector<uint32_t>& indices);
+
+    // 按重心做中位数划分, 直到每段不超过 leaf_size 个元素. order 为待划分元素的索引, 会被重排,
+    // 返回的每一段 [begin, end) 都是 order 内的下标, 按空间顺序排列.
+    std::vector<std::pair<uint32_t, uint32_t>> partition_triangles(
+        std::span<const float3> centroids,
+        std::span<uint32_t> order,
+        uint32_t leaf_size
+    );
+
+    // 将网格按空间划分为若干 cluster, 在线程池上并行地对每个 cluster 做局部简化 (锁定 cluster 边界),
+    // 逐级生成 lod 链. lods[0] 为焊接后的原始网格. 需要先调用 parallel::initialize().
+    std::vector<MeshLod> build_lod_chain(
+        std::span<const float3> vertices,
+        std::span<const uint32_t> indices,
+        uint32_t max_lod_count,
+        uint32_t cluster_triangle_count = 4096
+    );
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
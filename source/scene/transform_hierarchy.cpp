@@ -0,0 +1,270 @@
+#include "transform_hierarchy.h"
+#include "../core/parallel/parallel.h"
+#include <algorithm>
+#include <cassert>
+
+namespace fantasy
+{
+    static constexpr uint32_t MIN_TASK_NODE_COUNT = 256;
+
+    uint32_t TransformHierarchy::add_node(uint32_t parent, const float3& position, const Quaternion& rotation, const float3& scale)
+    {
+        assert(parent == INVALID_SIZE_32 || parent < _node_indices.size());
+
+        const uint32_t node = static_cast<uint32_t>(_node_indices.size());
+        const uint32_t index = static_cast<uint32_t>(_parents.size());
+        _node_indices.push_back(index);
+        _index_nodes.push_back(node);
+
+        // 父节点总是先于子节点添加, 追加到末尾仍然满足父节点在前, 子树在下一次 update() 时重排为连续.
+        const uint32_t parent_index = parent == INVALID_SIZE_32 ? INVALID_SIZE_32 : _node_indices[parent];
+        _parents.push_back(parent_index);
+        _subtree_ends.push_back(index + 1);
+        _positions.push_back(position);
+        _rotations.push_back(rotation);
+        _scales.push_back(scale);
+        _local_matrices.emplace_back();
+        _world_matrices.emplace_back();
+        _local_dirty.push_back(1);
+        _world_dirty.push_back(0);
+
+        _structure_dirty = true;
+        return node;
+    }
+
+    void TransformHierarchy::set_local_transform(uint32_t node, const float3& position, const Quaternion& rotation, const float3& scale)
+    {
+        const uint32_t index = _node_indices[node];
+        _positions[index] = position;
+        _rotations[index] = rotation;
+        _scales[index] = scale;
+        _local_dirty[index] = 1;
+    }
+
+    void TransformHierarchy::set_position(uint32_t node, const float3& position)
+    {
+        const uint32_t index = _node_indices[node];
+        _positions[index] = position;
+        _local_dirty[index] = 1;
+    }
+
+    void TransformHierarchy::set_rotation(uint32_t node, const Quaternion& rotation)
+    {
+        const uint32_t index = _node_indices[node];
+        _rotations[index] = rotation;
+        _local_dirty[index] = 1;
+    }
+
+    void TransformHierarchy::set_scale(uint32_t node, const float3& scale)
+    {
+        const uint32_t index = _node_indices[node];
+        _scales[index] = scale;
+        _local_dirty[index] = 1;
+    }
+
+    uint32_t TransformHierarchy::get_parent(uint32_t node) const
+    {
+        const uint32_t parent_index = _parents[_node_indices[node]];
+        return parent_index == INVALID_SIZE_32 ? INVALID_SIZE_32 : _index_nodes[parent_index];
+    }
+
+    void TransformHierarchy::update(bool parallel)
+    {
+        if (_structure_dirty)
+        {
+            sort_nodes();
+            build_tasks();
+            _structure_dirty = false;
+        }
+
+        const uint32_t count = node_count();
+        if (!parallel || _tasks.size() <= 1)
+        {
+            update_range(0, count);
+        }
+        else
+        {
+            for (uint32_t index : _serial_nodes) update_range(index, index + 1);
+
+            parallel::parallel_for(
+                [this](uint64_t task_index)
+                {
+                    const auto [begin, end] = _tasks[task_index];
+                    update_range(begin, end);
+                },
+                _tasks.size()
+            );
+        }
+
+        std::fill(_local_dirty.begin(), _local_dirty.end(), 0);
+        std::fill(_world_dirty.begin(), _world_dirty.end(), 0);
+    }
+
+    void TransformHierarchy::clear()
+    {
+        _node_indices.clear();
+        _index_nodes.clear();
+        _parents.clear();
+        _subtree_ends.clear();
+        _positions.clear();
+        _rotations.clear();
+        _scales.clear();
+        _local_matrices.clear();
+        _world_matrices.clear();
+        _local_dirty.clear();
+        _world_dirty.clear();
+        _serial_nodes.clear();
+        _tasks.clear();
+        _structure_dirty = false;
+    }
+
+    void TransformHierarchy::update_range(uint32_t begin, uint32_t end)
+    {
+        // 先对连续的脏节点批量组合局部矩阵.
+        for (uint32_t index = begin; index < end;)
+        {
+            if (!_local_dirty[index])
+            {
+                index++;
+                continue;
+            }
+
+            uint32_t run_end = index + 1;
+            while (run_end < end && _local_dirty[run_end]) run_end++;
+
+            const uint32_t run_count = run_end - index;
+            compose_transform(
+                std::span<const float3>(_positions.data() + index, run_count),
+                std::span<const Quaternion>(_rotations.data() + index, run_count),
+                std::span<const float3>(_scales.data() + index, run_count),
+                std::span<float4x4>(_local_matrices.data() + index, run_count)
+            );
+            index = run_end;
+        }
+
+        // 父节点的下标总是更小, 顺序遍历即可保证父节点的世界矩阵先被更新.
+        for (uint32_t index = begin; index < end; ++index)
+        {
+            const uint32_t parent = _parents[index];
+            if (parent == INVALID_SIZE_32)
+            {
+                _world_dirty[index] = _local_dirty[index];
+                if (_world_dirty[index]) _world_matrices[index] = _local_matrices[index];
+            }
+            else
+            {
+                _world_dirty[index] = _local_dirty[index] | _world_dirty[parent];
+                if (_world_dirty[index]) mul(_local_matrices[index], _world_matrices[parent], _world_matrices[index]);
+            }
+        }
+    }
+
+    void TransformHierarchy::sort_nodes()
+    {
+        const uint32_t count = node_count();
+
+        std::vector<uint32_t> child_offsets(count + 1, 0);
+        for (uint32_t parent : _parents)
+        {
+            if (parent != INVALID_SIZE_32) child_offsets[parent + 1]++;
+        }
+        for (uint32_t ix = 0; ix < count; ++ix) child_offsets[ix + 1] += child_offsets[ix];
+
+        std::vector<uint32_t> children(child_offsets.back());
+        std::vector<uint32_t> child_cursors(child_offsets.begin(), child_offsets.end() - 1);
+        for (uint32_t ix = 0; ix < count; ++ix)
+        {
+            if (_parents[ix] != INVALID_SIZE_32) children[child_cursors[_parents[ix]]++] = ix;
+        }
+
+        // 深度优先先序遍历, 同一父节点下保持添加顺序.
+        std::vector<uint32_t> order;
+        order.reserve(count);
+        std::vector<uint32_t> stack;
+        for (uint32_t ix = count; ix-- > 0;)
+        {
+            if (_parents[ix] == INVALID_SIZE_32) stack.push_back(ix);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+            order.push_back(index);
+            for (uint32_t ix = child_offsets[index + 1]; ix-- > child_offsets[index];) stack.push_back(children[ix]);
+        }
+        assert(order.size() == count);
+
+        std::vector<uint32_t> new_indices(count);
+        for (uint32_t ix = 0; ix < count; ++ix) new_indices[order[ix]] = ix;
+
+        auto reorder = [&order, count](auto& array)
+        {
+            std::remove_reference_t<decltype(array)> sorted(count);
+            for (uint32_t ix = 0; ix < count; ++ix) sorted[ix] = array[order[ix]];
+            array.swap(sorted);
+        };
+
+        reorder(_positions);
+        reorder(_rotations);
+        reorder(_scales);
+        reorder(_local_matrices);
+        reorder(_world_matrices);
+        reorder(_local_dirty);
+        reorder(_world_dirty);
+        reorder(_index_nodes);
+        reorder(_parents);
+        for (uint32_t& parent : _parents)
+        {
+            if (parent != INVALID_SIZE_32) parent = new_indices[parent];
+        }
+        for (uint32_t ix = 0; ix < count; ++ix) _node_indices[_index_nodes[ix]] = ix;
+
+        for (uint32_t ix = 0; ix < count; ++ix) _subtree_ends[ix] = ix + 1;
+        for (uint32_t ix = count; ix-- > 0;)
+        {
+            const uint32_t parent = _parents[ix];
+            if (parent != INVALID_SIZE_32) _subtree_ends[parent] = std::max(_subtree_ends[parent], _subtree_ends[ix]);
+        }
+    }
+
+    void TransformHierarchy::build_tasks()
+    {
+        _serial_nodes.clear();
+        _tasks.clear();
+
+        const uint32_t count = node_count();
+        const uint32_t thread_count = std::max(parallel::thread_count(), 1u);
+        const uint32_t task_node_count = std::max(count / (thread_count * 4), MIN_TASK_NODE_COUNT);
+
+        std::vector<uint32_t> stack;
+        for (uint32_t root = 0; root < count; root = _subtree_ends[root]) stack.push_back(root);
+        std::reverse(stack.begin(), stack.end());
+
+        while (!stack.empty())
+        {
+            const uint32_t index = stack.back();
+            stack.pop_back();
+
+            const uint32_t end = _subtree_ends[index];
+            if (end - index > task_node_count)
+            {
+                _serial_nodes.push_back(index);
+
+                const uint32_t stack_size = static_cast<uint32_t>(stack.size());
+                for (uint32_t child = index + 1; child < end; child = _subtree_ends[child]) stack.push_back(child);
+                std::reverse(stack.begin() + stack_size, stack.end());
+                continue;
+            }
+
+            // 先序下相邻的小子树下标连续, 合并为一个任务.
+            if (!_tasks.empty() && _tasks.back().second == index && end - _tasks.back().first <= task_node_count)
+            {
+                _tasks.back().second = end;
+            }
+            else
+            {
+                _tasks.emplace_back(index, end);
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef SCENE_TRANSFORM_HIERARCHY_H
+#define SCENE_TRANSFORM_HIERARCHY_H
+
+#include "../core/math/quaternion.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace fantasy
+{
+    // 节点按深度优先先序排列 (父节点在前, 每棵子树连续), 局部 TRS 以 SoA 存储.
+    // 节点 id 在整个生命周期内不变, 内部下标会在结构变化后的 update() 中重排.
+    class TransformHierarchy
+    {
+    public:
+        uint32_t add_node(
+            uint32_t parent = INVALID_SIZE_32,
+            const float3& position = float3(0.0f),
+            const Quaternion& rotation = Quaternion(),
+            const float3& scale = float3(1.0f)
+        );
+
+        void set_local_transform(uint32_t node, const float3& position, const Quaternion& rotation, const float3& scale);
+        void set_position(uint32_t node, const float3& position);
+        void set_rotation(uint32_t node, const Quaternion& rotation);
+        void set_scale(uint32_t node, const float3& scale);
+
+        const float3& get_position(uint32_t node) const { return _positions[_node_indices[node]]; }
+        const Quaternion& get_rotation(uint32_t node) const { return _rotations[_node_indices[node]]; }
+        const float3& get_scale(uint32_t node) const { return _scales[_node_indices[node]]; }
+        uint32_t get_parent(uint32_t node) const;
+
+        // 上一次 update() 的结果.
+        const float4x4& get_world_matrix(uint32_t node) const { return _world_matrices[_node_indices[node]]; }
+
+        // 只重新计算局部变换被修改过的节点及其子树. parallel 为 true 时按子树分配到线程池,
+        // 需要先调用 parallel::initialize().
+        void update(bool parallel = false);
+
+        uint32_t node_count() const { return static_cast<uint32_t>(_parents.size()); }
+        void clear();
+
+    private:
+        void sort_nodes();
+        void build_tasks();
+        void update_range(uint32_t begin, uint32_t end);
+
+    private:
+        std::vector<uint32_t> _node_indices;    // id -> 下标.
+        std::vector<uint32_t> _index_nodes;     // 下标 -> id.
+
+        // 以下均按下标索引.
+        std::vector<uint32_t> _parents;
+        std::vector<uint32_t> _subtree_ends;
+        std::vector<float3> _positions;
+        std::vector<Quaternion> _rotations;
+        std::vector<float3> _scales;
+        std::vector<float4x4> _local_matrices;
+        std::vector<float4x4> _world_matrices;
+        std::vector<uint8_t> _local_dirty;
+        std::vector<uint8_t> _world_dirty;
+
+        bool _structure_dirty = false;
+
+        // 过大的子树先串行处理其根节点, 再将其子树拆为并行任务.
+        std::vector<uint32_t> _serial_nodes;
+        std::vector<std::pair<uint32_t, uint32_t>> _tasks;
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,278 @@
+#include "shader_cache.h"
+#include "../core/tools/file.h"
+#include "../core/tools/log.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fantasy
+{
+    static constexpr uint32_t SHADER_CACHE_MAGIC = 0x43485346;     // "FSHC"
+    static constexpr uint32_t SHADER_CACHE_VERSION = 2;
+    static constexpr uint32_t SHADER_CACHE_RECORD_MAGIC = 0x52544e45;  // "ENTR"
+    static constexpr uint64_t SHADER_CACHE_DATA_ALIGNMENT = 16;
+
+    struct ShaderCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    // 每条记录: 记录头, 依赖文件路径 (uint32 长度 + 字符), 反射的绑定 (ShaderBinding 数组), 对齐填充, 字节码.
+    struct ShaderCacheRecord
+    {
+        uint32_t magic;
+        uint32_t dependency_count;
+        Hash128 request_key;
+        Hash128 content_hash;
+        uint64_t data_size;
+        uint32_t binding_count;
+        uint32_t push_constant_size;
+    };
+
+    static uint64_t align_offset(uint64_t offset)
+    {
+        return (offset + SHADER_CACHE_DATA_ALIGNMENT - 1) & ~(SHADER_CACHE_DATA_ALIGNMENT - 1);
+    }
+
+    bool ShaderCache::initialize(const std::string& pack_path)
+    {
+        std::lock_guard lock(_mutex);
+
+        _pack_path = pack_path;
+        _pack_size = 0;
+        _entries.clear();
+        _file_hashes.clear();
+        _mapping.reset();
+
+        std::filesystem::create_directories(std::filesystem::path(pack_path).parent_path());
+
+        auto mapping = std::make_shared<FileMapping>();
+        ShaderCacheHeader header{};
+        if (is_file_exist(pack_path.c_str()) && mapping->open(pack_path) && mapping->size() >= sizeof(header))
+        {
+            memcpy(&header, mapping->data(), sizeof(header));
+        }
+
+        if (header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION)
+        {
+            mapping.reset();
+
+            // 文件不存在或版本不同时重建.
+            std::ofstream output(pack_path, std::ios::binary | std::ios::trunc);
+            header = ShaderCacheHeader{ .magic = SHADER_CACHE_MAGIC, .version = SHADER_CACHE_VERSION };
+            if (!output.write(reinterpret_cast<const char*>(&header), sizeof(header)))
+            {
+                LOG_ERROR("Create shader cache " + pack_path + " failed.");
+                return false;
+            }
+            _pack_size = sizeof(header);
+            return true;
+        }
+
+        // 只解析记录头和依赖路径, 字节码留在映射中直到被使用.
+        const uint8_t* data = mapping->data();
+        const uint64_t file_size = mapping->size();
+        uint64_t offset = sizeof(header);
+        while (offset + sizeof(ShaderCacheRecord) <= file_size)
+        {
+            ShaderCacheRecord record;
+            memcpy(&record, data + offset, sizeof(record));
+            if (record.magic != SHADER_CACHE_RECORD_MAGIC) break;
+
+            Entry entry;
+            entry.content_hash = record.content_hash;
+            entry.data_size = record.data_size;
+            entry.dependencies.resize(record.dependency_count);
+
+            uint64_t record_offset = offset + sizeof(record);
+            bool valid = true;
+            for (auto& dependency : entry.dependencies)
+            {
+                uint32_t length = 0;
+                if (record_offset + sizeof(length) > file_size) { valid = false; break; }
+                memcpy(&length, data + record_offset, sizeof(length));
+                record_offset += sizeof(length);
+
+                if (record_offset + length > file_size) { valid = false; break; }
+                dependency.assign(reinterpret_cast<const char*>(data + record_offset), length);
+                record_offset += length;
+            }
+            if (!valid) break;
+
+            const uint64_t bindings_size = static_cast<uint64_t>(record.binding_count) * sizeof(ShaderBinding);
+            if (record_offset + bindings_size > file_size) break;
+            entry.reflection.bindings.resize(record.binding_count);
+            memcpy(entry.reflection.bindings.data(), data + record_offset, bindings_size);
+            entry.reflection.push_constant_size = record.push_constant_size;
+            record_offset += bindings_size;
+
+            entry.data_offset = align_offset(record_offset);
+            const uint64_t record_end = entry.data_offset + entry.data_size;
+            if (record_end > file_size) break;
+
+            // 同一个键后写入的记录覆盖之前的.
+            _entries[record.request_key] = std::move(entry);
+            offset = record_end;
+        }
+
+        // 末尾写了一半的记录直接丢弃, 后续追加从最后一条完整记录之后开始.
+        _pack_size = offset;
+        if (file_size != _pack_size)
+        {
+            mapping.reset();
+            std::filesystem::resize_file(pack_path, _pack_size);
+        }
+        else
+        {
+            _mapping = std::move(mapping);
+        }
+        return true;
+    }
+
+    bool ShaderCache::load(const Hash128& request_key, ShaderData& out_data)
+    {
+        std::lock_guard lock(_mutex);
+
+        auto iter = _entries.find(request_key);
+        if (iter == _entries.end()) return false;
+
+        const Entry& entry = iter->second;
+
+        Hash128 content_hash;
+        if (!hash_dependencies(entry.dependencies, content_hash) || content_hash != entry.content_hash) return false;
+
+        // 映射只覆盖建立时的文件大小, 之后追加的记录需要重新映射, 旧的映射由引用它的 ShaderData 保持.
+        if (!_mapping || entry.data_offset + entry.data_size > _mapping->size())
+        {
+            auto mapping = std::make_shared<FileMapping>();
+            if (!mapping->open(_pack_path) || entry.data_offset + entry.data_size > mapping->size())
+            {
+                LOG_ERROR("Map shader cache " + _pack_path + " failed.");
+                return false;
+            }
+            _mapping = std::move(mapping);
+        }
+
+        out_data.set_byte_code(std::span<const uint8_t>(_mapping->data() + entry.data_offset, entry.data_size), _mapping);
+        out_data._include_shader_files = entry.dependencies;
+        out_data._reflection = entry.reflection;
+        return true;
+    }
+
+    bool ShaderCache::save(const Hash128& request_key, const ShaderData& data)
+    {
+        if (data.invalid())
+        {
+            LOG_ERROR("Call to ShaderCache::save() failed for invalid shader data.");
+            return false;
+        }
+
+        std::lock_guard lock(_mutex);
+
+        Entry entry;
+        entry.dependencies = data._include_shader_files;
+        entry.data_size = data.size();
+        entry.reflection = data._reflection;
+        if (!hash_dependencies(entry.dependencies, entry.content_hash)) return false;
+
+        const ShaderCacheRecord record{
+            .magic = SHADER_CACHE_RECORD_MAGIC,
+            .dependency_count = static_cast<uint32_t>(entry.dependencies.size()),
+            .request_key = request_key,
+            .content_hash = entry.content_hash,
+            .data_size = entry.data_size,
+            .binding_count = static_cast<uint32_t>(entry.reflection.bindings.size()),
+            .push_constant_size = entry.reflection.push_constant_size
+        };
+
+        std::ofstream output(_pack_path, std::ios::binary | std::ios::in | std::ios::out);
+        if (!output.is_open() || !output.seekp(static_cast<std::streamoff>(_pack_size)))
+        {
+            LOG_ERROR("Open shader cache " + _pack_path + " failed.");
+            return false;
+        }
+
+        uint64_t offset = _pack_size + sizeof(record);
+        output.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        for (const auto& dependency : entry.dependencies)
+        {
+            const uint32_t length = static_cast<uint32_t>(dependency.size());
+            output.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            output.write(dependency.data(), length);
+            offset += sizeof(length) + length;
+        }
+
+        const uint64_t bindings_size = entry.reflection.bindings.size() * sizeof(ShaderBinding);
+        output.write(reinterpret_cast<const char*>(entry.reflection.bindings.data()), static_cast<std::streamsize>(bindings_size));
+        offset += bindings_size;
+
+        const char padding[SHADER_CACHE_DATA_ALIGNMENT] = {};
+        entry.data_offset = align_offset(offset);
+        output.write(padding, static_cast<std::streamsize>(entry.data_offset - offset));
+        output.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(entry.data_size));
+
+        if (!output.good())
+        {
+            LOG_ERROR("Write shader cache " + _pack_path + " failed.");
+            return false;
+        }
+
+        _pack_size = entry.data_offset + entry.data_size;
+        _entries[request_key] = std::move(entry);
+        return true;
+    }
+
+    uint32_t ShaderCache::entry_count()
+    {
+        std::lock_guard lock(_mutex);
+        return static_cast<uint32_t>(_entries.size());
+    }
+
+    void ShaderCache::invalidate_file(const std::string& path)
+    {
+        std::lock_guard lock(_mutex);
+        _file_hashes.erase(path);
+    }
+
+    bool ShaderCache::get_dependency_hash(const std::vector<std::string>& dependencies, Hash128& out_hash)
+    {
+        std::lock_guard lock(_mutex);
+        return hash_dependencies(dependencies, out_hash);
+    }
+
+    bool ShaderCache::hash_dependencies(const std::vector<std::string>& dependencies, Hash128& out_hash)
+    {
+        out_hash = Hash128{};
+        for (const auto& dependency : dependencies)
+        {
+            Hash128 file_hash;
+            if (!hash_file(dependency, file_hash)) return false;
+            out_hash = murmur_hash128(out_hash, &file_hash, sizeof(Hash128));
+        }
+        return true;
+    }
+
+    bool ShaderCache::hash_file(const std::string& path, Hash128& out_hash)
+    {
+        auto iter = _file_hashes.find(path);
+        if (iter != _file_hashes.end())
+        {
+            out_hash = iter->second;
+            return true;
+        }
+
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input.is_open()) return false;
+
+        std::string content(static_cast<uint64_t>(input.tellg()), '\0');
+        input.seekg(0);
+        if (!input.read(content.data(), static_cast<std::streamsize>(content.size()))) return false;
+
+        // 路径也参与 hash, 同样内容的文件换了位置视为不同依赖.
+        out_hash = murmur_hash128(path.data(), path.size());
+        out_hash = murmur_hash128(out_hash, content.data(), content.size());
+        _file_hashes[path] = out_hash;
+        return true;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "shader_compiler.h"
+#include "../core/tools/hash_table.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy
+{
+    // 所有编译结果追加写入同一个 pack 文件, 启动时映射整个文件并只解析记录头建立内存索引,
+    // load() 返回的字节码直接指向映射, 不做拷贝.
+    // 键为编译请求的 hash (文件名, 入口, 宏, 目标格式与 profile, 编译器版本), 命中后再比较所有依赖文件内容的 hash,
+    // 依赖文件的 hash 在进程内只计算一次, 因此不会检查文件时间戳. 所有接口可在多个线程中同时调用.
+    class ShaderCache
+    {
+    public:
+        bool initialize(const std::string& pack_path);
+
+        bool load(const Hash128& request_key, ShaderData& out_data);
+        bool save(const Hash128& request_key, const ShaderData& data);
+
+        // 文件被修改后调用, 下一次 load 时重新计算其内容 hash.
+        void invalidate_file(const std::string& path);
+
+        // 依次合并各文件的内容 hash, 与缓存条目使用同样的进程内文件 hash 表.
+        bool get_dependency_hash(const std::vector<std::string>& dependencies, Hash128& out_hash);
+
+        uint32_t entry_count();
+
+    private:
+        struct Entry
+        {
+            Hash128 content_hash;
+            std::vector<std::string> dependencies;
+            ShaderReflection reflection;
+            uint64_t data_offset = 0;
+            uint64_t data_size = 0;
+        };
+
+        bool hash_dependencies(const std::vector<std::string>& dependencies, Hash128& out_hash);
+        bool hash_file(const std::string& path, Hash128& out_hash);
+
+    private:
+        std::mutex _mutex;
+
+        std::string _pack_path;
+        uint64_t _pack_size = 0;
+        std::shared_ptr<FileMapping> _mapping;
+
+        std::unordered_map<Hash128, Entry, Hash128Hasher> _entries;
+        std::unordered_map<std::string, Hash128> _file_hashes;
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
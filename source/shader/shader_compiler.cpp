@@ -1,9 +1,18 @@
 ﻿#include "shader_compiler.h"
+#include "shader_cache.h"
+#include "spirv_strip.h"
 
+#include "../core/parallel/parallel.h"
 #include "../core/tools/file.h"
 #include "../core/tools/log.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <exception>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <winerror.h>
 #include <winnt.h>
@@ -16,98 +25,143 @@
 
 namespace fantasy 
 {
-    bool check_cache(const char* cache_path, const char* shader_path)
+    // slang 的 global session 不是线程安全的, 每个编译线程各持有一个, 以及由它创建的 session.
+    // 加载过的模块缓存在 session 中, 同一文件和配置的多个入口只解析一次源码.
+    struct CompilerContext
     {
-        if (!is_file_exist(cache_path)) return false;
-        if (compare_file_write_time(shader_path, cache_path)) return false;
-        return true;
-    }
+        Slang::ComPtr<slang::IGlobalSession> global_session;
+        std::unordered_map<Hash128, Slang::ComPtr<slang::ISession>, Hash128Hasher> sessions;
+        uint64_t generation = 0;
+    };
 
-    void save_to_cache(const char* cache_path, const ShaderData& data)
-    {
-        if (data.invalid())
-        {
-            LOG_ERROR("Call to FShaderCompiler::save_to_cache() failed for invalid Shader data.");
-            return;
-        }
+    static constexpr uint32_t MAX_SESSION_COUNT_PER_THREAD = 64;
 
-        serialization::BinaryOutput output(cache_path);
-        output(data._data.size());
-        output.save_binary_data(data._data.data(), data._data.size());
-    }
+    thread_local CompilerContext compiler_context;
 
-    ShaderData load_from_cache(const char* cache_path)
-    {
-        ShaderData shader_data;
-        
-        serialization::BinaryInput input(cache_path);
+    // 源文件每次被修改时递增, 之前创建的 session 中的模块已经过期.
+    std::atomic<uint64_t> session_generation = 0;
+    ShaderPlatform platform = ShaderPlatform::SPIRV;
 
-        uint64_t ByteCodeSize = 0;
-        input(ByteCodeSize);
-        shader_data._data.resize(ByteCodeSize);
-        input.load_binary_data(shader_data._data.data(), ByteCodeSize);
+    ShaderCache shader_cache;
+    std::once_flag shader_cache_flag;
 
-        return shader_data;
+    // 编译之前由 ShaderCompileDesc 得到的所有信息, 在调用线程上计算.
+    struct CompileRequest
+    {
+        ShaderPlatform platform = ShaderPlatform::SPIRV;
+        const char* profile_name = nullptr;
+
+        // DEBUG 在所有模式下都有定义, 调试信息由 xmake 只在 debug 模式下定义的 SHADER_DEBUG_INFO 控制.
+#ifdef SHADER_DEBUG_INFO
+        int32_t debug_info = SLANG_DEBUG_INFO_LEVEL_MINIMAL;
+        int32_t optimization = SLANG_OPTIMIZATION_LEVEL_NONE;
+#else
+        int32_t debug_info = SLANG_DEBUG_INFO_LEVEL_NONE;
+        int32_t optimization = SLANG_OPTIMIZATION_LEVEL_HIGH;
+#endif
+        std::string shader_path;
+        std::string search_path;
+
+        // 目标, 搜索路径和宏都相同的请求共用 session, slang 的宏是按 session 设置的, 所以宏也是键的一部分.
+        Hash128 session_key;
+        Hash128 request_key;
+    };
+
+    static Hash128 hash_string(const Hash128& seed, const std::string& str)
+    {
+        const uint64_t size = str.size();
+        return murmur_hash128(murmur_hash128(seed, &size, sizeof(size)), str.data(), size);
     }
 
-
-
-    Slang::ComPtr<slang::IGlobalSession> global_session;
-    ShaderPlatform platform = ShaderPlatform::SPIRV;
-
-    void set_shader_platform(ShaderPlatform in_platform)
+    static void initialize_shader_cache()
     {
-        platform = in_platform;
+        std::call_once(
+            shader_cache_flag,
+            []()
+            {
+                if (!shader_cache.initialize(std::string(PROJ_DIR) + "asset/shader_cache/shader_cache.pack"))
+                {
+                    LOG_ERROR("Initialize shader cache failed.");
+                }
+            }
+        );
     }
 
+    static bool make_compile_request(const ShaderCompileDesc& desc, ShaderPlatform in_platform, CompileRequest& out_request)
+    {
+        out_request.platform = in_platform;
+        out_request.shader_path = std::string(PROJ_DIR) + "source/shader/" + desc.shader_name;
 
-    ShaderData compile_shader(const ShaderCompileDesc& desc)
-    { 
-        if (global_session == nullptr)
+        size_t pos = out_request.shader_path.find_last_of('/');
+        if (pos == std::string::npos)
         {
-            SlangResult res = createGlobalSession(global_session.writeRef());
-            assert(res == SLANG_OK);
+            LOG_ERROR("Find hlsl file's Directory failed.");
+            return false;
         }
+        out_request.search_path = out_request.shader_path.substr(0, pos);
 
-        if (global_session == nullptr)
+        switch (in_platform)
         {
-            LOG_ERROR("Please call fantasy::StaticShaderCompiler::initialize() first.");
-            return ShaderData{};
+        case ShaderPlatform::DXIL: out_request.profile_name = "sm_6_5"; break;
+        case ShaderPlatform::SPIRV: out_request.profile_name = "spirv_1_0"; break;
         }
 
-        const std::string proj_path = PROJ_DIR;
-        const std::string cache_path = proj_path + "asset/shader_cache/" + remove_file_extension(desc.shader_name.c_str()) + "_" + desc.entry_point + "_DEBUG.bin";
-        const std::string shader_path = proj_path + "source/shader/" + desc.shader_name;
+        Hash128 key = murmur_hash128(&in_platform, sizeof(in_platform));
+        key = hash_string(key, out_request.profile_name);
+        key = murmur_hash128(key, &out_request.debug_info, sizeof(out_request.debug_info));
+        key = murmur_hash128(key, &out_request.optimization, sizeof(out_request.optimization));
+        key = hash_string(key, out_request.search_path);
+
+        // 宏的顺序不影响编译结果.
+        std::vector<std::string> defines = desc.defines;
+        std::sort(defines.begin(), defines.end());
+        for (const auto& define : defines) key = hash_string(key, define);
+        out_request.session_key = key;
+
+        // 请求的键包含除源码内容以外所有影响结果的因素,
+        // 源码内容由缓存条目中保存的依赖列表另外校验.
+        key = hash_string(key, desc.shader_name);
+        key = hash_string(key, desc.entry_point);
+        key = murmur_hash128(key, &desc.target, sizeof(desc.target));
+        key = hash_string(key, spGetBuildTagString());
+        out_request.request_key = key;
+        return true;
+    }
 
-        if (check_cache(cache_path.c_str(), shader_path.c_str()))
+    static slang::ISession* get_session(const ShaderCompileDesc& desc, const CompileRequest& request)
+    {
+        CompilerContext& context = compiler_context;
+        if (context.global_session == nullptr)
         {
-            return load_from_cache(cache_path.c_str());
+            if (SLANG_FAILED(createGlobalSession(context.global_session.writeRef())))
+            {
+                LOG_ERROR("Create slang global session failed.");
+                return nullptr;
+            }
         }
 
-        size_t pos = shader_path.find_last_of('/');
-        if (pos == std::string::npos)
+        const uint64_t generation = session_generation.load();
+        if (context.generation != generation)
         {
-            LOG_ERROR("Find hlsl file's Directory failed.");
-            return ShaderData{};
+            context.sessions.clear();
+            context.generation = generation;
         }
-        const std::string file_directory = shader_path.substr(0, pos);
 
+        auto iter = context.sessions.find(request.session_key);
+        if (iter != context.sessions.end()) return iter->second.get();
+
+        // 每个 session 都持有加载过的模块, 数量过多时全部丢弃.
+        if (context.sessions.size() >= MAX_SESSION_COUNT_PER_THREAD) context.sessions.clear();
 
         slang::SessionDesc session_desc{};
 
         slang::TargetDesc target_desc = {};
-        switch (platform)
+        switch (request.platform)
         {
-        case ShaderPlatform::DXIL:
-            target_desc.format = SLANG_DXIL;
-            target_desc.profile = global_session->findProfile("sm_6_5");
-            break;
-        case ShaderPlatform::SPIRV:
-            target_desc.format = SLANG_SPIRV;
-            target_desc.profile = global_session->findProfile("spirv_1_0");
-            break;        
+        case ShaderPlatform::DXIL: target_desc.format = SLANG_DXIL; break;
+        case ShaderPlatform::SPIRV: target_desc.format = SLANG_SPIRV; break;
         }
-        
+        target_desc.profile = context.global_session->findProfile(request.profile_name);
 
         session_desc.targets = &target_desc;
         session_desc.targetCount = 1;
@@ -133,29 +187,96 @@ namespace fantasy
         session_desc.preprocessorMacros = preprocessor_macro_desc.data();
         session_desc.preprocessorMacroCount = preprocessor_macro_desc.size();
 
-        std::array<slang::CompilerOptionEntry, 1> options = 
+        std::array<slang::CompilerOptionEntry, 2> options =
         {
-            { 
+            slang::CompilerOptionEntry{
                 slang::CompilerOptionName::DebugInformation,
-                { slang::CompilerOptionValueKind::Int, 1, 0, nullptr, nullptr }
+                { slang::CompilerOptionValueKind::Int, request.debug_info, 0, nullptr, nullptr }
+            },
+            slang::CompilerOptionEntry{
+                slang::CompilerOptionName::Optimization,
+                { slang::CompilerOptionValueKind::Int, request.optimization, 0, nullptr, nullptr }
             }
         };
         session_desc.compilerOptionEntries = options.data();
         session_desc.compilerOptionEntryCount = options.size();
 
-        const char* searchPaths[] = { file_directory.c_str() };
+        const char* searchPaths[] = { request.search_path.c_str() };
         session_desc.searchPaths = searchPaths;
         session_desc.searchPathCount = 1;
 
         Slang::ComPtr<slang::ISession> session;
-        if (SLANG_FAILED(global_session->createSession(session_desc, session.writeRef())))
+        if (SLANG_FAILED(context.global_session->createSession(session_desc, session.writeRef())))
         {
             LOG_ERROR("Create session failed.");
-            return ShaderData{};
+            return nullptr;
+        }
+        return context.sessions.emplace(request.session_key, session).first->second.get();
+    }
+
+    static ShaderResourceType convert_binding_type(uint32_t type)
+    {
+        const bool mutable_resource = (type & SLANG_BINDING_TYPE_MUTABLE_FLAG) != 0;
+        switch (type & ~static_cast<uint32_t>(SLANG_BINDING_TYPE_MUTABLE_FLAG))
+        {
+        case SLANG_BINDING_TYPE_CONSTANT_BUFFER: return ShaderResourceType::ConstantBuffer;
+        case SLANG_BINDING_TYPE_TEXTURE: return mutable_resource ? ShaderResourceType::StorageTexture : ShaderResourceType::Texture;
+        case SLANG_BINDING_TYPE_TYPED_BUFFER: return mutable_resource ? ShaderResourceType::StorageTypedBuffer : ShaderResourceType::TypedBuffer;
+        case SLANG_BINDING_TYPE_RAW_BUFFER: return ShaderResourceType::StorageBuffer;
+        case SLANG_BINDING_TYPE_SAMPLER: return ShaderResourceType::Sampler;
+        case SLANG_BINDING_TYPE_COMBINED_TEXTURE_SAMPLER: return ShaderResourceType::CombinedTextureSampler;
+        case SLANG_BINDING_TYPE_RAY_TRACING_ACCELERATION_STRUCTURE: return ShaderResourceType::AccelerationStructure;
+        default: return ShaderResourceType::Unknown;
+        }
+    }
+
+    // 只反射全局的着色器参数, 入口函数的 uniform 参数不处理.
+    static void reflect_program(slang::ProgramLayout* layout, ShaderReflection& out_reflection)
+    {
+        out_reflection = ShaderReflection{};
+        for (uint32_t ix = 0; ix < layout->getParameterCount(); ++ix)
+        {
+            slang::VariableLayoutReflection* parameter = layout->getParameterByIndex(ix);
+            slang::TypeLayoutReflection* type_layout = parameter->getTypeLayout();
+
+            const uint32_t category = static_cast<uint32_t>(parameter->getCategory());
+            if (category == SLANG_PARAMETER_CATEGORY_PUSH_CONSTANT_BUFFER)
+            {
+                const uint32_t size = static_cast<uint32_t>(type_layout->getElementTypeLayout()->getSize());
+                out_reflection.push_constant_size = std::max(out_reflection.push_constant_size, size);
+            }
+            else if (category == SLANG_PARAMETER_CATEGORY_DESCRIPTOR_TABLE_SLOT && type_layout->getBindingRangeCount() > 0)
+            {
+                const SlangInt count = type_layout->getBindingRangeBindingCount(0);
+                out_reflection.bindings.push_back(ShaderBinding{
+                    .set = static_cast<uint32_t>(parameter->getBindingSpace()),
+                    .binding = static_cast<uint32_t>(parameter->getBindingIndex()),
+                    .count = count < 0 ? 0 : static_cast<uint32_t>(count),
+                    .type = convert_binding_type(static_cast<uint32_t>(type_layout->getBindingRangeType(0)))
+                });
+            }
         }
 
+        std::sort(
+            out_reflection.bindings.begin(),
+            out_reflection.bindings.end(),
+            [](const ShaderBinding& a, const ShaderBinding& b) { return a.set != b.set ? a.set < b.set : a.binding < b.binding; }
+        );
+    }
+
+    static ShaderData compile_request(const ShaderCompileDesc& desc, const CompileRequest& request)
+    {
+        ShaderData cached_data;
+        if (shader_cache.load(request.request_key, cached_data))
+        {
+            return cached_data;
+        }
+
+        slang::ISession* session = get_session(desc, request);
+        if (session == nullptr) return ShaderData{};
+
         Slang::ComPtr<slang::IBlob> diagnostics;
-        Slang::ComPtr<slang::IModule> module(session->loadModule(shader_path.c_str(), diagnostics.writeRef()));
+        Slang::ComPtr<slang::IModule> module(session->loadModule(request.shader_path.c_str(), diagnostics.writeRef()));
         if (diagnostics)
         {
             LOG_ERROR((const char*) diagnostics->getBufferPointer());
@@ -186,8 +307,6 @@ namespace fantasy
         }
         diagnostics.setNull();
 
-        int32_t entryPointIndex = 0;
-        int32_t targetIndex = 0;
         Slang::ComPtr<slang::IBlob> pKernelBlob;
         if (SLANG_FAILED(linked_program->getEntryPointCode(0, 0, pKernelBlob.writeRef(), diagnostics.writeRef())) || diagnostics)
         {
@@ -199,18 +318,127 @@ namespace fantasy
         ShaderData shader_data;
         shader_data.set_byte_code(pKernelBlob->getBufferPointer(), pKernelBlob->getBufferSize());
 
-        save_to_cache(cache_path.c_str(), shader_data);
+        // 不生成调试信息时 slang 仍会输出名字和源码信息, release 下从字节码中去掉.
+        if (request.platform == ShaderPlatform::SPIRV && request.debug_info == SLANG_DEBUG_INFO_LEVEL_NONE)
+        {
+            if (!strip_spirv_debug_info(shader_data._data))
+            {
+                LOG_ERROR("Strip debug info of " + desc.shader_name + " failed.");
+                return ShaderData{};
+            }
+        }
+
+        slang::ProgramLayout* layout = linked_program->getLayout();
+        if (layout == nullptr)
+        {
+            LOG_ERROR("Get program layout failed.");
+            return ShaderData{};
+        }
+        reflect_program(layout, shader_data._reflection);
+
+        // 模块读取过的所有文件, 包括主文件和所有 include.
+        for (int32_t ix = 0; ix < module->getDependencyFileCount(); ++ix)
+        {
+            shader_data._include_shader_files.push_back(normalize_path(module->getDependencyFilePath(ix)));
+        }
+
+        shader_cache.save(request.request_key, shader_data);
 
         return shader_data;
     }
-}
 
 
+    void set_shader_platform(ShaderPlatform in_platform)
+    {
+        platform = in_platform;
+    }
 
+    void invalidate_shader_file(const std::string& path)
+    {
+        shader_cache.invalidate_file(normalize_path(path));
+        session_generation++;
+    }
+
+
+    ShaderData compile_shader(const ShaderCompileDesc& desc)
+    {
+        initialize_shader_cache();
+
+        CompileRequest request;
+        if (!make_compile_request(desc, platform, request)) return ShaderData{};
+        return compile_request(desc, request);
+    }
+
+    bool get_shader_request_key(const ShaderCompileDesc& desc, Hash128& out_key)
+    {
+        CompileRequest request;
+        ReturnIfFalse(make_compile_request(desc, platform, request));
+        out_key = request.request_key;
+        return true;
+    }
 
+    bool get_shader_source_hash(const std::vector<std::string>& paths, Hash128& out_hash)
+    {
+        initialize_shader_cache();
+        return shader_cache.get_dependency_hash(paths, out_hash);
+    }
 
+    std::vector<std::shared_future<ShaderData>> compile_shaders(std::span<const ShaderCompileDesc> descs)
+    {
+        initialize_shader_cache();
 
+        std::vector<std::shared_future<ShaderData>> futures;
+        futures.reserve(descs.size());
 
+        std::unordered_map<Hash128, std::shared_future<ShaderData>, Hash128Hasher> request_futures;
+        for (const auto& desc : descs)
+        {
+            CompileRequest request;
+            if (!make_compile_request(desc, platform, request))
+            {
+                std::promise<ShaderData> promise;
+                promise.set_value(ShaderData{});
+                futures.push_back(promise.get_future().share());
+                continue;
+            }
+
+            // 批次中相同的请求只编译一次.
+            auto iter = request_futures.find(request.request_key);
+            if (iter == request_futures.end())
+            {
+                auto promise = std::make_shared<std::promise<ShaderData>>();
+                iter = request_futures.emplace(request.request_key, promise->get_future().share()).first;
+
+                // slang 或内存分配抛出异常时 promise 也必须被设置, 否则等待 future 的线程永远阻塞.
+                auto compile = [promise, desc, request = std::move(request)]()
+                {
+                    ShaderData data;
+                    try
+                    {
+                        data = compile_request(desc, request);
+                    }
+                    catch (const std::exception& exception)
+                    {
+                        LOG_ERROR("Compile shader " + desc.shader_name + " threw: " + exception.what());
+                        data = ShaderData{};
+                    }
+                    catch (...)
+                    {
+                        LOG_ERROR("Compile shader " + desc.shader_name + " threw an unknown exception.");
+                        data = ShaderData{};
+                    }
+                    promise->set_value(std::move(data));
+                };
+
+                // 已经在 worker 上时直接编译, 调用者之后等待 future 不会占住 worker 而死锁.
+                if (parallel::is_worker_thread()) compile();
+                else parallel::begin_task(std::move(compile));
+            }
+            futures.push_back(iter->second);
+        }
+        return futures;
+    }
+}
 
 
 
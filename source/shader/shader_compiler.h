@@ -3,8 +3,14 @@
 
 
 #include <basetsd.h>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
+#include "../core/tools/file_mapping.h"
+#include "../core/tools/hash_table.h"
 
 namespace fantasy 
 {
@@ -37,13 +43,54 @@ namespace fantasy
         std::vector<std::string> defines;
     };
 
+    enum class ShaderResourceType : uint32_t
+    {
+        ConstantBuffer,
+        Texture,
+        StorageTexture,
+        TypedBuffer,
+        StorageTypedBuffer,
+        StorageBuffer,
+        Sampler,
+        CombinedTextureSampler,
+        AccelerationStructure,
+        Unknown
+    };
+
+    struct ShaderBinding
+    {
+        uint32_t set = 0;
+        uint32_t binding = 0;
+        uint32_t count = 1;     // 不定长数组为 0.
+        ShaderResourceType type = ShaderResourceType::Unknown;
+
+        bool operator==(const ShaderBinding&) const = default;
+    };
+
+    // 编译时从 slang 的反射中提取, 与字节码一起存入缓存,
+    // 创建管线布局时不需要重新编译, 也不需要解析字节码.
+    struct ShaderReflection
+    {
+        std::vector<ShaderBinding> bindings;
+        uint32_t push_constant_size = 0;
+
+        bool operator==(const ShaderReflection&) const = default;
+    };
+
     struct ShaderData
     {
         std::vector<uint8_t> _data;
         std::vector<std::string> _include_shader_files;
+        ShaderReflection _reflection;
+
+        // 从缓存读取的字节码直接指向映射的文件, 不在 _data 中,
+        // _mapping 保证字节码被使用期间映射一直有效.
+        std::span<const uint8_t> _mapped_data;
+        std::shared_ptr<const FileMapping> _mapping;
 
-        uint64_t size() const { return _data.size(); }
-        uint8_t* data() { return _data.data(); }
+        std::span<const uint8_t> byte_code() const { return _mapping ? _mapped_data : std::span<const uint8_t>(_data); }
+        uint64_t size() const { return byte_code().size(); }
+        const uint8_t* data() const { return byte_code().data(); }
 
         void set_byte_code(const void* data, uint64_t size)
         {
@@ -51,14 +98,38 @@ namespace fantasy
             {
                 _data.resize(size);
                 memcpy(_data.data(), data, size);
+                _mapped_data = {};
+                _mapping.reset();
             }
         }
 
-        bool invalid() const { return _data.empty(); }
+        void set_byte_code(std::span<const uint8_t> mapped_data, std::shared_ptr<const FileMapping> mapping)
+        {
+            _data.clear();
+            _mapped_data = mapped_data;
+            _mapping = std::move(mapping);
+        }
+
+        bool invalid() const { return size() == 0; }
     };
 
     void set_shader_platform(ShaderPlatform platform);
+
+    // 源文件在磁盘上被修改后调用, 下一次编译时重新计算其 hash 并重新加载相关模块.
+    void invalidate_shader_file(const std::string& path);
     ShaderData compile_shader(const ShaderCompileDesc& desc);
+
+    // 与 shader 缓存相同的请求键 (平台, profile, 调试与优化选项, 宏, 入口, 编译器版本), 不包括源码内容.
+    bool get_shader_request_key(const ShaderCompileDesc& desc, Hash128& out_key);
+
+    // 源文件内容的 hash, 每个文件在进程内只读取一次, invalidate_shader_file() 之后重新读取.
+    bool get_shader_source_hash(const std::vector<std::string>& paths, Hash128& out_hash);
+
+    // 在线程池上编译, 需要先调用 parallel::initialize(). 每个工作线程持有自己的 slang session,
+    // 相同的请求共用一个 future, 编译失败 (包括抛出异常) 的请求得到无效的 ShaderData.
+    // 在线程池的 worker 上调用时在当前线程依次编译, 返回的 future 都已就绪;
+    // 不要在 worker 任务中等待其它线程调用返回的 future, 线程池可能只有一个 worker.
+    std::vector<std::shared_future<ShaderData>> compile_shaders(std::span<const ShaderCompileDesc> descs);
 }
 
 
@@ -0,0 +1,219 @@
+#include "shader_hot_reload.h"
+#include "../core/tools/file.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+
+namespace fantasy
+{
+    static constexpr uint32_t WATCH_TIMEOUT_MS = 100;
+
+    // 编辑器保存时经常分几步 (截断, 写入, 重命名), 等这些操作结束.
+    static constexpr uint32_t DEBOUNCE_MS = 20;
+
+    ShaderHotReload::~ShaderHotReload()
+    {
+        destroy();
+    }
+
+    bool ShaderHotReload::initialize(const std::string& directory)
+    {
+        destroy();
+
+        if (!_watcher.initialize(directory)) return false;
+
+        _stop = false;
+        _thread = std::thread(&ShaderHotReload::watch_thread, this);
+        return true;
+    }
+
+    void ShaderHotReload::destroy()
+    {
+        _stop = true;
+        if (_thread.joinable()) _thread.join();
+        _watcher.destroy();
+
+        std::lock_guard lock(_mutex);
+        _pending_reloads.clear();
+    }
+
+    void ShaderHotReload::add_program(std::vector<ShaderCompileDesc> descs, std::span<const ShaderData> datas, ReloadFunc func)
+    {
+        std::lock_guard lock(_mutex);
+        const uint32_t program = static_cast<uint32_t>(_programs.size());
+        _programs.push_back(Program{ .stages = std::vector<Stage>(descs.size()), .func = std::move(func) });
+
+        for (uint32_t ix = 0; ix < descs.size(); ++ix)
+        {
+            std::vector<std::string> dependencies;
+            if (ix < datas.size() && !datas[ix]._include_shader_files.empty())
+            {
+                dependencies = datas[ix]._include_shader_files;
+                _programs[program].stages[ix].data = datas[ix];
+            }
+            else
+            {
+                // 编译失败时至少监视主文件, 修复后可以触发重载.
+                dependencies.push_back(normalize_path(std::string(PROJ_DIR) + "source/shader/" + descs[ix].shader_name));
+            }
+
+            _programs[program].stages[ix].desc = std::move(descs[ix]);
+            set_dependencies(StageIndex{ .program = program, .stage = ix }, std::move(dependencies));
+        }
+    }
+
+    void ShaderHotReload::update()
+    {
+        std::vector<Reload> reloads;
+        {
+            std::unique_lock lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock() || _pending_reloads.empty()) return;
+            reloads.swap(_pending_reloads);
+        }
+
+        for (const auto& reload : reloads)
+        {
+            reload.commit();
+
+            _last_reload_latency_ms = std::chrono::duration<float, std::milli>(clock::now() - reload.change_time).count();
+            LOG_INFO("Shader hot reload finished in " + std::to_string(_last_reload_latency_ms) + " ms.");
+        }
+    }
+
+    void ShaderHotReload::watch_thread()
+    {
+        std::vector<std::string> changed_files;
+        while (!_stop)
+        {
+            changed_files.clear();
+            if (!_watcher.wait_changes(changed_files, WATCH_TIMEOUT_MS))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_TIMEOUT_MS));
+                continue;
+            }
+            if (changed_files.empty()) continue;
+
+            const clock::time_point change_time = clock::now();
+            while (!_stop)
+            {
+                const uint64_t count = changed_files.size();
+                if (!_watcher.wait_changes(changed_files, DEBOUNCE_MS) || changed_files.size() == count) break;
+            }
+
+            std::sort(changed_files.begin(), changed_files.end());
+            changed_files.erase(std::unique(changed_files.begin(), changed_files.end()), changed_files.end());
+
+            std::vector<StageIndex> stages;
+            {
+                std::lock_guard lock(_mutex);
+                for (const auto& file : changed_files)
+                {
+                    auto iter = _dependents.find(file);
+                    if (iter != _dependents.end()) stages.insert(stages.end(), iter->second.begin(), iter->second.end());
+                }
+            }
+            if (stages.empty()) continue;
+
+            for (const auto& file : changed_files) invalidate_shader_file(file);
+
+            // 按程序分组, 每个程序只重新编译受影响的入口.
+            std::sort(stages.begin(), stages.end());
+            stages.erase(std::unique(stages.begin(), stages.end()), stages.end());
+
+            std::vector<uint32_t> program_stages;
+            for (uint64_t ix = 0; ix < stages.size(); ++ix)
+            {
+                program_stages.push_back(stages[ix].stage);
+                if (ix + 1 == stages.size() || stages[ix + 1].program != stages[ix].program)
+                {
+                    recompile(stages[ix].program, program_stages, change_time);
+                    program_stages.clear();
+                }
+            }
+        }
+    }
+
+    void ShaderHotReload::recompile(uint32_t program, std::span<const uint32_t> stages, clock::time_point change_time)
+    {
+        // 之前编译失败的入口没有可以沿用的字节码, 一并重新编译.
+        std::vector<uint32_t> compile_stages(stages.begin(), stages.end());
+        std::vector<ShaderCompileDesc> descs;
+        {
+            std::lock_guard lock(_mutex);
+            const auto& program_stages = _programs[program].stages;
+            for (uint32_t ix = 0; ix < program_stages.size(); ++ix)
+            {
+                if (program_stages[ix].data.invalid() && std::find(stages.begin(), stages.end(), ix) == stages.end())
+                {
+                    compile_stages.push_back(ix);
+                }
+            }
+            for (uint32_t stage : compile_stages) descs.push_back(program_stages[stage].desc);
+        }
+
+        std::vector<ShaderData> datas;
+        for (const auto& desc : descs)
+        {
+            ShaderData data = compile_shader(desc);
+            if (data.invalid())
+            {
+                // 保留旧的管线和 include 图, 下一次保存时重试.
+                LOG_ERROR("Shader hot reload of " + desc.shader_name + " failed to compile.");
+                return;
+            }
+            datas.push_back(std::move(data));
+        }
+
+        ReloadFunc func;
+        std::vector<ShaderData> program_datas;
+        {
+            std::lock_guard lock(_mutex);
+
+            // 修改后 include 的文件可能也变了.
+            for (uint32_t ix = 0; ix < compile_stages.size(); ++ix)
+            {
+                const StageIndex index{ .program = program, .stage = compile_stages[ix] };
+                set_dependencies(index, datas[ix]._include_shader_files);
+                _programs[program].stages[index.stage].data = std::move(datas[ix]);
+            }
+
+            for (const auto& stage : _programs[program].stages) program_datas.push_back(stage.data);
+            func = _programs[program].func;
+        }
+
+        // 管线等对象也在后台线程创建, 渲染线程只执行提交函数.
+        Reload reload{ .program = program, .commit = {}, .change_time = change_time };
+        if (!func(program_datas, reload.commit) || !reload.commit)
+        {
+            LOG_ERROR("Shader hot reload failed.");
+            return;
+        }
+
+        std::lock_guard lock(_mutex);
+
+        // 同一程序尚未被取走的结果直接被新的结果替换.
+        auto iter = std::find_if(
+            _pending_reloads.begin(),
+            _pending_reloads.end(),
+            [program](const Reload& pending) { return pending.program == program; }
+        );
+        if (iter != _pending_reloads.end()) *iter = std::move(reload);
+        else _pending_reloads.push_back(std::move(reload));
+    }
+
+    void ShaderHotReload::set_dependencies(StageIndex index, std::vector<std::string> dependencies)
+    {
+        std::sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+        Stage& stage = _programs[index.program].stages[index.stage];
+        for (const auto& file : stage.dependencies)
+        {
+            auto& stages = _dependents[file];
+            stages.erase(std::remove(stages.begin(), stages.end(), index), stages.end());
+            if (stages.empty()) _dependents.erase(file);
+        }
+        for (const auto& file : dependencies) _dependents[file].push_back(index);
+
+        stage.dependencies = std::move(dependencies);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef SHADER_HOT_RELOAD_H
+#define SHADER_HOT_RELOAD_H
+
+#include "shader_compiler.h"
+#include "../core/tools/file_watcher.h"
+#include <atomic>
+#include <chrono>
+#include <compare>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy
+{
+    // 在后台线程监视 shader 目录. 修改的文件通过反向 include 图找到读取过它的入口, 只重新编译这些入口,
+    // 同一程序中未受影响的入口沿用上一次的字节码, 编译仍在后台线程进行.
+    // 编译完成后同样在后台线程调用程序的回调创建新的对象 (如管线), 回调返回的提交函数在 update() 中执行,
+    // 渲染循环在帧的边界调用 update(), 只在这里替换句柄. 此时其他帧可能仍在执行, 需要延迟销毁被替换的对象.
+    class ShaderHotReload
+    {
+    public:
+        // 在 update() 中执行, 不能再做耗时的工作.
+        using CommitFunc = std::function<void()>;
+
+        // 在后台线程按 add_program() 中 descs 的顺序接收全部入口的字节码, 成功时写入 out_commit.
+        using ReloadFunc = std::function<bool(std::span<const ShaderData>, CommitFunc& out_commit)>;
+
+        ~ShaderHotReload();
+
+        bool initialize(const std::string& directory);
+        void destroy();
+
+        // datas 为当前的编译结果, 用它们的 _include_shader_files 建立 include 图.
+        void add_program(std::vector<ShaderCompileDesc> descs, std::span<const ShaderData> datas, ReloadFunc func);
+
+        // 不会等待编译和对象的创建.
+        void update();
+
+        // 最近一次重载从发现文件修改到回调结束的时间.
+        float last_reload_latency_ms() const { return _last_reload_latency_ms; }
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        struct Stage
+        {
+            ShaderCompileDesc desc;
+            ShaderData data;
+            std::vector<std::string> dependencies;
+        };
+
+        struct Program
+        {
+            std::vector<Stage> stages;
+            ReloadFunc func;
+        };
+
+        struct StageIndex
+        {
+            uint32_t program = 0;
+            uint32_t stage = 0;
+
+            auto operator<=>(const StageIndex&) const = default;
+        };
+
+        struct Reload
+        {
+            uint32_t program = 0;
+            CommitFunc commit;
+            clock::time_point change_time;
+        };
+
+        void watch_thread();
+        void recompile(uint32_t program, std::span<const uint32_t> stages, clock::time_point change_time);
+        void set_dependencies(StageIndex index, std::vector<std::string> dependencies);
+
+    private:
+        FileWatcher _watcher;
+        std::thread _thread;
+        std::atomic<bool> _stop = false;
+
+        std::mutex _mutex;
+        std::vector<Program> _programs;
+        std::unordered_map<std::string, std::vector<StageIndex>> _dependents;   // 文件 -> 读取过它的入口.
+        std::vector<Reload> _pending_reloads;
+
+        float _last_reload_latency_ms = 0.0f;
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,321 @@
+#include "shader_permutation.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fantasy
+{
+    static constexpr uint32_t SHADER_PERMUTATION_MAGIC = 0x41505346;     // "FSPA"
+    static constexpr uint32_t SHADER_PERMUTATION_VERSION = 3;
+    static constexpr uint64_t SHADER_PERMUTATION_DATA_ALIGNMENT = 16;
+    static constexpr uint32_t MAX_DIRECT_TABLE_BIT_COUNT = 16;
+
+    struct ShaderPermutationHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t variant_count;
+        uint32_t dependency_count;
+        Hash128 layout_hash;
+        Hash128 request_hash;
+        Hash128 source_hash;
+    };
+
+    struct ShaderPermutationRecord
+    {
+        uint64_t key;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // 记录之后是 dependency_count 个源文件路径, 每个为 uint32_t 长度加上字符, 之后是对齐的字节码.
+
+    static void hash_string(Hash128& hash, const std::string& str)
+    {
+        const uint64_t size = str.size();
+        hash = murmur_hash128(murmur_hash128(hash, &size, sizeof(size)), str.data(), size);
+    }
+
+    ShaderPermutationDimension ShaderPermutationDesc::add_bool(const std::string& name)
+    {
+        return add_enum(name, {});
+    }
+
+    ShaderPermutationDimension ShaderPermutationDesc::add_enum(const std::string& name, const std::vector<std::string>& values)
+    {
+        const uint32_t value_count = values.empty() ? 2 : static_cast<uint32_t>(values.size());
+
+        Dimension dimension;
+        dimension.name = name;
+        dimension.values = values;
+        dimension.bits.offset = _bit_count;
+        dimension.bits.bit_count = std::max(static_cast<uint32_t>(std::bit_width(value_count - 1)), 1u);
+
+        _bit_count += dimension.bits.bit_count;
+        assert(_bit_count <= 64);
+
+        _dimensions.push_back(std::move(dimension));
+        return _dimensions.back().bits;
+    }
+
+    void ShaderPermutationDesc::add_filter(std::function<bool(uint64_t)> filter)
+    {
+        _filters.push_back(std::move(filter));
+    }
+
+    bool ShaderPermutationDesc::valid(uint64_t key) const
+    {
+        if (_bit_count < 64 && (key >> _bit_count) != 0) return false;
+
+        for (const auto& dimension : _dimensions)
+        {
+            // 枚举值的个数不是 2 的幂时会留下未使用的编码.
+            if (!dimension.values.empty() && dimension.bits.decode(key) >= dimension.values.size()) return false;
+        }
+        for (const auto& filter : _filters)
+        {
+            if (!filter(key)) return false;
+        }
+        return true;
+    }
+
+    std::vector<uint64_t> ShaderPermutationDesc::enumerate() const
+    {
+        std::vector<uint64_t> keys;
+
+        // 以各维度的取值个数为基数的混合进制计数器, 不会访问未使用的编码.
+        std::vector<uint32_t> values(_dimensions.size(), 0);
+        while (true)
+        {
+            uint64_t key = 0;
+            for (uint32_t ix = 0; ix < _dimensions.size(); ++ix) key = _dimensions[ix].bits.encode(key, values[ix]);
+            if (valid(key)) keys.push_back(key);
+
+            uint32_t ix = 0;
+            for (; ix < _dimensions.size(); ++ix)
+            {
+                const uint32_t value_count = _dimensions[ix].values.empty() ? 2 : static_cast<uint32_t>(_dimensions[ix].values.size());
+                if (++values[ix] < value_count) break;
+                values[ix] = 0;
+            }
+            if (ix == _dimensions.size()) break;
+        }
+        return keys;
+    }
+
+    void ShaderPermutationDesc::get_defines(uint64_t key, std::vector<std::string>& out_defines) const
+    {
+        for (const auto& dimension : _dimensions)
+        {
+            out_defines.push_back(dimension.name + "=" + std::to_string(dimension.bits.decode(key)));
+            for (uint32_t ix = 0; ix < dimension.values.size(); ++ix)
+            {
+                out_defines.push_back(dimension.name + "_" + dimension.values[ix] + "=" + std::to_string(ix));
+            }
+        }
+    }
+
+    Hash128 ShaderPermutationDesc::layout_hash() const
+    {
+        Hash128 hash;
+        for (const auto& dimension : _dimensions)
+        {
+            hash_string(hash, dimension.name);
+            for (const auto& value : dimension.values) hash_string(hash, value);
+            hash = murmur_hash128(hash, &dimension.bits, sizeof(dimension.bits));
+        }
+        return hash;
+    }
+
+    bool build_shader_permutation_archive(
+        const ShaderCompileDesc& base_desc,
+        const ShaderPermutationDesc& permutation_desc,
+        const std::string& archive_path
+    )
+    {
+        const std::vector<uint64_t> keys = permutation_desc.enumerate();
+
+        std::vector<ShaderCompileDesc> descs(keys.size(), base_desc);
+        for (uint32_t ix = 0; ix < keys.size(); ++ix)
+        {
+            permutation_desc.get_defines(keys[ix], descs[ix].defines);
+        }
+
+        std::vector<std::shared_future<ShaderData>> futures = compile_shaders(descs);
+
+        // 不同排列可能 include 不同的文件, 取所有排列依赖的并集.
+        std::vector<std::string> dependencies;
+        for (uint32_t ix = 0; ix < keys.size(); ++ix)
+        {
+            const ShaderData& data = futures[ix].get();
+            if (data.invalid())
+            {
+                LOG_ERROR("Compile permutation " + std::to_string(keys[ix]) + " of " + base_desc.shader_name + " failed.");
+                return false;
+            }
+            dependencies.insert(dependencies.end(), data._include_shader_files.begin(), data._include_shader_files.end());
+        }
+        std::sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+        // 请求键与 ShaderCache 相同, 编译器版本或编译选项改变后存档失效.
+        Hash128 request_hash;
+        if (!get_shader_request_key(base_desc, request_hash))
+        {
+            LOG_ERROR("Get request key of " + base_desc.shader_name + " failed.");
+            return false;
+        }
+
+        ShaderPermutationHeader header{
+            .magic = SHADER_PERMUTATION_MAGIC,
+            .version = SHADER_PERMUTATION_VERSION,
+            .variant_count = static_cast<uint32_t>(keys.size()),
+            .dependency_count = static_cast<uint32_t>(dependencies.size()),
+            .layout_hash = permutation_desc.layout_hash(),
+            .request_hash = request_hash,
+            .source_hash = Hash128{}
+        };
+        if (!get_shader_source_hash(dependencies, header.source_hash))
+        {
+            LOG_ERROR("Read shader sources of " + base_desc.shader_name + " failed.");
+            return false;
+        }
+
+        uint64_t dependency_table_size = 0;
+        for (const auto& dependency : dependencies) dependency_table_size += sizeof(uint32_t) + dependency.size();
+
+        std::vector<ShaderPermutationRecord> records(keys.size());
+        const uint64_t data_begin = sizeof(header) + sizeof(ShaderPermutationRecord) * records.size() + dependency_table_size;
+        uint64_t offset = data_begin;
+        for (uint32_t ix = 0; ix < keys.size(); ++ix)
+        {
+            const ShaderData& data = futures[ix].get();
+            offset = (offset + SHADER_PERMUTATION_DATA_ALIGNMENT - 1) & ~(SHADER_PERMUTATION_DATA_ALIGNMENT - 1);
+            records[ix] = ShaderPermutationRecord{ .key = keys[ix], .offset = offset, .size = data.size() };
+            offset += data.size();
+        }
+
+        std::filesystem::create_directories(std::filesystem::path(archive_path).parent_path());
+        std::ofstream output(archive_path, std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(sizeof(ShaderPermutationRecord) * records.size()));
+        for (const auto& dependency : dependencies)
+        {
+            const uint32_t size = static_cast<uint32_t>(dependency.size());
+            output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            output.write(dependency.data(), static_cast<std::streamsize>(size));
+        }
+
+        const char padding[SHADER_PERMUTATION_DATA_ALIGNMENT] = {};
+        uint64_t position = data_begin;
+        for (uint32_t ix = 0; ix < keys.size(); ++ix)
+        {
+            const ShaderData& data = futures[ix].get();
+            output.write(padding, static_cast<std::streamsize>(records[ix].offset - position));
+            output.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            position = records[ix].offset + data.size();
+        }
+
+        if (!output.good())
+        {
+            LOG_ERROR("Write shader permutation archive " + archive_path + " failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool ShaderPermutationArchive::load(const std::string& archive_path, const ShaderCompileDesc& base_desc, const ShaderPermutationDesc& permutation_desc)
+    {
+        _mapping.close();
+        _variants.clear();
+        _direct_table.clear();
+        _key_table.clear();
+
+        if (!_mapping.open(archive_path) || _mapping.size() < sizeof(ShaderPermutationHeader))
+        {
+            LOG_ERROR("Read shader permutation archive " + archive_path + " failed.");
+            return false;
+        }
+
+        Hash128 request_hash;
+        if (!get_shader_request_key(base_desc, request_hash))
+        {
+            LOG_ERROR("Get request key of " + base_desc.shader_name + " failed.");
+            return false;
+        }
+
+        ShaderPermutationHeader header;
+        memcpy(&header, _mapping.data(), sizeof(header));
+        if (header.magic != SHADER_PERMUTATION_MAGIC ||
+            header.version != SHADER_PERMUTATION_VERSION ||
+            header.layout_hash != permutation_desc.layout_hash() ||
+            header.request_hash != request_hash)
+        {
+            LOG_ERROR("Shader permutation archive " + archive_path + " is outdated.");
+            return false;
+        }
+
+        if (_mapping.size() < sizeof(header) + sizeof(ShaderPermutationRecord) * static_cast<uint64_t>(header.variant_count))
+        {
+            LOG_ERROR("Shader permutation archive " + archive_path + " is truncated.");
+            return false;
+        }
+
+        std::vector<ShaderPermutationRecord> records(header.variant_count);
+        memcpy(records.data(), _mapping.data() + sizeof(header), sizeof(ShaderPermutationRecord) * records.size());
+
+        std::vector<std::string> dependencies(header.dependency_count);
+        uint64_t position = sizeof(header) + sizeof(ShaderPermutationRecord) * records.size();
+        for (auto& dependency : dependencies)
+        {
+            uint32_t size = 0;
+            if (_mapping.size() - position < sizeof(size))
+            {
+                LOG_ERROR("Shader permutation archive " + archive_path + " is truncated.");
+                return false;
+            }
+            memcpy(&size, _mapping.data() + position, sizeof(size));
+            position += sizeof(size);
+
+            if (_mapping.size() - position < size)
+            {
+                LOG_ERROR("Shader permutation archive " + archive_path + " is truncated.");
+                return false;
+            }
+            dependency.assign(reinterpret_cast<const char*>(_mapping.data() + position), size);
+            position += size;
+        }
+
+        // 源码 hash 取自 shader 缓存的进程内文件 hash 表, 文件改动由 invalidate_file 清除, 不会继续使用旧的字节码.
+        Hash128 source_hash;
+        if (!get_shader_source_hash(dependencies, source_hash) || source_hash != header.source_hash)
+        {
+            LOG_ERROR("Shader permutation archive " + archive_path + " is outdated.");
+            return false;
+        }
+
+        const bool direct = permutation_desc.bit_count() <= MAX_DIRECT_TABLE_BIT_COUNT;
+        if (direct) _direct_table.resize(1ull << permutation_desc.bit_count(), INVALID_SIZE_32);
+        else _key_table.reserve(records.size());
+
+        _variants.resize(records.size());
+        for (uint32_t ix = 0; ix < records.size(); ++ix)
+        {
+            const auto& record = records[ix];
+            if (record.offset > _mapping.size() || record.size > _mapping.size() - record.offset || (direct && record.key >= _direct_table.size()))
+            {
+                LOG_ERROR("Shader permutation archive " + archive_path + " is truncated.");
+                return false;
+            }
+
+            _variants[ix] = Variant{ .offset = record.offset, .size = record.size };
+            if (direct) _direct_table[record.key] = ix;
+            else _key_table[record.key] = ix;
+        }
+        return true;
+    }
+}
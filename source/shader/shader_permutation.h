@@ -0,0 +1,127 @@
+#ifndef SHADER_PERMUTATION_H
+#define SHADER_PERMUTATION_H
+
+#include "shader_compiler.h"
+#include "../core/tools/hash_table.h"
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fantasy
+{
+    // 一个维度占用 64 位排列键中从 offset 开始的 bit_count 位.
+    // 只是普通的值, 调用者保存下来后只需移位即可拼出键.
+    struct ShaderPermutationDimension
+    {
+        uint32_t offset = 0;
+        uint32_t bit_count = 0;
+
+        constexpr uint64_t mask() const { return ((1ull << bit_count) - 1) << offset; }
+        constexpr uint64_t encode(uint64_t key, uint32_t value) const { return (key & ~mask()) | (static_cast<uint64_t>(value) << offset); }
+        constexpr uint32_t decode(uint64_t key) const { return static_cast<uint32_t>((key & mask()) >> offset); }
+    };
+
+    // 声明 shader 的 bool 和枚举维度. bool 维度 NAME 定义 NAME=0/1.
+    // 取值为 {A, B} 的枚举维度 NAME 定义 NAME=下标, 以及 NAME_A=0 和 NAME_B=1,
+    // shader 中可以写 "#if NAME == NAME_B".
+    class ShaderPermutationDesc
+    {
+    public:
+        ShaderPermutationDimension add_bool(const std::string& name);
+        ShaderPermutationDimension add_enum(const std::string& name, const std::vector<std::string>& values);
+
+        // 对不需要编译的键返回 false.
+        void add_filter(std::function<bool(uint64_t)> filter);
+
+        bool valid(uint64_t key) const;
+        std::vector<uint64_t> enumerate() const;
+
+        void get_defines(uint64_t key, std::vector<std::string>& out_defines) const;
+
+        // 标识键的编码方式, 用不同编码构建的存档会被拒绝.
+        Hash128 layout_hash() const;
+
+        uint32_t bit_count() const { return _bit_count; }
+
+    private:
+        struct Dimension
+        {
+            std::string name;
+            std::vector<std::string> values;    // bool 维度为空.
+            ShaderPermutationDimension bits;
+        };
+
+        std::vector<Dimension> _dimensions;
+        std::vector<std::function<bool(uint64_t)>> _filters;
+        uint32_t _bit_count = 0;
+    };
+
+    // 编译 base_desc 的所有有效排列并写入一个存档, 所有排列读取过的源文件路径及其内容 hash 也一并写入.
+    // 需要先调用 parallel::initialize().
+    bool build_shader_permutation_archive(
+        const ShaderCompileDesc& base_desc,
+        const ShaderPermutationDesc& permutation_desc,
+        const std::string& archive_path
+    );
+
+    // 存档通过内存映射读取, find() 返回映射中的视图, 在下一次 load() 之前一直有效.
+    class ShaderPermutationArchive
+    {
+    public:
+        // base_desc 与键的编码需要和构建时一致, 存档记录的源文件有任何一个被修改或删除都视为过期.
+        bool load(const std::string& archive_path, const ShaderCompileDesc& base_desc, const ShaderPermutationDesc& permutation_desc);
+
+        // 键被过滤掉或者不在存档中时为空.
+        std::span<const uint8_t> find(uint64_t key) const
+        {
+            uint32_t variant = INVALID_SIZE_32;
+            if (!_direct_table.empty())
+            {
+                if (key < _direct_table.size()) variant = _direct_table[key];
+            }
+            else
+            {
+                auto iter = _key_table.find(key);
+                if (iter != _key_table.end()) variant = iter->second;
+            }
+
+            if (variant == INVALID_SIZE_32) return {};
+            const Variant& data = _variants[variant];
+            return std::span<const uint8_t>(_mapping.data() + data.offset, data.size);
+        }
+
+        uint32_t variant_count() const { return static_cast<uint32_t>(_variants.size()); }
+
+    private:
+        struct Variant
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        FileMapping _mapping;
+        std::vector<Variant> _variants;
+
+        // 键空间较小时直接索引平坦表, 较大时退回到哈希表.
+        std::vector<uint32_t> _direct_table;
+        std::unordered_map<uint64_t, uint32_t> _key_table;
+    };
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
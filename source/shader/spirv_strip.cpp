@@ -0,0 +1,93 @@
+#include "spirv_strip.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace fantasy
+{
+    static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    static constexpr uint32_t SPIRV_HEADER_WORD_COUNT = 5;
+
+    enum SpirvOp : uint16_t
+    {
+        SpirvOpSourceContinued = 2,
+        SpirvOpSource = 3,
+        SpirvOpSourceExtension = 4,
+        SpirvOpName = 5,
+        SpirvOpMemberName = 6,
+        SpirvOpString = 7,
+        SpirvOpLine = 8,
+        SpirvOpExtension = 10,
+        SpirvOpExtInstImport = 11,
+        SpirvOpExtInst = 12,
+        SpirvOpNoLine = 317,
+        SpirvOpModuleProcessed = 330,
+    };
+
+    static std::string_view spirv_string(const uint32_t* words, uint32_t word_count)
+    {
+        const char* str = reinterpret_cast<const char*>(words);
+        return std::string_view(str, strnlen(str, word_count * sizeof(uint32_t)));
+    }
+
+    bool strip_spirv_debug_info(std::vector<uint8_t>& spirv)
+    {
+        if (spirv.size() % sizeof(uint32_t) != 0 || spirv.size() < SPIRV_HEADER_WORD_COUNT * sizeof(uint32_t)) return false;
+
+        std::vector<uint32_t> words(spirv.size() / sizeof(uint32_t));
+        memcpy(words.data(), spirv.data(), spirv.size());
+        if (words[0] != SPIRV_MAGIC) return false;
+
+        // OpExtInstImport 总是在所有 OpExtInst 之前, 遍历一次即可.
+        std::vector<uint32_t> non_semantic_sets;
+        uint32_t write = SPIRV_HEADER_WORD_COUNT;
+        for (uint32_t read = SPIRV_HEADER_WORD_COUNT; read < words.size();)
+        {
+            const uint32_t word_count = words[read] >> 16;
+            const uint32_t opcode = words[read] & 0xffff;
+            if (word_count == 0 || read + word_count > words.size()) return false;
+
+            const uint32_t* operands = words.data() + read + 1;
+            bool strip = false;
+            switch (opcode)
+            {
+            case SpirvOpSourceContinued:
+            case SpirvOpSource:
+            case SpirvOpSourceExtension:
+            case SpirvOpName:
+            case SpirvOpMemberName:
+            case SpirvOpString:
+            case SpirvOpLine:
+            case SpirvOpNoLine:
+            case SpirvOpModuleProcessed:
+                strip = true;
+                break;
+            case SpirvOpExtension:
+                strip = spirv_string(operands, word_count - 1) == "SPV_KHR_non_semantic_info";
+                break;
+            case SpirvOpExtInstImport:
+                if (word_count > 2 && spirv_string(operands + 1, word_count - 2).starts_with("NonSemantic."))
+                {
+                    non_semantic_sets.push_back(operands[0]);
+                    strip = true;
+                }
+                break;
+            case SpirvOpExtInst:
+                // 操作数依次为结果类型, 结果 id, 指令集, 指令.
+                strip = word_count > 3 && std::find(non_semantic_sets.begin(), non_semantic_sets.end(), operands[2]) != non_semantic_sets.end();
+                break;
+            }
+
+            if (!strip)
+            {
+                if (write != read) std::copy(words.begin() + read, words.begin() + read + word_count, words.begin() + write);
+                write += word_count;
+            }
+            read += word_count;
+        }
+
+        spirv.resize(write * sizeof(uint32_t));
+        memcpy(spirv.data(), words.data(), spirv.size());
+        return true;
+    }
+}
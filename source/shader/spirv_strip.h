@@ -0,0 +1,27 @@
+#ifndef SHADER_SPIRV_STRIP_H
+#define SHADER_SPIRV_STRIP_H
+
+#include <cstdint>
+#include <vector>
+
+namespace fantasy
+{
+    // 原地删除调试指令 (OpSource*, OpName, OpMemberName, OpString, OpLine, OpNoLine, OpModuleProcessed)
+    // 以及所有 NonSemantic 扩展指令集, 如 NonSemantic.Shader.DebugInfo.100.
+    // 不是有效的模块时返回 false, spirv 保持不变.
+    bool strip_spirv_debug_info(std::vector<uint8_t>& spirv);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,315 @@
+#include "block_compression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace fantasy
+{
+    static constexpr uint32_t BLOCK_PIXEL_COUNT = 16;
+
+    // BC7 4 位索引的插值权重.
+    static constexpr uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    class BitWriter
+    {
+    public:
+        explicit BitWriter(uint8_t* out_data) : _data(out_data) {}
+
+        void write(uint32_t value, uint32_t bit_count)
+        {
+            for (uint32_t ix = 0; ix < bit_count; ++ix, ++_bit)
+            {
+                if (value & (1u << ix)) _data[_bit >> 3] |= static_cast<uint8_t>(1u << (_bit & 7));
+            }
+        }
+
+    private:
+        uint8_t* _data;
+        uint32_t _bit = 0;
+    };
+
+    // 沿主成分方向取两端的点作为端点, 主成分用幂迭代求得.
+    static void find_endpoints(const uint8_t* pixels, uint32_t channel_count, float* out_min, float* out_max)
+    {
+        float mean[4] = {};
+        for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+        {
+            for (uint32_t c = 0; c < channel_count; ++c) mean[c] += pixels[ix * 4 + c];
+        }
+        for (uint32_t c = 0; c < channel_count; ++c) mean[c] /= BLOCK_PIXEL_COUNT;
+
+        float covariance[4][4] = {};
+        for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+        {
+            float diff[4];
+            for (uint32_t c = 0; c < channel_count; ++c) diff[c] = pixels[ix * 4 + c] - mean[c];
+            for (uint32_t a = 0; a < channel_count; ++a)
+            {
+                for (uint32_t b = 0; b < channel_count; ++b) covariance[a][b] += diff[a] * diff[b];
+            }
+        }
+
+        // 从方差最大的通道对应的一行开始迭代, 避免初始方向与主成分正交.
+        uint32_t max_channel = 0;
+        for (uint32_t c = 1; c < channel_count; ++c)
+        {
+            if (covariance[c][c] > covariance[max_channel][max_channel]) max_channel = c;
+        }
+
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        if (covariance[max_channel][max_channel] > 0.0f)
+        {
+            for (uint32_t c = 0; c < channel_count; ++c) axis[c] = covariance[max_channel][c];
+        }
+        for (uint32_t iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (uint32_t a = 0; a < channel_count; ++a)
+            {
+                for (uint32_t b = 0; b < channel_count; ++b) next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::abs(next[a]));
+            }
+            if (length < 1e-6f) break;
+            for (uint32_t c = 0; c < channel_count; ++c) axis[c] = next[c] / length;
+        }
+
+        float min_projection = 0.0f;
+        float max_projection = 0.0f;
+        for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+        {
+            float projection = 0.0f;
+            for (uint32_t c = 0; c < channel_count; ++c) projection += (pixels[ix * 4 + c] - mean[c]) * axis[c];
+            min_projection = std::min(min_projection, projection);
+            max_projection = std::max(max_projection, projection);
+        }
+
+        float axis_length = 0.0f;
+        for (uint32_t c = 0; c < channel_count; ++c) axis_length += axis[c] * axis[c];
+        if (axis_length > 0.0f)
+        {
+            min_projection /= axis_length;
+            max_projection /= axis_length;
+        }
+
+        for (uint32_t c = 0; c < channel_count; ++c)
+        {
+            out_min[c] = std::clamp(mean[c] + axis[c] * min_projection, 0.0f, 255.0f);
+            out_max[c] = std::clamp(mean[c] + axis[c] * max_projection, 0.0f, 255.0f);
+        }
+    }
+
+    static uint32_t squared_distance(const uint8_t* a, const uint32_t* b, uint32_t channel_count)
+    {
+        uint32_t distance = 0;
+        for (uint32_t c = 0; c < channel_count; ++c)
+        {
+            const int32_t diff = static_cast<int32_t>(a[c]) - static_cast<int32_t>(b[c]);
+            distance += static_cast<uint32_t>(diff * diff);
+        }
+        return distance;
+    }
+
+    static uint16_t pack_565(const float* color)
+    {
+        const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    static void unpack_565(uint16_t color, uint32_t* out_color)
+    {
+        const uint32_t r = (color >> 11) & 31;
+        const uint32_t g = (color >> 5) & 63;
+        const uint32_t b = color & 31;
+        out_color[0] = (r << 3) | (r >> 2);
+        out_color[1] = (g << 2) | (g >> 4);
+        out_color[2] = (b << 3) | (b >> 2);
+    }
+
+    void compress_bc1_block(const uint8_t* pixels, uint8_t* out_block)
+    {
+        float min_color[4];
+        float max_color[4];
+        find_endpoints(pixels, 3, min_color, max_color);
+
+        // 向内收缩 1/16, 减少端点落在离群点上带来的误差.
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            const float inset = (max_color[c] - min_color[c]) / 16.0f;
+            min_color[c] += inset;
+            max_color[c] -= inset;
+        }
+
+        uint16_t color0 = pack_565(max_color);
+        uint16_t color1 = pack_565(min_color);
+
+        // color0 > color1 时为 4 色模式.
+        if (color0 < color1) std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            uint32_t palette[4][3];
+            unpack_565(color0, palette[0]);
+            unpack_565(color1, palette[1]);
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+            {
+                uint32_t best_index = 0;
+                uint32_t best_distance = ~0u;
+                for (uint32_t index = 0; index < 4; ++index)
+                {
+                    const uint32_t distance = squared_distance(pixels + ix * 4, palette[index], 3);
+                    if (distance < best_distance)
+                    {
+                        best_distance = distance;
+                        best_index = index;
+                    }
+                }
+                indices |= best_index << (ix * 2);
+            }
+        }
+
+        memcpy(out_block, &color0, 2);
+        memcpy(out_block + 2, &color1, 2);
+        memcpy(out_block + 4, &indices, 4);
+    }
+
+    void compress_bc4_block(const uint8_t* pixels, uint32_t channel, uint8_t* out_block)
+    {
+        uint32_t min_value = 255;
+        uint32_t max_value = 0;
+        for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+        {
+            min_value = std::min<uint32_t>(min_value, pixels[ix * 4 + channel]);
+            max_value = std::max<uint32_t>(max_value, pixels[ix * 4 + channel]);
+        }
+
+        // red0 > red1 时为 8 值模式: red0, red1, 之后 6 个插值.
+        uint32_t palette[8] = { max_value, min_value };
+        for (uint32_t ix = 1; ix < 7; ++ix) palette[ix + 1] = ((7 - ix) * max_value + ix * min_value) / 7;
+
+        uint64_t indices = 0;
+        if (max_value != min_value)
+        {
+            for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+            {
+                const uint32_t value = pixels[ix * 4 + channel];
+
+                uint32_t best_index = 0;
+                uint32_t best_distance = ~0u;
+                for (uint32_t index = 0; index < 8; ++index)
+                {
+                    const uint32_t distance = value > palette[index] ? value - palette[index] : palette[index] - value;
+                    if (distance < best_distance)
+                    {
+                        best_distance = distance;
+                        best_index = index;
+                    }
+                }
+                indices |= static_cast<uint64_t>(best_index) << (ix * 3);
+            }
+        }
+
+        out_block[0] = static_cast<uint8_t>(max_value);
+        out_block[1] = static_cast<uint8_t>(min_value);
+        for (uint32_t ix = 0; ix < 6; ++ix) out_block[2 + ix] = static_cast<uint8_t>(indices >> (ix * 8));
+    }
+
+    void compress_bc5_block(const uint8_t* pixels, uint8_t* out_block)
+    {
+        compress_bc4_block(pixels, 0, out_block);
+        compress_bc4_block(pixels, 1, out_block + 8);
+    }
+
+    // 把 8 位端点量化为 7 位 + p-bit, 端点的 4 个通道共用一个 p-bit, 选误差小的一个.
+    static void quantize_bc7_endpoint(const float* color, uint32_t* out_color, uint32_t& out_p_bit)
+    {
+        uint32_t best_error = ~0u;
+        for (uint32_t p_bit = 0; p_bit < 2; ++p_bit)
+        {
+            uint32_t quantized[4];
+            uint32_t error = 0;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const float value = (color[c] - static_cast<float>(p_bit)) / 2.0f;
+                quantized[c] = static_cast<uint32_t>(std::clamp(value + 0.5f, 0.0f, 127.0f));
+
+                const int32_t diff = static_cast<int32_t>((quantized[c] << 1) | p_bit) - static_cast<int32_t>(color[c] + 0.5f);
+                error += static_cast<uint32_t>(diff * diff);
+            }
+            if (error < best_error)
+            {
+                best_error = error;
+                out_p_bit = p_bit;
+                memcpy(out_color, quantized, sizeof(quantized));
+            }
+        }
+    }
+
+    void compress_bc7_block(const uint8_t* pixels, uint8_t* out_block)
+    {
+        float min_color[4];
+        float max_color[4];
+        find_endpoints(pixels, 4, min_color, max_color);
+
+        uint32_t endpoints[2][4];
+        uint32_t p_bits[2];
+        quantize_bc7_endpoint(min_color, endpoints[0], p_bits[0]);
+        quantize_bc7_endpoint(max_color, endpoints[1], p_bits[1]);
+
+        uint32_t palette[16][4];
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            const uint32_t e0 = (endpoints[0][c] << 1) | p_bits[0];
+            const uint32_t e1 = (endpoints[1][c] << 1) | p_bits[1];
+            for (uint32_t index = 0; index < 16; ++index)
+            {
+                palette[index][c] = ((64 - BC7_WEIGHTS[index]) * e0 + BC7_WEIGHTS[index] * e1 + 32) >> 6;
+            }
+        }
+
+        uint32_t indices[BLOCK_PIXEL_COUNT];
+        for (uint32_t ix = 0; ix < BLOCK_PIXEL_COUNT; ++ix)
+        {
+            uint32_t best_distance = ~0u;
+            for (uint32_t index = 0; index < 16; ++index)
+            {
+                const uint32_t distance = squared_distance(pixels + ix * 4, palette[index], 4);
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    indices[ix] = index;
+                }
+            }
+        }
+
+        // 第一个像素的索引最高位隐含为 0, 不满足时交换端点并翻转索引.
+        if (indices[0] >= 8)
+        {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(p_bits[0], p_bits[1]);
+            for (uint32_t& index : indices) index = 15 - index;
+        }
+
+        memset(out_block, 0, 16);
+        BitWriter writer(out_block);
+        writer.write(1u << 6, 7);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            writer.write(endpoints[0][c], 7);
+            writer.write(endpoints[1][c], 7);
+        }
+        writer.write(p_bits[0], 1);
+        writer.write(p_bits[1], 1);
+        writer.write(indices[0], 3);
+        for (uint32_t ix = 1; ix < BLOCK_PIXEL_COUNT; ++ix) writer.write(indices[ix], 4);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef TEXTURE_BLOCK_COMPRESSION_H
+#define TEXTURE_BLOCK_COMPRESSION_H
+
+#include <cstdint>
+
+namespace fantasy
+{
+    // 输入均为按行存放的 4x4 RGBA8 像素块 (64 字节).
+
+    // 不透明的 4 色模式, 忽略 alpha.
+    void compress_bc1_block(const uint8_t* pixels, uint8_t* out_block);
+
+    // 压缩 pixels 中的一个通道, 8 字节.
+    void compress_bc4_block(const uint8_t* pixels, uint32_t channel, uint8_t* out_block);
+
+    // R, G 两个通道各一个 BC4 块, 16 字节, 用于法线等双通道数据.
+    void compress_bc5_block(const uint8_t* pixels, uint8_t* out_block);
+
+    // 只使用 mode 6 (单分区, RGBA 7777 + p-bit, 4 位索引), 16 字节.
+    void compress_bc7_block(const uint8_t* pixels, uint8_t* out_block);
+}
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,408 @@
+#include "texture_cooker.h"
+#include "block_compression.h"
+#include "../core/parallel/parallel.h"
+#include "../core/tools/log.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stb_image.h>
+
+namespace fantasy
+{
+    static constexpr uint32_t TEXTURE_FILE_MAGIC = 0x58455446;     // "FTEX"
+    static constexpr uint32_t TEXTURE_FILE_VERSION = 2;
+    static constexpr uint64_t TEXTURE_DATA_ALIGNMENT = 16;
+    static constexpr uint32_t TEXTURE_FLAG_SRGB = 0x1;
+    static constexpr uint32_t TEXTURE_FLAG_GENERATE_MIPS = 0x2;    // 1x1 的图片只有一级 mip, 不能由 mip_count 推断.
+
+    // 每个任务处理的行数, mip 生成按像素行, 块压缩按块行.
+    static constexpr uint32_t MIP_ROWS_PER_TASK = 16;
+    static constexpr uint32_t BLOCK_ROWS_PER_TASK = 4;
+
+    struct TextureFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        TextureFormat format;
+        uint32_t flags;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_count;
+        uint32_t padding;
+        uint64_t data_offset;
+        uint64_t data_size;
+    };
+
+    struct Image
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels;    // RGBA8.
+    };
+
+    static uint64_t align_offset(uint64_t offset)
+    {
+        return (offset + TEXTURE_DATA_ALIGNMENT - 1) & ~(TEXTURE_DATA_ALIGNMENT - 1);
+    }
+
+    // sRGB 与线性空间的转换表, 线性值量化为 12 位查表.
+    struct SrgbTables
+    {
+        std::array<float, 256> to_linear;
+        std::array<uint8_t, 4096> from_linear;
+
+        SrgbTables()
+        {
+            for (uint32_t ix = 0; ix < 256; ++ix)
+            {
+                const float value = ix / 255.0f;
+                to_linear[ix] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (uint32_t ix = 0; ix < 4096; ++ix)
+            {
+                const float value = ix / 4095.0f;
+                const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                from_linear[ix] = static_cast<uint8_t>(std::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    };
+
+    static const SrgbTables& get_srgb_tables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // 按任务数较少时直接在当前线程执行, 避免小 mip 的调度开销.
+    static void parallel_rows(uint32_t row_count, uint32_t rows_per_task, const std::function<void(uint32_t, uint32_t)>& func)
+    {
+        const uint32_t task_count = (row_count + rows_per_task - 1) / rows_per_task;
+        if (task_count <= 1)
+        {
+            func(0, row_count);
+            return;
+        }
+
+        parallel::parallel_for(
+            [&](uint64_t task)
+            {
+                const uint32_t begin = static_cast<uint32_t>(task) * rows_per_task;
+                func(begin, std::min(begin + rows_per_task, row_count));
+            },
+            task_count
+        );
+    }
+
+    static bool decode_image(std::span<const uint8_t> image_file, Image& out_image)
+    {
+        int width, height, channels;
+        uint8_t* pixels = stbi_load_from_memory(image_file.data(), static_cast<int>(image_file.size()), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr)
+        {
+            LOG_ERROR(std::string("Decode image failed: ") + stbi_failure_reason());
+            return false;
+        }
+
+        out_image.width = static_cast<uint32_t>(width);
+        out_image.height = static_cast<uint32_t>(height);
+        out_image.pixels.assign(pixels, pixels + static_cast<uint64_t>(width) * height * 4);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    // 一个像素的 4 个通道放在一个 uint32_t 中, 奇偶字节分开累加, 每个 16 位的通道和不会溢出,
+    // 一次整数运算处理 4 个通道. 结果与逐通道计算 (a + b + c + d + 2) / 4 相同.
+    static uint32_t average_rgba8(uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3)
+    {
+        constexpr uint32_t mask = 0x00ff00ff;
+        const uint32_t even = (p0 & mask) + (p1 & mask) + (p2 & mask) + (p3 & mask) + 0x00020002;
+        const uint32_t odd = ((p0 >> 8) & mask) + ((p1 >> 8) & mask) + ((p2 >> 8) & mask) + ((p3 >> 8) & mask) + 0x00020002;
+        return ((even >> 2) & mask) | (((odd >> 2) & mask) << 8);
+    }
+
+    // 2x2 盒式滤波, 奇数尺寸时边缘像素重复使用.
+    // 线性路径用 average_rgba8() 按像素计算; sRGB 路径需要逐通道查表转换到线性空间再转回, 只能逐通道计算.
+    static void downsample(const Image& src, bool srgb, Image& out_image)
+    {
+        out_image.width = std::max(src.width / 2, 1u);
+        out_image.height = std::max(src.height / 2, 1u);
+        out_image.pixels.resize(static_cast<uint64_t>(out_image.width) * out_image.height * 4);
+
+        const SrgbTables& tables = get_srgb_tables();
+        parallel_rows(out_image.height, MIP_ROWS_PER_TASK, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                const uint8_t* row0 = src.pixels.data() + static_cast<uint64_t>(std::min(y * 2, src.height - 1)) * src.width * 4;
+                const uint8_t* row1 = src.pixels.data() + static_cast<uint64_t>(std::min(y * 2 + 1, src.height - 1)) * src.width * 4;
+                uint8_t* dst = out_image.pixels.data() + static_cast<uint64_t>(y) * out_image.width * 4;
+
+                for (uint32_t x = 0; x < out_image.width; ++x)
+                {
+                    const uint32_t x0 = std::min(x * 2, src.width - 1) * 4;
+                    const uint32_t x1 = std::min(x * 2 + 1, src.width - 1) * 4;
+
+                    if (srgb)
+                    {
+                        const uint8_t* samples[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+                        for (uint32_t c = 0; c < 3; ++c)
+                        {
+                            float sum = 0.0f;
+                            for (const uint8_t* sample : samples) sum += tables.to_linear[sample[c]];
+                            dst[x * 4 + c] = tables.from_linear[static_cast<uint32_t>(sum * 0.25f * 4095.0f + 0.5f)];
+                        }
+                        dst[x * 4 + 3] = static_cast<uint8_t>((samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 2) / 4);
+                    }
+                    else
+                    {
+                        uint32_t pixels[4];
+                        memcpy(&pixels[0], row0 + x0, 4);
+                        memcpy(&pixels[1], row0 + x1, 4);
+                        memcpy(&pixels[2], row1 + x0, 4);
+                        memcpy(&pixels[3], row1 + x1, 4);
+                        const uint32_t result = average_rgba8(pixels[0], pixels[1], pixels[2], pixels[3]);
+                        memcpy(dst + x * 4, &result, 4);
+                    }
+                }
+            }
+        });
+    }
+
+    static uint64_t get_mip_size(TextureFormat format, uint32_t width, uint32_t height)
+    {
+        if (!is_block_compressed(format)) return static_cast<uint64_t>(width) * height * get_texture_block_size(format);
+        return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * get_texture_block_size(format);
+    }
+
+    static void compress_image(const Image& image, TextureFormat format, uint8_t* out_data)
+    {
+        if (!is_block_compressed(format))
+        {
+            memcpy(out_data, image.pixels.data(), image.pixels.size());
+            return;
+        }
+
+        const uint32_t block_size = get_texture_block_size(format);
+        const uint32_t blocks_x = (image.width + 3) / 4;
+        const uint32_t blocks_y = (image.height + 3) / 4;
+        parallel_rows(blocks_y, BLOCK_ROWS_PER_TASK, [&](uint32_t begin, uint32_t end)
+        {
+            uint8_t pixels[64];
+            for (uint32_t by = begin; by < end; ++by)
+            {
+                for (uint32_t bx = 0; bx < blocks_x; ++bx)
+                {
+                    // 图片边缘不足 4 个像素时重复最后一行或一列.
+                    for (uint32_t y = 0; y < 4; ++y)
+                    {
+                        const uint32_t py = std::min(by * 4 + y, image.height - 1);
+                        for (uint32_t x = 0; x < 4; ++x)
+                        {
+                            const uint32_t px = std::min(bx * 4 + x, image.width - 1);
+                            memcpy(pixels + (y * 4 + x) * 4, image.pixels.data() + (static_cast<uint64_t>(py) * image.width + px) * 4, 4);
+                        }
+                    }
+
+                    uint8_t* block = out_data + (static_cast<uint64_t>(by) * blocks_x + bx) * block_size;
+                    switch (format)
+                    {
+                    case TextureFormat::BC1: compress_bc1_block(pixels, block); break;
+                    case TextureFormat::BC5: compress_bc5_block(pixels, block); break;
+                    case TextureFormat::BC7: compress_bc7_block(pixels, block); break;
+                    default: break;
+                    }
+                }
+            }
+        });
+    }
+
+    static void cook_image(Image base, const TextureCookOptions& options, CookedTexture& out_texture)
+    {
+        out_texture.options = options;
+
+        TextureDesc& desc = out_texture.desc;
+        desc.format = options.format;
+        desc.srgb = options.srgb;
+        desc.width = base.width;
+        desc.height = base.height;
+        desc.mips.clear();
+
+        const uint32_t mip_count = options.generate_mips ? static_cast<uint32_t>(std::floor(std::log2(std::max(base.width, base.height)))) + 1 : 1;
+
+        uint64_t offset = 0;
+        for (uint32_t mip = 0; mip < mip_count; ++mip)
+        {
+            const uint32_t width = std::max(base.width >> mip, 1u);
+            const uint32_t height = std::max(base.height >> mip, 1u);
+            const uint64_t size = get_mip_size(options.format, width, height);
+            desc.mips.push_back(TextureMip{ .offset = offset, .size = size, .width = width, .height = height });
+            offset = align_offset(offset + size);
+        }
+        out_texture.data.assign(offset, 0);
+
+        Image image = std::move(base);
+        for (uint32_t mip = 0; mip < mip_count; ++mip)
+        {
+            if (mip > 0)
+            {
+                Image next;
+                downsample(image, options.srgb, next);
+                image = std::move(next);
+            }
+            compress_image(image, options.format, out_texture.data.data() + desc.mips[mip].offset);
+        }
+    }
+
+    uint32_t get_texture_block_size(TextureFormat format)
+    {
+        switch (format)
+        {
+        case TextureFormat::RGBA8: return 4;
+        case TextureFormat::BC1: return 8;
+        case TextureFormat::BC5: return 16;
+        case TextureFormat::BC7: return 16;
+        default: return 0;
+        }
+    }
+
+    bool is_block_compressed(TextureFormat format)
+    {
+        return format != TextureFormat::RGBA8;
+    }
+
+    bool cook_texture(std::span<const uint8_t> image_file, const TextureCookOptions& options, CookedTexture& out_texture)
+    {
+        Image image;
+        if (!decode_image(image_file, image)) return false;
+
+        cook_image(std::move(image), options, out_texture);
+        return true;
+    }
+
+    bool cook_texture(std::span<const uint8_t> pixels, uint32_t width, uint32_t height, const TextureCookOptions& options, CookedTexture& out_texture)
+    {
+        if (width == 0 || height == 0 || pixels.size() != static_cast<uint64_t>(width) * height * 4)
+        {
+            LOG_ERROR("Call to cook_texture() failed for invalid pixel size.");
+            return false;
+        }
+
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.pixels.assign(pixels.begin(), pixels.end());
+        cook_image(std::move(image), options, out_texture);
+        return true;
+    }
+
+    bool cook_textures(std::span<const TextureCookDesc> descs)
+    {
+        std::vector<Image> images(descs.size());
+        std::vector<uint8_t> decoded(descs.size(), 0);
+        parallel::parallel_for(
+            [&](uint64_t ix)
+            {
+                std::ifstream input(descs[ix].source_path, std::ios::binary | std::ios::ate);
+                if (!input.is_open()) return;
+
+                std::vector<uint8_t> file(static_cast<uint64_t>(input.tellg()));
+                input.seekg(0);
+                if (!input.read(reinterpret_cast<char*>(file.data()), static_cast<std::streamsize>(file.size()))) return;
+
+                decoded[ix] = decode_image(file, images[ix]);
+            },
+            descs.size()
+        );
+
+        bool success = true;
+        for (uint64_t ix = 0; ix < descs.size(); ++ix)
+        {
+            if (!decoded[ix])
+            {
+                LOG_ERROR("Load texture " + descs[ix].source_path + " failed.");
+                success = false;
+                continue;
+            }
+
+            CookedTexture texture;
+            cook_image(std::move(images[ix]), descs[ix].options, texture);
+            if (!save_texture(descs[ix].output_path, texture)) success = false;
+        }
+        return success;
+    }
+
+    bool save_texture(const std::string& path, const CookedTexture& texture)
+    {
+        const TextureDesc& desc = texture.desc;
+
+        TextureFileHeader header{};
+        header.magic = TEXTURE_FILE_MAGIC;
+        header.version = TEXTURE_FILE_VERSION;
+        header.format = desc.format;
+        header.flags = (desc.srgb ? TEXTURE_FLAG_SRGB : 0) | (texture.options.generate_mips ? TEXTURE_FLAG_GENERATE_MIPS : 0);
+        header.width = desc.width;
+        header.height = desc.height;
+        header.mip_count = static_cast<uint32_t>(desc.mips.size());
+        header.data_offset = align_offset(sizeof(header) + desc.mips.size() * sizeof(TextureMip));
+        header.data_size = texture.data.size();
+
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            LOG_ERROR("Create texture " + path + " failed.");
+            return false;
+        }
+
+        const char padding[TEXTURE_DATA_ALIGNMENT] = {};
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(desc.mips.data()), static_cast<std::streamsize>(desc.mips.size() * sizeof(TextureMip)));
+        output.write(padding, static_cast<std::streamsize>(header.data_offset - sizeof(header) - desc.mips.size() * sizeof(TextureMip)));
+        output.write(reinterpret_cast<const char*>(texture.data.data()), static_cast<std::streamsize>(texture.data.size()));
+
+        if (!output.good())
+        {
+            LOG_ERROR("Write texture " + path + " failed.");
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_texture(
+        std::span<const uint8_t> file_data,
+        TextureDesc& out_desc,
+        TextureCookOptions& out_options,
+        std::span<const uint8_t>& out_data
+    )
+    {
+        TextureFileHeader header;
+        if (file_data.size() < sizeof(header)) return false;
+        memcpy(&header, file_data.data(), sizeof(header));
+
+        if (header.magic != TEXTURE_FILE_MAGIC || header.version != TEXTURE_FILE_VERSION) return false;
+        if (sizeof(header) + static_cast<uint64_t>(header.mip_count) * sizeof(TextureMip) > header.data_offset) return false;
+        // 偏移和大小都来自文件, 分开比较避免相加溢出.
+        if (header.data_offset > file_data.size() || header.data_size > file_data.size() - header.data_offset) return false;
+
+        out_desc.format = header.format;
+        out_desc.srgb = (header.flags & TEXTURE_FLAG_SRGB) != 0;
+        out_desc.width = header.width;
+        out_desc.height = header.height;
+        out_desc.mips.resize(header.mip_count);
+        memcpy(out_desc.mips.data(), file_data.data() + sizeof(header), header.mip_count * sizeof(TextureMip));
+
+        // 格式和 sRGB 在烘焙时直接取自选项.
+        out_options.format = header.format;
+        out_options.srgb = out_desc.srgb;
+        out_options.generate_mips = (header.flags & TEXTURE_FLAG_GENERATE_MIPS) != 0;
+
+        for (const auto& mip : out_desc.mips)
+        {
+            if (mip.offset > header.data_size || mip.size > header.data_size - mip.offset) return false;
+        }
+
+        out_data = file_data.subspan(header.data_offset, header.data_size);
+        return true;
+    }
+}
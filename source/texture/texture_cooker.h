@@ -0,0 +1,94 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace fantasy
+{
+    enum class TextureFormat : uint32_t
+    {
+        RGBA8,
+        BC1,
+        BC5,
+        BC7
+    };
+
+    struct TextureMip
+    {
+        uint64_t offset = 0;        // 相对数据起始位置, 按 16 字节对齐, 可直接作为 bufferOffset.
+        uint64_t size = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    struct TextureDesc
+    {
+        TextureFormat format = TextureFormat::RGBA8;
+        bool srgb = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<TextureMip> mips;
+    };
+
+    struct TextureCookOptions
+    {
+        TextureFormat format = TextureFormat::BC7;
+        bool srgb = true;           // 颜色贴图在线性空间中生成 mip.
+        bool generate_mips = true;
+
+        bool operator==(const TextureCookOptions&) const = default;
+    };
+
+    struct CookedTexture
+    {
+        TextureDesc desc;
+        TextureCookOptions options; // 写入 .ftex, 读取时与当前的选项比较, 不同则需要重新烘焙.
+        std::vector<uint8_t> data;  // 所有 mip 连续存放, 可整体拷贝到暂存缓冲区.
+    };
+
+    struct TextureCookDesc
+    {
+        std::string source_path;
+        std::string output_path;
+        TextureCookOptions options;
+    };
+
+    // 一个像素或一个 4x4 块的字节数.
+    uint32_t get_texture_block_size(TextureFormat format);
+    bool is_block_compressed(TextureFormat format);
+
+    // 解码 jpg/png 等图片文件, 生成 mip 链并压缩. mip 生成和块压缩按行分块并行, 需要先调用 parallel::initialize(),
+    // 且不能在线程池的任务中调用.
+    bool cook_texture(std::span<const uint8_t> image_file, const TextureCookOptions& options, CookedTexture& out_texture);
+
+    // 输入已经解码的 RGBA8 像素, 其余与上面相同.
+    bool cook_texture(std::span<const uint8_t> pixels, uint32_t width, uint32_t height, const TextureCookOptions& options, CookedTexture& out_texture);
+
+    // 离线批量处理, 并行解码所有图片, 之后逐个生成 mip 并压缩, 写入 output_path.
+    bool cook_textures(std::span<const TextureCookDesc> descs);
+
+    // .ftex 文件: 文件头 (包括烘焙选项), mip 表, 对齐到 16 字节的数据.
+    bool save_texture(const std::string& path, const CookedTexture& texture);
+
+    // out_data 指向 file_data 中的数据部分, 不做拷贝.
+    bool parse_texture(
+        std::span<const uint8_t> file_data,
+        TextureDesc& out_desc,
+        TextureCookOptions& out_options,
+        std::span<const uint8_t>& out_data
+    );
+}
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -3,7 +3,11 @@
 #include <cstdint>
 #include <cstring>
 #include <minwindef.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <set>
+#include <thread>
 #include <vector>
 #include <windef.h>
 #include "core/math/common.h"
@@ -11,6 +15,12 @@
 #include "core/math/vector.h"
 #include "vulkan/vulkan_core.h"
 #include "shader/shader_compiler.h"
+#include "core/parallel/parallel.h"
+#include "core/tools/asset_archive.h"
+#include "core/tools/file.h"
+#include "core/tools/timer.h"
+#include "texture/texture_cooker.h"
+#include <span>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -36,13 +46,95 @@ namespace fantasy
         app->window_resized = true;
     }
 
+	bool VulkanBase::run(const RunOptions& options)
+	{
+		_options = options;
+		ReturnIfFalse(_options.instance_count > 0);
+
+		if (_options.headless && _options.frame_count == 0)
+		{
+			LOG_ERROR("Headless mode needs a frame count.");
+			return false;
+		}
+		if (!_options.dump_path.empty() && !_options.headless)
+		{
+			LOG_ERROR("Dumping the back buffer needs headless mode.");
+			return false;
+		}
+		if (!_options.benchmark_path.empty())
+		{
+			ReturnIfFalse(_options.frame_count > 0);
+			_benchmark.initialize(_options.warmup_frame_count, _options.frame_count);
+		}
+
+		if (!_options.headless && !_window.initialize_window(_options.resolution)) return false;
+
+		ReturnIfFalse(initialize());
+
+		// CPU 帧时间是相邻两帧开始的间隔, 包括等待 fence 和 present.
+		bool succeeded = true;
+		Timer frame_timer;
+		const uint64_t total_frame_count = _options.warmup_frame_count + _options.frame_count;
+		while (_options.frame_count == 0 || _frame_index < total_frame_count)
+		{
+			if (!_options.headless)
+			{
+				if (_window.should_close()) break;
+				glfwPollEvents();
+			}
+
+			const uint64_t frame_index = _frame_index;
+			if (!render_loop())
+			{
+				succeeded = false;
+				break;
+			}
+
+			// 重建交换链时这一帧没有提交, 不计入.
+			const float frame_time = frame_timer.tick();
+			if (_frame_index != frame_index) _benchmark.record_cpu_time(frame_index, frame_time * 1000.0);
+
+			if (!_options.headless) _window.title_fps();
+		}
+		ReturnIfFalse(vkDeviceWaitIdle(_device) == VK_SUCCESS);
+
+		// 最后几帧的时间戳还没有读取.
+		for (uint64_t ix = _frame_index - std::min<uint64_t>(_frame_index, NUM_FRAMES_IN_FLIGHT); ix < _frame_index; ++ix)
+		{
+			collect_gpu_time(ix);
+		}
+		if (succeeded) succeeded = write_benchmark();
+		if (succeeded && !_options.dump_path.empty()) succeeded = dump_back_buffer();
+
+		destroy();
+		if (!_options.headless) _window.terminate_window();
+		return succeeded;
+	}
+
 	bool VulkanBase::initialize()
 	{
-		glfwSetWindowUserPointer(_window.get_window(), this);
-		glfwSetFramebufferSizeCallback(_window.get_window(), window_resize_callback);
+		if (!_options.headless)
+		{
+			glfwSetWindowUserPointer(_window.get_window(), this);
+			glfwSetFramebufferSizeCallback(_window.get_window(), window_resize_callback);
+		}
+
+		parallel::initialize();
+		ReturnIfFalse(_async_file_io.initialize());
+
+		// 贴图的读取和解码在后台进行, 与设备创建重叠, create_texture() 中等待完成.
+		load_texture_async();
 
 		set_shader_platform(ShaderPlatform::SPIRV);
 
+#ifdef SHADER_HOT_RELOAD
+		// 只在 debug 模式下监视 shader 目录, 无窗口运行时不会修改 shader.
+		if (!_options.headless)
+		{
+			ReturnIfFalse(_shader_hot_reload.initialize(std::string(PROJ_DIR) + "source/shader/"));
+		}
+#endif
+
 		ReturnIfFalse(create_instance());
 
 		// 遍历系统支持的扩展, 并全部输出.
@@ -52,62 +144,99 @@ namespace fantasy
 		// 开启调试信息回调, 之开启校验层并不会输出信息.
 		ReturnIfFalse(create_debug_utils_messager());
 #endif
-		ReturnIfFalse(glfwCreateWindowSurface(_instance, _window.get_window(), nullptr, &_surface) == VK_SUCCESS);
+		if (!_options.headless)
+		{
+			ReturnIfFalse(glfwCreateWindowSurface(_instance, _window.get_window(), nullptr, &_surface) == VK_SUCCESS);
+		}
 		ReturnIfFalse(pick_physical_device());
 		ReturnIfFalse(create_device());
+		ReturnIfFalse(_gpu_allocator.initialize(_physical_device, _device));
+		ReturnIfFalse(_upload_manager.initialize(
+			_device, 
+			&_gpu_allocator, 
+			_queue_family_index.transfer_index, 
+			_transfer_queue, 
+			_queue_family_index.graphics_index
+		));
+		ReturnIfFalse(_pipeline_cache.initialize(
+			_physical_device, 
+			_device, 
+			std::string(PROJ_DIR) + "asset/pipeline_cache/pipeline_cache.bin"
+		));
+		ReturnIfFalse(_bindless_heap.initialize(_physical_device, _device));
+		ReturnIfFalse(_constant_allocator.initialize(_physical_device, &_gpu_allocator, &_bindless_heap));
 		ReturnIfFalse(create_swapchain());
-		ReturnIfFalse(create_pipeline());
+		ReturnIfFalse(create_pipelines());
 		ReturnIfFalse(create_frame_buffer());
 		ReturnIfFalse(create_command_pool());
 		ReturnIfFalse(create_command_buffer());
+		ReturnIfFalse(_command_recorder.initialize(
+			_device, 
+			_queue_family_index.graphics_index, 
+			_options.record_thread_count > 0 ? _options.record_thread_count : std::max(std::thread::hardware_concurrency(), 1u)
+		));
+		ReturnIfFalse(_render_graph_executor.initialize(_device, &_gpu_allocator));
 		ReturnIfFalse(create_sync_objects());
 		ReturnIfFalse(create_vertex_buffer());
 		ReturnIfFalse(create_index_buffer());
+		ReturnIfFalse(create_instance_buffer());
 
-		ReturnIfFalse(create_binding_layout());
-		ReturnIfFalse(create_constant_buffer());
+		ReturnIfFalse(create_draw_buffers());
 		ReturnIfFalse(create_texture());
 		ReturnIfFalse(create_sampler());
-		ReturnIfFalse(create_binding_set());
+
+		if (_benchmark.is_enabled())
+		{
+			ReturnIfFalse(_gpu_timer.initialize(_physical_device, _device, _queue_family_index.graphics_index));
+		}
 		return true;
 	}
 
 
 	bool VulkanBase::destroy()
 	{
-		vkDestroyBuffer(_device, _index_buffer, nullptr);
-		vkFreeMemory(_device, _index_buffer_memory, nullptr);
-		vkDestroyBuffer(_device, _vertex_buffer, nullptr);
-		vkFreeMemory(_device, _vertex_buffer_memory, nullptr);
-		vkDestroySemaphore(_device, _back_buffer_avaible_semaphore, nullptr);
-		vkDestroySemaphore(_device, _render_finished_semaphore, nullptr);
-		vkDestroyFence(_device, _fence, nullptr);
+		_shader_hot_reload.destroy();
+		_async_file_io.destroy();
+		parallel::destroy();
+		_upload_manager.destroy();
+
+		_gpu_allocator.destroy_buffer(_index_buffer, _index_buffer_memory);
+		_gpu_allocator.destroy_buffer(_vertex_buffer, _vertex_buffer_memory);
+		_gpu_allocator.destroy_buffer(_instance_buffer, _instance_buffer_memory);
+		for (auto& frame : _frames)
+		{
+			release_retired_pipelines(frame);
+			vkDestroySemaphore(_device, frame.back_buffer_avaible_semaphore, nullptr);
+			vkDestroySemaphore(_device, frame.render_finished_semaphore, nullptr);
+			vkDestroyFence(_device, frame.fence, nullptr);
+			_gpu_allocator.destroy_buffer(frame.draw_command_buffer, frame.draw_command_buffer_memory);
+			_gpu_allocator.destroy_buffer(frame.draw_count_buffer, frame.draw_count_buffer_memory);
+			vkFreeCommandBuffers(_device, frame.cmd_pool, 1, &frame.cmd_buffer);
+			vkDestroyCommandPool(_device, frame.cmd_pool, nullptr);
+		}
+		_command_recorder.destroy();
+		_render_graph_executor.destroy();
+		_gpu_timer.destroy();
 
 		clean_up_swapchain();
 
 		vkDestroySampler(_device, _linear_wrap_sampler, nullptr);
 
 		vkDestroyImageView(_device, _test_texture_view, nullptr);
-		vkDestroyImage(_device, _test_texture, nullptr);
-		vkFreeMemory(_device, _test_texture_memory, nullptr);
+		_gpu_allocator.destroy_image(_test_texture, _test_texture_memory);
 		
-		vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr);
-		vkDestroyDescriptorSetLayout(_device, _binding_layout, nullptr);	
-		for (uint32_t ix = 0; ix < _constant_buffers.size(); ++ix)
-		{
-			vkDestroyBuffer(_device, _constant_buffers[ix], nullptr);
-			vkFreeMemory(_device, _constant_buffer_memorys[ix], nullptr);
-		}
-		vkFreeCommandBuffers(_device, _cmd_pool, 1, &_cmd_buffer);
-		vkDestroyCommandPool(_device, _cmd_pool, nullptr);
-		vkDestroyPipeline(_device, _graphics_pipeline, nullptr);
+		_constant_allocator.destroy();
+		_bindless_heap.destroy();
+		_pipeline_cache.destroy();
 		vkDestroyPipelineLayout(_device, _layout, nullptr);
+		vkDestroyPipelineLayout(_device, _cull_layout, nullptr);
 		vkDestroyRenderPass(_device, _render_pass, nullptr);
 
 #ifdef DEBUG
 		ReturnIfFalse(destroy_debug_utils_messager());
 #endif
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		_gpu_allocator.destroy();
+		if (!_options.headless) vkDestroySurfaceKHR(_instance, _surface, nullptr);
 		vkDestroyDevice(_device, nullptr);
 		vkDestroyInstance(_instance, nullptr);
 		return true;
@@ -136,9 +265,13 @@ namespace fantasy
 		instance_info.pApplicationInfo = &app_info;
 
 
-		uint32_t glfw_extension_count = 0;
-		const CHAR** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-		_instance_extensions.insert(_instance_extensions.end(), glfw_extensions, glfw_extensions + glfw_extension_count);
+		// headless 时没有 surface, 不需要窗口系统的扩展.
+		if (!_options.headless)
+		{
+			uint32_t glfw_extension_count = 0;
+			const CHAR** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+			_instance_extensions.insert(_instance_extensions.end(), glfw_extensions, glfw_extensions + glfw_extension_count);
+		}
 
 #ifdef DEBUG
 		// LunarG 的 Vulkan SDK 允许我们通过 VKLAYER_KHRONOS_validation 来隐式地开启所有可用的校验层.
@@ -257,28 +390,64 @@ namespace fantasy
 		for (const auto& device : physical_devices)
 		{
 			VkPhysicalDeviceProperties properties;
-			VkPhysicalDeviceFeatures features;
 			vkGetPhysicalDeviceProperties(device, &properties);
-			vkGetPhysicalDeviceFeatures(device, &features);
 
+			VkPhysicalDeviceVulkan13Features features13{};
+			features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+			VkPhysicalDeviceVulkan12Features features12{};
+			features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			features12.pNext = &features13;
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &features12;
+			vkGetPhysicalDeviceFeatures2(device, &features);
+
+			// headless 时也接受 CPU 设备, 以便在没有 GPU 的机器上用 lavapipe 运行.
 			bool device_type_support = 
 				properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || 
-				properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+				properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+				(_options.headless && properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU);
 			
+			// 贴图使用 BC 压缩格式, 上传队列使用时间线信号量, 渲染图使用 vkCmdPipelineBarrier2.
+			// 实例由 GPU 剔除后用 vkCmdDrawIndexedIndirectCount 绘制, firstInstance 传递实例下标.
+			const bool indirect_draw_support = 
+				features.features.multiDrawIndirect &&
+				features.features.drawIndirectFirstInstance &&
+				features12.drawIndirectCount;
+
+			// 资源通过 bindless 描述符集访问, 需要 descriptor indexing 的全部相关特性.
+			const bool descriptor_indexing_support = 
+				features12.runtimeDescriptorArray &&
+				features12.descriptorBindingPartiallyBound &&
+				features12.descriptorBindingUpdateUnusedWhilePending &&
+				features12.descriptorBindingSampledImageUpdateAfterBind &&
+				features12.descriptorBindingStorageBufferUpdateAfterBind &&
+				features12.shaderSampledImageArrayNonUniformIndexing &&
+				features12.shaderStorageBufferArrayNonUniformIndexing;
+
 			if (
 				device_type_support && 
+				features.features.textureCompressionBC &&
+				features12.timelineSemaphore &&
+				features13.synchronization2 &&
+				descriptor_indexing_support &&
+				indirect_draw_support &&
 				find_queue_family(device) &&
 				check_device_extension(device) && 
-				check_swapchain_support(device)
+				(_options.headless || check_swapchain_support(device))
 			)
 			{
 				_physical_device = device;
-				vkGetPhysicalDeviceMemoryProperties(_physical_device, &_memory_properties);
 
 				break;
 			}
 		}
 
+		if (_physical_device == VK_NULL_HANDLE)
+		{
+			LOG_ERROR("No physical device supports the required features.");
+			return false;
+		}
 		return true;
 	}
 
@@ -295,7 +464,11 @@ namespace fantasy
 			VkBool32 present_support = false;
 
 			// 验证所获取的 surface 能否支持该物理设备的 queue family 进行 present.
-			if (vkGetPhysicalDeviceSurfaceSupportKHR(physical_device , ix, _surface, &present_support) == VK_SUCCESS && present_support) 
+			if (
+				!_options.headless &&
+				vkGetPhysicalDeviceSurfaceSupportKHR(physical_device , ix, _surface, &present_support) == VK_SUCCESS && 
+				present_support
+			) 
 			{
 				_queue_family_index.present_index = ix;
 			}
@@ -304,15 +477,34 @@ namespace fantasy
 				_queue_family_index.graphics_index = ix;
 			}
 
+			// headless 时不需要 present, present 队列就是图形队列.
+			if (_options.headless) _queue_family_index.present_index = _queue_family_index.graphics_index;
+
 
 			if (
 				_queue_family_index.graphics_index != INVALID_SIZE_32 && 
-				_queue_family_index.graphics_index != INVALID_SIZE_32
+				_queue_family_index.present_index != INVALID_SIZE_32
 			) 
 			{
 				break;
 			}
 		}
+
+		// 优先使用只支持传输的队列族 (独显上的 DMA 引擎), 上传与渲染并行. 没有时与图形队列共用.
+		_queue_family_index.transfer_index = _queue_family_index.graphics_index;
+		for (uint32_t ix = 0; ix < properties.size(); ++ix)
+		{
+			const VkQueueFlags flags = properties[ix].queueFlags;
+			if (
+				properties[ix].queueCount > 0 && 
+				(flags & VK_QUEUE_TRANSFER_BIT) && 
+				!(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+			)
+			{
+				_queue_family_index.transfer_index = ix;
+				break;
+			}
+		}
 		return true;
 	}
 
@@ -322,7 +514,11 @@ namespace fantasy
 		VkDeviceCreateInfo device_create_info{};
 		device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
-		std::set<uint32_t> queue_family_indices = { _queue_family_index.graphics_index, _queue_family_index.present_index };
+		std::set<uint32_t> queue_family_indices = { 
+			_queue_family_index.graphics_index, 
+			_queue_family_index.present_index, 
+			_queue_family_index.transfer_index 
+		};
 		std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 
 		FLOAT queue_priority = 1.0f;
@@ -336,12 +532,32 @@ namespace fantasy
 		}
 
 		device_create_info.pQueueCreateInfos = queue_create_infos.data();
-		device_create_info.queueCreateInfoCount = 1;
+		device_create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 		
-		// 暂时不设立 features.
 		VkPhysicalDeviceFeatures device_features{};
+		device_features.textureCompressionBC = VK_TRUE;
+		device_features.multiDrawIndirect = VK_TRUE;
+		device_features.drawIndirectFirstInstance = VK_TRUE;
 		device_create_info.pEnabledFeatures = &device_features;
 
+		VkPhysicalDeviceVulkan13Features features13{};
+		features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		features13.synchronization2 = VK_TRUE;
+
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		features12.timelineSemaphore = VK_TRUE;
+		features12.drawIndirectCount = VK_TRUE;
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+		features12.pNext = &features13;
+		device_create_info.pNext = &features12;
+
 		device_create_info.enabledExtensionCount = static_cast<uint32_t>(_device_extensions.size());
 		device_create_info.ppEnabledExtensionNames = _device_extensions.data();
 #if DEBUG
@@ -352,15 +568,16 @@ namespace fantasy
 		ReturnIfFalse(vkCreateDevice(_physical_device, &device_create_info, nullptr, &_device) == VK_SUCCESS);
 		vkGetDeviceQueue(_device, _queue_family_index.graphics_index, 0, &_graphics_queue);
 		vkGetDeviceQueue(_device, _queue_family_index.present_index, 0, &_present_queue);
+		vkGetDeviceQueue(_device, _queue_family_index.transfer_index, 0, &_transfer_queue);
 		
 		return true;  
 	}
 
 	bool VulkanBase::check_device_extension(const auto& physical_device)
 	{
-		_device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		if (!_options.headless) _device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		
-		// 检查物理设备是否支持所需扩展, 现在就只有交换链这一个设备扩展.
+		// 检查物理设备是否支持所需扩展, 现在就只有交换链这一个设备扩展, headless 时没有.
 		uint32_t extension_count = 0;
 		ReturnIfFalse(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr) == VK_SUCCESS);
 		std::vector<VkExtensionProperties> extension_properties(extension_count);
@@ -422,6 +639,8 @@ namespace fantasy
 
 	bool VulkanBase::create_swapchain()
 	{
+		if (_options.headless) return create_offscreen_back_buffers() && create_back_buffer_views();
+
 		// 确定缓冲区个数.
 		// 若 maxImageCount 的值为 0 表明，只要内存可以满足，我们可以使用任意数量的图像.
 		uint32_t frames_in_flight_count = std::min(_swapchain_info.surface_capabilities.minImageCount + 1, NUM_FRAMES_IN_FLIGHT);
@@ -528,14 +747,54 @@ namespace fantasy
 		_back_buffers.resize(back_buffer_count);
 		ReturnIfFalse(vkGetSwapchainImagesKHR(_device, _swapchain, &back_buffer_count, _back_buffers.data()) == VK_SUCCESS);
 		
-		_back_buffer_views.resize(back_buffer_count);
-		for (uint32_t ix = 0; ix < back_buffer_count; ++ix)
+		return create_back_buffer_views();
+	}
+
+	bool VulkanBase::create_offscreen_back_buffers()
+	{
+		// 与帧资源一一对应, 第 N 帧使用的图像在等待这一帧的 fence 后就不再被 GPU 使用, 不需要获取图像的信号量.
+		_client_resolution = _options.resolution;
+		_swapchain_format = VK_FORMAT_R8G8B8A8_UNORM;
+
+		VkImageCreateInfo create_info{};
+		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		create_info.imageType = VK_IMAGE_TYPE_2D;
+		create_info.format = _swapchain_format;
+		create_info.extent = { _client_resolution.width, _client_resolution.height, 1 };
+		create_info.mipLevels = 1;
+		create_info.arrayLayers = 1;
+		create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+
+		// TRANSFER_SRC 用于 --dump 时把最后一帧拷贝出来比对.
+		create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		_back_buffers.resize(NUM_FRAMES_IN_FLIGHT);
+		_back_buffer_memories.resize(NUM_FRAMES_IN_FLIGHT);
+		for (uint32_t ix = 0; ix < NUM_FRAMES_IN_FLIGHT; ++ix)
+		{
+			ReturnIfFalse(_gpu_allocator.create_image(
+				create_info, 
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+				_back_buffers[ix], 
+				_back_buffer_memories[ix]
+			));
+		}
+		return true;
+	}
+
+	bool VulkanBase::create_back_buffer_views()
+	{
+		_back_buffer_views.resize(_back_buffers.size());
+		for (uint32_t ix = 0; ix < _back_buffers.size(); ++ix)
 		{
 			VkImageViewCreateInfo view_create_info{};
 			view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 			view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
 			view_create_info.image = _back_buffers[ix];
-			view_create_info.format = swapchain_create_info.imageFormat;
+			view_create_info.format = _swapchain_format;
 			
 			// components 成员变量用于进行图像颜色通道的映射.
 			// 比如, 对于单色纹理, 我们可以将所有颜色通道映射到红色通道. 我们也可以直接将颜色通道的值映射为常数 0 或 1.
@@ -561,70 +820,71 @@ namespace fantasy
 		return true;
 	}
 
-	bool VulkanBase::create_pipeline()
+	bool VulkanBase::create_pipelines()
+	{
+		// 着色器的字节码在管线创建完成之前必须有效.
+		std::array<ShaderData, 2> shader_datas;
+		ShaderData cull_shader_data;
+		GraphicsPipelineDesc graphics_desc;
+		ComputePipelineDesc cull_desc;
+		ReturnIfFalse(create_pipeline(shader_datas, graphics_desc));
+		ReturnIfFalse(create_cull_pipeline(cull_shader_data, cull_desc));
+
+		// 所有管线在线程池上一起创建, 驱动编译着色器的时间可以重叠.
+		return _pipeline_cache.create_pipelines({ &graphics_desc, 1 }, { &_graphics_pipeline, 1 }, { &cull_desc, 1 }, { &_cull_pipeline, 1 });
+	}
+
+	bool VulkanBase::create_pipeline(std::array<ShaderData, 2>& out_shader_datas, GraphicsPipelineDesc& out_desc)
 	{
 		ShaderCompileDesc vs_desc;
 		vs_desc.shader_name = "triangle_vs.slang";
 		vs_desc.entry_point = "main";
 		vs_desc.target = ShaderTarget::Vertex;
-		ShaderData vs_data = compile_shader(vs_desc);
+		out_shader_datas[0] = compile_shader(vs_desc);
 		
 		ShaderCompileDesc ps_desc;
 		ps_desc.shader_name = "triangle_ps.slang";
 		ps_desc.entry_point = "main";
 		ps_desc.target = ShaderTarget::Pixel;
-		ShaderData ps_data = compile_shader(ps_desc);
-
-
-		VkShaderModule vs;
-		VkShaderModule ps;
-
-		VkShaderModuleCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		create_info.codeSize = vs_data.size();
-		create_info.pCode = reinterpret_cast<uint32_t*>(vs_data.data());
-		ReturnIfFalse(vkCreateShaderModule(_device, &create_info, nullptr, &vs) == VK_SUCCESS);
-		create_info.codeSize = ps_data.size();
-		create_info.pCode = reinterpret_cast<uint32_t*>(ps_data.data());
-		ReturnIfFalse(vkCreateShaderModule(_device, &create_info, nullptr, &ps) == VK_SUCCESS);
-
-		VkPipelineShaderStageCreateInfo vs_stage_create_info{};
-		vs_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vs_stage_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vs_stage_create_info.module = vs;
-		vs_stage_create_info.pName = vs_desc.entry_point.c_str();
-
-		VkPipelineShaderStageCreateInfo ps_stage_create_info{};
-		ps_stage_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		ps_stage_create_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		ps_stage_create_info.module = ps;
-		ps_stage_create_info.pName = ps_desc.entry_point.c_str();
-		// 该成员变量指定预编译宏.
-		// shader_stage_create_info.pSpecializationInfo;
-
-		VkPipelineShaderStageCreateInfo shader_stage_infos[2] = {
-			vs_stage_create_info, ps_stage_create_info
-		};
+		out_shader_datas[1] = compile_shader(ps_desc);
 
-		auto vertex_input_binding = Vertex::get_input_binding_description();
-		auto vertex_input_attribute = Vertex::get_input_attribute_description();
+		ReturnIfFalse(!out_shader_datas[0].invalid() && !out_shader_datas[1].invalid());
 
-		VkPipelineVertexInputStateCreateInfo vertex_input_create_info{};
-		vertex_input_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertex_input_create_info.vertexBindingDescriptionCount = 1;
-		vertex_input_create_info.pVertexBindingDescriptions = &vertex_input_binding;
-		vertex_input_create_info.vertexAttributeDescriptionCount = vertex_input_attribute.size();
-		vertex_input_create_info.pVertexAttributeDescriptions = vertex_input_attribute.data();
+		// 描述符集固定为 bindless 描述符集, 反射只用于校验. push constant 来自编译时的反射.
+		const ShaderCompileDesc shader_descs[2] = { vs_desc, ps_desc };
+		const std::span<const ShaderData> shader_datas = out_shader_datas;
+		ReturnIfFalse(check_bindless_bindings(shader_descs, shader_datas));
 
-		VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info{};
-		input_assembly_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		input_assembly_create_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		
-		// 设置为VK TRUE, 那么使用带有 _STRIP 结尾的图元类型, 
-		// 可以通过一个特殊索引值 0xFFFF 或 0xFFFFFFFF 达到重启图元的目的
-		// (从特殊索引值之后的索引重置为图元的第一个顶点).
-		input_assembly_create_info.primitiveRestartEnable = VK_FALSE;
+		VkPushConstantRange push_constant_range{};
+		for (uint32_t ix = 0; ix < 2; ++ix)
+		{
+			const uint32_t size = shader_datas[ix]._reflection.push_constant_size;
+			if (size == 0) continue;
+			push_constant_range.stageFlags |= get_shader_stage(shader_descs[ix].target);
+			push_constant_range.size = std::max(push_constant_range.size, size);
+		}
+		if (push_constant_range.size != sizeof(DrawPushConstant))
+		{
+			LOG_ERROR("Push constant size " + std::to_string(push_constant_range.size) + " doesn't match DrawPushConstant.");
+			return false;
+		}
+		_push_constant_stages = push_constant_range.stageFlags;
+
+		const VkDescriptorSetLayout bindless_layout = _bindless_heap.get_layout();
+
+		VkPipelineLayoutCreateInfo layout_create_info{};
+		layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layout_create_info.setLayoutCount = 1;
+		layout_create_info.pSetLayouts = &bindless_layout;
+		layout_create_info.pushConstantRangeCount = push_constant_range.size > 0 ? 1 : 0;
+		layout_create_info.pPushConstantRanges = push_constant_range.size > 0 ? &push_constant_range : nullptr;
+
+		ReturnIfFalse(vkCreatePipelineLayout(_device, &layout_create_info, nullptr, &_layout) == VK_SUCCESS);
+
+		ReturnIfFalse(create_render_pass());
+		out_desc = get_graphics_pipeline_desc(vs_desc, out_shader_datas[0], ps_desc, out_shader_datas[1]);
 
+		// 视口和裁剪矩形是动态状态, 在绘制时指定.
 		_viewport.x = 0.0f;
 		_viewport.y = 0.0f;
 		_viewport.width = _client_resolution.width;
@@ -635,138 +895,153 @@ namespace fantasy
 		_scissor.offset = { 0, 0 };
 		_scissor.extent = { _client_resolution.width, _client_resolution.height };
 
-		// 使用多个视口和裁剪矩形需要启用特性 VkPhysicalDeviceFeatures.multiViewport.
-		VkPipelineViewportStateCreateInfo viewport_create_info{};
-		viewport_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewport_create_info.viewportCount = 1;
-		viewport_create_info.pViewports = &_viewport;
-		viewport_create_info.scissorCount = 1;
-		viewport_create_info.pScissors = &_scissor;
-
-		VkPipelineRasterizationStateCreateInfo raster_create_info{};
-		raster_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-
-		// 设置为 VK_TRUE 表示在近平面和远平面外的片段会被截断为在近平面和远平面上, 而不是直接丢弃这些片段.
-		// 需启用特性 VkPhysicalDeviceFeatures.depthClamp.
-		raster_create_info.depthBiasClamp = VK_FALSE;
+		// 着色器文件修改后在后台重新编译并创建管线, 在 draw() 中只替换句柄, 旧管线可能仍被其它帧使用, 延迟销毁.
+		_shader_hot_reload.add_program(
+			{ vs_desc, ps_desc },
+			shader_datas,
+			[this, vs_desc, ps_desc](std::span<const ShaderData> datas, ShaderHotReload::CommitFunc& out_commit)
+			{
+				// 描述符集布局是固定的, 只要仍在 bindless 布局内就可以沿用管线布局; push constant 的阶段变化后只能重启.
+				const ShaderCompileDesc shader_descs[2] = { vs_desc, ps_desc };
+				ReturnIfFalse(check_bindless_bindings(shader_descs, datas));
 
-		// 设置为 VK_TRUE 表示所有几何图元都不能通过光栅化阶段, 这一设置会禁止一切片段输出到帧缓冲.
-		raster_create_info.rasterizerDiscardEnable = VK_FALSE;
+				VkShaderStageFlags push_constant_stages = 0;
+				if (datas[0]._reflection.push_constant_size > 0) push_constant_stages |= get_shader_stage(vs_desc.target);
+				if (datas[1]._reflection.push_constant_size > 0) push_constant_stages |= get_shader_stage(ps_desc.target);
+				if (
+					push_constant_stages != _push_constant_stages ||
+					std::max(datas[0]._reflection.push_constant_size, datas[1]._reflection.push_constant_size) != sizeof(DrawPushConstant)
+				)
+				{
+					LOG_ERROR("Shader push constants changed, restart to apply the shader change.");
+					return false;
+				}
 
-		// VK_POLYGON_MODE_FILL：整个多边形，包括多边形内部都产生片段.
-		// VK_POLYGON_MODE_LINE：只有多边形的边会产生片段.
-		// VK_POLYGON_MODE_POINT：只有多边形的顶点会产生片段.
-		raster_create_info.polygonMode = VK_POLYGON_MODE_FILL;
+				VkPipeline pipeline;
+				ReturnIfFalse(_pipeline_cache.get_graphics_pipeline(get_graphics_pipeline_desc(vs_desc, datas[0], ps_desc, datas[1]), pipeline));
 
-		// lineWidth 成员变量用于指定光栅化后的线段宽度, 它以线宽所占的片段数目为单位.
-		// 线宽的最大值依赖于硬件, 使用大于 1.0f 的线宽, 需要启用特性 VkPhysicalDeviceFeatures.wideLines.
-		raster_create_info.lineWidth = 1.0f;
+				out_commit = [this, pipeline]()
+				{
+					// 字节码没有变化时得到的是同一个管线.
+					if (pipeline == _graphics_pipeline) return;
+
+					_pipeline_cache.evict(_graphics_pipeline);
+					get_current_frame().retired_pipelines.push_back(_graphics_pipeline);
+					_graphics_pipeline = pipeline;
+				};
+				return true;
+			}
+		);
+		return true;
+	}
 
-		raster_create_info.cullMode = VK_CULL_MODE_BACK_BIT;
-		raster_create_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		
-		// 设置为 VK_TRUE 时, 光栅化程序可以添加一个常量值或是一个基于片段所处线段的斜率得到的变量值到深度值上.
-		raster_create_info.depthBiasEnable = VK_FALSE;
-		raster_create_info.depthBiasConstantFactor = 0.0f;
-		raster_create_info.depthBiasClamp = 0.0f;
-		raster_create_info.depthBiasSlopeFactor = 0.0f;
-
-		VkPipelineMultisampleStateCreateInfo multisample_create_info{};
-		multisample_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisample_create_info.sampleShadingEnable = VK_FALSE;
-		multisample_create_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		multisample_create_info.minSampleShading = 1.0f;
-		multisample_create_info.pSampleMask = nullptr;
-		multisample_create_info.alphaToCoverageEnable = VK_FALSE;
-		multisample_create_info.alphaToOneEnable = VK_FALSE;
-
-		// 深度模板测试.
-		// VkPipelineDepthStencilStateCreateInfo
+	bool VulkanBase::create_cull_pipeline(ShaderData& out_shader_data, ComputePipelineDesc& out_desc)
+	{
+		ShaderCompileDesc cs_desc;
+		cs_desc.shader_name = "cull_cs.slang";
+		cs_desc.entry_point = "main";
+		cs_desc.target = ShaderTarget::Compute;
+		out_shader_data = compile_shader(cs_desc);
+		const ShaderData& cs_data = out_shader_data;
+		ReturnIfFalse(!cs_data.invalid());
+
+		ReturnIfFalse(check_bindless_bindings({ &cs_desc, 1 }, { &cs_data, 1 }));
+		if (cs_data._reflection.push_constant_size != sizeof(CullPushConstant))
+		{
+			LOG_ERROR("Push constant size " + std::to_string(cs_data._reflection.push_constant_size) + " doesn't match CullPushConstant.");
+			return false;
+		}
 
-		VkPipelineColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        color_blend_attachment.blendEnable = VK_FALSE;
-
-        VkPipelineColorBlendStateCreateInfo color_blend_create_info{};
-        color_blend_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        color_blend_create_info.logicOpEnable = VK_FALSE;
-        color_blend_create_info.logicOp = VK_LOGIC_OP_COPY;
-        color_blend_create_info.attachmentCount = 1;
-        color_blend_create_info.pAttachments = &color_blend_attachment;
-
-		// 包含 4 个浮点数的数组, 表示 RGBA 颜色值. 它的作用是为某些混合因子 (Blend Factors) 提供常量值. 
-		// 当 VkPipelineColorBlendAttachmentState.colorBlendOp 或 alphaBlendOP 中使用了以下混合因子
-		// VK_BLEND_FACTOR_CONSTANT_COLOR
-		// VK_BLEND_FACTOR_CONSTANT_ALPHA
-		// VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR
-		// VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_ALPHA
-		// 时, blendConstants 的值会被用作输入.
-		// blendConstants 的默认值为 [0.0f, 0.0f, 0.0f, 0.0f]
-        color_blend_create_info.blendConstants[0] = 0.0f;
-        color_blend_create_info.blendConstants[1] = 0.0f;
-        color_blend_create_info.blendConstants[2] = 0.0f;
-        color_blend_create_info.blendConstants[3] = 0.0f;
-
-		// 只有非常有限的管线状态可以在不重建管线的情况下进行动态修改.
-		// 这包括视口大小, 线宽和混合常量 (VkPipelineColorBlendStateCreateInfo.blendConstants).
-		VkDynamicState dynamic_state[2] = {
-			VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR
-		};
-		// 这样设置后会导致我们之前对这里使用的动态状态的设置被忽略掉, 需要我们在进行绘制时重新指定它们的值.
-		VkPipelineDynamicStateCreateInfo dynamic_state_create_info{};
-		dynamic_state_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		dynamic_state_create_info.dynamicStateCount = 2;
-		dynamic_state_create_info.pDynamicStates = dynamic_state;
+		VkPushConstantRange push_constant_range{};
+		push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_constant_range.size = sizeof(CullPushConstant);
 
-		ReturnIfFalse(create_binding_layout());
+		const VkDescriptorSetLayout bindless_layout = _bindless_heap.get_layout();
 
 		VkPipelineLayoutCreateInfo layout_create_info{};
 		layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		
-		// 暂时什么都不需要.
 		layout_create_info.setLayoutCount = 1;
-		layout_create_info.pSetLayouts = &_binding_layout;
-		layout_create_info.pushConstantRangeCount = 0;
-		layout_create_info.pPushConstantRanges = nullptr;
+		layout_create_info.pSetLayouts = &bindless_layout;
+		layout_create_info.pushConstantRangeCount = 1;
+		layout_create_info.pPushConstantRanges = &push_constant_range;
+		ReturnIfFalse(vkCreatePipelineLayout(_device, &layout_create_info, nullptr, &_cull_layout) == VK_SUCCESS);
+
+		out_desc.cs_code = cs_data.byte_code();
+		out_desc.cs_entry_point = cs_desc.entry_point;
+		out_desc.layout = _cull_layout;
+
+		_shader_hot_reload.add_program(
+			{ cs_desc },
+			{ &cs_data, 1 },
+			[this, cs_desc](std::span<const ShaderData> datas, ShaderHotReload::CommitFunc& out_commit)
+			{
+				ReturnIfFalse(check_bindless_bindings({ &cs_desc, 1 }, datas));
+				if (datas[0]._reflection.push_constant_size != sizeof(CullPushConstant))
+				{
+					LOG_ERROR("Shader push constants changed, restart to apply the shader change.");
+					return false;
+				}
 
-		ReturnIfFalse(vkCreatePipelineLayout(_device, &layout_create_info, nullptr, &_layout) == VK_SUCCESS);
+				ComputePipelineDesc desc;
+				desc.cs_code = datas[0].byte_code();
+				desc.cs_entry_point = cs_desc.entry_point;
+				desc.layout = _cull_layout;
 
-		ReturnIfFalse(create_render_pass());
+				VkPipeline pipeline;
+				ReturnIfFalse(_pipeline_cache.get_compute_pipeline(desc, pipeline));
 
-		VkGraphicsPipelineCreateInfo pipeline_create_info{};
-		pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipeline_create_info.stageCount = 2;
-		pipeline_create_info.pStages = shader_stage_infos;
-		pipeline_create_info.pVertexInputState = &vertex_input_create_info;
-		pipeline_create_info.pInputAssemblyState = &input_assembly_create_info;
-		pipeline_create_info.pViewportState = &viewport_create_info;
-		pipeline_create_info.pRasterizationState = &raster_create_info;
-		pipeline_create_info.pMultisampleState = &multisample_create_info;
-		pipeline_create_info.pColorBlendState = &color_blend_create_info;
-		pipeline_create_info.pDynamicState = &dynamic_state_create_info;
-		pipeline_create_info.layout = _layout;
-		pipeline_create_info.renderPass = _render_pass;
-		
-		// 若是要应用其他 subpass, 需要再创建一个 VkGraphicsPipeline.
-		pipeline_create_info.subpass = 0; 
+				out_commit = [this, pipeline]()
+				{
+					if (pipeline == _cull_pipeline) return;
+
+					_pipeline_cache.evict(_cull_pipeline);
+					get_current_frame().retired_pipelines.push_back(_cull_pipeline);
+					_cull_pipeline = pipeline;
+				};
+				return true;
+			}
+		);
+		return true;
+	}
 
-		// basePipelineHandle 和 basePipelineIndex 成员变量用于以一个创建好的图形管线为基础创建一个新的图形管线.
-		pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+	GraphicsPipelineDesc VulkanBase::get_graphics_pipeline_desc(
+		const ShaderCompileDesc& vs_desc,
+		const ShaderData& vs_data,
+		const ShaderCompileDesc& ps_desc,
+		const ShaderData& ps_data
+	) const
+	{
+		// 完整的管线状态交给 PipelineCache, 状态相同的管线只创建一次, 驱动的编译结果在下次启动时复用.
+		GraphicsPipelineDesc desc;
+		desc.vs_code = vs_data.byte_code();
+		desc.vs_entry_point = vs_desc.entry_point;
+		desc.ps_code = ps_data.byte_code();
+		desc.ps_entry_point = ps_desc.entry_point;
 
-		// 该函数被设计成一次调用可以通过多个 VkGraphicsPipelineCreateInfo 结构体数据创建多个 VkPipeline 对象.
-		ReturnIfFalse(VK_SUCCESS == vkCreateGraphicsPipelines(
-			_device, 
-			VK_NULL_HANDLE, 
-			1, 
-			&pipeline_create_info, 
-			nullptr, 
-			&_graphics_pipeline
-		));
-		
-		vkDestroyShaderModule(_device, vs, nullptr);
-		vkDestroyShaderModule(_device, ps, nullptr);
+		auto vertex_input_attribute = Vertex::get_input_attribute_description();
+		desc.vertex_bindings = { Vertex::get_input_binding_description() };
+		desc.vertex_attributes.assign(vertex_input_attribute.begin(), vertex_input_attribute.end());
+		desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-		return true;
+		// VK_POLYGON_MODE_FILL：整个多边形，包括多边形内部都产生片段.
+		// VK_POLYGON_MODE_LINE：只有多边形的边会产生片段.
+		// VK_POLYGON_MODE_POINT：只有多边形的顶点会产生片段.
+		desc.polygon_mode = VK_POLYGON_MODE_FILL;
+		desc.cull_mode = VK_CULL_MODE_BACK_BIT;
+		desc.front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		VkPipelineColorBlendAttachmentState color_blend_attachment{};
+		color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		color_blend_attachment.blendEnable = VK_FALSE;
+		desc.blend_attachments = { color_blend_attachment };
+
+		desc.layout = _layout;
+		desc.render_pass = _render_pass;
+
+		// 若是要应用其他 subpass, 需要再创建一个 VkGraphicsPipeline.
+		desc.subpass = 0;
+
+		return desc;
 	}
 
 	bool VulkanBase::create_render_pass()
@@ -791,12 +1066,10 @@ namespace fantasy
 		// image layout 类似于 resource state.
 		// initialLayout 成员变量用于指定渲染流程开始前的图像布局方式. 
 		// finalLayout 成员变量用于指定渲染流程结束后的图像布局方式. 
-		// 将 initialLayout 成员变量设置为 VK_IMAGE_LAYOUT_UNDEFINED 表示我们不关心之前的图像布局方式.
-		// 使用这一值后, 图像的内容不保证会被保留, 但这里，每次渲染前都要清除图像, 所以这样的设置更符合需求. 
-		// 对于 finalLayout 成员变量, 设置为 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR，使得渲染后的图像可以被交换链呈现.
-		// UNDEFINED 也就是 common, PRESENT_SRC_KHR 也就是 present.
-		attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachment_description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// 布局转换由渲染图的屏障完成: 进入 pass 前从 UNDEFINED 转换为 COLOR_ATTACHMENT_OPTIMAL,
+		// 所有 pass 结束后再转换为 PRESENT_SRC_KHR, 所以渲染流程本身不再转换布局.
+		attachment_description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment_description.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference attachment_ref{};
 		attachment_ref.attachment = 0;	// 索引.
@@ -817,25 +1090,9 @@ namespace fantasy
 		// pDepthStencilAttachment: 用于深度和模板数据的附着.
 		// pPreserveAttachments: 没有被这一子流程使用，但需要保留数据的附着.
 
-		VkSubpassDependency subpass_dependency{};
-		subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		subpass_dependency.dstSubpass = 0;
-
-		// srcStageMask 和 srcAccessMask 成员变量用于指定需要等待的管线阶段和子流程将进行的操作类型.
-		// 我们需要等待交换链结束对图像的读取才能对图像进行访问操作, 也就是等待颜色附着输出这一管线阶段.
-		subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpass_dependency.srcAccessMask = 0;
-
-		// dstStageMask 和 dstAccessMask 成员变量用于指定需要等待的管线阶段和子流程将进行的操作类型.
-		// 在这里, 我们的设置为等待颜色附着的输出阶段, 子流程将会进行颜色附着的读写操作.
-		// 这样设置后，图像布局变换 (也就是 resource state barrier)直到开始写入颜色数据时时才会进行.
-		subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-
 		// 需要把各个 VkAttachmentDescription 都放进来, 然后 VkSubpassDescription 会根据其 colorAttachmentCount 索引
-		// 使用这些 VkAttachmentDescription, 所有 VkSubpassDescription 也放进来, VkSubpassDependency 则会索引他们
-		// 根据依赖排列 pass 的执行顺序.
+		// 使用这些 VkAttachmentDescription, 所有 VkSubpassDescription 也放进来.
+		// 与渲染流程之外的同步 (等待交换链释放图像) 由渲染图的屏障负责, 不需要 VkSubpassDependency.
 
 		VkRenderPassCreateInfo render_pass_create_info{};
 		render_pass_create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -844,10 +1101,6 @@ namespace fantasy
 		render_pass_create_info.subpassCount = 1;
 		render_pass_create_info.pSubpasses = &subpass;
 
-		// VkSubpassDependency 用于定义渲染流程中不同子流程（Subpass）之间的依赖关系
-		render_pass_create_info.dependencyCount = 1;
-		render_pass_create_info.pDependencies = &subpass_dependency;
-
 		return vkCreateRenderPass(_device, &render_pass_create_info, nullptr, &_render_pass) == VK_SUCCESS;
 	}
 
@@ -881,31 +1134,39 @@ namespace fantasy
 		VkCommandPoolCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		create_info.queueFamilyIndex = _queue_family_index.graphics_index;
-		create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		// VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: 使用它分配的
 		// 指令缓冲对象被频繁用来记录新的指令 (使用这一标记可能会改变帧缓冲对象的内存分配策略).
 		// VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: 
 		// 指令缓冲对象之间相互独立, 不会被一起重置, 不使用这一标记, 指令缓冲对象会被放在一起重置.
 
-		return vkCreateCommandPool(_device, &create_info, nullptr, &_cmd_pool) == VK_SUCCESS;
+		// 每帧一个 pool, 等待该帧的 fence 后整体重置.
+		create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		for (auto& frame : _frames)
+		{
+			ReturnIfFalse(vkCreateCommandPool(_device, &create_info, nullptr, &frame.cmd_pool) == VK_SUCCESS);
+		}
+		return true;
 	}
 
 	bool VulkanBase::create_command_buffer()
 	{
 		VkCommandBufferAllocateInfo alloc_info{};
 		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		alloc_info.commandPool = _cmd_pool;
 
 		// VK_COMMAND_BUFFER_LEVEL_PRIMARY: 可以被提交到队列进行执行, 但不能被其它指令缓冲对象调用.
 		// VK_COMMAND_BUFFER_LEVEL_SECONDARY: 不能直接被提交到队列进行执行, 但可以被主要指令缓冲对象调用执行.
 		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 		alloc_info.commandBufferCount = 1;
-		ReturnIfFalse(vkAllocateCommandBuffers(_device, &alloc_info, &_cmd_buffer) == VK_SUCCESS);
+		for (auto& frame : _frames)
+		{
+			alloc_info.commandPool = frame.cmd_pool;
+			ReturnIfFalse(vkAllocateCommandBuffers(_device, &alloc_info, &frame.cmd_buffer) == VK_SUCCESS);
+		}
 
 		return true;
 	}
 
-	bool VulkanBase::record_command(uint32_t frame_buffer_index)
+	bool VulkanBase::record_command(const FrameContext& frame, uint32_t frame_buffer_index, uint64_t& upload_wait_value)
 	{
 		VkCommandBufferBeginInfo cmd_buffer_begin{};
 		cmd_buffer_begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -913,51 +1174,209 @@ namespace fantasy
 		// VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT: 这是一个只在一个渲染流程内使用的辅助指令缓冲.
 		// VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: 在指令缓冲等待执行时, 仍然可以提交这一指令缓冲.
 
-		ReturnIfFalse(vkBeginCommandBuffer(_cmd_buffer, &cmd_buffer_begin) == VK_SUCCESS);
+		ReturnIfFalse(vkBeginCommandBuffer(frame.cmd_buffer, &cmd_buffer_begin) == VK_SUCCESS);
+		_gpu_timer.begin_frame(frame.cmd_buffer, _frame_index);
+
+		// 提交这段时间攒下的上传, 并在渲染之前取得上传资源的所有权.
+		ReturnIfFalse(_upload_manager.flush(frame.cmd_buffer, upload_wait_value));
+
+		// 每帧重新声明渲染图, 声明不变时直接复用上次的执行计划.
+		// back buffer 由交换链提供, 获取它的信号量在 COLOR_ATTACHMENT_OUTPUT 阶段等待, 屏障从这一阶段开始即可.
+		// headless 时离屏图像的上一次使用已由 fence 等待, 渲染完后转换为 TRANSFER_SRC_OPTIMAL 以便 dump_back_buffer() 拷贝.
+		_render_graph.reset();
+		const RenderGraphHandle back_buffer = _render_graph.import_texture(
+			"back_buffer",
+			RenderGraphTextureDesc{
+				.width = _client_resolution.width,
+				.height = _client_resolution.height,
+				.format = _swapchain_format,
+				.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+			},
+			_options.headless ? 
+				RenderGraphResourceState{} : 
+				RenderGraphResourceState{ .stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT },
+			_options.headless ?
+				RenderGraphResourceState{ 
+					.stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+					.access = VK_ACCESS_2_TRANSFER_READ_BIT,
+					.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+				} :
+				RenderGraphResourceState{ .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR }
+		);
 
-		VkRenderPassBeginInfo render_pass_begin_info{};
-		render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		render_pass_begin_info.renderPass = _render_pass;
-		render_pass_begin_info.framebuffer = _frame_buffers[frame_buffer_index];
-		render_pass_begin_info.renderArea.offset = { 0, 0 };
-		render_pass_begin_info.renderArea.extent = _client_resolution;
+		// 间接绘制参数每帧由计算着色器重新生成. 这一帧的 fence 已经等待过, 之前的读取都已完成.
+		// 直接绘制时没有剔除 pass, 也不使用这两个 buffer.
+		RenderGraphHandle draw_commands;
+		RenderGraphHandle draw_count;
+		if (!_options.direct_draws)
+		{
+			draw_commands = _render_graph.import_buffer(
+				"draw_commands",
+				RenderGraphBufferDesc{ .size = sizeof(VkDrawIndexedIndirectCommand) * _options.instance_count },
+				RenderGraphResourceState{},
+				RenderGraphResourceState{}
+			);
+			draw_count = _render_graph.import_buffer(
+				"draw_count",
+				RenderGraphBufferDesc{ .size = sizeof(uint32_t) },
+				RenderGraphResourceState{},
+				RenderGraphResourceState{}
+			);
 
-		// 多个 render target 就指定多个 clear value.
-		VkClearValue clear_value = { 0.0f, 0.0f, 0.0f, 1.0f };
-		render_pass_begin_info.clearValueCount = 1;
-		render_pass_begin_info.pClearValues = &clear_value;
+			const uint32_t clear_pass = _render_graph.add_pass(
+				"clear_draw_count",
+				[&frame](VkCommandBuffer cmd_buffer, const RenderGraphRegistry&)
+				{
+					vkCmdFillBuffer(cmd_buffer, frame.draw_count_buffer, 0, sizeof(uint32_t), 0);
+					return true;
+				}
+			);
+			ReturnIfFalse(_render_graph.write(clear_pass, draw_count, RenderGraphUsage::TransferDst));
 
-		// VK_SUBPASS_CONTENTS_INLINE: 所有要执行的指令都在主要指令缓冲中, 没有辅助指令缓冲需要执行.
-		// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: 有来自辅助指令缓冲的指令需要执行.
-		vkCmdBeginRenderPass(_cmd_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+			const uint32_t cull_pass = _render_graph.add_pass(
+				"cull",
+				[this, &frame](VkCommandBuffer cmd_buffer, const RenderGraphRegistry&)
+				{
+					return record_cull(cmd_buffer, frame);
+				}
+			);
+			ReturnIfFalse(_render_graph.write(cull_pass, draw_count, RenderGraphUsage::ComputeStorageWrite));
+			ReturnIfFalse(_render_graph.write(cull_pass, draw_commands, RenderGraphUsage::ComputeStorageWrite));
+		}
 
-		vkCmdBindPipeline(_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics_pipeline);
-		vkCmdSetViewport(_cmd_buffer, 0, 1, &_viewport);
-		vkCmdSetScissor(_cmd_buffer, 0, 1, &_scissor);
+		const uint32_t main_pass = _render_graph.add_pass(
+			"main",
+			[this, &frame, frame_buffer_index](VkCommandBuffer cmd_buffer, const RenderGraphRegistry&)
+			{
+				VkRenderPassBeginInfo render_pass_begin_info{};
+				render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				render_pass_begin_info.renderPass = _render_pass;
+				render_pass_begin_info.framebuffer = _frame_buffers[frame_buffer_index];
+				render_pass_begin_info.renderArea.offset = { 0, 0 };
+				render_pass_begin_info.renderArea.extent = _client_resolution;
+
+				// 多个 render target 就指定多个 clear value.
+				VkClearValue clear_value = { 0.0f, 0.0f, 0.0f, 1.0f };
+				render_pass_begin_info.clearValueCount = 1;
+				render_pass_begin_info.pClearValues = &clear_value;
+
+				// VK_SUBPASS_CONTENTS_INLINE: 所有要执行的指令都在主要指令缓冲中, 没有辅助指令缓冲需要执行.
+				// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: 有来自辅助指令缓冲的指令需要执行.
+				// 直接绘制时每个实例一个 draw, 按实例分段并行录制进辅助指令缓冲.
+				if (_options.direct_draws)
+				{
+					return _command_recorder.record_render_pass(
+						cmd_buffer, 
+						render_pass_begin_info, 
+						_options.instance_count, 
+						[this, &frame](VkCommandBuffer cmd_buffer, uint64_t begin, uint64_t end)
+						{
+							return record_direct_draws(cmd_buffer, frame, begin, end);
+						}
+					);
+				}
+
+				// 所有实例只有一次间接绘制, 不需要分段并行录制, 直接录制进主要指令缓冲.
+				return _command_recorder.record_render_pass(
+					cmd_buffer, 
+					render_pass_begin_info, 
+					1, 
+					[this, &frame](VkCommandBuffer cmd_buffer, uint64_t, uint64_t)
+					{
+						return record_draws(cmd_buffer, frame);
+					}
+				);
+			}
+		);
+		ReturnIfFalse(_render_graph.write(main_pass, back_buffer, RenderGraphUsage::ColorAttachment));
+		_render_graph_executor.bind_image(back_buffer, _back_buffers[frame_buffer_index], _back_buffer_views[frame_buffer_index]);
+
+		if (!_options.direct_draws)
+		{
+			ReturnIfFalse(_render_graph.read(main_pass, draw_commands, RenderGraphUsage::IndirectBuffer));
+			ReturnIfFalse(_render_graph.read(main_pass, draw_count, RenderGraphUsage::IndirectBuffer));
+			_render_graph_executor.bind_buffer(draw_commands, frame.draw_command_buffer);
+			_render_graph_executor.bind_buffer(draw_count, frame.draw_count_buffer);
+		}
+		ReturnIfFalse(_render_graph_executor.execute(_render_graph, frame.cmd_buffer));
+
+		_gpu_timer.end_frame(frame.cmd_buffer, _frame_index);
+		return vkEndCommandBuffer(frame.cmd_buffer) == VK_SUCCESS;
+	}
+
+	bool VulkanBase::record_cull(VkCommandBuffer cmd_buffer, const FrameContext& frame)
+	{
+		vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+		_bindless_heap.bind(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_layout);
+
+		CullPushConstant push_constant{};
+		push_constant.constant_buffer_index = _constant_allocator.get_buffer_index();
+		push_constant.constant_offset = frame.constant_offset;
+		push_constant.instance_buffer_index = _instance_buffer_index;
+		push_constant.draw_command_buffer_index = frame.draw_command_buffer_index;
+		push_constant.draw_count_buffer_index = frame.draw_count_buffer_index;
+		push_constant.instance_count = _options.instance_count;
+		vkCmdPushConstants(cmd_buffer, _cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constant), &push_constant);
+
+		// 与 cull_cs.slang 的 numthreads 一致.
+		constexpr uint32_t group_size = 64;
+		vkCmdDispatch(cmd_buffer, (_options.instance_count + group_size - 1) / group_size, 1, 1);
+		return true;
+	}
+
+	void VulkanBase::bind_draw_state(VkCommandBuffer cmd_buffer, const FrameContext& frame)
+	{
+		// 可能在工作线程上执行, 只能读取成员, 状态需要在每个指令缓冲中重新绑定.
+		vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _graphics_pipeline);
+		vkCmdSetViewport(cmd_buffer, 0, 1, &_viewport);
+		vkCmdSetScissor(cmd_buffer, 0, 1, &_scissor);
 
 		VkBuffer vertex_buffers[] = { _vertex_buffer };
 		VkDeviceSize vertex_buffer_offsets[] = { 0 };
-		vkCmdBindVertexBuffers(_cmd_buffer, 0, 1, vertex_buffers, vertex_buffer_offsets);
+		vkCmdBindVertexBuffers(cmd_buffer, 0, 1, vertex_buffers, vertex_buffer_offsets);
+
+		vkCmdBindIndexBuffer(cmd_buffer, _index_buffer, 0, VK_INDEX_TYPE_UINT32);
 
-		vkCmdBindIndexBuffer(_cmd_buffer, _index_buffer, 0, VK_INDEX_TYPE_UINT32);
+		// 整个指令缓冲只绑定一次描述符集, 资源通过 push constant 中的下标访问.
+		_bindless_heap.bind(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _layout);
 
-		vkCmdBindDescriptorSets(
-			_cmd_buffer, 
-			VK_PIPELINE_BIND_POINT_GRAPHICS, 
-			_layout, 
+		DrawPushConstant push_constant{};
+		push_constant.constant_buffer_index = _constant_allocator.get_buffer_index();
+		push_constant.constant_offset = frame.constant_offset;
+		push_constant.instance_buffer_index = _instance_buffer_index;
+		push_constant.texture_index = _test_texture_index;
+		push_constant.sampler_index = _linear_wrap_sampler_index;
+		vkCmdPushConstants(cmd_buffer, _layout, _push_constant_stages, 0, sizeof(push_constant), &push_constant);
+	}
+
+	bool VulkanBase::record_draws(VkCommandBuffer cmd_buffer, const FrameContext& frame)
+	{
+		bind_draw_state(cmd_buffer, frame);
+
+		// 绘制数量由剔除 pass 写入 draw_count_buffer, 最多 _options.instance_count 个.
+		vkCmdDrawIndexedIndirectCount(
+			cmd_buffer, 
+			frame.draw_command_buffer, 
 			0, 
-			1, 
-			&_binding_sets[frame_buffer_index], 
+			frame.draw_count_buffer, 
 			0, 
-			nullptr
+			_options.instance_count, 
+			sizeof(VkDrawIndexedIndirectCommand)
 		);
+		return true;
+	}
 
-		vkCmdDrawIndexed(_cmd_buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-		vkCmdEndRenderPass(_cmd_buffer);
-
+	bool VulkanBase::record_direct_draws(VkCommandBuffer cmd_buffer, const FrameContext& frame, uint64_t begin, uint64_t end)
+	{
+		bind_draw_state(cmd_buffer, frame);
 
-		return vkEndCommandBuffer(_cmd_buffer) == VK_SUCCESS;
+		// 与剔除 pass 生成的绘制参数相同, 实例下标通过 firstInstance 传给顶点着色器, 只是不做剔除.
+		for (uint64_t ix = begin; ix < end; ++ix)
+		{
+			const VkDrawIndexedIndirectCommand& command = _direct_draw_commands[ix];
+			vkCmdDrawIndexed(cmd_buffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+		}
+		return true;
 	}
 
 	bool VulkanBase::create_sync_objects()
@@ -972,64 +1391,234 @@ namespace fantasy
 		// 发出 fence 信号, vkWaitForFences 函数调用将会一直处于等待状态, 所以设置其初始状态为已发出信号.
 		fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 		
-		return 	vkCreateSemaphore(_device, &create_info, nullptr, &_back_buffer_avaible_semaphore) == VK_SUCCESS &&
-				vkCreateSemaphore(_device, &create_info, nullptr, &_render_finished_semaphore) == VK_SUCCESS &&
-				vkCreateFence(_device, &fence_create_info, nullptr, &_fence) == VK_SUCCESS;
+		for (auto& frame : _frames)
+		{
+			ReturnIfFalse(vkCreateSemaphore(_device, &create_info, nullptr, &frame.back_buffer_avaible_semaphore) == VK_SUCCESS);
+			ReturnIfFalse(vkCreateSemaphore(_device, &create_info, nullptr, &frame.render_finished_semaphore) == VK_SUCCESS);
+			ReturnIfFalse(vkCreateFence(_device, &fence_create_info, nullptr, &frame.fence) == VK_SUCCESS);
+		}
+		return true;
 	}
 
 
-	bool VulkanBase::draw()
+	void VulkanBase::release_retired_pipelines(FrameContext& frame)
 	{
-		ReturnIfFalse(vkWaitForFences(_device, 1, &_fence, VK_TRUE, INVALID_SIZE_64) == VK_SUCCESS);
+		for (VkPipeline pipeline : frame.retired_pipelines)
+		{
+			vkDestroyPipeline(_device, pipeline, nullptr);
+		}
+		frame.retired_pipelines.clear();
+	}
 
-		uint32_t back_buffer_index = 0;
-		VkResult result = vkAcquireNextImageKHR(
-			_device, 
-			_swapchain, 
-			INVALID_SIZE_64, 
-			_back_buffer_avaible_semaphore, 
-			VK_NULL_HANDLE, 
-			&back_buffer_index
-		);
+	void VulkanBase::collect_gpu_time(uint64_t frame_index)
+	{
+		double milliseconds = 0.0;
+		if (_gpu_timer.get_frame_time(frame_index, milliseconds)) _benchmark.record_gpu_time(frame_index, milliseconds);
+	}
+
+	bool VulkanBase::write_benchmark()
+	{
+		if (!_benchmark.is_enabled()) return true;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(_physical_device, &properties);
+		_benchmark.add_info("device", properties.deviceName);
+		_benchmark.add_info("mode", _options.headless ? "headless" : "window");
+		_benchmark.add_info("width", _client_resolution.width);
+		_benchmark.add_info("height", _client_resolution.height);
+		_benchmark.add_info("instance_count", _options.instance_count);
+		_benchmark.add_info("draw_mode", _options.direct_draws ? "direct" : "indirect");
+		_benchmark.add_info("record_thread_count", _command_recorder.get_thread_count());
+		ReturnIfFalse(_benchmark.write_json(_options.benchmark_path));
+
+		LOG_INFO("Benchmark written to " + _options.benchmark_path + ".");
+		return true;
+	}
+
+	bool VulkanBase::dump_back_buffer()
+	{
+		ReturnIfFalse(_options.headless && _frame_index > 0);
+
+		// 设备已经空闲, 最后一帧的离屏图像处于 TRANSFER_SRC_OPTIMAL, 借用当前帧的指令池录制拷贝.
+		const VkImage back_buffer = _back_buffers[(_frame_index - 1) % _back_buffers.size()];
+		const uint32_t width = _client_resolution.width;
+		const uint32_t height = _client_resolution.height;
+
+		VkBufferCreateInfo buffer_create_info{};
+		buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_create_info.size = static_cast<VkDeviceSize>(width) * height * 4;
+		buffer_create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer readback_buffer;
+		GpuAllocation readback_memory;
+		ReturnIfFalse(_gpu_allocator.create_buffer(
+			buffer_create_info,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			readback_buffer,
+			readback_memory
+		));
 
-		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		auto copy_back_buffer = [&]()
 		{
-			ReturnIfFalse(recreate_swapchain());
+			FrameContext& frame = get_current_frame();
+			ReturnIfFalse(vkResetCommandPool(_device, frame.cmd_pool, 0) == VK_SUCCESS);
+
+			VkCommandBufferBeginInfo begin_info{};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			ReturnIfFalse(vkBeginCommandBuffer(frame.cmd_buffer, &begin_info) == VK_SUCCESS);
+
+			VkBufferImageCopy region{};
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { width, height, 1 };
+			vkCmdCopyImageToBuffer(frame.cmd_buffer, back_buffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer, 1, &region);
+
+			// 拷贝结果对主机可见.
+			VkMemoryBarrier2 memory_barrier{};
+			memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+			memory_barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			memory_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			memory_barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+			memory_barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+			VkDependencyInfo dependency_info{};
+			dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependency_info.memoryBarrierCount = 1;
+			dependency_info.pMemoryBarriers = &memory_barrier;
+			vkCmdPipelineBarrier2(frame.cmd_buffer, &dependency_info);
+			ReturnIfFalse(vkEndCommandBuffer(frame.cmd_buffer) == VK_SUCCESS);
+
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &frame.cmd_buffer;
+			ReturnIfFalse(vkQueueSubmit(_graphics_queue, 1, &submit_info, VK_NULL_HANDLE) == VK_SUCCESS);
+			return vkQueueWaitIdle(_graphics_queue) == VK_SUCCESS;
+		};
+
+		// 离屏图像是 R8G8B8A8_UNORM, PPM 只保存 RGB.
+		auto write_ppm = [&]()
+		{
+			const auto* pixels = static_cast<const uint8_t*>(readback_memory.mapped_data);
+			ReturnIfFalse(pixels != nullptr);
+
+			std::vector<uint8_t> rgb(static_cast<uint64_t>(width) * height * 3);
+			for (uint64_t ix = 0; ix < static_cast<uint64_t>(width) * height; ++ix)
+			{
+				memcpy(rgb.data() + ix * 3, pixels + ix * 4, 3);
+			}
+
+			std::ofstream file(_options.dump_path, std::ios::binary | std::ios::trunc);
+			const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+			if (
+				!file.write(header.data(), static_cast<std::streamsize>(header.size())) ||
+				!file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()))
+			)
+			{
+				LOG_ERROR("Write back buffer dump " + _options.dump_path + " failed.");
+				return false;
+			}
 			return true;
+		};
+
+		const bool succeeded = copy_back_buffer() && write_ppm();
+		_gpu_allocator.destroy_buffer(readback_buffer, readback_memory);
+		if (succeeded) LOG_INFO("Back buffer written to " + _options.dump_path + ".");
+		return succeeded;
+	}
+
+	bool VulkanBase::draw()
+	{
+		// 只等待 NUM_FRAMES_IN_FLIGHT 帧之前使用同一组资源的那一帧, 其余帧仍可在 GPU 上执行.
+		FrameContext& frame = get_current_frame();
+		ReturnIfFalse(vkWaitForFences(_device, 1, &frame.fence, VK_TRUE, INVALID_SIZE_64) == VK_SUCCESS);
+
+		// 队列按提交顺序执行, 这一帧完成时, 管线被替换之前提交的帧也都已完成.
+		release_retired_pipelines(frame);
+		_shader_hot_reload.update();
+
+		// 上次使用这组帧资源的那一帧已经完成, 可以读取它的时间戳.
+		if (_frame_index >= NUM_FRAMES_IN_FLIGHT) collect_gpu_time(_frame_index - NUM_FRAMES_IN_FLIGHT);
+
+		uint32_t back_buffer_index = 0;
+		if (_options.headless)
+		{
+			// 离屏图像与帧资源一一对应, 不需要获取.
+			back_buffer_index = static_cast<uint32_t>(_frame_index % _back_buffers.size());
 		}
-		else if (result != VK_SUCCESS)
+		else
 		{
-			LOG_ERROR("vkAcquireNextImageKHR() called failed.");
-			return false;
+			VkResult result = vkAcquireNextImageKHR(
+				_device, 
+				_swapchain, 
+				INVALID_SIZE_64, 
+				frame.back_buffer_avaible_semaphore, 
+				VK_NULL_HANDLE, 
+				&back_buffer_index
+			);
+
+			if (result == VK_ERROR_OUT_OF_DATE_KHR)
+			{
+				ReturnIfFalse(recreate_swapchain());
+				return true;
+			}
+			else if (result != VK_SUCCESS)
+			{
+				LOG_ERROR("vkAcquireNextImageKHR() called failed.");
+				return false;
+			}
 		}
 
-		vkResetFences(_device, 1, &_fence); 
+		vkResetFences(_device, 1, &frame.fence); 
+
+		ReturnIfFalse(vkResetCommandPool(_device, frame.cmd_pool, 0) == VK_SUCCESS);
+		ReturnIfFalse(_command_recorder.begin_frame(_frame_index));
+		_render_graph_executor.begin_frame(_frame_index);
+		_bindless_heap.begin_frame(_frame_index);
+		_constant_allocator.begin_frame(_frame_index);
 
-		ReturnIfFalse(vkResetCommandBuffer(_cmd_buffer, 0) == VK_SUCCESS);
-        ReturnIfFalse(record_command(back_buffer_index));
+		// 常量的偏移在录制时通过 push constant 传入, 需要先写入.
+		ReturnIfFalse(update_constant_buffer(frame));
 
-		update_constant_buffer(back_buffer_index);
+		uint64_t upload_wait_value = 0;
+        ReturnIfFalse(record_command(frame, back_buffer_index, upload_wait_value));
 
 		VkSubmitInfo submit_info{};
 		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore wait_semaphores[] = { _back_buffer_avaible_semaphore };
+		VkSemaphore wait_semaphores[] = { frame.back_buffer_avaible_semaphore, _upload_manager.get_timeline_semaphore() };
+
+		// 指定等待的管线阶段. 上传在 GPU 上等待, CPU 不会因为上传而阻塞.
+		VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
 
-		// 指定等待的管线阶段.
-		VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		// 二值信号量的等待值会被忽略.
+		uint64_t wait_values[] = { 0, upload_wait_value };
 
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = wait_semaphores;
-		submit_info.pWaitDstStageMask = wait_stages;
+		// headless 时没有获取图像的信号量, 跳过第一个.
+		const uint32_t first_wait = _options.headless ? 1 : 0;
+		VkTimelineSemaphoreSubmitInfo timeline_info{};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.waitSemaphoreValueCount = (upload_wait_value != 0 ? 2 : 1) - first_wait;
+		timeline_info.pWaitSemaphoreValues = wait_values + first_wait;
+		submit_info.pNext = &timeline_info;
+
+		submit_info.waitSemaphoreCount = timeline_info.waitSemaphoreValueCount;
+		submit_info.pWaitSemaphores = wait_semaphores + first_wait;
+		submit_info.pWaitDstStageMask = wait_stages + first_wait;
 		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &_cmd_buffer;
+		submit_info.pCommandBuffers = &frame.cmd_buffer;
 
-		VkSemaphore signal_semaphores[] = { _render_finished_semaphore };
+		VkSemaphore signal_semaphores[] = { frame.render_finished_semaphore };
 		
-		submit_info.signalSemaphoreCount = 1;
+		submit_info.signalSemaphoreCount = _options.headless ? 0 : 1;
 		submit_info.pSignalSemaphores = signal_semaphores;
 
-		ReturnIfFalse(vkQueueSubmit(_graphics_queue, 1, &submit_info, _fence) == VK_SUCCESS);
+		ReturnIfFalse(vkQueueSubmit(_graphics_queue, 1, &submit_info, frame.fence) == VK_SUCCESS);
+		_frame_index++;
+
+		if (_options.headless) return true;
 
 		// 开始交换链的 present.
 
@@ -1047,7 +1636,7 @@ namespace fantasy
 		// 由于只使用了一个交换链, 可以直接使用呈现函数的返回值来判断呈现操作是否成功, 没有必要使用 pResults.
 		present_info.pResults = nullptr;
 
-		result = vkQueuePresentKHR(_present_queue, &present_info);
+		const VkResult result = vkQueuePresentKHR(_present_queue, &present_info);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window_resized)
 		{
@@ -1077,6 +1666,15 @@ namespace fantasy
 			vkDestroyImageView(_device, _back_buffer_views[ix], nullptr);
 		}
 
+		if (_options.headless)
+		{
+			for (uint32_t ix = 0; ix < _back_buffers.size(); ++ix)
+			{
+				_gpu_allocator.destroy_image(_back_buffers[ix], _back_buffer_memories[ix]);
+			}
+			return;
+		}
+
 		vkDestroySwapchainKHR(_device, _swapchain, nullptr);
 	}
 
@@ -1119,38 +1717,10 @@ namespace fantasy
 		return create_swapchain() && create_frame_buffer();
     }
 
-	uint32_t VulkanBase::get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags flags)
-	{
-		for (uint32_t ix = 0; ix < _memory_properties.memoryTypeCount; ++ix)
-		{
-			if ((type_filter & (1 << ix)) && (_memory_properties.memoryTypes[ix].propertyFlags & flags) == flags)
-			{
-				return ix;
-			}
-		}
-		return INVALID_SIZE_32;
-	}
-
-
 	bool VulkanBase::create_vertex_buffer()
 	{
 		VkDeviceSize vertex_buffer_size = sizeof(Vertex) * vertices.size();
 
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_memory;
-		ReturnIfFalse(create_buffer(
-			vertex_buffer_size, 
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			staging_buffer, 
-			staging_memory
-		));
-
-		void* vertex_data = nullptr;
-		vkMapMemory(_device, staging_memory, 0, vertex_buffer_size, 0, &vertex_data);
-		memcpy(vertex_data, vertices.data(), vertices.size() * sizeof(Vertex));
-		vkUnmapMemory(_device, staging_memory);
-
 		ReturnIfFalse(create_buffer(
 			vertex_buffer_size, 
 			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
@@ -1159,46 +1729,140 @@ namespace fantasy
 			_vertex_buffer_memory
 		));
 
-		ReturnIfFalse(copy_buffer(_vertex_buffer, staging_buffer, vertex_buffer_size));
-
-		vkDestroyBuffer(_device, staging_buffer, nullptr);
-		vkFreeMemory(_device, staging_memory, nullptr);
-
-		return true;
+		// 数据写入上传队列的暂存区, 拷贝随第一帧之前的上传批次一起提交.
+		return _upload_manager.upload_buffer(
+			_vertex_buffer, 
+			0, 
+			vertices.data(), 
+			vertex_buffer_size, 
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT
+		);
 	}
 
 	bool VulkanBase::create_index_buffer()
 	{
 		VkDeviceSize index_buffer_size = sizeof(uint32_t) * indices.size();
 
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_memory;
 		ReturnIfFalse(create_buffer(
 			index_buffer_size, 
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			staging_buffer, 
-			staging_memory
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+			_index_buffer, 
+			_index_buffer_memory
 		));
 
-		void* index_data = nullptr;
-		vkMapMemory(_device, staging_memory, 0, index_buffer_size, 0, &index_data);
-		memcpy(index_data, indices.data(), indices.size() * sizeof(uint32_t));
-		vkUnmapMemory(_device, staging_memory);
+		// 数据写入上传队列的暂存区, 拷贝随第一帧之前的上传批次一起提交.
+		return _upload_manager.upload_buffer(
+			_index_buffer, 
+			0, 
+			indices.data(), 
+			index_buffer_size, 
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 
+			VK_ACCESS_INDEX_READ_BIT
+		);
+	}
+
+	bool VulkanBase::create_instance_buffer()
+	{
+		// 实例数据作为一个存储缓冲区绑定, 大小受 maxStorageBufferRange 限制 (常见为 128 MB, 约 139 万个实例).
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(_physical_device, &properties);
+		if (sizeof(InstanceData) * static_cast<uint64_t>(_options.instance_count) > properties.limits.maxStorageBufferRange)
+		{
+			LOG_ERROR(
+				std::to_string(_options.instance_count) + " instances exceed maxStorageBufferRange " + 
+				std::to_string(properties.limits.maxStorageBufferRange) + "."
+			);
+			return false;
+		}
 
+		// 实例排列成 XY 平面上的网格, 大部分在视锥之外, 由剔除 pass 过滤.
+		const uint32_t grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(_options.instance_count))));
+		const float spacing = 1.2f;
+		const float grid_offset = (grid_size - 1) * spacing * 0.5f;
+
+		std::vector<InstanceData> instances(_options.instance_count);
+		for (uint32_t ix = 0; ix < _options.instance_count; ++ix)
+		{
+			InstanceData& instance = instances[ix];
+			instance.world_matrix = translate(float3(
+				(ix % grid_size) * spacing - grid_offset, 
+				(ix / grid_size) * spacing - grid_offset, 
+				0.0f
+			));
+
+			// 四边形的顶点在 [-0.5, 0.5] 之间.
+			instance.bounding_sphere = float4(0.0f, 0.0f, 0.0f, 0.7072f);
+			instance.index_count = static_cast<uint32_t>(indices.size());
+			instance.first_index = 0;
+			instance.vertex_offset = 0;
+		}
+
+		if (_options.direct_draws)
+		{
+			_direct_draw_commands.resize(instances.size());
+			for (uint32_t ix = 0; ix < instances.size(); ++ix)
+			{
+				_direct_draw_commands[ix] = VkDrawIndexedIndirectCommand{
+					.indexCount = instances[ix].index_count,
+					.instanceCount = 1,
+					.firstIndex = instances[ix].first_index,
+					.vertexOffset = instances[ix].vertex_offset,
+					.firstInstance = ix
+				};
+			}
+		}
+
+		const VkDeviceSize instance_buffer_size = sizeof(InstanceData) * instances.size();
 		ReturnIfFalse(create_buffer(
-			index_buffer_size, 
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
+			instance_buffer_size, 
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-			_index_buffer, 
-			_index_buffer_memory
+			_instance_buffer, 
+			_instance_buffer_memory
+		));
+		ReturnIfFalse(_upload_manager.upload_buffer(
+			_instance_buffer, 
+			0, 
+			instances.data(), 
+			instance_buffer_size, 
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 
+			VK_ACCESS_SHADER_READ_BIT
 		));
 
-		ReturnIfFalse(copy_buffer(_index_buffer, staging_buffer, index_buffer_size));
+		_instance_buffer_index = _bindless_heap.allocate_storage_buffer(_instance_buffer, 0, instance_buffer_size);
+		return _instance_buffer_index != BindlessDescriptorHeap::INVALID_INDEX;
+	}
+
+	bool VulkanBase::create_draw_buffers()
+	{
+		const VkDeviceSize draw_command_buffer_size = sizeof(VkDrawIndexedIndirectCommand) * _options.instance_count;
 
-		vkDestroyBuffer(_device, staging_buffer, nullptr);
-		vkFreeMemory(_device, staging_memory, nullptr);
+		for (auto& frame : _frames)
+		{
+			ReturnIfFalse(create_buffer(
+				draw_command_buffer_size, 
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+				frame.draw_command_buffer, 
+				frame.draw_command_buffer_memory
+			));
+			ReturnIfFalse(create_buffer(
+				sizeof(uint32_t), 
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+				frame.draw_count_buffer, 
+				frame.draw_count_buffer_memory
+			));
 
+			frame.draw_command_buffer_index = _bindless_heap.allocate_storage_buffer(frame.draw_command_buffer, 0, draw_command_buffer_size);
+			frame.draw_count_buffer_index = _bindless_heap.allocate_storage_buffer(frame.draw_count_buffer, 0, sizeof(uint32_t));
+			ReturnIfFalse(
+				frame.draw_command_buffer_index != BindlessDescriptorHeap::INVALID_INDEX &&
+				frame.draw_count_buffer_index != BindlessDescriptorHeap::INVALID_INDEX
+			);
+		}
 		return true;
 	}
 
@@ -1207,7 +1871,7 @@ namespace fantasy
 			VkBufferUsageFlags usage, 
 			VkMemoryPropertyFlags properties, 
 			VkBuffer& buffer, 
-			VkDeviceMemory& buffer_memory
+			GpuAllocation& buffer_memory
 		)
 	{
 		VkBufferCreateInfo buffer_info{};
@@ -1215,100 +1879,70 @@ namespace fantasy
 		buffer_info.size = size;
 		buffer_info.usage = usage;
 		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		ReturnIfFalse(vkCreateBuffer(_device, &buffer_info, nullptr, &buffer) == VK_SUCCESS); 
 
-		VkMemoryRequirements memory_requirements;
-		vkGetBufferMemoryRequirements(_device, buffer, &memory_requirements);
-
-		VkMemoryAllocateInfo allocate_info{};
-		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocate_info.allocationSize = memory_requirements.size;
-		allocate_info.memoryTypeIndex = get_memory_type(
-			memory_requirements.memoryTypeBits, 
-			properties
-		);
-		ReturnIfFalse(vkAllocateMemory(_device, &allocate_info, nullptr, &buffer_memory) == VK_SUCCESS);
-		ReturnIfFalse(vkBindBufferMemory(_device, buffer, buffer_memory, 0) == VK_SUCCESS);
-
-		return true;
+		// 内存从分配器的大块中子分配, 主机可见的内存已经常驻映射.
+		return _gpu_allocator.create_buffer(buffer_info, properties, buffer, buffer_memory);
 	}
 
-	bool VulkanBase::copy_buffer(VkBuffer dst_buffer, VkBuffer src_buffer, VkDeviceSize size)
+	VkShaderStageFlags VulkanBase::get_shader_stage(ShaderTarget target)
 	{
-		VkCommandBuffer cmd_buffer;
-		ReturnIfFalse(begin_once_command_buffer(cmd_buffer));
-
-		VkBufferCopy copy_region{};
-		copy_region.size = size;
-
-		vkCmdCopyBuffer(cmd_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-		ReturnIfFalse(end_once_command_buffer(cmd_buffer));
-		return true;
+		switch (target)
+		{
+		case ShaderTarget::Vertex: return VK_SHADER_STAGE_VERTEX_BIT;
+		case ShaderTarget::Hull: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case ShaderTarget::Domain: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case ShaderTarget::Geometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case ShaderTarget::Pixel: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case ShaderTarget::Compute: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default: return 0;
+		}
 	}
 
-	bool VulkanBase::create_binding_layout()
+	bool VulkanBase::get_descriptor_type(ShaderResourceType type, VkDescriptorType& out_type)
 	{
-		VkDescriptorSetLayoutBinding constant_layout_desc{};
-		constant_layout_desc.binding = 0;
-		constant_layout_desc.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		constant_layout_desc.descriptorCount = 1;
-		constant_layout_desc.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		VkDescriptorSetLayoutBinding texture_layout_desc{};
-        texture_layout_desc.binding = 1;
-        texture_layout_desc.descriptorCount = 1;
-        texture_layout_desc.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        texture_layout_desc.pImmutableSamplers = nullptr;
-        texture_layout_desc.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-		VkDescriptorSetLayoutBinding sampler_layout_desc{};
-        sampler_layout_desc.binding = 2;
-        sampler_layout_desc.descriptorCount = 1;
-        sampler_layout_desc.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-        sampler_layout_desc.pImmutableSamplers = nullptr;
-        sampler_layout_desc.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
- 		std::array<VkDescriptorSetLayoutBinding, 3> bindings = {constant_layout_desc, texture_layout_desc, sampler_layout_desc};
-
-		VkDescriptorSetLayoutCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		create_info.bindingCount = static_cast<uint32_t>(bindings.size());
-		create_info.pBindings = bindings.data();
-
-		return vkCreateDescriptorSetLayout(_device, &create_info, nullptr, &_binding_layout) == VK_SUCCESS;
+		switch (type)
+		{
+		case ShaderResourceType::ConstantBuffer: out_type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; return true;
+		case ShaderResourceType::Texture: out_type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; return true;
+		case ShaderResourceType::StorageTexture: out_type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; return true;
+		case ShaderResourceType::TypedBuffer: out_type = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER; return true;
+		case ShaderResourceType::StorageTypedBuffer: out_type = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER; return true;
+		case ShaderResourceType::StorageBuffer: out_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; return true;
+		case ShaderResourceType::Sampler: out_type = VK_DESCRIPTOR_TYPE_SAMPLER; return true;
+		case ShaderResourceType::CombinedTextureSampler: out_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; return true;
+		case ShaderResourceType::AccelerationStructure: out_type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR; return true;
+		default: return false;
+		}
 	}
 
-	bool VulkanBase::create_constant_buffer()
+	bool VulkanBase::check_bindless_bindings(std::span<const ShaderCompileDesc> descs, std::span<const ShaderData> datas)
 	{
-		VkDeviceSize buffer_size = sizeof(Constant);
-
-		_constant_buffers.resize(_back_buffers.size());
-		_constant_buffer_memorys.resize(_back_buffers.size());
-		_constant_buffer_mapped_datas.resize(_back_buffers.size());
-
-		for (uint32_t ix = 0; ix < _back_buffers.size(); ++ix)
+		// 着色器只能声明 bindless 描述符集中的无大小数组, binding 编号即 BindlessResourceType.
+		for (uint32_t ix = 0; ix < descs.size(); ++ix)
 		{
-			ReturnIfFalse(create_buffer(
-				buffer_size, 
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-				_constant_buffers[ix], 
-				_constant_buffer_memorys[ix]
-			));
-			ReturnIfFalse(VK_SUCCESS == vkMapMemory(
-				_device, 
-				_constant_buffer_memorys[ix], 
-				0, 
-				buffer_size, 
-				0, 
-				&_constant_buffer_mapped_datas[ix]
-			));
+			for (const auto& binding : datas[ix]._reflection.bindings)
+			{
+				VkDescriptorType type;
+				const bool valid = 
+					binding.set == 0 &&
+					binding.binding < static_cast<uint32_t>(BindlessResourceType::Count) &&
+					binding.count == 0 &&
+					get_descriptor_type(binding.type, type) &&
+					type == BindlessDescriptorHeap::get_descriptor_type(static_cast<BindlessResourceType>(binding.binding));
+				if (!valid)
+				{
+					LOG_ERROR(
+						"Binding (" + std::to_string(binding.set) + ", " + std::to_string(binding.binding) + ") in " + 
+						descs[ix].shader_name + " doesn't match the bindless descriptor set."
+					);
+					return false;
+				}
+			}
 		}
 		return true;
 	}
 
-	void VulkanBase::update_constant_buffer(uint32_t back_buffer_index)
+	bool VulkanBase::update_constant_buffer(FrameContext& frame)
 	{
 		static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -1328,140 +1962,95 @@ namespace fantasy
 			)
 		);
 
-        memcpy(_constant_buffer_mapped_datas[back_buffer_index], &ubo, sizeof(ubo));
+		// 每帧的常量从线性分配器中分配, 之后每个 draw 的常量也可以同样写入, 不需要新的 buffer 和描述符.
+		return _constant_allocator.write(ubo, frame.constant_offset);
 	}
 
-	bool VulkanBase::create_binding_set()
+	void VulkanBase::load_texture_async()
 	{
-		std::array<VkDescriptorPoolSize, 3> pool_size{};
-        pool_size[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        pool_size[0].descriptorCount = static_cast<uint32_t>(NUM_FRAMES_IN_FLIGHT);
-        pool_size[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        pool_size[1].descriptorCount = static_cast<uint32_t>(NUM_FRAMES_IN_FLIGHT);
-        pool_size[2].type = VK_DESCRIPTOR_TYPE_SAMPLER;
-        pool_size[2].descriptorCount = static_cast<uint32_t>(NUM_FRAMES_IN_FLIGHT);
-
-		VkDescriptorPoolCreateInfo create_info{};
-		create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		create_info.poolSizeCount = static_cast<uint32_t>(pool_size.size());
-		create_info.pPoolSizes = pool_size.data();
-		create_info.maxSets = NUM_FRAMES_IN_FLIGHT;
-
-		ReturnIfFalse(vkCreateDescriptorPool(_device, &create_info, nullptr, &_descriptor_pool) == VK_SUCCESS);
-
-		std::vector<VkDescriptorSetLayout> layouts(NUM_FRAMES_IN_FLIGHT, _binding_layout);
+		// 发布时烘焙结果由 fpak 打包进 texture_cache.fpak, 存在时优先从包中读取, 不再检查原图.
+		const std::string archive_path = std::string(PROJ_DIR) + "/asset/texture_cache.fpak";
+		if (is_file_exist(archive_path.c_str()))
+		{
+			AssetArchive archive;
+			if (archive.open(archive_path))
+			{
+				const uint32_t index = archive.find("test_image.ftex");
+				if (index != INVALID_SIZE_32 && archive.load(index, _test_image.file))
+				{
+					_test_image.cooked = true;
+					return;
+				}
+			}
+			LOG_WARN("Read test_image.ftex from " + archive_path + " failed, fall back to the texture cache.");
+			_test_image.file.clear();
+		}
 
-		VkDescriptorSetAllocateInfo allocate_info{};
-		allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocate_info.descriptorPool = _descriptor_pool;
-		allocate_info.descriptorSetCount = NUM_FRAMES_IN_FLIGHT;
-		allocate_info.pSetLayouts = layouts.data();
+		// 烘焙结果比原图新时直接读取 .ftex, 否则读取原图, 在 create_texture() 中烘焙.
+		// 烘焙选项是否相同要读到文件头才知道, 在 create_texture() 中检查.
+		const std::string cooked_path = std::string(PROJ_DIR) + "/asset/texture_cache/test_image.ftex";
+		_test_image.cooked = is_file_exist(cooked_path.c_str()) && compare_file_write_time(cooked_path.c_str(), _test_image.source_path.c_str());
 
-		_binding_sets.resize(NUM_FRAMES_IN_FLIGHT);
+		const AsyncReadRequest request{ .path = _test_image.cooked ? cooked_path : _test_image.source_path };
+		_async_file_io.read(
+			std::span(&request, 1),
+			[this](AsyncReadResult& result)
+			{
+				if (!result.success) return;
 
-		ReturnIfFalse(vkAllocateDescriptorSets(_device, &allocate_info, _binding_sets.data()) == VK_SUCCESS);
+				// 烘焙本身会使用线程池并行, 不能在回调中进行.
+				_test_image.file.assign(result.data.begin(), result.data.end());
+			}
+		);
+	}
 
-		for (uint32_t ix = 0; ix < NUM_FRAMES_IN_FLIGHT; ++ix)
+	bool VulkanBase::create_texture()
+	{
+		_async_file_io.wait_idle();
+		if (_test_image.file.empty())
 		{
-			VkDescriptorBufferInfo buffer_info{};
-			buffer_info.buffer = _constant_buffers[ix];
-			buffer_info.offset = 0;
-			buffer_info.range = sizeof(Constant);
-			
-            VkDescriptorImageInfo texture_info{};
-            texture_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            texture_info.imageView = _test_texture_view;
-
-            VkDescriptorImageInfo sampler_info{};
-            sampler_info.sampler = _linear_wrap_sampler;
-
-			std::array<VkWriteDescriptorSet, 3> write_descriptor_sets;
-			write_descriptor_sets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[0].dstSet = _binding_sets[ix];
-			write_descriptor_sets[0].dstBinding = 0;
-
-			// 没有使用数组作为描述符, 将索引指定为0即可.
-			write_descriptor_sets[0].dstArrayElement = 0;
-			write_descriptor_sets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			write_descriptor_sets[0].descriptorCount = 1;
-			write_descriptor_sets[0].pNext = NULL;
-
-			// pBufferInfo 成员变量用于指定描述符引用的缓冲数据.
-			// pImageInfo 成员变量用于指定描述符引用的图像数据.
-			// pTexelBufferView 成员变量用于指定描述符引用的缓冲视图.
-			write_descriptor_sets[0].pBufferInfo = &buffer_info;
-			write_descriptor_sets[0].pImageInfo = nullptr;
-			write_descriptor_sets[0].pTexelBufferView = nullptr;
-
-			write_descriptor_sets[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            write_descriptor_sets[1].dstSet = _binding_sets[ix];
-            write_descriptor_sets[1].dstBinding = 1;
-            write_descriptor_sets[1].dstArrayElement = 0;
-            write_descriptor_sets[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-            write_descriptor_sets[1].descriptorCount = 1;
-            write_descriptor_sets[1].pImageInfo = &texture_info;
-			write_descriptor_sets[1].pNext = NULL;
-
-			write_descriptor_sets[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			write_descriptor_sets[2].dstSet = _binding_sets[ix];
-			write_descriptor_sets[2].dstBinding = 2;
-			write_descriptor_sets[2].descriptorCount = 1;
-            write_descriptor_sets[2].dstArrayElement = 0;
-			write_descriptor_sets[2].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-			write_descriptor_sets[2].pImageInfo = &sampler_info;
-			write_descriptor_sets[2].pNext = NULL;
-
-			vkUpdateDescriptorSets(
-				_device, 
-				static_cast<uint32_t>(write_descriptor_sets.size()), 
-				write_descriptor_sets.data(), 
-				0, 
-				nullptr
-			);
+			LOG_ERROR("Load test image failed.");
+			return false;
 		}
 
-		return true;
-	}
+		const TextureCookOptions cook_options{};
 
-	bool VulkanBase::create_texture()
-	{
-		int width, height, channels;
-		auto image = stbi_load(
-			std::string(std::string(PROJ_DIR) + "/asset/test_image.jpg").c_str(), 
-			&width, 
-			&height, 
-			&channels, 
-			STBI_rgb_alpha
-		);
+		CookedTexture texture;
+		std::span<const uint8_t> texture_data;
+		if (_test_image.cooked)
+		{
+			// 旧版本的 .ftex 或者烘焙选项不同时重新读取原图烘焙.
+			if (!parse_texture(_test_image.file, texture.desc, texture.options, texture_data) || texture.options != cook_options)
+			{
+				LOG_INFO("Cooked test image is outdated, cook it again.");
+				ReturnIfFalse(read_binary_file(_test_image.source_path.c_str(), _test_image.file));
+				_test_image.cooked = false;
+			}
+		}
 
-		uint32_t size = width * height * 4;
-		
-		VkBuffer staging_buffer;
-		VkDeviceMemory staging_memory;
-		ReturnIfFalse(create_buffer(
-			size, 
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			staging_buffer, 
-			staging_memory
-		));
+		if (!_test_image.cooked)
+		{
+			ReturnIfFalse(cook_texture(_test_image.file, cook_options, texture));
+			texture_data = texture.data;
 
-		void* data = nullptr;
-		ReturnIfFalse(vkMapMemory(_device, staging_memory, 0, size, 0, &data) == VK_SUCCESS);
-		memcpy(data, image, size);
-		vkUnmapMemory(_device, staging_memory);
+			const std::string cache_directory = std::string(PROJ_DIR) + "/asset/texture_cache";
+			std::filesystem::create_directories(cache_directory);
+			if (!save_texture(cache_directory + "/test_image.ftex", texture)) LOG_ERROR("Save cooked test image failed.");
+		}
 
-		stbi_image_free(image);
+		const TextureDesc& desc = texture.desc;
+		const VkFormat format = get_texture_format(desc);
+		const uint32_t mip_count = static_cast<uint32_t>(desc.mips.size());
 
 		VkImageCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		create_info.imageType = VK_IMAGE_TYPE_2D;
-		create_info.extent.width = width;
-		create_info.extent.height = height;
+		create_info.extent.width = desc.width;
+		create_info.extent.height = desc.height;
 		create_info.extent.depth = 1;
-		create_info.mipLevels = 1;
+		create_info.mipLevels = mip_count;
 		create_info.arrayLayers = 1;
-		create_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+		create_info.format = format;
 		create_info.samples = VK_SAMPLE_COUNT_1_BIT;
 
 		// tiling成员变量可以是下面这两个值之一
@@ -1481,153 +2070,69 @@ namespace fantasy
 		create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		create_info.flags = 0;
 
-		ReturnIfFalse(vkCreateImage(_device, &create_info, nullptr, &_test_texture) == VK_SUCCESS);
-
-		VkMemoryRequirements memory_requirements;
-		vkGetImageMemoryRequirements(_device, _test_texture, &memory_requirements);
-
-		VkMemoryAllocateInfo allocate_info{};
-		allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocate_info.allocationSize = memory_requirements.size;
-		allocate_info.memoryTypeIndex = get_memory_type(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		ReturnIfFalse(vkAllocateMemory(_device, &allocate_info, nullptr, &_test_texture_memory) == VK_SUCCESS);
-
-		ReturnIfFalse(vkBindImageMemory(_device, _test_texture, _test_texture_memory, 0) == VK_SUCCESS);
-
-		ReturnIfFalse(texture_transition(
-			_test_texture, 
-			VK_FORMAT_R8G8B8A8_SRGB, 
-			VK_IMAGE_LAYOUT_UNDEFINED, 
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-		));
-
-		VkCommandBuffer cmd_buffer;
-		ReturnIfFalse(begin_once_command_buffer(cmd_buffer));
-
-		VkBufferImageCopy copy{};
-		copy.bufferOffset = 0;
-		copy.bufferRowLength = 0;
-		copy.bufferImageHeight = 0;
-		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        copy.imageSubresource.mipLevel = 0;
-        copy.imageSubresource.baseArrayLayer = 0;
-        copy.imageSubresource.layerCount = 1;
-        copy.imageOffset = {0, 0, 0};
-        copy.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+		ReturnIfFalse(_gpu_allocator.create_image(create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _test_texture, _test_texture_memory));
 
-        vkCmdCopyBufferToImage(cmd_buffer, staging_buffer, _test_texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-
-		ReturnIfFalse(end_once_command_buffer(cmd_buffer));
+		// 每个 mip 一个拷贝区域, 压缩格式的 extent 使用 mip 的实际尺寸, 不足一个块时到达边缘即可.
+		std::vector<VkBufferImageCopy> copies(mip_count);
+		for (uint32_t ix = 0; ix < mip_count; ++ix)
+		{
+			VkBufferImageCopy& copy = copies[ix];
+			copy.bufferOffset = desc.mips[ix].offset;
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = ix;
+			copy.imageSubresource.baseArrayLayer = 0;
+			copy.imageSubresource.layerCount = 1;
+			copy.imageOffset = {0, 0, 0};
+			copy.imageExtent = { desc.mips[ix].width, desc.mips[ix].height, 1 };
+		}
 
-		ReturnIfFalse(texture_transition(
+		// 布局转换和拷贝在上传批次中完成, 不再单独提交并等待队列空闲.
+		ReturnIfFalse(_upload_manager.upload_image(
 			_test_texture, 
-			VK_FORMAT_R8G8B8A8_SRGB, 
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			VK_IMAGE_ASPECT_COLOR_BIT, 
+			mip_count, 
+			copies, 
+			texture_data, 
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
+			VK_ACCESS_SHADER_READ_BIT
 		));
 
-		vkDestroyBuffer(_device, staging_buffer, nullptr);
-        vkFreeMemory(_device, staging_memory, nullptr);
+		_test_image.file.clear();
+		_test_image.file.shrink_to_fit();
 
 		VkImageViewCreateInfo view_create_info{};
 		view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		view_create_info.image = _test_texture;
 		view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		view_create_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+		view_create_info.format = format;
 		view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		view_create_info.subresourceRange.baseMipLevel = 0;
-		view_create_info.subresourceRange.levelCount = 1;
+		view_create_info.subresourceRange.levelCount = mip_count;
 		view_create_info.subresourceRange.baseArrayLayer = 0;
 		view_create_info.subresourceRange.layerCount = 1;
 
-		return vkCreateImageView(_device, &view_create_info, nullptr, &_test_texture_view) == VK_SUCCESS;		
-	}
-
-
-	bool VulkanBase::begin_once_command_buffer(VkCommandBuffer& cmd_buffer)
-	{
-		VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = _cmd_pool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        ReturnIfFalse(vkAllocateCommandBuffers(_device, &allocInfo, &cmd_buffer) == VK_SUCCESS);
-
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        return vkBeginCommandBuffer(cmd_buffer, &beginInfo) == VK_SUCCESS;
-	}
-
-	bool VulkanBase::end_once_command_buffer(VkCommandBuffer& cmd_buffer)
-	{
-		ReturnIfFalse(vkEndCommandBuffer(cmd_buffer) == VK_SUCCESS);
+		ReturnIfFalse(vkCreateImageView(_device, &view_create_info, nullptr, &_test_texture_view) == VK_SUCCESS);
 
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &cmd_buffer;
-
-        ReturnIfFalse(vkQueueSubmit(_graphics_queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS);
-        ReturnIfFalse(vkQueueWaitIdle(_graphics_queue) == VK_SUCCESS);
-
-        vkFreeCommandBuffers(_device, _cmd_pool, 1, &cmd_buffer);
-		return true;
+		_test_texture_index = _bindless_heap.allocate_sampled_image(_test_texture_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		return _test_texture_index != BindlessDescriptorHeap::INVALID_INDEX;
 	}
 
-	bool VulkanBase::texture_transition(VkImage texture, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
+	VkFormat VulkanBase::get_texture_format(const TextureDesc& desc)
 	{
-		VkCommandBuffer cmd_buffer;
-		ReturnIfFalse(begin_once_command_buffer(cmd_buffer));
-		VkImageMemoryBarrier barrier{};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = old_layout;
-		barrier.newLayout = new_layout;
-
-		// 如果使用屏障来传递队列族所有权, 那么就需要对 srcQueueFamilyIndex 和 dstQueueFamilyIndex 进行设置.
-		// 如果读者不进行队列所有权传递, 则必须将这两个成员变量的值设置为 VKQUEUE_FAMILY_IGNORED.
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-		barrier.image = texture;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		VkPipelineStageFlags src_stage;
-        VkPipelineStageFlags dst_stage;
-
-        if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) 
+		switch (desc.format)
 		{
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-        } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) 
-		{
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			
-        } else 
-		{
-            return false;
-        }
-
-		vkCmdPipelineBarrier(cmd_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		ReturnIfFalse(end_once_command_buffer(cmd_buffer));
-		return true;
+		case TextureFormat::RGBA8: return desc.srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		case TextureFormat::BC1: return desc.srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case TextureFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case TextureFormat::BC7: return desc.srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
 	}
 
+
 	bool VulkanBase::create_sampler()
 	{
 		VkSamplerCreateInfo create_info{};
@@ -1652,7 +2157,12 @@ namespace fantasy
         create_info.compareOp = VK_COMPARE_OP_ALWAYS;
 
         create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		return vkCreateSampler(_device, &create_info, nullptr, &_linear_wrap_sampler) == VK_SUCCESS;
+		create_info.minLod = 0.0f;
+		create_info.maxLod = VK_LOD_CLAMP_NONE;
+		ReturnIfFalse(vkCreateSampler(_device, &create_info, nullptr, &_linear_wrap_sampler) == VK_SUCCESS);
+
+		_linear_wrap_sampler_index = _bindless_heap.allocate_sampler(_linear_wrap_sampler);
+		return _linear_wrap_sampler_index != BindlessDescriptorHeap::INVALID_INDEX;
 	}
 
 }
\ No newline at end of file
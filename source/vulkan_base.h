@@ -10,20 +10,91 @@
 #endif
 
 #include <vulkan/vulkan.h>
+#include <array>
 #include <vector>
 #include "glfw_window.h"
 #include "../source/core/math/common.h"
 #include "../source/core/math/matrix.h"
+#include "shader/shader_hot_reload.h"
+#include "core/tools/async_file_io.h"
+#include "texture/texture_cooker.h"
+#include "gpu/gpu_memory_allocator.h"
+#include "gpu/upload_manager.h"
+#include "gpu/command_recorder.h"
+#include "gpu/render_graph_executor.h"
+#include "gpu/pipeline_cache.h"
+#include "gpu/bindless_descriptor_heap.h"
+#include "gpu/frame_constant_allocator.h"
+#include "gpu/gpu_timer.h"
+#include "core/tools/frame_benchmark.h"
+#include <string>
 
 
 namespace fantasy
 {
+	struct RunOptions
+	{
+		// 不创建窗口和交换链, 渲染到离屏图像, 可以在没有显示器的机器上用软件光栅 (如 lavapipe) 运行.
+		bool headless = false;
+		VkExtent2D resolution = { CLIENT_WIDTH, CLIENT_HEIGHT };
+		uint32_t instance_count = 4096;
+
+		// 不做 GPU 剔除, 每个实例录制一次 vkCmdDrawIndexed, 用于测量并行录制 secondary command buffer 的开销.
+		bool direct_draws = false;
+
+		// direct_draws 时录制 draw 的线程数 (包括渲染线程), 为 0 时使用全部硬件线程.
+		uint32_t record_thread_count = 0;
+
+		// 渲染 warmup_frame_count + frame_count 帧后退出, 为 0 时运行到窗口关闭, headless 时必须指定.
+		uint64_t frame_count = 0;
+		uint64_t warmup_frame_count = 0;
+
+		// 非空时把 frame_count 帧的 CPU 帧时间和 GPU 时间统计写入该 JSON 文件.
+		std::string benchmark_path;
+
+		// headless 时非空, 把最后一帧的图像读回并写入该 PPM 文件, 用于比对渲染结果.
+		std::string dump_path;
+	};
+
 	struct Constant
 	{
 		float4x4 world_matrix;
 		float4x4 view_proj;
 	};
 
+	// 与 shader 中的 DrawIndices 一致, 都是 bindless 描述符集中的下标.
+	struct DrawPushConstant
+	{
+		uint32_t constant_buffer_index;
+		uint32_t constant_offset;
+		uint32_t instance_buffer_index;
+		uint32_t texture_index;
+		uint32_t sampler_index;
+	};
+
+	// 与 cull_cs.slang 中的 CullIndices 一致.
+	struct CullPushConstant
+	{
+		uint32_t constant_buffer_index;
+		uint32_t constant_offset;
+		uint32_t instance_buffer_index;
+		uint32_t draw_command_buffer_index;
+		uint32_t draw_count_buffer_index;
+		uint32_t instance_count;
+	};
+
+	// 场景中的一个实例, 与 shader 中的 Instance 一致, 着色器按 96 字节的步长读取.
+	struct InstanceData
+	{
+		float4x4 world_matrix;
+		float4 bounding_sphere;     // 物体空间的球心和半径.
+		uint32_t index_count;
+		uint32_t first_index;
+		int32_t vertex_offset;
+		uint32_t padding;
+	};
+	static_assert(sizeof(InstanceData) == 96);
+
 	struct Vertex
 	{
 		float2 position;
@@ -77,28 +148,34 @@ namespace fantasy
 		0, 1, 2, 2, 3, 0
 	};
 
-	class VulkanBase
+	// 每帧独占的资源, 按帧序号轮流使用, CPU 录制第 N 帧时 GPU 仍可执行之前的帧.
+	struct FrameContext
 	{
-	public:
-		bool run()
-		{
-			if (!_window.initialize_window(VkExtent2D{ 1280,720 })) return false;
+		VkCommandPool cmd_pool;
+		VkCommandBuffer cmd_buffer;
 
-			ReturnIfFalse(initialize());
+		VkSemaphore back_buffer_avaible_semaphore;
+		VkSemaphore render_finished_semaphore;
+		VkFence fence;
 
-			while (!_window.should_close())
-			{
-				glfwPollEvents();
-				render_loop();
-				_window.title_fps();
+		uint32_t constant_offset;     // 本帧的 Constant 在 _constant_allocator 中的偏移.
 
-			}
-			ReturnIfFalse(vkDeviceWaitIdle(_device) == VK_SUCCESS);
+		// 剔除后的间接绘制参数, 计算着色器写入, vkCmdDrawIndexedIndirectCount 读取.
+		VkBuffer draw_command_buffer;
+		GpuAllocation draw_command_buffer_memory;
+		uint32_t draw_command_buffer_index;
+		VkBuffer draw_count_buffer;
+		GpuAllocation draw_count_buffer_memory;
+		uint32_t draw_count_buffer_index;
 
-			destroy();
-			_window.terminate_window();
-			return true;
-		}
+		// 热重载替换下来的管线, 下次等待这一帧的 fence 后销毁.
+		std::vector<VkPipeline> retired_pipelines;
+	};
+
+	class VulkanBase
+	{
+	public:
+		bool run(const RunOptions& options = RunOptions{});
 
 		bool window_resized = false;
 
@@ -123,11 +200,26 @@ namespace fantasy
 
 		bool create_device();
 		bool create_swapchain();
-		bool create_pipeline();
+		bool create_offscreen_back_buffers();
+		bool create_back_buffer_views();
+		bool create_pipelines();
+		// 编译着色器, 创建管线布局并注册热重载, 管线本身由 create_pipelines() 批量创建.
+		bool create_pipeline(std::array<ShaderData, 2>& out_shader_datas, GraphicsPipelineDesc& out_desc);
+		GraphicsPipelineDesc get_graphics_pipeline_desc(
+			const ShaderCompileDesc& vs_desc,
+			const ShaderData& vs_data,
+			const ShaderCompileDesc& ps_desc,
+			const ShaderData& ps_data
+		) const;
+		bool create_cull_pipeline(ShaderData& out_shader_data, ComputePipelineDesc& out_desc);
 		bool create_frame_buffer();
 		bool create_command_pool();
 		bool create_command_buffer();
-		bool record_command(uint32_t frame_buffer_index);
+		bool record_command(const FrameContext& frame, uint32_t frame_buffer_index, uint64_t& upload_wait_value);
+		bool record_cull(VkCommandBuffer cmd_buffer, const FrameContext& frame);
+		void bind_draw_state(VkCommandBuffer cmd_buffer, const FrameContext& frame);
+		bool record_draws(VkCommandBuffer cmd_buffer, const FrameContext& frame);
+		bool record_direct_draws(VkCommandBuffer cmd_buffer, const FrameContext& frame, uint64_t begin, uint64_t end);
 		bool create_sync_objects();
 
 		void clean_up_swapchain();
@@ -136,29 +228,33 @@ namespace fantasy
 
 		bool create_vertex_buffer();
 		bool create_index_buffer();
+		bool create_instance_buffer();
+		bool create_draw_buffers();
 		bool create_buffer(
 			VkDeviceSize size, 
 			VkBufferUsageFlags usage, 
 			VkMemoryPropertyFlags properties, 
 			VkBuffer& buffer, 
-			VkDeviceMemory& buffer_memory
+			GpuAllocation& buffer_memory
 		);
-		bool create_binding_layout();
-		bool create_constant_buffer();
-		void update_constant_buffer(uint32_t back_buffer_index);
-		bool create_binding_set();
-		bool copy_buffer(VkBuffer dst_buffer, VkBuffer src_buffer, VkDeviceSize size);
+		bool check_bindless_bindings(std::span<const ShaderCompileDesc> descs, std::span<const ShaderData> datas);
+		static VkShaderStageFlags get_shader_stage(ShaderTarget target);
+		static bool get_descriptor_type(ShaderResourceType type, VkDescriptorType& out_type);
+		bool update_constant_buffer(FrameContext& frame);
+		void load_texture_async();
 		bool create_texture();
+		static VkFormat get_texture_format(const TextureDesc& desc);
 		bool create_sampler();
 		bool draw();
+		FrameContext& get_current_frame() { return _frames[_frame_index % NUM_FRAMES_IN_FLIGHT]; }
+		void release_retired_pipelines(FrameContext& frame);
+		void collect_gpu_time(uint64_t frame_index);
+		bool write_benchmark();
+		bool dump_back_buffer();
 
-		bool begin_once_command_buffer(VkCommandBuffer& cmd_buffer);
-		bool end_once_command_buffer(VkCommandBuffer& cmd_buffer);
-		bool texture_transition(VkImage texture, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-
-		uint32_t get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags flags);
 	
 	private:
+		RunOptions _options;
 		GlfwWindow _window;
 
 		VkInstance _instance;
@@ -178,22 +274,23 @@ namespace fantasy
 
 		std::vector<const char*> _device_extensions;
 		VkPhysicalDevice _physical_device = VK_NULL_HANDLE;
-		VkPhysicalDeviceMemoryProperties _memory_properties;
 
 
 		
 		// Vulkan 有多种不同类型的队列, 它们属于不同的队列族, 每个队列族的队列只允许执行特定的一部分指令.
 		// 创建 VkQueue 逻辑队列时会根据 queue family index 索引进行检索创建.
-		// 这里我们需要一个 graphics queue 和一个 present queue.
+		// 这里我们需要一个 graphics queue, 一个 present queue 和一个用于上传的 transfer queue.
 		struct 
 		{
 			uint32_t graphics_index = INVALID_SIZE_32;
 			uint32_t present_index = INVALID_SIZE_32;
+			uint32_t transfer_index = INVALID_SIZE_32;
 		} _queue_family_index;
 
 		VkDevice _device;
 		VkQueue _graphics_queue;
 		VkQueue _present_queue;
+		VkQueue _transfer_queue;
 
 
 		struct
@@ -208,40 +305,66 @@ namespace fantasy
 		VkFormat _swapchain_format;
 		std::vector<VkImage> _back_buffers;
 		std::vector<VkImageView> _back_buffer_views;
+		std::vector<GpuAllocation> _back_buffer_memories;     // 只有 headless 时的离屏图像需要自己分配.
 
 		VkViewport _viewport;
 		VkRect2D _scissor;
 
 		VkPipelineLayout _layout;
+		VkShaderStageFlags _push_constant_stages = 0;
 		VkRenderPass _render_pass;
-		VkPipeline _graphics_pipeline;
+		VkPipeline _graphics_pipeline;     // 归 _pipeline_cache 所有.
+		PipelineCache _pipeline_cache;
 
 		std::vector<VkFramebuffer> _frame_buffers;
 
-		VkCommandPool _cmd_pool;
-		VkCommandBuffer _cmd_buffer;
+		std::array<FrameContext, NUM_FRAMES_IN_FLIGHT> _frames;
+		uint64_t _frame_index = 0;
+
+		ParallelCommandRecorder _command_recorder;
 
-		VkSemaphore _back_buffer_avaible_semaphore;
-		VkSemaphore _render_finished_semaphore;
-		VkFence _fence;
+		RenderGraph _render_graph;
+		RenderGraphExecutor _render_graph_executor;
 
 		VkBuffer _vertex_buffer;
-		VkDeviceMemory _vertex_buffer_memory;
+		GpuAllocation _vertex_buffer_memory;
 		VkBuffer _index_buffer;
-		VkDeviceMemory _index_buffer_memory;
+		GpuAllocation _index_buffer_memory;
+
+		// 实例数量为 _options.instance_count. 实例由计算着色器做视锥剔除, 可见的实例压缩成间接绘制参数, CPU 的录制量与实例数无关.
+		std::vector<VkDrawIndexedIndirectCommand> _direct_draw_commands;     // 只在 RunOptions::direct_draws 时使用.
+		VkBuffer _instance_buffer;
+		GpuAllocation _instance_buffer_memory;
+		uint32_t _instance_buffer_index = BindlessDescriptorHeap::INVALID_INDEX;
 
-		VkDescriptorSetLayout _binding_layout;
-		VkDescriptorPool _descriptor_pool;
-		std::vector<VkDescriptorSet> _binding_sets;
-		std::vector<VkBuffer> _constant_buffers;
-		std::vector<VkDeviceMemory> _constant_buffer_memorys;
-		std::vector<void*> _constant_buffer_mapped_datas;
+		VkPipelineLayout _cull_layout;
+		VkPipeline _cull_pipeline;          // 归 _pipeline_cache 所有.
+
+		BindlessDescriptorHeap _bindless_heap;
+		FrameConstantAllocator _constant_allocator;
+
+		struct
+		{
+			std::string source_path = std::string(PROJ_DIR) + "/asset/test_image.jpg";
+			std::vector<uint8_t> file;     // 原图或 .ftex 的文件内容.
+			bool cooked = false;
+		} _test_image;
 
 		VkImage _test_texture;
-		VkDeviceMemory _test_texture_memory;
+		GpuAllocation _test_texture_memory;
 		VkImageView _test_texture_view;
+		uint32_t _test_texture_index = BindlessDescriptorHeap::INVALID_INDEX;
 
 		VkSampler _linear_wrap_sampler;
+		uint32_t _linear_wrap_sampler_index = BindlessDescriptorHeap::INVALID_INDEX;
+
+		ShaderHotReload _shader_hot_reload;
+		AsyncFileIo _async_file_io;
+		GpuMemoryAllocator _gpu_allocator;
+		UploadManager _upload_manager;
+
+		GpuTimer _gpu_timer;
+		FrameBenchmark _benchmark;
 	};
 }
 
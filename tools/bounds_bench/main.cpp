@@ -0,0 +1,162 @@
+#include "core/math/bounding_sphere.h"
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace fantasy;
+
+// 原来的 Sphere(const std::vector<float3>&): 坐标轴极值点, Ritter 扩张, 再对每个点开方校验 (NDEBUG 和 DEBUG 同时定义时 assert 仍然生效).
+static Sphere ritter_sphere(std::span<const float3> vertices)
+{
+    uint32_t min_idx[3] = {};
+    uint32_t max_idx[3] = {};
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            if (vertices[i][k] < vertices[min_idx[k]][k]) min_idx[k] = i;
+            if (vertices[i][k] > vertices[max_idx[k]][k]) max_idx[k] = i;
+        }
+    }
+
+    float max_len = 0;
+    uint32_t max_axis = 0;
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        float tlen = float3(vertices[max_idx[k]] - vertices[min_idx[k]]).length_squared();
+        if (tlen > max_len) max_len = tlen, max_axis = k;
+    }
+
+    float3 center = (vertices[min_idx[max_axis]] + vertices[max_idx[max_axis]]) * 0.5f;
+    float radius = float(0.5 * sqrt(max_len));
+    max_len = radius * radius;
+
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        float len = float3(vertices[i] - center).length_squared();
+        if (len > max_len)
+        {
+            len = sqrt(len);
+            float t = 0.5 - 0.5 * (radius / len);
+            center = center + (vertices[i] - center) * t;
+            radius = (radius + len) * 0.5;
+            max_len = radius * radius;
+        }
+    }
+
+    uint32_t outside_count = 0;
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        if (float3(vertices[i] - center).length() - 1e-6 > radius) outside_count++;
+    }
+    if (outside_count > 0) LOG_ERROR(std::to_string(outside_count) + " points outside the Ritter sphere.");
+    return Sphere(center, radius);
+}
+
+// 所有点都在球内, 允许与半径成比例的浮点误差.
+static bool contains_all(const Sphere& sphere, std::span<const float3> points)
+{
+    const double radius = sphere.radius * (1.0 + 1e-5) + 1e-6;
+    for (const float3& point : points)
+    {
+        const double dx = point.x - sphere.center.x;
+        const double dy = point.y - sphere.center.y;
+        const double dz = point.z - sphere.center.z;
+        if (dx * dx + dy * dy + dz * dz > radius * radius) return false;
+    }
+    return true;
+}
+
+// uniform: 立方体内均匀分布. cluster: 正态分布的点云加上少量远处的离群点, 扩张阶段会多次遇到球外的点.
+static std::vector<float3> generate_points(const std::string& distribution, uint32_t count, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<float3> points(count);
+    if (distribution == "uniform")
+    {
+        std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+        for (float3& point : points) point = float3(coordinate(random), coordinate(random), coordinate(random));
+    }
+    else
+    {
+        std::normal_distribution<float> coordinate(0.0f, 10.0f);
+        std::uniform_real_distribution<float> outlier(-200.0f, 200.0f);
+        for (uint32_t ix = 0; ix < count; ++ix)
+        {
+            points[ix] = ix % 100000 == 0 ?
+                float3(outlier(random), outlier(random), outlier(random)) :
+                float3(coordinate(random), coordinate(random), coordinate(random));
+        }
+    }
+    return points;
+}
+
+// 用法: bounds_bench [--points N] [--repeat N] [--seed N]
+// 对 N 个 (默认 1000 万) 点分别用原来的 Ritter 构造, compute_bounding_sphere() 和 compute_bounding_sphere_parallel()
+// 求包围球, 输出每种方法多次中最快的时间和半径, 半径越小越紧. 有点不在球内时返回 1.
+int main(int argc, char** argv)
+{
+    uint32_t point_count = 10000000;
+    uint32_t repeat_count = 3;
+    uint32_t seed = 1;
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--points") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') point_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--repeat") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') repeat_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--seed") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') seed = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else point_count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        point_count = 0;
+    }
+    if (point_count == 0 || repeat_count == 0)
+    {
+        LOG_ERROR("Usage: bounds_bench [--points N] [--repeat N] [--seed N]");
+        return 1;
+    }
+
+    parallel::initialize();
+
+    bool ret = true;
+    for (const char* distribution : { "uniform", "cluster" })
+    {
+        const std::vector<float3> points = generate_points(distribution, point_count, seed);
+        LOG_INFO(std::string(distribution) + ": " + std::to_string(point_count) + " points.");
+
+        auto run = [&](const char* name, const std::function<Sphere(std::span<const float3>)>& func)
+        {
+            Sphere sphere;
+            float best_seconds = 0.0f;
+            for (uint32_t ix = 0; ix < repeat_count; ++ix)
+            {
+                Timer timer;
+                sphere = func(points);
+                const float seconds = timer.elapsed();
+                if (ix == 0 || seconds < best_seconds) best_seconds = seconds;
+            }
+
+            const bool contained = contains_all(sphere, points);
+            ret = ret && contained;
+            LOG_INFO(
+                std::string("    ") + name + ": " + std::to_string(best_seconds * 1000.0f) + " ms, radius " +
+                std::to_string(sphere.radius) + (contained ? "." : ", points outside the sphere!")
+            );
+        };
+        run("ritter", ritter_sphere);
+        run("compute_bounding_sphere", [](std::span<const float3> points) { return compute_bounding_sphere(points); });
+        run("compute_bounding_sphere_parallel", [](std::span<const float3> points) { return compute_bounding_sphere_parallel(points); });
+    }
+
+    parallel::destroy();
+    return ret ? 0 : 1;
+}
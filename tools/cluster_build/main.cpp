@@ -0,0 +1,132 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "mesh/cluster_builder.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 只读取 obj 中的顶点位置 (v) 和面 (f), 多边形按扇形拆分为三角形, 支持负数索引.
+static bool load_obj(const std::string& path, std::vector<fantasy::float3>& out_vertices, std::vector<uint32_t>& out_indices)
+{
+    std::ifstream input(path);
+    if (!input.is_open())
+    {
+        LOG_ERROR("Open obj file " + path + " failed.");
+        return false;
+    }
+
+    std::string line;
+    std::vector<uint32_t> face;
+    while (std::getline(input, line))
+    {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+        if (type == "v")
+        {
+            fantasy::float3 position;
+            stream >> position.x >> position.y >> position.z;
+            out_vertices.push_back(position);
+        }
+        else if (type == "f")
+        {
+            face.clear();
+            std::string token;
+            while (stream >> token)
+            {
+                // "v", "v/vt", "v//vn" 或 "v/vt/vn", 只取第一个.
+                const int64_t index = std::stoll(token.substr(0, token.find('/')));
+                const int64_t vertex = index < 0 ? static_cast<int64_t>(out_vertices.size()) + index : index - 1;
+                if (vertex < 0 || vertex >= static_cast<int64_t>(out_vertices.size()))
+                {
+                    LOG_ERROR("Obj file " + path + " has an invalid face index " + token + ".");
+                    return false;
+                }
+                face.push_back(static_cast<uint32_t>(vertex));
+            }
+            for (uint32_t ix = 2; ix < face.size(); ++ix)
+            {
+                out_indices.insert(out_indices.end(), { face[0], face[ix - 1], face[ix] });
+            }
+        }
+    }
+    return !out_indices.empty();
+}
+
+// 用法: cluster_build <输入 .obj> <输出文件> [--cluster-triangles 64|128] [--group-clusters N]
+// 离线生成 cluster lod dag, 写入后重新读取一遍确认文件有效.
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        LOG_ERROR("Usage: cluster_build <input .obj> <output file> [--cluster-triangles 64|128] [--group-clusters N]");
+        return 1;
+    }
+
+    fantasy::ClusterBuildDesc desc;
+    try
+    {
+        for (int ix = 3; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--cluster-triangles") == 0 && ix + 1 < argc) desc.cluster_triangle_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--group-clusters") == 0 && ix + 1 < argc) desc.group_cluster_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+        }
+    }
+    catch (const std::exception&)
+    {
+        LOG_ERROR("Invalid argument.");
+        return 1;
+    }
+
+    std::vector<fantasy::float3> vertices;
+    std::vector<uint32_t> indices;
+    try
+    {
+        if (!load_obj(argv[1], vertices, indices)) return 1;
+    }
+    catch (const std::exception&)
+    {
+        LOG_ERROR(std::string("Parse obj file ") + argv[1] + " failed.");
+        return 1;
+    }
+
+    fantasy::parallel::initialize();
+
+    fantasy::Timer timer;
+    fantasy::ClusterDag dag;
+    const bool built = fantasy::build_cluster_dag(vertices, indices, desc, dag);
+    const float seconds = timer.elapsed();
+
+    fantasy::parallel::destroy();
+
+    if (!built) return 1;
+
+    fantasy::Timer save_timer;
+    if (!fantasy::save_cluster_dag(argv[2], dag)) return 1;
+    const float save_seconds = save_timer.elapsed();
+
+    fantasy::Timer load_timer;
+    fantasy::ClusterDag loaded_dag;
+    if (!fantasy::load_cluster_dag(argv[2], loaded_dag)) return 1;
+    const float load_seconds = load_timer.elapsed();
+
+    // 文件刚写入, 读取的是页缓存中的数据, 主要反映序列化本身的开销.
+    const double gigabytes = static_cast<double>(dag.memory_size()) / (1024.0 * 1024.0 * 1024.0);
+    LOG_INFO(
+        "Saved in " + std::to_string(save_seconds * 1000.0f) + " ms (" + std::to_string(gigabytes / save_seconds) + " GB/s), " +
+        "loaded in " + std::to_string(load_seconds * 1000.0f) + " ms (" + std::to_string(gigabytes / load_seconds) + " GB/s)."
+    );
+
+    LOG_INFO(
+        std::to_string(indices.size() / 3) + " triangles -> " + 
+        std::to_string(dag.clusters.size()) + " clusters, " + 
+        std::to_string(dag.groups.size()) + " groups, " + 
+        std::to_string(dag.memory_size() / 1024) + " KB in " + 
+        std::to_string(seconds * 1000.0f) + " ms."
+    );
+    LOG_INFO(std::string("Built ") + argv[2] + ".");
+    return 0;
+}
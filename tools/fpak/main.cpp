@@ -0,0 +1,44 @@
+#include "core/tools/asset_archive.h"
+#include "core/tools/log.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 用法: fpak <资源目录> <输出文件> [--compress] [--align N]
+// 目录下的所有文件按相对路径作为名字写入 .fpak.
+int main(int argc, char** argv)
+{
+    bool compress = false;
+    uint32_t alignment = fantasy::ASSET_ARCHIVE_DEFAULT_ALIGNMENT;
+    bool valid = argc >= 3;
+    try
+    {
+        for (int ix = 3; ix < argc && valid; ++ix)
+        {
+            if (strcmp(argv[ix], "--compress") == 0) compress = true;
+            else if (strcmp(argv[ix], "--align") == 0 && ix + 1 < argc)
+            {
+                // stoul 接受负数并回绕, 需要单独拒绝.
+                const unsigned long value = std::stoul(argv[++ix]);
+                valid = argv[ix][0] != '-' && value <= UINT32_MAX;
+                alignment = static_cast<uint32_t>(value);
+            }
+            else valid = false;
+        }
+    }
+    catch (const std::exception&)
+    {
+        valid = false;
+    }
+    if (!valid)
+    {
+        LOG_ERROR("Usage: fpak <asset directory> <output .fpak> [--compress] [--align N]");
+        return 1;
+    }
+
+    fantasy::AssetArchiveBuilder builder;
+    if (!builder.add_directory(argv[1], compress) || !builder.build(argv[2], alignment)) return 1;
+
+    LOG_INFO(std::string("Built ") + argv[2] + ".");
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/async_file_io.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 把文件从页缓存中丢弃, 之后的读取需要访问磁盘. 只在 Linux 上可用.
+static bool drop_page_cache(const std::vector<std::string>& paths)
+{
+#if defined(__linux__)
+    for (const auto& path : paths)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        const bool dropped = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(fd);
+        if (!dropped) return false;
+    }
+    return true;
+#else
+    (void)paths;
+    return false;
+#endif
+}
+
+static bool read_sync(const std::vector<std::string>& paths, uint64_t& out_bytes)
+{
+    out_bytes = 0;
+    std::vector<char> buffer;
+    for (const auto& path : paths)
+    {
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input.is_open()) return false;
+
+        buffer.resize(static_cast<uint64_t>(input.tellg()));
+        input.seekg(0);
+        if (!input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) return false;
+        out_bytes += buffer.size();
+    }
+    return true;
+}
+
+static bool read_async(fantasy::AsyncFileIo& io, const std::vector<fantasy::AsyncReadRequest>& requests, uint64_t& out_bytes)
+{
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<uint32_t> failed_count = 0;
+    io.read(
+        requests,
+        [&](fantasy::AsyncReadResult& result)
+        {
+            if (!result.success) failed_count.fetch_add(1);
+            bytes.fetch_add(result.data.size());
+            io.recycle(std::move(result.buffer));
+        }
+    );
+    io.wait_idle();
+
+    out_bytes = bytes.load();
+    return failed_count.load() == 0;
+}
+
+// 用法: io_bench [--files N] [--min-size B] [--max-size B] [--repeat N]
+// 在临时目录中生成 N 个 (默认 10000) 大小在 [min-size, max-size] 之间的小文件, 分别用 AsyncFileIo 和
+// 同步的 std::ifstream 读取全部文件. 冷启动前用 POSIX_FADV_DONTNEED 丢弃页缓存, 热启动取多次中最快的一次.
+int main(int argc, char** argv)
+{
+    uint32_t file_count = 10000;
+    uint32_t min_size = 1024;
+    uint32_t max_size = 4096;
+    uint32_t repeat_count = 3;
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--files") == 0 && ix + 1 < argc) file_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--min-size") == 0 && ix + 1 < argc) min_size = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--max-size") == 0 && ix + 1 < argc) max_size = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--repeat") == 0 && ix + 1 < argc) repeat_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else file_count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        file_count = 0;
+    }
+    if (file_count == 0 || min_size == 0 || min_size > max_size || repeat_count == 0)
+    {
+        LOG_ERROR("Usage: io_bench [--files N] [--min-size B] [--max-size B] [--repeat N]");
+        return 1;
+    }
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "fantasy_io_bench";
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    if (!std::filesystem::create_directories(directory, error))
+    {
+        LOG_ERROR("Create directory " + directory.string() + " failed.");
+        return 1;
+    }
+
+    // 内容和大小由固定种子生成, 多次运行的文件集合相同.
+    std::mt19937 random(7);
+    std::uniform_int_distribution<uint32_t> size_distribution(min_size, max_size);
+    std::vector<std::string> paths(file_count);
+    std::vector<fantasy::AsyncReadRequest> requests(file_count);
+    std::vector<char> content(max_size);
+    uint64_t total_bytes = 0;
+    for (uint32_t ix = 0; ix < file_count; ++ix)
+    {
+        for (char& c : content) c = static_cast<char>(random());
+
+        paths[ix] = (directory / (std::to_string(ix) + ".bin")).string();
+        const uint32_t size = size_distribution(random);
+        std::ofstream output(paths[ix], std::ios::binary | std::ios::trunc);
+        if (!output.write(content.data(), size))
+        {
+            LOG_ERROR("Write " + paths[ix] + " failed.");
+            return 1;
+        }
+        requests[ix].path = paths[ix];
+        total_bytes += size;
+    }
+
+    fantasy::parallel::initialize();
+    fantasy::AsyncFileIo io;
+    io.initialize();
+    LOG_INFO(
+        std::to_string(file_count) + " files, " + std::to_string(total_bytes / 1024) + " KB, " +
+        (io.using_io_uring() ? "io_uring." : "blocking reads.")
+    );
+
+    bool ret = true;
+    auto run = [&](const char* name, auto&& func)
+    {
+        float best_seconds = 0.0f;
+        for (uint32_t ix = 0; ix <= repeat_count && ret; ++ix)
+        {
+            // 第 0 次在丢弃页缓存后读取, 之后的都是热启动.
+            if (ix == 0 && !drop_page_cache(paths)) LOG_ERROR("Drop page cache failed, the cold result is warm.");
+
+            uint64_t bytes = 0;
+            fantasy::Timer timer;
+            ret = ret && func(bytes) && bytes == total_bytes;
+            const float seconds = timer.elapsed();
+
+            if (ix == 0)
+            {
+                LOG_INFO(std::string(name) + " cold: " + std::to_string(seconds * 1000.0f) + " ms.");
+            }
+            else if (ix == 1 || seconds < best_seconds)
+            {
+                best_seconds = seconds;
+            }
+        }
+        if (ret) LOG_INFO(std::string(name) + " warm: " + std::to_string(best_seconds * 1000.0f) + " ms.");
+    };
+    run("AsyncFileIo", [&](uint64_t& out_bytes) { return read_async(io, requests, out_bytes); });
+    run("ifstream", [&](uint64_t& out_bytes) { return read_sync(paths, out_bytes); });
+
+    io.destroy();
+    fantasy::parallel::destroy();
+    std::filesystem::remove_all(directory, error);
+
+    if (!ret)
+    {
+        LOG_ERROR("Read files failed.");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "core/math/vector.h"
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "mesh/mesh_simplifier.h"
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 用法: lod_bench [--grid N] [--lods N]
+// 生成 N * N * 2 个三角形的起伏网格 (默认约 100 万), 统计 build_lod_chain() 的耗时.
+int main(int argc, char** argv)
+{
+    uint32_t grid_size = 708;
+    uint32_t max_lod_count = 8;
+    for (int ix = 1; ix < argc; ++ix)
+    {
+        if (strcmp(argv[ix], "--grid") == 0 && ix + 1 < argc) grid_size = static_cast<uint32_t>(std::stoul(argv[++ix]));
+        else if (strcmp(argv[ix], "--lods") == 0 && ix + 1 < argc) max_lod_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+    }
+
+    std::vector<fantasy::float3> vertices;
+    vertices.reserve((grid_size + 1) * (grid_size + 1));
+    for (uint32_t y = 0; y <= grid_size; ++y)
+    {
+        for (uint32_t x = 0; x <= grid_size; ++x)
+        {
+            const float height = std::sin(x * 0.05f) * std::cos(y * 0.07f) * 4.0f + std::sin((x + y) * 0.31f) * 0.25f;
+            vertices.emplace_back(static_cast<float>(x), height, static_cast<float>(y));
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(grid_size * grid_size * 6);
+    for (uint32_t y = 0; y < grid_size; ++y)
+    {
+        for (uint32_t x = 0; x < grid_size; ++x)
+        {
+            const uint32_t v0 = y * (grid_size + 1) + x;
+            const uint32_t v1 = v0 + 1;
+            const uint32_t v2 = v0 + grid_size + 1;
+            const uint32_t v3 = v2 + 1;
+            indices.insert(indices.end(), { v0, v2, v1, v1, v2, v3 });
+        }
+    }
+
+    fantasy::parallel::initialize();
+
+    fantasy::Timer timer;
+    const std::vector<fantasy::MeshLod> lods = fantasy::build_lod_chain(vertices, indices, max_lod_count);
+    const float seconds = timer.elapsed();
+
+    const uint64_t triangle_count = indices.size() / 3;
+    for (uint32_t ix = 0; ix < lods.size(); ++ix)
+    {
+        LOG_INFO(
+            "Lod " + std::to_string(ix) + 
+            ": " + std::to_string(lods[ix].indices.size() / 3) + " triangles, error " + std::to_string(lods[ix].error) + "."
+        );
+    }
+    LOG_INFO(
+        std::to_string(triangle_count) + " triangles, " + std::to_string(fantasy::parallel::thread_count()) + " threads, " +
+        std::to_string(seconds * 1000.0f) + " ms, " + std::to_string(triangle_count / seconds / 1e6) + " M triangles/s."
+    );
+
+    fantasy::parallel::destroy();
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "gpu/bindless_descriptor_heap.h"
+#include "gpu/pipeline_cache.h"
+#include "shader/shader_compiler.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// 与 VulkanBase::Vertex 相同的顶点布局.
+struct Vertex
+{
+    float position[2];
+    float color[3];
+    float uv[2];
+};
+
+struct Device
+{
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+
+    void destroy()
+    {
+        if (device != VK_NULL_HANDLE) vkDestroyDevice(device, nullptr);
+        if (instance != VK_NULL_HANDLE) vkDestroyInstance(instance, nullptr);
+    }
+};
+
+// 不需要窗口和交换链. 选择第一个支持 Vulkan 1.3 和图形队列的设备, 开启与 VulkanBase 相同的 bindless 特性.
+static bool create_device(Device& out_device)
+{
+    VkApplicationInfo app_info{};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "pipeline_bench";
+    app_info.apiVersion = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo instance_create_info{};
+    instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_create_info.pApplicationInfo = &app_info;
+    ReturnIfFalse(vkCreateInstance(&instance_create_info, nullptr, &out_device.instance) == VK_SUCCESS);
+
+    uint32_t device_count = 0;
+    vkEnumeratePhysicalDevices(out_device.instance, &device_count, nullptr);
+    std::vector<VkPhysicalDevice> physical_devices(device_count);
+    vkEnumeratePhysicalDevices(out_device.instance, &device_count, physical_devices.data());
+
+    uint32_t queue_family_index = ~0u;
+    for (VkPhysicalDevice physical_device : physical_devices)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_3) continue;
+
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+        for (uint32_t ix = 0; ix < family_count; ++ix)
+        {
+            if ((families[ix].queueFlags & VK_QUEUE_GRAPHICS_BIT) == 0) continue;
+            out_device.physical_device = physical_device;
+            queue_family_index = ix;
+            LOG_INFO(std::string("Device: ") + properties.deviceName + ".");
+            break;
+        }
+        if (out_device.physical_device != VK_NULL_HANDLE) break;
+    }
+    if (out_device.physical_device == VK_NULL_HANDLE)
+    {
+        LOG_ERROR("No Vulkan 1.3 device with a graphics queue.");
+        return false;
+    }
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_create_info{};
+    queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_create_info.queueFamilyIndex = queue_family_index;
+    queue_create_info.queueCount = 1;
+    queue_create_info.pQueuePriorities = &priority;
+
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+    VkDeviceCreateInfo device_create_info{};
+    device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_create_info.pNext = &features12;
+    device_create_info.queueCreateInfoCount = 1;
+    device_create_info.pQueueCreateInfos = &queue_create_info;
+    return vkCreateDevice(out_device.physical_device, &device_create_info, nullptr, &out_device.device) == VK_SUCCESS;
+}
+
+static bool create_render_pass(VkDevice device, VkRenderPass& out_render_pass)
+{
+    VkAttachmentDescription attachment_description{};
+    attachment_description.format = VK_FORMAT_R8G8B8A8_UNORM;
+    attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment_description.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment_description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachment_description.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference attachment_ref{};
+    attachment_ref.attachment = 0;
+    attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &attachment_ref;
+
+    VkRenderPassCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.attachmentCount = 1;
+    create_info.pAttachments = &attachment_description;
+    create_info.subpassCount = 1;
+    create_info.pSubpasses = &subpass;
+    return vkCreateRenderPass(device, &create_info, nullptr, &out_render_pass) == VK_SUCCESS;
+}
+
+static constexpr uint32_t CULL_MODE_COUNT = 4;
+static constexpr uint32_t FRONT_FACE_COUNT = 2;
+static constexpr uint32_t TOPOLOGY_COUNT = 2;
+static constexpr uint32_t WRITE_MASK_COUNT = 15;
+static constexpr uint32_t BLEND_COUNT = 5;
+static constexpr uint32_t MAX_PERMUTATION_COUNT = CULL_MODE_COUNT * FRONT_FACE_COUNT * TOPOLOGY_COUNT * WRITE_MASK_COUNT * BLEND_COUNT;
+
+// 着色器相同, 只改变不需要额外设备特性的固定管线状态, 每个 index 得到不同的管线键.
+static fantasy::GraphicsPipelineDesc get_permutation(const fantasy::GraphicsPipelineDesc& base, uint32_t index)
+{
+    const VkCullModeFlags cull_modes[CULL_MODE_COUNT] = {
+        VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_AND_BACK
+    };
+    const VkPrimitiveTopology topologies[TOPOLOGY_COUNT] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP
+    };
+    // 0 表示不混合.
+    const VkBlendFactor blend_factors[BLEND_COUNT] = {
+        VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_DST_ALPHA, VK_BLEND_FACTOR_ZERO
+    };
+
+    fantasy::GraphicsPipelineDesc desc = base;
+    VkPipelineColorBlendAttachmentState& blend = desc.blend_attachments[0];
+    blend.colorWriteMask = 1 + index % WRITE_MASK_COUNT;
+    index /= WRITE_MASK_COUNT;
+    desc.cull_mode = cull_modes[index % CULL_MODE_COUNT];
+    index /= CULL_MODE_COUNT;
+    desc.front_face = index % FRONT_FACE_COUNT == 0 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+    index /= FRONT_FACE_COUNT;
+    desc.topology = topologies[index % TOPOLOGY_COUNT];
+    index /= TOPOLOGY_COUNT;
+
+    const uint32_t blend_index = index % BLEND_COUNT;
+    blend.blendEnable = blend_index == 0 ? VK_FALSE : VK_TRUE;
+    blend.srcColorBlendFactor = blend_factors[blend_index];
+    blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    return desc;
+}
+
+// 用 PipelineCache 创建所有管线并计时, destroy() 时把驱动的缓存数据写入 cache_path.
+static bool run(
+    const Device& device,
+    const std::string& cache_path,
+    const std::vector<fantasy::GraphicsPipelineDesc>& descs,
+    float& out_seconds
+)
+{
+    fantasy::PipelineCache cache;
+    ReturnIfFalse(cache.initialize(device.physical_device, device.device, cache_path));
+
+    std::vector<VkPipeline> pipelines(descs.size(), VK_NULL_HANDLE);
+    fantasy::Timer timer;
+    const bool ret = cache.create_pipelines(descs, pipelines, {}, {});
+    out_seconds = timer.elapsed();
+
+    const bool all_created = ret && cache.get_pipeline_count() == descs.size();
+    cache.destroy();
+    return all_created;
+}
+
+// 用法: pipeline_bench [--count N] [--cache PATH]
+// 用 triangle_vs/triangle_ps 和 N 种 (默认 500) 不同的固定管线状态创建图形管线, 先删除缓存文件冷启动创建一遍,
+// 保存后重新读取缓存文件热启动再创建一遍, 输出两次的时间. 需要 Vulkan 1.3 设备.
+// 驱动自己的磁盘缓存 (例如 Mesa 的 MESA_SHADER_CACHE_DISABLE=true) 需要关闭, 否则冷启动的结果偏快.
+int main(int argc, char** argv)
+{
+    uint32_t count = 500;
+    std::string cache_path = (std::filesystem::temp_directory_path() / "fantasy_pipeline_bench.cache").string();
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--count") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--cache") == 0 && ix + 1 < argc) cache_path = argv[++ix];
+            else count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        count = 0;
+    }
+    if (count == 0 || count > MAX_PERMUTATION_COUNT)
+    {
+        LOG_ERROR("Usage: pipeline_bench [--count N] [--cache PATH], N in [1, " + std::to_string(MAX_PERMUTATION_COUNT) + "]");
+        return 1;
+    }
+
+    fantasy::parallel::initialize();
+    fantasy::set_shader_platform(fantasy::ShaderPlatform::SPIRV);
+
+    Device device;
+    fantasy::BindlessDescriptorHeap bindless_heap;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    auto destroy = [&]()
+    {
+        if (device.device != VK_NULL_HANDLE)
+        {
+            if (render_pass != VK_NULL_HANDLE) vkDestroyRenderPass(device.device, render_pass, nullptr);
+            if (layout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device.device, layout, nullptr);
+            bindless_heap.destroy();
+        }
+        device.destroy();
+        fantasy::parallel::destroy();
+    };
+
+    fantasy::ShaderCompileDesc vs_desc;
+    vs_desc.shader_name = "triangle_vs.slang";
+    vs_desc.entry_point = "main";
+    vs_desc.target = fantasy::ShaderTarget::Vertex;
+    fantasy::ShaderCompileDesc ps_desc;
+    ps_desc.shader_name = "triangle_ps.slang";
+    ps_desc.entry_point = "main";
+    ps_desc.target = fantasy::ShaderTarget::Pixel;
+    const fantasy::ShaderData vs_data = fantasy::compile_shader(vs_desc);
+    const fantasy::ShaderData ps_data = fantasy::compile_shader(ps_desc);
+
+    bool ret = !vs_data.invalid() && !ps_data.invalid();
+    if (!ret) LOG_ERROR("Compile triangle_vs/triangle_ps failed.");
+
+    ret = ret && create_device(device) && bindless_heap.initialize(device.physical_device, device.device);
+    if (ret)
+    {
+        VkPushConstantRange push_constant_range{};
+        if (vs_data._reflection.push_constant_size > 0) push_constant_range.stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+        if (ps_data._reflection.push_constant_size > 0) push_constant_range.stageFlags |= VK_SHADER_STAGE_FRAGMENT_BIT;
+        push_constant_range.size = std::max(vs_data._reflection.push_constant_size, ps_data._reflection.push_constant_size);
+
+        const VkDescriptorSetLayout bindless_layout = bindless_heap.get_layout();
+        VkPipelineLayoutCreateInfo layout_create_info{};
+        layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_create_info.setLayoutCount = 1;
+        layout_create_info.pSetLayouts = &bindless_layout;
+        layout_create_info.pushConstantRangeCount = push_constant_range.size > 0 ? 1 : 0;
+        layout_create_info.pPushConstantRanges = push_constant_range.size > 0 ? &push_constant_range : nullptr;
+        ret = vkCreatePipelineLayout(device.device, &layout_create_info, nullptr, &layout) == VK_SUCCESS &&
+            create_render_pass(device.device, render_pass);
+    }
+    if (!ret)
+    {
+        destroy();
+        return 1;
+    }
+
+    fantasy::GraphicsPipelineDesc base;
+    base.vs_code = vs_data.byte_code();
+    base.ps_code = ps_data.byte_code();
+    base.vertex_bindings = { VkVertexInputBindingDescription{ 0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX } };
+    base.vertex_attributes = {
+        VkVertexInputAttributeDescription{ 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, position) },
+        VkVertexInputAttributeDescription{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) },
+        VkVertexInputAttributeDescription{ 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) }
+    };
+    base.blend_attachments = { VkPipelineColorBlendAttachmentState{} };
+    base.layout = layout;
+    base.render_pass = render_pass;
+
+    std::vector<fantasy::GraphicsPipelineDesc> descs(count);
+    for (uint32_t ix = 0; ix < count; ++ix) descs[ix] = get_permutation(base, ix);
+
+    std::error_code error;
+    std::filesystem::remove(cache_path, error);
+
+    float cold_seconds = 0.0f;
+    float warm_seconds = 0.0f;
+    ret = run(device, cache_path, descs, cold_seconds) && std::filesystem::exists(cache_path, error);
+    if (ret)
+    {
+        LOG_INFO(
+            "Cold: " + std::to_string(count) + " pipelines in " + std::to_string(cold_seconds * 1000.0f) + " ms, cache file " +
+            std::to_string(std::filesystem::file_size(cache_path, error) / 1024) + " KB."
+        );
+        ret = run(device, cache_path, descs, warm_seconds);
+    }
+    if (ret)
+    {
+        LOG_INFO(
+            "Warm: " + std::to_string(count) + " pipelines in " + std::to_string(warm_seconds * 1000.0f) + " ms, " +
+            std::to_string(cold_seconds / std::max(warm_seconds, 1e-6f)) + "x faster."
+        );
+    }
+    else
+    {
+        LOG_ERROR("Create pipelines failed.");
+    }
+
+    std::filesystem::remove(cache_path, error);
+    destroy();
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+#include "core/tools/log.h"
+#include "gpu/render_graph.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// 用法: render_graph_test
+// 只测试 RenderGraph::compile() 的结果 (pass 剔除, 临时资源共用内存, 屏障), 内存需求是伪造的, 不需要 GPU.
+// 有检查失败时返回 1.
+
+using namespace fantasy;
+
+static uint32_t failure_count = 0;
+
+static void check(bool condition, const std::string& message)
+{
+    if (condition) return;
+    LOG_ERROR("Check failed: " + message);
+    failure_count++;
+}
+
+static constexpr VkDeviceSize FAKE_ALIGNMENT = 64 * 1024;
+
+// 按描述伪造内存需求, 同时记录查询了哪些资源.
+static RenderGraph::MemoryQuery fake_memory_query(const RenderGraph& graph, std::vector<uint32_t>& out_queried)
+{
+    return [&graph, &out_queried](uint32_t resource, VkMemoryRequirements& out_requirements)
+    {
+        const RenderGraph::Resource& desc = graph.get_resources()[resource];
+        const VkDeviceSize size = desc.image ?
+            static_cast<VkDeviceSize>(desc.texture_desc.width) * desc.texture_desc.height * 4 :
+            desc.buffer_desc.size;
+
+        out_requirements.size = (size + FAKE_ALIGNMENT - 1) / FAKE_ALIGNMENT * FAKE_ALIGNMENT;
+        out_requirements.alignment = FAKE_ALIGNMENT;
+        out_requirements.memoryTypeBits = 0xf;
+        out_queried.push_back(resource);
+        return true;
+    };
+}
+
+static RenderGraphTextureDesc color_desc(uint32_t width, uint32_t height)
+{
+    return RenderGraphTextureDesc{
+        .width = width,
+        .height = height,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+    };
+}
+
+static RenderGraphHandle import_back_buffer(RenderGraph& graph)
+{
+    return graph.import_texture(
+        "back_buffer",
+        color_desc(1024, 768),
+        RenderGraphResourceState{ .stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT },
+        RenderGraphResourceState{ .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR }
+    );
+}
+
+static bool overlap(const RenderGraphPlan::Placement& a, const RenderGraphPlan::Placement& b)
+{
+    return a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+// 结果没有被使用的 pass 被剔除, 有副作用的 pass 和写入外部资源的 pass 及其依赖保留.
+static void test_culling()
+{
+    RenderGraph graph;
+    const auto back_buffer = import_back_buffer(graph);
+    const auto depth = graph.create_texture("depth", color_desc(1024, 768));
+    const auto unused = graph.create_texture("unused", color_desc(512, 512));
+    const auto readback = graph.create_buffer("readback", RenderGraphBufferDesc{ .size = 4096 });
+
+    const uint32_t prepass = graph.add_pass("prepass", nullptr);
+    graph.write(prepass, depth, RenderGraphUsage::DepthAttachment);
+
+    const uint32_t dead = graph.add_pass("dead", nullptr);
+    graph.read(dead, depth, RenderGraphUsage::GraphicsShaderRead);
+    graph.write(dead, unused, RenderGraphUsage::ColorAttachment);
+
+    const uint32_t copy = graph.add_pass("copy", nullptr, true);
+    graph.write(copy, readback, RenderGraphUsage::TransferDst);
+
+    const uint32_t main = graph.add_pass("main", nullptr);
+    graph.read(main, depth, RenderGraphUsage::DepthRead);
+    graph.write(main, back_buffer, RenderGraphUsage::ColorAttachment);
+
+    std::vector<uint32_t> queried;
+    bool rebuilt = false;
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt), "culling: compile");
+    check(rebuilt, "culling: first compile rebuilds the plan");
+
+    const RenderGraphPlan& plan = graph.get_plan();
+    check(plan.steps.size() == 3, "culling: 3 passes alive");
+    if (plan.steps.size() == 3)
+    {
+        check(plan.steps[0].pass == prepass, "culling: prepass is step 0");
+        check(plan.steps[1].pass == copy, "culling: side effect pass is kept");
+        check(plan.steps[2].pass == main, "culling: main is step 2");
+    }
+    check(plan.placements[unused.index].heap == ~0u, "culling: output of culled pass has no memory");
+    check(queried == std::vector<uint32_t>{ depth.index, readback.index }, "culling: memory queried only for live transients");
+}
+
+// 生命周期不重叠的临时资源共用内存, 重叠的不共用, buffer 和图像不在同一个 heap.
+static void test_aliasing()
+{
+    RenderGraph graph;
+    const auto back_buffer = import_back_buffer(graph);
+    const RenderGraphHandle targets[] = {
+        graph.create_texture("target0", color_desc(1024, 1024)),
+        graph.create_texture("target1", color_desc(1024, 1024)),
+        graph.create_texture("target2", color_desc(1024, 1024))
+    };
+    const auto scratch = graph.create_buffer("scratch", RenderGraphBufferDesc{ .size = 100000 });
+
+    // target0 [0, 1], target1 [1, 2], target2 [2, 3].
+    const uint32_t pass0 = graph.add_pass("pass0", nullptr);
+    graph.write(pass0, targets[0], RenderGraphUsage::ColorAttachment);
+    graph.write(pass0, scratch, RenderGraphUsage::ComputeStorageWrite);
+    for (uint32_t ix = 1; ix < 3; ++ix)
+    {
+        const uint32_t pass = graph.add_pass("pass" + std::to_string(ix), nullptr);
+        graph.read(pass, targets[ix - 1], RenderGraphUsage::GraphicsShaderRead);
+        graph.write(pass, targets[ix], RenderGraphUsage::ColorAttachment);
+        if (ix == 1) graph.read(pass, scratch, RenderGraphUsage::ComputeStorageRead);
+    }
+    const uint32_t pass3 = graph.add_pass("pass3", nullptr);
+    graph.read(pass3, targets[2], RenderGraphUsage::GraphicsShaderRead);
+    graph.write(pass3, back_buffer, RenderGraphUsage::ColorAttachment);
+
+    std::vector<uint32_t> queried;
+    bool rebuilt = false;
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt), "aliasing: compile");
+
+    const RenderGraphPlan& plan = graph.get_plan();
+    const auto& p0 = plan.placements[targets[0].index];
+    const auto& p1 = plan.placements[targets[1].index];
+    const auto& p2 = plan.placements[targets[2].index];
+    const auto& ps = plan.placements[scratch.index];
+    const VkDeviceSize target_size = 1024 * 1024 * 4;
+
+    check(plan.heaps.size() == 2, "aliasing: one image heap and one buffer heap");
+    check(p0.heap == p1.heap && p1.heap == p2.heap, "aliasing: targets share a heap");
+    check(ps.heap < plan.heaps.size() && ps.heap != p0.heap && !plan.heaps[ps.heap].image, "aliasing: buffer in its own heap");
+    check(overlap(p0, p2), "aliasing: target0 and target2 share memory");
+    check(!overlap(p0, p1) && !overlap(p1, p2), "aliasing: overlapping lifetimes do not share memory");
+    check(p0.heap < plan.heaps.size() && plan.heaps[p0.heap].size == 2 * target_size, "aliasing: image heap holds two targets");
+    check(p0.offset % FAKE_ALIGNMENT == 0 && p1.offset % FAKE_ALIGNMENT == 0, "aliasing: offsets aligned");
+
+    check(plan.steps.size() == 4, "aliasing: no pass culled");
+    if (plan.steps.size() != 4) return;
+
+    // target2 第一次使用前要等待共用内存的 target0 的访问完成.
+    bool found = false;
+    const auto& step2 = plan.steps[2];
+    for (uint32_t ix = step2.barrier_offset; ix < step2.barrier_offset + step2.barrier_count; ++ix)
+    {
+        const RenderGraphBarrier& barrier = plan.barriers[ix];
+        if (barrier.resource != targets[2].index) continue;
+        found = true;
+        check(barrier.old_layout == VK_IMAGE_LAYOUT_UNDEFINED, "aliasing: aliased target starts undefined");
+        check(
+            (barrier.src_stages & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT) != 0,
+            "aliasing: aliased target waits for reads of target0"
+        );
+    }
+    check(found, "aliasing: barrier before first use of aliased target");
+}
+
+// 写后读有布局转换, 读后读没有屏障, 写后写有屏障, 外部资源最后转换到最终布局.
+static void test_barriers()
+{
+    RenderGraph graph;
+    const auto back_buffer = import_back_buffer(graph);
+    const auto color = graph.create_texture("color", color_desc(1024, 768));
+
+    const uint32_t scene = graph.add_pass("scene", nullptr);
+    graph.write(scene, color, RenderGraphUsage::ColorAttachment);
+
+    const uint32_t tonemap = graph.add_pass("tonemap", nullptr);
+    graph.read(tonemap, color, RenderGraphUsage::GraphicsShaderRead);
+    graph.write(tonemap, back_buffer, RenderGraphUsage::ColorAttachment);
+
+    const uint32_t overlay = graph.add_pass("overlay", nullptr);
+    graph.read(overlay, color, RenderGraphUsage::GraphicsShaderRead);
+    graph.write(overlay, back_buffer, RenderGraphUsage::ColorAttachment);
+
+    std::vector<uint32_t> queried;
+    bool rebuilt = false;
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt), "barriers: compile");
+
+    const RenderGraphPlan& plan = graph.get_plan();
+    check(plan.steps.size() == 3, "barriers: no pass culled");
+    if (plan.steps.size() != 3) return;
+
+    auto find_barrier = [&](uint32_t step, RenderGraphHandle resource) -> const RenderGraphBarrier*
+    {
+        const auto& s = plan.steps[step];
+        for (uint32_t ix = s.barrier_offset; ix < s.barrier_offset + s.barrier_count; ++ix)
+        {
+            if (plan.barriers[ix].resource == resource.index) return &plan.barriers[ix];
+        }
+        return nullptr;
+    };
+
+    const RenderGraphBarrier* barrier = find_barrier(0, color);
+    check(barrier && barrier->new_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, "barriers: color to attachment layout");
+
+    barrier = find_barrier(1, color);
+    check(
+        barrier &&
+        barrier->old_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL &&
+        barrier->new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+        barrier->src_stages == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT &&
+        barrier->src_access == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT &&
+        (barrier->dst_access & VK_ACCESS_2_SHADER_READ_BIT) != 0,
+        "barriers: write then read transitions color to shader read"
+    );
+    barrier = find_barrier(1, back_buffer);
+    check(
+        barrier && barrier->old_layout == VK_IMAGE_LAYOUT_UNDEFINED && barrier->new_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        "barriers: back buffer from initial state"
+    );
+
+    check(find_barrier(2, color) == nullptr, "barriers: read after read needs no barrier");
+    barrier = find_barrier(2, back_buffer);
+    check(
+        barrier &&
+        barrier->old_layout == barrier->new_layout &&
+        barrier->src_access == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        "barriers: write after write waits without transition"
+    );
+    check(plan.steps[2].barrier_count == 1, "barriers: one barrier before overlay");
+
+    check(plan.final_barrier_count == 1, "barriers: one final barrier");
+    if (plan.final_barrier_count == 1)
+    {
+        const RenderGraphBarrier& final_barrier = plan.barriers[plan.final_barrier_offset];
+        check(
+            final_barrier.resource == back_buffer.index &&
+            final_barrier.old_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL &&
+            final_barrier.new_layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            "barriers: back buffer to present layout"
+        );
+    }
+}
+
+// 声明相同时复用执行计划, 不再查询内存需求; 描述改变时重新编译.
+static void test_plan_reuse()
+{
+    RenderGraph graph;
+    auto declare = [&graph](uint32_t width)
+    {
+        graph.reset();
+        const auto back_buffer = import_back_buffer(graph);
+        const auto color = graph.create_texture("color", color_desc(width, 768));
+
+        const uint32_t scene = graph.add_pass("scene", nullptr);
+        graph.write(scene, color, RenderGraphUsage::ColorAttachment);
+        const uint32_t tonemap = graph.add_pass("tonemap", nullptr);
+        graph.read(tonemap, color, RenderGraphUsage::GraphicsShaderRead);
+        graph.write(tonemap, back_buffer, RenderGraphUsage::ColorAttachment);
+    };
+
+    std::vector<uint32_t> queried;
+    bool rebuilt = false;
+
+    declare(1024);
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt) && rebuilt, "reuse: first compile rebuilds");
+
+    queried.clear();
+    declare(1024);
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt) && !rebuilt, "reuse: same declaration reuses the plan");
+    check(queried.empty(), "reuse: no memory query when reused");
+
+    declare(1280);
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt) && rebuilt, "reuse: changed desc rebuilds");
+
+    graph.invalidate();
+    declare(1280);
+    check(graph.compile(fake_memory_query(graph, queried), rebuilt) && rebuilt, "reuse: invalidated plan rebuilds");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 1)
+    {
+        LOG_ERROR("Usage: render_graph_test");
+        return 1;
+    }
+
+    const std::pair<void (*)(), const char*> tests[] = {
+        { test_culling, "culling" },
+        { test_aliasing, "aliasing" },
+        { test_barriers, "barriers" },
+        { test_plan_reuse, "plan reuse" }
+    };
+    for (const auto& [test, name] : tests)
+    {
+        const uint32_t failures = failure_count;
+        test();
+        if (failure_count == failures)
+        {
+            LOG_INFO(std::string(name) + " passed.");
+        }
+        else
+        {
+            LOG_ERROR(std::string(name) + " failed.");
+        }
+    }
+    return failure_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "shader/shader_compiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 每个排列是一对 triangle_vs/triangle_ps, 用不被着色器使用的宏区分, 每个排列的请求键不同.
+// seed 也作为宏参与请求键, 换一个 seed 时所有请求都不在 shader 缓存中.
+static std::vector<fantasy::ShaderCompileDesc> get_permutations(uint32_t count, uint64_t seed)
+{
+    std::vector<fantasy::ShaderCompileDesc> descs;
+    descs.reserve(count * 2);
+    for (uint32_t ix = 0; ix < count; ++ix)
+    {
+        const std::vector<std::string> defines = {
+            "SHADER_BENCH_SEED=" + std::to_string(seed),
+            "SHADER_BENCH_VARIANT=" + std::to_string(ix)
+        };
+
+        fantasy::ShaderCompileDesc& vs_desc = descs.emplace_back();
+        vs_desc.shader_name = "triangle_vs.slang";
+        vs_desc.entry_point = "main";
+        vs_desc.target = fantasy::ShaderTarget::Vertex;
+        vs_desc.defines = defines;
+
+        fantasy::ShaderCompileDesc& ps_desc = descs.emplace_back();
+        ps_desc.shader_name = "triangle_ps.slang";
+        ps_desc.entry_point = "main";
+        ps_desc.target = fantasy::ShaderTarget::Pixel;
+        ps_desc.defines = defines;
+    }
+    return descs;
+}
+
+static bool compile_batch(const std::vector<fantasy::ShaderCompileDesc>& descs, float& out_seconds)
+{
+    fantasy::Timer timer;
+    bool ret = true;
+    for (const auto& future : fantasy::compile_shaders(descs)) ret = !future.get().invalid() && ret;
+    out_seconds = timer.elapsed();
+    return ret;
+}
+
+static bool compile_serial(const std::vector<fantasy::ShaderCompileDesc>& descs, float& out_seconds)
+{
+    fantasy::Timer timer;
+    bool ret = true;
+    for (const auto& desc : descs) ret = !fantasy::compile_shader(desc).invalid() && ret;
+    out_seconds = timer.elapsed();
+    return ret;
+}
+
+// 用法: shader_bench [--count N] [--seed N] [--serial]
+// 用 compile_shaders() 在线程池上编译 N 个 (默认 500) 排列, 第一次都不在 shader 缓存中 (冷启动),
+// 第二次同样的请求全部命中缓存 (热启动), 输出两次的时间. --serial 时再用另一个 seed 在当前线程依次冷编译一遍作为对比.
+// 默认 seed 取当前时间, 每次运行都会向 asset/shader_cache 追加 N 组新条目; 指定上次的 --seed 时两次都从磁盘缓存读取.
+int main(int argc, char** argv)
+{
+    uint32_t count = 500;
+    uint64_t seed = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    bool serial = false;
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--count") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--seed") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') seed = std::stoull(argv[++ix]);
+            else if (strcmp(argv[ix], "--serial") == 0) serial = true;
+            else count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        count = 0;
+    }
+    if (count == 0)
+    {
+        LOG_ERROR("Usage: shader_bench [--count N] [--seed N] [--serial]");
+        return 1;
+    }
+
+    fantasy::parallel::initialize();
+    fantasy::set_shader_platform(fantasy::ShaderPlatform::SPIRV);
+
+    const std::vector<fantasy::ShaderCompileDesc> descs = get_permutations(count, seed);
+    const std::string shader_count = std::to_string(descs.size()) + " shaders";
+    LOG_INFO(std::to_string(count) + " permutations, seed " + std::to_string(seed) + ".");
+
+    float cold_seconds = 0.0f;
+    float warm_seconds = 0.0f;
+    bool ret = compile_batch(descs, cold_seconds);
+    if (ret)
+    {
+        LOG_INFO("compile_shaders cold: " + shader_count + " in " + std::to_string(cold_seconds * 1000.0f) + " ms.");
+        ret = compile_batch(descs, warm_seconds);
+    }
+    if (ret)
+    {
+        LOG_INFO("compile_shaders warm: " + shader_count + " in " + std::to_string(warm_seconds * 1000.0f) + " ms.");
+    }
+
+    if (ret && serial)
+    {
+        float serial_seconds = 0.0f;
+        ret = compile_serial(get_permutations(count, seed + 1), serial_seconds);
+        if (ret)
+        {
+            LOG_INFO(
+                "compile_shader cold: " + shader_count + " in " + std::to_string(serial_seconds * 1000.0f) + " ms, " +
+                std::to_string(serial_seconds / std::max(cold_seconds, 1e-6f)) + "x the batch time."
+            );
+        }
+    }
+
+    if (!ret) LOG_ERROR("Compile shaders failed.");
+
+    fantasy::parallel::destroy();
+    return ret ? 0 : 1;
+}
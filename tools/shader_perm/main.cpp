@@ -0,0 +1,79 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "shader/shader_permutation.h"
+#include <cstring>
+#include <string>
+
+// 用法: shader_perm <shader 文件> <入口> <vs|ps|cs> <输出文件> [--bool NAME] [--enum NAME A,B,...] [--define X]
+// shader 文件为 source/shader 下的相对路径, 编译所有排列写入存档后重新 load 一次作为校验.
+int main(int argc, char** argv)
+{
+    const char* usage = "Usage: shader_perm <shader file> <entry point> <vs|ps|cs> <output archive> [--bool NAME] [--enum NAME A,B,...] [--define X]";
+    if (argc < 5)
+    {
+        LOG_ERROR(usage);
+        return 1;
+    }
+
+    fantasy::ShaderCompileDesc desc;
+    desc.shader_name = argv[1];
+    desc.entry_point = argv[2];
+    if (strcmp(argv[3], "vs") == 0) desc.target = fantasy::ShaderTarget::Vertex;
+    else if (strcmp(argv[3], "ps") == 0) desc.target = fantasy::ShaderTarget::Pixel;
+    else if (strcmp(argv[3], "cs") == 0) desc.target = fantasy::ShaderTarget::Compute;
+    else
+    {
+        LOG_ERROR(usage);
+        return 1;
+    }
+
+    fantasy::ShaderPermutationDesc permutation_desc;
+    for (int ix = 5; ix < argc; ++ix)
+    {
+        if (strcmp(argv[ix], "--bool") == 0 && ix + 1 < argc) permutation_desc.add_bool(argv[++ix]);
+        else if (strcmp(argv[ix], "--define") == 0 && ix + 1 < argc) desc.defines.push_back(argv[++ix]);
+        else if (strcmp(argv[ix], "--enum") == 0 && ix + 2 < argc)
+        {
+            const std::string name = argv[++ix];
+            const std::string list = argv[++ix];
+
+            std::vector<std::string> values;
+            for (size_t begin = 0; begin <= list.size();)
+            {
+                size_t end = list.find(',', begin);
+                if (end == std::string::npos) end = list.size();
+                if (end > begin) values.push_back(list.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            if (values.empty())
+            {
+                LOG_ERROR(usage);
+                return 1;
+            }
+            permutation_desc.add_enum(name, values);
+        }
+        else
+        {
+            LOG_ERROR(usage);
+            return 1;
+        }
+    }
+
+    fantasy::parallel::initialize();
+    fantasy::set_shader_platform(fantasy::ShaderPlatform::SPIRV);
+
+    fantasy::Timer timer;
+    bool ret = fantasy::build_shader_permutation_archive(desc, permutation_desc, argv[4]);
+    const float seconds = timer.elapsed();
+
+    fantasy::ShaderPermutationArchive archive;
+    ret = ret && archive.load(argv[4], desc, permutation_desc);
+    if (ret)
+    {
+        LOG_INFO("Built " + std::to_string(archive.variant_count()) + " variants into " + argv[4] + " in " + std::to_string(seconds) + " s.");
+    }
+
+    fantasy::parallel::destroy();
+    return ret ? 0 : 1;
+}
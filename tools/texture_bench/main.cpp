@@ -0,0 +1,91 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "texture/texture_cooker.h"
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// 用法: texture_bench [--size N] [--repeat N] [--linear] [--no-mips]
+// 生成 N * N 的图片 (默认 2048), 对每种格式统计 cook_texture() 生成 mip 并压缩的耗时, 不包括解码.
+// 吞吐量按第 0 级 mip 的像素数计算.
+int main(int argc, char** argv)
+{
+    uint32_t size = 2048;
+    uint32_t repeat_count = 3;
+    fantasy::TextureCookOptions options;
+    for (int ix = 1; ix < argc; ++ix)
+    {
+        if (strcmp(argv[ix], "--size") == 0 && ix + 1 < argc) size = static_cast<uint32_t>(std::stoul(argv[++ix]));
+        else if (strcmp(argv[ix], "--repeat") == 0 && ix + 1 < argc) repeat_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+        else if (strcmp(argv[ix], "--linear") == 0) options.srgb = false;
+        else if (strcmp(argv[ix], "--no-mips") == 0) options.generate_mips = false;
+    }
+    if (size == 0 || repeat_count == 0)
+    {
+        LOG_ERROR("Usage: texture_bench [--size N] [--repeat N] [--linear] [--no-mips]");
+        return 1;
+    }
+
+    // 平滑的渐变加上少量高频变化, 接近真实贴图, 块压缩的端点搜索不会退化.
+    std::vector<uint8_t> pixels(static_cast<uint64_t>(size) * size * 4);
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint8_t* pixel = pixels.data() + (static_cast<uint64_t>(y) * size + x) * 4;
+            pixel[0] = static_cast<uint8_t>(x * 255 / size);
+            pixel[1] = static_cast<uint8_t>(y * 255 / size);
+            pixel[2] = static_cast<uint8_t>(127.5f + 127.5f * std::sin(x * 0.05f) * std::cos(y * 0.07f));
+            pixel[3] = static_cast<uint8_t>(((x ^ y) & 0x1f) * 8);
+        }
+    }
+
+    fantasy::parallel::initialize();
+    LOG_INFO(
+        std::to_string(size) + "x" + std::to_string(size) + (options.srgb ? " srgb" : " linear") +
+        (options.generate_mips ? " with mips" : " without mips") + ", " + std::to_string(fantasy::parallel::thread_count()) + " threads."
+    );
+
+    const std::pair<fantasy::TextureFormat, const char*> formats[] = {
+        { fantasy::TextureFormat::RGBA8, "RGBA8" },
+        { fantasy::TextureFormat::BC1, "BC1" },
+        { fantasy::TextureFormat::BC5, "BC5" },
+        { fantasy::TextureFormat::BC7, "BC7" }
+    };
+
+    bool ret = true;
+    for (const auto& [format, name] : formats)
+    {
+        options.format = format;
+
+        // 取多次中最快的一次, 减少其他进程的干扰.
+        float best_seconds = 0.0f;
+        for (uint32_t ix = 0; ix < repeat_count; ++ix)
+        {
+            fantasy::CookedTexture texture;
+            fantasy::Timer timer;
+            if (!fantasy::cook_texture(pixels, size, size, options, texture))
+            {
+                ret = false;
+                break;
+            }
+            const float seconds = timer.elapsed();
+            if (ix == 0 || seconds < best_seconds) best_seconds = seconds;
+        }
+        if (!ret) break;
+
+        const double mega_pixels = static_cast<double>(size) * size / 1000000.0;
+        LOG_INFO(
+            std::string(name) + ": " + std::to_string(best_seconds * 1000.0f) + " ms, " +
+            std::to_string(mega_pixels / std::max(best_seconds, 1e-6f)) + " MPixels/s."
+        );
+    }
+
+    fantasy::parallel::destroy();
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "core/tools/tlsf_allocator.h"
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Operation
+{
+    bool allocate = false;
+    uint64_t size = 0;
+    uint64_t alignment = 1;
+    uint32_t release_index = 0;     // 释放时在存活分配中的随机位置.
+};
+
+// 大小按对数均匀分布在 [64, max_size] 之间, 对齐从 1 到 4096 随机选取, 接近 GPU 资源的子分配.
+// 分配和释放大约各占一半, 存活的分配数随机游走, 容量用尽后分配开始失败.
+static std::vector<Operation> generate_operations(uint32_t count, uint64_t max_size, uint32_t seed)
+{
+    std::mt19937_64 random(seed);
+    std::uniform_real_distribution<double> size_distribution(std::log2(64.0), std::log2(static_cast<double>(max_size)));
+    const uint64_t alignments[] = { 1, 16, 256, 4096 };
+
+    std::vector<Operation> operations(count);
+    for (auto& operation : operations)
+    {
+        operation.allocate = (random() & 1) == 0;
+        operation.size = static_cast<uint64_t>(std::exp2(size_distribution(random)));
+        operation.alignment = alignments[random() % 4];
+        operation.release_index = static_cast<uint32_t>(random());
+    }
+    return operations;
+}
+
+// 执行所有操作, 没有存活的分配时改为分配. check 为 true 时用区间表检查每次分配是否与存活的分配重叠,
+// 并记录执行到一半时的统计, 用来观察碎片.
+static bool run(
+    fantasy::TlsfAllocator& allocator,
+    const std::vector<Operation>& operations,
+    bool check,
+    uint64_t& out_failed_count,
+    fantasy::TlsfStats& out_half_stats
+)
+{
+    std::vector<fantasy::TlsfAllocation> live;
+    std::map<uint64_t, uint64_t> ranges;   // offset -> end.
+    out_failed_count = 0;
+
+    for (uint64_t ix = 0; ix < operations.size(); ++ix)
+    {
+        const Operation& operation = operations[ix];
+        if (check && ix == operations.size() / 2) out_half_stats = allocator.get_stats();
+
+        if (operation.allocate || live.empty())
+        {
+            const fantasy::TlsfAllocation allocation = allocator.allocate(operation.size, operation.alignment);
+            if (!allocation.valid())
+            {
+                out_failed_count++;
+                continue;
+            }
+            if (check)
+            {
+                const uint64_t end = allocation.offset + allocation.size;
+                auto next = ranges.lower_bound(allocation.offset);
+                const bool overlap =
+                    (next != ranges.end() && next->first < end) ||
+                    (next != ranges.begin() && std::prev(next)->second > allocation.offset);
+                if (
+                    overlap ||
+                    allocation.size < operation.size ||
+                    allocation.offset % operation.alignment != 0 ||
+                    end > allocator.capacity()
+                )
+                {
+                    LOG_ERROR(
+                        "Bad allocation [" + std::to_string(allocation.offset) + ", " + std::to_string(end) + ") for size " +
+                        std::to_string(operation.size) + " alignment " + std::to_string(operation.alignment) + "."
+                    );
+                    return false;
+                }
+                ranges.emplace(allocation.offset, end);
+            }
+            live.push_back(allocation);
+        }
+        else
+        {
+            const uint32_t index = operation.release_index % live.size();
+            if (check) ranges.erase(live[index].offset);
+            allocator.release(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+
+    if (check)
+    {
+        uint64_t used_size = 0;
+        for (const auto& [offset, end] : ranges) used_size += end - offset;
+        if (used_size != allocator.used_size() || live.size() != allocator.get_stats().allocation_count)
+        {
+            LOG_ERROR("Allocator statistics don't match the live allocations.");
+            return false;
+        }
+    }
+
+    for (const auto& allocation : live) allocator.release(allocation);
+
+    // 全部释放后应当合并回一个完整的空闲块.
+    const fantasy::TlsfStats stats = allocator.get_stats();
+    if (!allocator.empty() || stats.free_block_count != 1 || stats.largest_free_size != allocator.capacity())
+    {
+        LOG_ERROR("Free blocks are not merged after releasing all allocations.");
+        return false;
+    }
+    return true;
+}
+
+// 用法: tlsf_bench [--capacity MB] [--ops N] [--max-size KB] [--seed N]
+// 先带重叠检查执行一遍随机的分配和释放, 再不带检查计时执行同样的操作, 输出每秒操作数,
+// 以及执行到一半时的最大空闲块和空闲块个数.
+int main(int argc, char** argv)
+{
+    uint64_t capacity_mb = 256;
+    uint32_t operation_count = 1000000;
+    uint64_t max_size_kb = 4096;
+    uint32_t seed = 1;
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--capacity") == 0 && ix + 1 < argc) capacity_mb = std::stoull(argv[++ix]);
+            else if (strcmp(argv[ix], "--ops") == 0 && ix + 1 < argc) operation_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--max-size") == 0 && ix + 1 < argc) max_size_kb = std::stoull(argv[++ix]);
+            else if (strcmp(argv[ix], "--seed") == 0 && ix + 1 < argc) seed = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else operation_count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        operation_count = 0;
+    }
+    if (operation_count == 0 || capacity_mb == 0 || max_size_kb == 0 || capacity_mb > (1ull << 40))
+    {
+        LOG_ERROR("Usage: tlsf_bench [--capacity MB] [--ops N] [--max-size KB] [--seed N]");
+        return 1;
+    }
+
+    const uint64_t capacity = capacity_mb * 1024 * 1024;
+    const std::vector<Operation> operations = generate_operations(operation_count, max_size_kb * 1024, seed);
+
+    fantasy::TlsfAllocator allocator(capacity);
+    uint64_t failed_count = 0;
+    fantasy::TlsfStats half_stats;
+    if (!run(allocator, operations, true, failed_count, half_stats)) return 1;
+
+    fantasy::TlsfStats unused_stats;
+    fantasy::Timer timer;
+    if (!run(allocator, operations, false, failed_count, unused_stats)) return 1;
+    const float seconds = timer.elapsed();
+
+    LOG_INFO(
+        std::to_string(operation_count) + " operations in " + std::to_string(seconds * 1000.0f) + " ms, " +
+        std::to_string(static_cast<uint64_t>(operation_count / seconds)) + " ops/s, " +
+        std::to_string(failed_count) + " allocations failed."
+    );
+    LOG_INFO(
+        "Halfway: " + std::to_string(half_stats.allocation_count) + " allocations, " +
+        std::to_string(half_stats.used_size / 1024) + " KB used of " + std::to_string(capacity / 1024) + " KB, " +
+        std::to_string(half_stats.free_block_count) + " free blocks, largest " + std::to_string(half_stats.largest_free_size / 1024) + " KB."
+    );
+    return 0;
+}
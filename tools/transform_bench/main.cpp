@@ -0,0 +1,134 @@
+#include "core/parallel/parallel.h"
+#include "core/tools/log.h"
+#include "core/tools/timer.h"
+#include "scene/transform_hierarchy.h"
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace fantasy;
+
+static Quaternion random_rotation(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+    return normalize(Quaternion(component(random), component(random), component(random), component(random) + 2.0f));
+}
+
+// 逐个节点用标量函数计算世界矩阵, 与 update() 的结果比较. 节点 id 总是大于父节点 id, 按 id 顺序即可.
+static bool check_world_matrices(const TransformHierarchy& hierarchy)
+{
+    const uint32_t count = hierarchy.node_count();
+    std::vector<float4x4> world_matrices(count);
+    for (uint32_t node = 0; node < count; ++node)
+    {
+        const float4x4 local = mul(mul(scale(hierarchy.get_scale(node)), hierarchy.get_rotation(node).to_matrix()), translate(hierarchy.get_position(node)));
+        const uint32_t parent = hierarchy.get_parent(node);
+        world_matrices[node] = parent == INVALID_SIZE_32 ? local : mul(local, world_matrices[parent]);
+
+        const float4x4& result = hierarchy.get_world_matrix(node);
+        for (uint32_t row = 0; row < 4; ++row)
+        {
+            for (uint32_t column = 0; column < 4; ++column)
+            {
+                const float expected = world_matrices[node][row][column];
+                if (std::abs(result[row][column] - expected) > 1e-3f * (1.0f + std::abs(expected)))
+                {
+                    LOG_ERROR("World matrix of node " + std::to_string(node) + " doesn't match the scalar reference.");
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// 用法: transform_bench [--nodes N] [--roots N] [--dirty PERCENT] [--repeat N]
+// 生成 N 个 (默认 10 万) 节点, 分成若干棵随机树 (每个节点的父节点在同一棵树中先添加的节点里随机选取),
+// 分别统计全部节点修改, 部分节点修改和没有修改时串行与并行 update() 的时间 (取多次中最快的一次), 并用标量实现校验结果.
+int main(int argc, char** argv)
+{
+    uint32_t node_count = 100000;
+    uint32_t root_count = 100;
+    uint32_t dirty_percent = 1;
+    uint32_t repeat_count = 5;
+    try
+    {
+        for (int ix = 1; ix < argc; ++ix)
+        {
+            if (strcmp(argv[ix], "--nodes") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') node_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--roots") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') root_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--dirty") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') dirty_percent = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else if (strcmp(argv[ix], "--repeat") == 0 && ix + 1 < argc && argv[ix + 1][0] != '-') repeat_count = static_cast<uint32_t>(std::stoul(argv[++ix]));
+            else node_count = 0;
+        }
+    }
+    catch (const std::exception&)
+    {
+        node_count = 0;
+    }
+    if (node_count == 0 || root_count == 0 || root_count > node_count || dirty_percent > 100 || repeat_count == 0)
+    {
+        LOG_ERROR("Usage: transform_bench [--nodes N] [--roots N] [--dirty PERCENT] [--repeat N]");
+        return 1;
+    }
+
+    parallel::initialize();
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale_factor(0.9f, 1.1f);
+    auto random_position = [&]() { return float3(coordinate(random), coordinate(random), coordinate(random)); };
+    auto random_scale = [&]() { return float3(scale_factor(random)); };
+
+    TransformHierarchy hierarchy;
+    const uint32_t tree_size = (node_count + root_count - 1) / root_count;
+    uint32_t tree_begin = 0;
+    for (uint32_t node = 0; node < node_count; ++node)
+    {
+        if (node % tree_size == 0) tree_begin = node;
+        const uint32_t parent = node == tree_begin ? INVALID_SIZE_32 : tree_begin + random() % (node - tree_begin);
+        hierarchy.add_node(parent, random_position(), random_rotation(random), random_scale());
+    }
+
+    Timer build_timer;
+    hierarchy.update();
+    LOG_INFO(
+        std::to_string(node_count) + " nodes in " + std::to_string(root_count) + " trees, first update (with sorting) " +
+        std::to_string(build_timer.elapsed() * 1000.0f) + " ms."
+    );
+
+    bool ret = check_world_matrices(hierarchy);
+
+    const uint32_t dirty_count = static_cast<uint32_t>(static_cast<uint64_t>(node_count) * dirty_percent / 100);
+    auto run = [&](const std::string& name, uint32_t modify_count, bool parallel)
+    {
+        float best_seconds = 0.0f;
+        for (uint32_t ix = 0; ix < repeat_count && ret; ++ix)
+        {
+            // 修改本身不计入时间.
+            for (uint32_t jx = 0; jx < modify_count; ++jx)
+            {
+                const uint32_t node = modify_count == node_count ? jx : random() % node_count;
+                hierarchy.set_local_transform(node, random_position(), random_rotation(random), random_scale());
+            }
+
+            Timer timer;
+            hierarchy.update(parallel);
+            const float seconds = timer.elapsed();
+            if (ix == 0 || seconds < best_seconds) best_seconds = seconds;
+        }
+        ret = ret && check_world_matrices(hierarchy);
+        if (ret) LOG_INFO("    " + name + (parallel ? " parallel: " : " serial: ") + std::to_string(best_seconds * 1000.0f) + " ms.");
+    };
+    for (bool parallel : { false, true })
+    {
+        run("all dirty", node_count, parallel);
+        run(std::to_string(dirty_percent) + "% dirty", dirty_count, parallel);
+        run("clean", 0, parallel);
+    }
+
+    parallel::destroy();
+    return ret ? 0 : 1;
+}
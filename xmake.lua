@@ -1,6 +1,6 @@
 add_rules("mode.debug", "mode.release")
 add_rules("plugin.compile_commands.autoupdate", {outputdir = "$(projectdir)"})
-add_requires("spdlog", "glfw", "vulkansdk", "slang", "stb")
+add_requires("spdlog", "glfw", "vulkansdk", "slang", "stb", "zstd")
 
 local proj_dir = os.projectdir()
 local normalized_proj_dir = proj_dir:gsub("\\", "/")
@@ -16,6 +16,219 @@ target("learn-vulkan")
         "CLIENT_HEIGHT=768",
         "PROJ_DIR=\"" .. normalized_proj_dir .. "/\""
     )
+    -- release 模式下编译的 shader 不带调试信息, 并删除 SPIR-V 中的调试指令, 也不监视 shader 目录.
+    if is_mode("debug") then
+        add_defines("SHADER_DEBUG_INFO", "SHADER_HOT_RELOAD")
+    end
     add_files("$(projectdir)/source/**.cpp")
-    add_packages("spdlog", "glfw", "vulkansdk", "slang", "stb")
-target_end()
\ No newline at end of file
+    add_packages("spdlog", "glfw", "vulkansdk", "slang", "stb", "zstd")
+target_end()
+
+-- 资源打包工具: fpak <资源目录> <输出文件> [--compress] [--align N]
+target("fpak")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/fpak/main.cpp",
+        "$(projectdir)/source/core/tools/asset_archive.cpp",
+        "$(projectdir)/source/core/tools/file_mapping.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog", "zstd")
+target_end()
+-- LOD 链构建的性能测试: lod_bench [--grid N] [--lods N]
+target("lod_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/lod_bench/main.cpp",
+        "$(projectdir)/source/mesh/mesh_simplifier.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/math/*.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- 包围球构建的性能测试: bounds_bench [--points N] [--repeat N] [--seed N]
+target("bounds_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/bounds_bench/main.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/math/*.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- 变换层级更新的性能测试: transform_bench [--nodes N] [--roots N] [--dirty PERCENT] [--repeat N]
+target("transform_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/transform_bench/main.cpp",
+        "$(projectdir)/source/scene/transform_hierarchy.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/math/*.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- cluster lod dag 离线构建工具: cluster_build <输入 .obj> <输出文件> [--cluster-triangles 64|128] [--group-clusters N]
+target("cluster_build")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/cluster_build/main.cpp",
+        "$(projectdir)/source/mesh/cluster_builder.cpp",
+        "$(projectdir)/source/mesh/mesh_simplifier.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/math/*.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp",
+        "$(projectdir)/source/core/tools/serialization.cpp",
+        "$(projectdir)/source/core/tools/file_mapping.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- 离线编译 shader 的所有排列: shader_perm <shader 文件> <入口> <vs|ps|cs> <输出文件> [--bool NAME] [--enum NAME A,B,...] [--define X]
+target("shader_perm")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines(
+        "NDEBUG",
+        "DEBUG",
+        "NOMINMAX",
+        "PROJ_DIR=\"" .. normalized_proj_dir .. "/\""
+    )
+    if is_mode("debug") then
+        add_defines("SHADER_DEBUG_INFO")
+    end
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/shader_perm/main.cpp",
+        "$(projectdir)/source/shader/*.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/tools/file_mapping.cpp",
+        "$(projectdir)/source/core/tools/file_watcher.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog", "slang")
+target_end()
+
+-- 批量编译 shader 冷启动和热启动的时间: shader_bench [--count N] [--seed N] [--serial]
+target("shader_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines(
+        "NDEBUG",
+        "DEBUG",
+        "NOMINMAX",
+        "PROJ_DIR=\"" .. normalized_proj_dir .. "/\""
+    )
+    if is_mode("debug") then
+        add_defines("SHADER_DEBUG_INFO")
+    end
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/shader_bench/main.cpp",
+        "$(projectdir)/source/shader/*.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/tools/file_mapping.cpp",
+        "$(projectdir)/source/core/tools/file_watcher.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog", "slang")
+target_end()
+
+-- 贴图烘焙的性能测试: texture_bench [--size N] [--repeat N] [--linear] [--no-mips]
+target("texture_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/texture_bench/main.cpp",
+        "$(projectdir)/source/texture/*.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp"
+    )
+    add_packages("spdlog", "stb")
+target_end()
+
+-- 小文件读取的性能测试, 分别统计冷启动和热启动: io_bench [--files N] [--min-size B] [--max-size B] [--repeat N]
+target("io_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/io_bench/main.cpp",
+        "$(projectdir)/source/core/tools/async_file_io.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- TLSF 分配器的随机测试和性能测试: tlsf_bench [--capacity MB] [--ops N] [--max-size KB] [--seed N]
+target("tlsf_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/tlsf_bench/main.cpp",
+        "$(projectdir)/source/core/tools/tlsf_allocator.cpp"
+    )
+    add_packages("spdlog")
+target_end()
+
+-- 管线缓存冷启动和热启动的创建时间, 需要 Vulkan 1.3 设备: pipeline_bench [--count N] [--cache PATH]
+target("pipeline_bench")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines(
+        "NDEBUG",
+        "DEBUG",
+        "NOMINMAX",
+        "NUM_FRAMES_IN_FLIGHT=3u",
+        "PROJ_DIR=\"" .. normalized_proj_dir .. "/\""
+    )
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/pipeline_bench/main.cpp",
+        "$(projectdir)/source/gpu/pipeline_cache.cpp",
+        "$(projectdir)/source/gpu/bindless_descriptor_heap.cpp",
+        "$(projectdir)/source/shader/*.cpp",
+        "$(projectdir)/source/core/parallel/*.cpp",
+        "$(projectdir)/source/core/tools/file_mapping.cpp",
+        "$(projectdir)/source/core/tools/file_watcher.cpp",
+        "$(projectdir)/source/core/tools/hash_table.cpp"
+    )
+    add_packages("spdlog", "vulkansdk", "slang")
+target_end()
+
+-- 渲染图编译的测试, 不需要 GPU: render_graph_test
+target("render_graph_test")
+    set_kind("binary")
+    set_languages("c++20")
+    add_defines("NDEBUG", "DEBUG", "NOMINMAX")
+    add_includedirs("$(projectdir)/source")
+    add_files(
+        "$(projectdir)/tools/render_graph_test/main.cpp",
+        "$(projectdir)/source/gpu/render_graph.cpp"
+    )
+    add_packages("spdlog", "vulkansdk")
+target_end()